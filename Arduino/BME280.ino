@@ -4,149 +4,246 @@
 // This code is designed to work with the BME280_I2CS I2C Mini Module available from ControlEverything.com.
 // https://www.controleverything.com/content/Humidity?sku=BME280_I2CS#tabs-0-product_tabset-2
 
+// Low-power loop: calibration is read once, each sample triggers a single
+// forced-mode conversion, and between samples the sensor returns to sleep
+// on its own while the MCU powers down and is woken by the watchdog.
+
 #include<Wire.h>
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#endif
 
 // BME280 I2C address is 0x76(108)
 #define Addr 0x76
 
-void setup()
-{
-  // Initialise I2C communication as MASTER
-  Wire.begin();
-  // Initialise Serial communication, set baud rate = 9600
-  Serial.begin(9600);
-}
+// Seconds between samples
+#define SAMPLE_PERIOD_S 60
 
-void loop()
+// Oversampling x1 for humidity, temperature and pressure
+#define OSRS_H 1
+#define OSRS_T 1
+#define OSRS_P 1
+// ctrl_meas: osrs_t[7:5], osrs_p[4:2], forced mode (01)
+#define CTRL_MEAS_FORCED ((OSRS_T << 5) | (OSRS_P << 2) | 0x01)
+
+// Currents for the average-current estimate, in microamps
+#define I_MCU_ACTIVE_UA   5000.0  // ATmega328P at 8-16 MHz incl. I2C and UART
+#define I_MCU_SLEEP_UA       5.0  // Power-down with watchdog enabled
+#define I_SENSOR_MEAS_UA   700.0  // BME280 during a T+P+H conversion
+#define I_SENSOR_SLEEP_UA    0.1  // BME280 sleep mode
+#define T_AWAKE_OVERHEAD_MS 3.0   // I2C transfers and compensation
+
+// Serial output; the report is flushed before sleeping, so it keeps the MCU awake
+#define SERIAL_BAUD  9600
+#define REPORT_BYTES  125         // Typical four-line report printed per sample
+
+unsigned int dig_T1, dig_P1, dig_H1, dig_H3;
+int dig_T2, dig_T3, dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
+int dig_H2, dig_H4, dig_H5, dig_H6;
+
+// Maximum measurement time in ms from the datasheet (section 9.1)
+unsigned int measurementTimeMs()
 {
-  unsigned int b1[24];
-  unsigned int data[8];
-  unsigned int dig_H1 = 0;
-  for(int i = 0; i < 24; i++)
+  float t = 1.25 + 2.3 * OSRS_T;
+  if(OSRS_P)
   {
-    // Start I2C Transmission
-    Wire.beginTransmission(Addr);
-    // Select data register
-    Wire.write((136+i));
-    // Stop I2C Transmission
-    Wire.endTransmission();
-
-    // Request 1 byte of data
-    Wire.requestFrom(Addr, 1);
-
-    // Read 24 bytes of data
-    if(Wire.available() == 1)
-    {
-      b1[i] = Wire.read();
-    }
+    t += 2.3 * OSRS_P + 0.575;
+  }
+  if(OSRS_H)
+  {
+    t += 2.3 * OSRS_H + 0.575;
   }
+  return (unsigned int)(t + 0.999);
+}
 
-  // Convert the data
-  // temp coefficients
-  unsigned int dig_T1 = (b1[0] & 0xff) + ((b1[1] & 0xff) * 256);
-  int dig_T2 = b1[2] + (b1[3] * 256);
-  int dig_T3 = b1[4] + (b1[5] * 256);
-  
-  // pressure coefficients
-  unsigned int dig_P1 = (b1[6] & 0xff) + ((b1[7] & 0xff ) * 256);
-  int dig_P2 = b1[8] + (b1[9] * 256);
-  int dig_P3 = b1[10] + (b1[11] * 256);
-  int dig_P4 = b1[12] + (b1[13] * 256);
-  int dig_P5 = b1[14] + (b1[15] * 256);
-  int dig_P6 = b1[16] + (b1[17] * 256);
-  int dig_P7 = b1[18] + (b1[19] * 256);
-  int dig_P8 = b1[20] + (b1[21] * 256);
-  int dig_P9 = b1[22] + (b1[23] * 256);
+// Average supply current in uA for one forced conversion every periodS seconds
+float averageCurrentUa(float periodS)
+{
+  float measS = measurementTimeMs() / 1000.0;
+  // 10 bit times per byte on the UART (start, 8 data, stop)
+  float printS = REPORT_BYTES * 10.0 / SERIAL_BAUD;
+  float awakeS = measS + T_AWAKE_OVERHEAD_MS / 1000.0 + printS;
+  float mcu = (I_MCU_ACTIVE_UA * awakeS + I_MCU_SLEEP_UA * (periodS - awakeS)) / periodS;
+  float sensor = (I_SENSOR_MEAS_UA * measS + I_SENSOR_SLEEP_UA * (periodS - measS)) / periodS;
+  return mcu + sensor;
+}
 
+void writeRegister(byte reg, byte value)
+{
+  // Start I2C Transmission
+  Wire.beginTransmission(Addr);
+  // Select register
+  Wire.write(reg);
+  // Write value
+  Wire.write(value);
+  // Stop I2C Transmission
+  Wire.endTransmission();
+}
+
+// Burst read: the register address auto-increments after each byte
+void readRegisters(byte reg, byte *buf, byte len)
+{
   // Start I2C Transmission
   Wire.beginTransmission(Addr);
   // Select data register
-  Wire.write(161);
+  Wire.write(reg);
   // Stop I2C Transmission
   Wire.endTransmission();
 
-  // Request 1 byte of data
-  Wire.requestFrom(Addr, 1);
-  
-  // Read 1 byte of data
-  if(Wire.available() == 1)
+  // Request len bytes of data
+  Wire.requestFrom(Addr, (int)len);
+  for(byte i = 0; i < len && Wire.available(); i++)
   {
-    dig_H1 = Wire.read();
+    buf[i] = Wire.read();
   }
+}
 
-  for(int i = 0; i < 7; i++)
+#if defined(__AVR__)
+ISR(WDT_vect)
+{
+  // Wake-up only
+}
+
+// Power down for the given number of seconds in watchdog-sized steps
+void sleepSeconds(unsigned int seconds)
+{
+  byte adcsra = ADCSRA;
+  // Disable the ADC while asleep
+  ADCSRA = 0;
+  while(seconds > 0)
   {
-    // Start I2C Transmission
-    Wire.beginTransmission(Addr);
-    // Select data register
-    Wire.write((225+i));
-    // Stop I2C Transmission
-    Wire.endTransmission();
-    
-    // Request 1 byte of data
-    Wire.requestFrom(Addr, 1);
-    
-    // Read 7 bytes of data
-    if(Wire.available() == 1)
+    byte prescaler;
+    unsigned int step;
+    if(seconds >= 8)
+    {
+      prescaler = (1 << WDP3) | (1 << WDP0);
+      step = 8;
+    }
+    else if(seconds >= 4)
     {
-      b1[i] = Wire.read();
+      prescaler = (1 << WDP3);
+      step = 4;
     }
+    else if(seconds >= 2)
+    {
+      prescaler = (1 << WDP2) | (1 << WDP1) | (1 << WDP0);
+      step = 2;
+    }
+    else
+    {
+      prescaler = (1 << WDP2) | (1 << WDP1);
+      step = 1;
+    }
+
+    // Watchdog in interrupt-only mode
+    cli();
+    MCUSR &= ~(1 << WDRF);
+    WDTCSR = (1 << WDCE) | (1 << WDE);
+    WDTCSR = (1 << WDIE) | prescaler;
+    sei();
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    sleep_cpu();
+    sleep_disable();
+
+    wdt_disable();
+    seconds -= step;
   }
+  ADCSRA = adcsra;
+}
+#else
+void sleepSeconds(unsigned int seconds)
+{
+  delay(seconds * 1000UL);
+}
+#endif
+
+// Little-endian register pair, built in unsigned arithmetic: byte * 256
+// promotes to a 16-bit signed int on AVR and overflows for high bytes >= 0x80
+unsigned int word16(const byte *b)
+{
+  return (unsigned int)b[0] | ((unsigned int)b[1] << 8);
+}
+
+void setup()
+{
+  byte b1[24];
+
+  // Initialise I2C communication as MASTER
+  Wire.begin();
+  // Initialise Serial communication, set baud rate = 9600
+  Serial.begin(SERIAL_BAUD);
+
+  // Read 24 bytes of data from 0x88(136)
+  readRegisters(0x88, b1, 24);
+
+  // Convert the data
+  // temp coefficients
+  dig_T1 = word16(b1);
+  dig_T2 = (int16_t)word16(b1 + 2);
+  dig_T3 = (int16_t)word16(b1 + 4);
+
+  // pressure coefficients
+  dig_P1 = word16(b1 + 6);
+  dig_P2 = (int16_t)word16(b1 + 8);
+  dig_P3 = (int16_t)word16(b1 + 10);
+  dig_P4 = (int16_t)word16(b1 + 12);
+  dig_P5 = (int16_t)word16(b1 + 14);
+  dig_P6 = (int16_t)word16(b1 + 16);
+  dig_P7 = (int16_t)word16(b1 + 18);
+  dig_P8 = (int16_t)word16(b1 + 20);
+  dig_P9 = (int16_t)word16(b1 + 22);
+
+  // Read 1 byte of data from 0xA1(161)
+  readRegisters(0xA1, b1, 1);
+  dig_H1 = b1[0];
+
+  // Read 7 bytes of data from 0xE1(225)
+  readRegisters(0xE1, b1, 7);
 
   // Convert the data
   // humidity coefficients
-  int dig_H2 = b1[0] + (b1[1] * 256);
-  unsigned int dig_H3 = b1[2] & 0xFF ;
-  int dig_H4 = (b1[3] * 16) + (b1[4] & 0xF);
-  int dig_H5 = (b1[4] / 16) + (b1[5] * 16);
-  int dig_H6 = b1[6];
-  
-  // Start I2C Transmission
-  Wire.beginTransmission(Addr);
+  dig_H2 = (int16_t)word16(b1);
+  dig_H3 = b1[2] & 0xFF ;
+  dig_H4 = (b1[3] * 16) + (b1[4] & 0xF);
+  dig_H5 = (b1[4] / 16) + (b1[5] * 16);
+  // H6 is a signed byte
+  dig_H6 = (signed char)b1[6];
+
   // Select control humidity register
-  Wire.write(0xF2);
-  // Humidity over sampling rate = 1
-  Wire.write(0x01);
-  // Stop I2C Transmission
-  Wire.endTransmission();
-  
-  // Start I2C Transmission
-  Wire.beginTransmission(Addr);
-  // Select control measurement register
-  Wire.write(0xF4);
-  // Normal mode, temp and pressure over sampling rate = 1
-  Wire.write(0x27);
-  // Stop I2C Transmission
-  Wire.endTransmission();
-  
-  // Start I2C Transmission
-  Wire.beginTransmission(Addr);
+  // Humidity over sampling rate = 1 (takes effect on the next ctrl_meas write)
+  writeRegister(0xF2, OSRS_H);
   // Select config register
-  Wire.write(0xF5);
-  // Stand_by time = 1000ms
-  Wire.write(0xA0);
-  // Stop I2C Transmission
-  Wire.endTransmission();
-  
-  for(int i = 0; i < 8; i++)
-  {
-    // Start I2C Transmission
-    Wire.beginTransmission(Addr);
-    // Select data register
-    Wire.write((247+i));
-    // Stop I2C Transmission
-    Wire.endTransmission();
-    
-    // Request 1 byte of data
-    Wire.requestFrom(Addr, 1);
-    
-    // Read 8 bytes of data
-    if(Wire.available() == 1)
-    {
-      data[i] = Wire.read();
-    }
-  }
-  
+  // Filter off, standby time unused in forced mode
+  writeRegister(0xF5, 0x00);
+  // Select control measurement register
+  // Sleep mode until the first forced conversion
+  writeRegister(0xF4, CTRL_MEAS_FORCED & 0xFC);
+
+  Serial.print("Sample period : ");
+  Serial.print(SAMPLE_PERIOD_S);
+  Serial.print(" s, estimated average current : ");
+  Serial.print(averageCurrentUa(SAMPLE_PERIOD_S));
+  Serial.println(" uA");
+}
+
+void loop()
+{
+  byte data[8];
+
+  // Select control measurement register
+  // Forced mode, temp and pressure over sampling rate = 1: one conversion, then sleep
+  writeRegister(0xF4, CTRL_MEAS_FORCED);
+
+  // Wait for the maximum measurement time
+  delay(measurementTimeMs());
+
+  // Read 8 bytes of data from 0xF7(247)
+  readRegisters(0xF7, data, 8);
+
   // Convert pressure and temperature data to 19-bits
   long adc_p = (((long)(data[0] & 0xFF) * 65536) + ((long)(data[1] & 0xFF) * 256) + (long)(data[2] & 0xF0)) / 16;
   long adc_t = (((long)(data[3] & 0xFF) * 65536) + ((long)(data[4] & 0xFF) * 256) + (long)(data[5] & 0xF0)) / 16;
@@ -200,5 +297,8 @@ void loop()
   Serial.print("Relative Humidity : ");
   Serial.print(humidity);
   Serial.println(" RH");
-  delay(1000);
+
+  // Drain the UART before powering down
+  Serial.flush();
+  sleepSeconds(SAMPLE_PERIOD_S);
 }
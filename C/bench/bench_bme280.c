@@ -0,0 +1,498 @@
+/**
+ * BME280 Driver Benchmark Harness
+ *
+ * Times each stage of the read path and, where the kernel allows it,
+ * collects hardware counters per sample through perf_event_open:
+ * cycles, instructions (IPC), branch misses, L1D read misses and LLC misses.
+ * The counters are opened as one group led by cycles, with one kernel/user
+ * scope for all of them; if the PMU multiplexes the group, counts are scaled
+ * by its enabled/running time and the row is marked.
+ *
+ * The full read path runs against a socketpair standing in for the I2C bus,
+ * so it includes real write()/read() syscall costs but no bus time. The
+ * *_sim kernels run it against the out-of-process simulator (bme280_sim),
+ * which answers each transaction from another process, and also report
+ * syscalls per sample, so transfer layouts can be compared by what they
+ * cost in the kernel.
+ *
+ * Usage: bench_bme280 [iterations]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "bme280.h"
+#include "bme280_sketch.h"
+#include "bme280_sim.h"
+
+/*******************************************************************************
+ * Hardware Counters
+ ******************************************************************************/
+
+enum {
+    COUNTER_CYCLES = 0,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_COUNT
+};
+
+static const char *const counter_names[COUNTER_COUNT] = {
+    "cycles", "instr", "br-miss", "L1D-miss", "LLC-miss"
+};
+
+typedef struct {
+    int      fd[COUNTER_COUNT];   /* -1 where the counter is unavailable; cycles leads the group */
+    uint64_t id[COUNTER_COUNT];   /* Kernel ids, to match values in a group read */
+    uint64_t value[COUNTER_COUNT];
+    int      exclude_kernel;      /* Chosen once for the whole group */
+    int      running;             /* Non-zero if the group was scheduled at all */
+    double   scale;               /* time_enabled / time_running of the last read; > 1 when multiplexed */
+} counters_t;
+
+static int perf_open(uint32_t type, uint64_t config, int exclude_kernel, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd < 0;   /* Members follow the leader */
+    attr.exclude_hv = 1;
+    attr.exclude_kernel = (uint64_t)exclude_kernel;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID
+                     | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/*
+ * One group, so every counter covers the same scheduled time and the PMU
+ * multiplexes them together; IPC then divides like-for-like counts
+ */
+static void counters_open(counters_t *c)
+{
+    static const struct { uint32_t type; uint64_t config; } events[COUNTER_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                              | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                              | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES }
+    };
+
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        c->fd[i] = -1;
+        c->value[i] = 0;
+    }
+    c->running = 0;
+    c->scale = 1.0;
+
+    /* Count kernel time too when allowed: the read path is syscall-heavy */
+    c->exclude_kernel = 0;
+    int leader = perf_open(events[0].type, events[0].config, 0, -1);
+    if (leader < 0) {
+        c->exclude_kernel = 1;
+        leader = perf_open(events[0].type, events[0].config, 1, -1);
+    }
+    if (leader < 0) {
+        return;
+    }
+
+    c->fd[COUNTER_CYCLES] = leader;
+    for (int i = 1; i < COUNTER_COUNT; i++) {
+        c->fd[i] = perf_open(events[i].type, events[i].config, c->exclude_kernel, leader);
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (c->fd[i] >= 0 && ioctl(c->fd[i], PERF_EVENT_IOC_ID, &c->id[i]) != 0) {
+            close(c->fd[i]);
+            c->fd[i] = -1;
+        }
+    }
+}
+
+static void counters_close(counters_t *c)
+{
+    /* Members first, then the leader */
+    for (int i = COUNTER_COUNT - 1; i >= 0; i--) {
+        if (c->fd[i] >= 0) {
+            close(c->fd[i]);
+        }
+    }
+}
+
+static void counters_reset(counters_t *c)
+{
+    if (c->fd[COUNTER_CYCLES] >= 0) {
+        ioctl(c->fd[COUNTER_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static void counters_enable(counters_t *c, int enable)
+{
+    if (c->fd[COUNTER_CYCLES] >= 0) {
+        ioctl(c->fd[COUNTER_CYCLES], enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE,
+              PERF_IOC_FLAG_GROUP);
+    }
+}
+
+/* Group read: nr, time_enabled, time_running, then { value, id } per counter */
+static void counters_read(counters_t *c)
+{
+    uint64_t buf[3 + 2 * COUNTER_COUNT];
+
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        c->value[i] = 0;
+    }
+    c->running = 0;
+    c->scale = 1.0;
+    if (c->fd[COUNTER_CYCLES] < 0) {
+        return;
+    }
+
+    ssize_t n = read(c->fd[COUNTER_CYCLES], buf, sizeof(buf));
+    if (n < (ssize_t)(3 * sizeof(uint64_t)) || buf[2] == 0) {
+        return;
+    }
+    uint64_t nr = buf[0];
+    if (nr > COUNTER_COUNT || (size_t)n < (3 + 2 * nr) * sizeof(uint64_t)) {
+        return;
+    }
+
+    /* Scale to the enabled time if the PMU multiplexed the group */
+    c->running = 1;
+    c->scale = (double)buf[1] / (double)buf[2];
+    for (uint64_t k = 0; k < nr; k++) {
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (c->fd[i] >= 0 && c->id[i] == buf[4 + 2 * k]) {
+                c->value[i] = (uint64_t)((double)buf[3 + 2 * k] * c->scale + 0.5);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Benchmark Fixtures
+ ******************************************************************************/
+
+static const uint8_t calib_tp[24] = {
+    0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC, 0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B,
+    0x27, 0x0B, 0x8C, 0x00, 0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17
+};
+static const uint8_t calib_h1 = 75;
+static const uint8_t calib_hum[7] = { 0x6A, 0x01, 0x00, 0x13, 0x25, 0x03, 0x1E };
+static const uint8_t burst[8] = { 0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00, 0x75, 0x30 };
+
+static bme280_calib_t calib;
+static bme280_ctx_t   bus_ctx;
+static int            bus_peer = -1;
+
+/* Sink that keeps the compiler from discarding benchmark results */
+static volatile float sink;
+
+/* Samples per timed batch; untimed prepare() runs before each batch */
+#define BENCH_BATCH  256
+
+typedef struct {
+    const char *name;
+    int  (*prepare)(uint32_t count);  /* Untimed setup; 0 on success */
+    void (*run)(uint32_t count);      /* Timed kernel */
+    int  sim;                         /* Non-zero if it talks to the simulator */
+} bench_kernel_t;
+
+static int prepare_none(uint32_t count)
+{
+    (void)count;
+    return 0;
+}
+
+static void run_parse_calibration(uint32_t iterations)
+{
+    bme280_calib_t out;
+    for (uint32_t i = 0; i < iterations; i++) {
+        bme280_parse_calibration(&out, calib_tp, calib_h1, calib_hum);
+        sink = (float)out.hum.dig_H5;
+    }
+}
+
+static void run_unpack(uint32_t iterations)
+{
+    bme280_raw_t raw;
+    uint8_t buf[8];
+    memcpy(buf, burst, sizeof(buf));
+    for (uint32_t i = 0; i < iterations; i++) {
+        buf[7] = (uint8_t)i;
+        bme280_unpack_raw(buf, &raw);
+        sink = (float)raw.adc_h;
+    }
+}
+
+static void run_compensate_float(uint32_t iterations)
+{
+    bme280_raw_t raw = { 519888, 415148, 30000 };
+    bme280_data_t data;
+    for (uint32_t i = 0; i < iterations; i++) {
+        raw.adc_t = 500000 + (int32_t)(i & 0xFFFF);
+        bme280_compensate(&calib, &raw, &data, NULL);
+        sink = data.pressure_hpa;
+    }
+}
+
+static int prepare_read_path(uint32_t count)
+{
+    uint8_t drain[BENCH_BATCH];
+
+    if (bus_peer < 0) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+            return -1;
+        }
+        bme280_attach(&bus_ctx, sv[0], BME280_DEFAULT_ADDRESS);
+        bus_ctx.calib = calib;
+        bus_peer = sv[1];
+    }
+
+    /* Discard register pointer writes from the previous batch */
+    while (recv(bus_peer, drain, sizeof(drain), MSG_DONTWAIT) > 0) {
+    }
+
+    /* Queue one burst per read in the coming batch */
+    for (uint32_t i = 0; i < count; i++) {
+        if (write(bus_peer, burst, sizeof(burst)) != (ssize_t)sizeof(burst)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void run_read_path(uint32_t iterations)
+{
+    bme280_data_t data;
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (bme280_read_data(&bus_ctx, &data) == BME280_OK) {
+            sink = data.temperature_c;
+        }
+    }
+}
+
+static bme280_sim_t sim;
+static bme280_ctx_t sim_ctx;
+static int          sim_up = 0;
+
+/* Simulator with calibration read and the part configured, outside any timing */
+static int sim_setup(void)
+{
+    bme280_sim_config_t config;
+    memcpy(config.calib, calib_tp, sizeof(calib_tp));
+    config.calib[24] = calib_h1;
+    memcpy(config.calib + 25, calib_hum, sizeof(calib_hum));
+    memcpy(config.burst, burst, sizeof(burst));
+    config.conversion_us = 0;
+
+    if (bme280_sim_spawn(&sim, &config) != BME280_OK) {
+        return -1;
+    }
+    if (bme280_attach(&sim_ctx, sim.fd, BME280_DEFAULT_ADDRESS) != BME280_OK
+        || bme280_read_calibration(&sim_ctx) != BME280_OK
+        || bme280_configure(&sim_ctx) != BME280_OK) {
+        bme280_close(&sim_ctx);
+        bme280_sim_stop(&sim);
+        return -1;
+    }
+    sim_up = 1;
+    return 0;
+}
+
+static int prepare_sim_data(uint32_t count)
+{
+    (void)count;
+    return sim_up && bme280_set_read_mode(&sim_ctx, BME280_READ_DATA) == BME280_OK ? 0 : -1;
+}
+
+static int prepare_sim_verified(uint32_t count)
+{
+    (void)count;
+    return sim_up && bme280_set_read_mode(&sim_ctx, BME280_READ_VERIFIED) == BME280_OK ? 0 : -1;
+}
+
+static void run_sim_read(uint32_t iterations)
+{
+    bme280_data_t data;
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (bme280_read_data(&sim_ctx, &data) == BME280_OK) {
+            sink = data.temperature_c;
+        }
+    }
+}
+
+/* Status check as its own transfer before the data burst */
+static void run_sim_status_then_data(uint32_t iterations)
+{
+    bme280_data_t data;
+    uint8_t reg = BME280_REG_STATUS;
+    uint8_t status;
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (write(sim_ctx.fd, &reg, 1) != 1 || read(sim_ctx.fd, &status, 1) != 1
+            || (status & BME280_STATUS_MEASURING) != 0) {
+            continue;
+        }
+        if (bme280_read_data(&sim_ctx, &data) == BME280_OK) {
+            sink = data.temperature_c;
+        }
+    }
+}
+
+static bme280_sketch_t temp_sketch;
+
+static int prepare_sketch(uint32_t count)
+{
+    (void)count;
+    if (temp_sketch.gamma == 0.0
+        && bme280_sketch_init(&temp_sketch, BME280_SKETCH_DEFAULT_ALPHA) != BME280_OK) {
+        return -1;
+    }
+    return 0;
+}
+
+static void run_sketch_add(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; i++) {
+        bme280_sketch_add(&temp_sketch, 15.0 + (double)(i & 1023) * 0.01);
+    }
+    sink = (float)temp_sketch.count;
+}
+
+static const bench_kernel_t kernels[] = {
+    { "parse_calibration", prepare_none,         run_parse_calibration,    0 },
+    { "unpack_raw",        prepare_none,         run_unpack,               0 },
+    { "compensate_float",  prepare_none,         run_compensate_float,     0 },
+    { "read_data_socket",  prepare_read_path,    run_read_path,            0 },
+    { "read_data_sim",     prepare_sim_data,     run_sim_read,             1 },
+    { "status_data_sim",   prepare_sim_data,     run_sim_status_then_data, 1 },
+    { "read_verified_sim", prepare_sim_verified, run_sim_read,             1 },
+    { "sketch_add",        prepare_sketch,       run_sketch_add,           0 },
+};
+
+/*******************************************************************************
+ * Main Benchmark Runner
+ ******************************************************************************/
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = 100000;
+    if (argc > 1) {
+        iterations = (uint32_t)strtoul(argv[1], NULL, 10);
+        if (iterations == 0) {
+            fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bme280_parse_calibration(&calib, calib_tp, calib_h1, calib_hum);
+
+    counters_t counters;
+    counters_open(&counters);
+    if (counters.fd[COUNTER_CYCLES] < 0) {
+        printf("note: hardware counters unavailable (perf_event_paranoid or VM); timing only\n");
+    } else if (counters.exclude_kernel) {
+        printf("note: counters exclude kernel time (perf_event_paranoid)\n");
+    }
+
+    printf("%-18s %10s", "kernel", "ns/sample");
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        printf(" %10s", counter_names[i]);
+    }
+    printf(" %6s %8s\n", "IPC", "syscalls");
+
+    if (sim_setup() != 0) {
+        printf("note: simulator unavailable; *_sim kernels skipped\n");
+    }
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        const bench_kernel_t *kernel = &kernels[k];
+        uint64_t elapsed = 0;
+        int failed = 0;
+        bme280_sim_stats_t before = { 0, 0, 0, 0 };
+        bme280_sim_stats_t after = { 0, 0, 0, 0 };
+
+        if (kernel->sim && sim_up) {
+            bme280_sim_get_stats(&sim, &before);
+        }
+
+        counters_reset(&counters);
+        for (uint32_t done = 0; done < iterations && !failed; done += BENCH_BATCH) {
+            uint32_t count = iterations - done;
+            if (count > BENCH_BATCH) {
+                count = BENCH_BATCH;
+            }
+            if (kernel->prepare(count) != 0) {
+                failed = 1;
+                break;
+            }
+
+            uint64_t start = bme280_time_us();
+            counters_enable(&counters, 1);
+            kernel->run(count);
+            counters_enable(&counters, 0);
+            elapsed += bme280_time_us() - start;
+        }
+        if (failed) {
+            printf("%-18s setup failed\n", kernel->name);
+            continue;
+        }
+        counters_read(&counters);
+
+        printf("%-18s %10.1f", kernel->name, (double)elapsed * 1000.0 / iterations);
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (counters.fd[i] >= 0 && counters.running) {
+                printf(" %10.2f", (double)counters.value[i] / iterations);
+            } else {
+                printf(" %10s", "n/a");
+            }
+        }
+        if (counters.running && counters.fd[COUNTER_INSTRUCTIONS] >= 0
+            && counters.value[COUNTER_CYCLES] > 0) {
+            printf(" %6.2f", (double)counters.value[COUNTER_INSTRUCTIONS]
+                             / (double)counters.value[COUNTER_CYCLES]);
+        } else {
+            printf(" %6s", "n/a");
+        }
+
+        /* Client write() and read() calls, as served by the simulator */
+        if (kernel->sim) {
+            bme280_sim_get_stats(&sim, &after);
+            printf(" %8.2f", (double)(after.messages - before.messages
+                                      + after.replies - before.replies) / iterations);
+        } else {
+            printf(" %8s", "n/a");
+        }
+
+        /* Counted for only part of the run: values are extrapolated */
+        if (counters.running && counters.scale > 1.0001) {
+            printf("  multiplexed x%.2f", counters.scale);
+        }
+        printf("\n");
+    }
+
+    if (bus_peer >= 0) {
+        bme280_close(&bus_ctx);
+        close(bus_peer);
+    }
+    if (sim_up) {
+        bme280_close(&sim_ctx);
+        bme280_sim_stop(&sim);
+    }
+    counters_close(&counters);
+    return 0;
+}
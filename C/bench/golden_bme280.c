@@ -0,0 +1,128 @@
+/**
+ * BME280 Golden Vector Runner (C port)
+ *
+ * Compensates every vector in the shared golden file with the C library,
+ * repeating the pass to measure throughput, and reports the maximum
+ * deviation from the expected outputs. Output is one line:
+ *
+ *   port,vectors,ns_per_sample,max_dt_c,max_dp_hpa,max_dh_rh
+ *
+ * Usage: golden_bme280 <golden.csv> [passes]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "bme280.h"
+
+#define GOLDEN_MAX_VECTORS  4096
+
+typedef struct {
+    bme280_calib_t calib;
+    uint8_t        burst[8];
+    double         expected[3];  /* temperature_c, pressure_hpa, humidity_rh */
+} golden_vector_t;
+
+static golden_vector_t vectors[GOLDEN_MAX_VECTORS];
+
+/* Sink that keeps the compiler from discarding benchmark results */
+static volatile float sink;
+
+static int parse_hex(const char *hex, uint8_t *out, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        unsigned int byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            return -1;
+        }
+        out[i] = (uint8_t)byte;
+    }
+    return 0;
+}
+
+static int load_vectors(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[256];
+    int count = 0;
+    while (count < GOLDEN_MAX_VECTORS && fgets(line, sizeof(line), file) != NULL) {
+        char calib_hex[65];
+        char burst_hex[17];
+        uint8_t calib[32];
+        golden_vector_t *v = &vectors[count];
+
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%64[0-9a-f],%16[0-9a-f],%lf,%lf,%lf", calib_hex, burst_hex,
+                   &v->expected[0], &v->expected[1], &v->expected[2]) != 5
+            || parse_hex(calib_hex, calib, sizeof(calib)) != 0
+            || parse_hex(burst_hex, v->burst, sizeof(v->burst)) != 0) {
+            fclose(file);
+            return -1;
+        }
+        bme280_parse_calibration(&v->calib, calib, calib[24], calib + 25);
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <golden.csv> [passes]\n", argv[0]);
+        return 1;
+    }
+
+    int passes = (argc > 2) ? atoi(argv[2]) : 1000;
+    int count = load_vectors(argv[1]);
+    if (count <= 0 || passes <= 0) {
+        fprintf(stderr, "failed to load vectors from %s\n", argv[1]);
+        return 1;
+    }
+
+    /* Accuracy pass */
+    double max_dev[3] = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < count; i++) {
+        bme280_raw_t raw;
+        bme280_data_t data;
+        bme280_unpack_raw(vectors[i].burst, &raw);
+        bme280_compensate(&vectors[i].calib, &raw, &data, NULL);
+
+        double actual[3] = { data.temperature_c, data.pressure_hpa, data.humidity_rh };
+        for (int k = 0; k < 3; k++) {
+            double dev = fabs(actual[k] - vectors[i].expected[k]);
+            if (dev > max_dev[k]) {
+                max_dev[k] = dev;
+            }
+        }
+    }
+
+    /* Throughput passes: unpack + compensate per sample */
+    uint64_t start = bme280_time_us();
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < count; i++) {
+            bme280_raw_t raw;
+            bme280_data_t data;
+            bme280_unpack_raw(vectors[i].burst, &raw);
+            bme280_compensate(&vectors[i].calib, &raw, &data, NULL);
+            sink = data.pressure_hpa;
+        }
+    }
+    uint64_t elapsed = bme280_time_us() - start;
+
+    printf("c,%d,%.1f,%.6f,%.6f,%.6f\n", count,
+           (double)elapsed * 1000.0 / ((double)passes * count),
+           max_dev[0], max_dev[1], max_dev[2]);
+    return 0;
+}
@@ -0,0 +1,875 @@
+/**
+ * BME280 I2C Sensor Driver Implementation
+ * 
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ * BME280
+ * This code is designed to work with the BME280_I2CS I2C Mini Module available from ControlEverything.com.
+ * https://www.controleverything.com/content/Humidity?sku=BME280_I2CS#tabs-0-product_tabset-2
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bme280.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+/*******************************************************************************
+ * Internal Helpers
+ ******************************************************************************/
+
+/* Standby time in microseconds, indexed by config[7:5] */
+static const uint32_t standby_us[8] = {
+    500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000
+};
+
+/* Oversampling factor, indexed by the 3-bit osrs_x field */
+static const uint8_t osrs_factor[8] = { 0, 1, 2, 4, 8, 16, 16, 16 };
+
+/* Maximum measurement time from datasheet section 9.1 */
+static uint32_t measure_time_us(uint8_t ctrl_meas, uint8_t ctrl_hum)
+{
+    uint32_t os_t = osrs_factor[(ctrl_meas >> 5) & 0x07];
+    uint32_t os_p = osrs_factor[(ctrl_meas >> 2) & 0x07];
+    uint32_t os_h = osrs_factor[ctrl_hum & 0x07];
+    uint32_t meas_us = 1250 + 2300 * os_t;
+    if (os_p != 0) {
+        meas_us += 2300 * os_p + 575;
+    }
+    if (os_h != 0) {
+        meas_us += 2300 * os_h + 575;
+    }
+    return meas_us;
+}
+
+static void reset_ctx(bme280_ctx_t *ctx, int fd, uint8_t address)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->fd = fd;
+    ctx->address = address;
+}
+
+/* Take ownership of an open fd; sync primitives live as long as the fd */
+static void open_ctx(bme280_ctx_t *ctx, int fd)
+{
+    ctx->fd = fd;
+    pthread_mutex_init(&ctx->bus, NULL);
+    pthread_mutex_init(&ctx->flight.lock, NULL);
+    pthread_cond_init(&ctx->flight.done, NULL);
+}
+
+/*******************************************************************************
+ * Error String Conversion
+ ******************************************************************************/
+
+const char* bme280_error_string(bme280_error_t error)
+{
+    switch (error) {
+        case BME280_OK:
+            return "Success";
+        case BME280_ERR_BUS_OPEN:
+            return "Failed to open I2C bus";
+        case BME280_ERR_ADDR_SET:
+            return "Failed to set I2C slave address";
+        case BME280_ERR_WRITE:
+            return "I2C write operation failed";
+        case BME280_ERR_READ:
+            return "I2C read operation failed";
+        case BME280_ERR_NULL_PTR:
+            return "NULL pointer passed to function";
+        case BME280_ERR_NOT_INIT:
+            return "Device not initialized";
+        case BME280_ERR_INVALID_ARG:
+            return "Argument out of range";
+        case BME280_ERR_BUSY:
+            return "Sensor busy (conversion or NVM copy in progress)";
+        case BME280_ERR_CONFIG:
+            return "Sensor settings differ from configuration (reset?)";
+        default:
+            return "Unknown error";
+    }
+}
+
+/*******************************************************************************
+ * Clock
+ ******************************************************************************/
+
+uint64_t bme280_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/*******************************************************************************
+ * Allocator
+ ******************************************************************************/
+
+static void *default_alloc(void *user, size_t size, size_t align)
+{
+    void *ptr = NULL;
+    (void)user;
+
+    if (align < sizeof(void *)) {
+        align = sizeof(void *);
+    }
+    return posix_memalign(&ptr, align, size) == 0 ? ptr : NULL;
+}
+
+static void default_free(void *user, void *ptr)
+{
+    (void)user;
+    free(ptr);
+}
+
+static bme280_allocator_t allocator = { default_alloc, default_free, NULL };
+
+bme280_error_t bme280_set_allocator(const bme280_allocator_t *a)
+{
+    if (a == NULL) {
+        allocator.alloc = default_alloc;
+        allocator.free = default_free;
+        allocator.user = NULL;
+        return BME280_OK;
+    }
+
+    if (a->alloc == NULL || a->free == NULL) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    allocator = *a;
+    return BME280_OK;
+}
+
+void *bme280_alloc(size_t size, size_t align)
+{
+    if ((align & (align - 1)) != 0 || size == 0) {
+        return NULL;
+    }
+    return allocator.alloc(allocator.user, size, align);
+}
+
+void bme280_free(void *ptr)
+{
+    if (ptr != NULL) {
+        allocator.free(allocator.user, ptr);
+    }
+}
+
+/*******************************************************************************
+ * Initialization and Cleanup Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_init(bme280_ctx_t *ctx, const char *bus_path, uint8_t address)
+{
+    if (ctx == NULL || bus_path == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    /* Initialize context to safe defaults */
+    reset_ctx(ctx, -1, address);
+
+    /* Open I2C bus */
+    int fd = open(bus_path, O_RDWR);
+    if (fd < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    /* Set I2C slave address */
+    if (ioctl(fd, I2C_SLAVE, address) < 0) {
+        close(fd);
+        return BME280_ERR_ADDR_SET;
+    }
+
+    open_ctx(ctx, fd);
+    return BME280_OK;
+}
+
+bme280_error_t bme280_attach(bme280_ctx_t *ctx, int fd, uint8_t address)
+{
+    if (ctx == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    reset_ctx(ctx, -1, address);
+
+    if (fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    open_ctx(ctx, fd);
+    return BME280_OK;
+}
+
+void bme280_close(bme280_ctx_t *ctx)
+{
+    if (ctx != NULL && ctx->fd >= 0) {
+        close(ctx->fd);
+        ctx->fd = -1;
+        pthread_cond_destroy(&ctx->flight.done);
+        pthread_mutex_destroy(&ctx->flight.lock);
+        pthread_mutex_destroy(&ctx->bus);
+    }
+}
+
+
+/*******************************************************************************
+ * Register Decoding and Compensation Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_parse_calibration(bme280_calib_t *calib, const uint8_t *tp,
+                                        uint8_t h1, const uint8_t *hum)
+{
+    if (calib == NULL || tp == NULL || hum == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    /* Parse temperature coefficients */
+    calib->temp.dig_T1 = (uint16_t)(tp[0] | (tp[1] << 8));
+    calib->temp.dig_T2 = (int16_t)(tp[2] | (tp[3] << 8));
+    calib->temp.dig_T3 = (int16_t)(tp[4] | (tp[5] << 8));
+
+    /* Parse pressure coefficients */
+    calib->press.dig_P1 = (uint16_t)(tp[6] | (tp[7] << 8));
+    calib->press.dig_P2 = (int16_t)(tp[8] | (tp[9] << 8));
+    calib->press.dig_P3 = (int16_t)(tp[10] | (tp[11] << 8));
+    calib->press.dig_P4 = (int16_t)(tp[12] | (tp[13] << 8));
+    calib->press.dig_P5 = (int16_t)(tp[14] | (tp[15] << 8));
+    calib->press.dig_P6 = (int16_t)(tp[16] | (tp[17] << 8));
+    calib->press.dig_P7 = (int16_t)(tp[18] | (tp[19] << 8));
+    calib->press.dig_P8 = (int16_t)(tp[20] | (tp[21] << 8));
+    calib->press.dig_P9 = (int16_t)(tp[22] | (tp[23] << 8));
+
+    /* Parse humidity coefficients */
+    calib->hum.dig_H1 = h1;
+    calib->hum.dig_H2 = (int16_t)(hum[0] | (hum[1] << 8));
+    calib->hum.dig_H3 = hum[2];
+    calib->hum.dig_H4 = (int16_t)((hum[3] << 4) | (hum[4] & 0x0F));
+    calib->hum.dig_H5 = (int16_t)(((hum[4] >> 4) & 0x0F) | (hum[5] << 4));
+    calib->hum.dig_H6 = (int8_t)hum[6];
+
+    return BME280_OK;
+}
+
+bme280_error_t bme280_pack_calibration(const bme280_calib_t *calib, uint8_t *regs)
+{
+    if (calib == NULL || regs == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    const uint16_t tp[12] = {
+        calib->temp.dig_T1, (uint16_t)calib->temp.dig_T2, (uint16_t)calib->temp.dig_T3,
+        calib->press.dig_P1, (uint16_t)calib->press.dig_P2, (uint16_t)calib->press.dig_P3,
+        (uint16_t)calib->press.dig_P4, (uint16_t)calib->press.dig_P5, (uint16_t)calib->press.dig_P6,
+        (uint16_t)calib->press.dig_P7, (uint16_t)calib->press.dig_P8, (uint16_t)calib->press.dig_P9
+    };
+    for (int i = 0; i < 12; i++) {
+        regs[i * 2] = (uint8_t)tp[i];
+        regs[i * 2 + 1] = (uint8_t)(tp[i] >> 8);
+    }
+
+    /* Humidity: H1 from 0xA1, then 0xE1..0xE7 with H4/H5 sharing 0xE5 */
+    uint8_t *hum = regs + 25;
+    regs[24] = calib->hum.dig_H1;
+    hum[0] = (uint8_t)calib->hum.dig_H2;
+    hum[1] = (uint8_t)((uint16_t)calib->hum.dig_H2 >> 8);
+    hum[2] = calib->hum.dig_H3;
+    hum[3] = (uint8_t)(calib->hum.dig_H4 >> 4);
+    hum[4] = (uint8_t)((calib->hum.dig_H4 & 0x0F) | ((calib->hum.dig_H5 & 0x0F) << 4));
+    hum[5] = (uint8_t)(calib->hum.dig_H5 >> 4);
+    hum[6] = (uint8_t)calib->hum.dig_H6;
+
+    return BME280_OK;
+}
+
+bme280_error_t bme280_unpack_raw(const uint8_t *buf, bme280_raw_t *raw)
+{
+    if (buf == NULL || raw == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    /* Convert raw ADC values to 20-bit (pressure, temperature) and 16-bit (humidity) */
+    raw->adc_p = ((int32_t)buf[0] << 12) | ((int32_t)buf[1] << 4) | ((int32_t)buf[2] >> 4);
+    raw->adc_t = ((int32_t)buf[3] << 12) | ((int32_t)buf[4] << 4) | ((int32_t)buf[5] >> 4);
+    raw->adc_h = ((int32_t)buf[6] << 8) | (int32_t)buf[7];
+
+    return BME280_OK;
+}
+
+bme280_error_t bme280_compensate(const bme280_calib_t *calib, const bme280_raw_t *raw,
+                                 bme280_data_t *data, int32_t *t_fine_out)
+{
+    if (calib == NULL || raw == NULL || data == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    int32_t adc_t = raw->adc_t;
+    int32_t adc_p = raw->adc_p;
+    int32_t adc_h = raw->adc_h;
+
+    /* Temperature compensation (from BME280 datasheet) */
+    float var1 = (((float)adc_t) / 16384.0f - ((float)calib->temp.dig_T1) / 1024.0f) 
+                 * ((float)calib->temp.dig_T2);
+    float var2 = ((((float)adc_t) / 131072.0f - ((float)calib->temp.dig_T1) / 8192.0f) 
+                 * (((float)adc_t) / 131072.0f - ((float)calib->temp.dig_T1) / 8192.0f)) 
+                 * ((float)calib->temp.dig_T3);
+    int32_t t_fine = (int32_t)(var1 + var2);
+    data->temperature_c = (var1 + var2) / 5120.0f;
+    data->temperature_f = data->temperature_c * 1.8f + 32.0f;
+
+    /* Pressure compensation (from BME280 datasheet) */
+    var1 = ((float)t_fine / 2.0f) - 64000.0f;
+    var2 = var1 * var1 * ((float)calib->press.dig_P6) / 32768.0f;
+    var2 = var2 + var1 * ((float)calib->press.dig_P5) * 2.0f;
+    var2 = (var2 / 4.0f) + (((float)calib->press.dig_P4) * 65536.0f);
+    var1 = (((float)calib->press.dig_P3) * var1 * var1 / 524288.0f 
+           + ((float)calib->press.dig_P2) * var1) / 524288.0f;
+    var1 = (1.0f + var1 / 32768.0f) * ((float)calib->press.dig_P1);
+    
+    float p = 1048576.0f - (float)adc_p;
+    p = (p - (var2 / 4096.0f)) * 6250.0f / var1;
+    var1 = ((float)calib->press.dig_P9) * p * p / 2147483648.0f;
+    var2 = p * ((float)calib->press.dig_P8) / 32768.0f;
+    data->pressure_hpa = (p + (var1 + var2 + ((float)calib->press.dig_P7)) / 16.0f) / 100.0f;
+
+    /* Humidity compensation (from BME280 datasheet) */
+    float var_H = ((float)t_fine) - 76800.0f;
+    var_H = (adc_h - (calib->hum.dig_H4 * 64.0f + calib->hum.dig_H5 / 16384.0f * var_H)) 
+            * (calib->hum.dig_H2 / 65536.0f 
+            * (1.0f + calib->hum.dig_H6 / 67108864.0f * var_H 
+            * (1.0f + calib->hum.dig_H3 / 67108864.0f * var_H)));
+    data->humidity_rh = var_H * (1.0f - calib->hum.dig_H1 * var_H / 524288.0f);
+
+    /* Clamp humidity to valid range [0, 100] */
+    if (data->humidity_rh > 100.0f) {
+        data->humidity_rh = 100.0f;
+    } else if (data->humidity_rh < 0.0f) {
+        data->humidity_rh = 0.0f;
+    }
+
+    if (t_fine_out != NULL) {
+        *t_fine_out = t_fine;
+    }
+
+    return BME280_OK;
+}
+
+
+/*******************************************************************************
+ * Calibration Reading Function
+ ******************************************************************************/
+
+/* Caller holds the bus lock */
+static bme280_error_t read_calibration(bme280_ctx_t *ctx)
+{
+    uint8_t reg;
+    uint8_t buf[24];
+    uint8_t h1;
+    uint8_t hum[7];
+    ssize_t ret;
+
+    /* Read 24 bytes of temperature and pressure calibration data from register 0x88 */
+    reg = BME280_REG_CALIB_TEMP_PRESS;
+    if (write(ctx->fd, &reg, 1) != 1) {
+        return BME280_ERR_WRITE;
+    }
+
+    ret = read(ctx->fd, buf, 24);
+    if (ret != 24) {
+        return BME280_ERR_READ;
+    }
+
+    /* Read 1 byte of humidity calibration data from register 0xA1 (H1) */
+    reg = BME280_REG_CALIB_HUM1;
+    if (write(ctx->fd, &reg, 1) != 1) {
+        return BME280_ERR_WRITE;
+    }
+
+    ret = read(ctx->fd, &h1, 1);
+    if (ret != 1) {
+        return BME280_ERR_READ;
+    }
+
+    /* Read 7 bytes of humidity calibration data from register 0xE1 (H2-H6) */
+    reg = BME280_REG_CALIB_HUM2;
+    if (write(ctx->fd, &reg, 1) != 1) {
+        return BME280_ERR_WRITE;
+    }
+
+    ret = read(ctx->fd, hum, 7);
+    if (ret != 7) {
+        return BME280_ERR_READ;
+    }
+
+    return bme280_parse_calibration(&ctx->calib, buf, h1, hum);
+}
+
+bme280_error_t bme280_read_calibration(bme280_ctx_t *ctx)
+{
+    if (ctx == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (ctx->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    pthread_mutex_lock(&ctx->bus);
+    bme280_error_t err = read_calibration(ctx);
+    pthread_mutex_unlock(&ctx->bus);
+    return err;
+}
+
+
+/*******************************************************************************
+ * Sensor Configuration Function
+ ******************************************************************************/
+
+/* Caller holds the bus lock */
+static bme280_error_t write_config(bme280_ctx_t *ctx)
+{
+    uint8_t config[2];
+
+    /* Set humidity oversampling rate to 1x (0x01) */
+    config[0] = BME280_REG_CTRL_HUM;
+    config[1] = BME280_OSRS_HUM_1X;
+    if (write(ctx->fd, config, 2) != 2) {
+        return BME280_ERR_WRITE;
+    }
+    ctx->ctrl_hum = config[1];
+
+    /* Set measurement control: normal mode, temp and pressure oversampling = 1x (0x27) */
+    config[0] = BME280_REG_CTRL_MEAS;
+    config[1] = BME280_CTRL_MEAS_NORMAL;
+    if (write(ctx->fd, config, 2) != 2) {
+        return BME280_ERR_WRITE;
+    }
+    ctx->ctrl_meas = config[1];
+
+    /* Set config: standby time = 1000ms (0xA0) */
+    config[0] = BME280_REG_CONFIG;
+    config[1] = BME280_STANDBY_1000MS;
+    if (write(ctx->fd, config, 2) != 2) {
+        return BME280_ERR_WRITE;
+    }
+    ctx->config = config[1];
+    ctx->sample_state = BME280_SAMPLE_IDLE;
+    return BME280_OK;
+}
+
+/* Drop the cached sample, and any bus read in flight with it; caller holds flight.lock */
+static void invalidate_cache(bme280_ctx_t *ctx)
+{
+    ctx->cache.valid = 0;
+    ctx->cache.epoch++;
+}
+
+bme280_error_t bme280_configure(bme280_ctx_t *ctx)
+{
+    if (ctx == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (ctx->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    pthread_mutex_lock(&ctx->bus);
+    bme280_error_t err = write_config(ctx);
+
+    /* Configuration changed (perhaps partly), so any cached sample is stale */
+    pthread_mutex_lock(&ctx->flight.lock);
+    invalidate_cache(ctx);
+    ctx->cache.odr_us = bme280_odr_period_us(ctx);
+    pthread_mutex_unlock(&ctx->flight.lock);
+    pthread_mutex_unlock(&ctx->bus);
+
+    return err;
+}
+
+
+/*******************************************************************************
+ * Data Reading and Compensation Function
+ ******************************************************************************/
+
+/* Check status, ctrl_meas and config from a 0xF3 burst against the shadow registers */
+static bme280_error_t verify_burst(const bme280_ctx_t *ctx, const uint8_t *buf)
+{
+    uint8_t status = buf[0];
+    uint8_t ctrl_meas = buf[1];
+    uint8_t config = buf[2];
+
+    /*
+     * In normal mode the data registers are shadowed while a conversion runs,
+     * so the burst is consistent; only a forced conversion leaves them stale
+     */
+    uint8_t mode = ctx->ctrl_meas & BME280_MODE_MASK;
+    if ((status & BME280_STATUS_IM_UPDATE)
+        || ((status & BME280_STATUS_MEASURING) && mode != BME280_MODE_NORMAL)) {
+        return BME280_ERR_BUSY;
+    }
+
+    /* A forced conversion drops the mode back to sleep when it is done */
+    uint8_t got = ctrl_meas & BME280_MODE_MASK;
+    int mode_ok = (got == mode) || (mode != BME280_MODE_NORMAL && mode != 0 && got == 0);
+
+    if (!mode_ok || (ctrl_meas & ~BME280_MODE_MASK) != (ctx->ctrl_meas & ~BME280_MODE_MASK)
+        || (config & BME280_CONFIG_MASK) != (ctx->config & BME280_CONFIG_MASK)) {
+        return BME280_ERR_CONFIG;
+    }
+    return BME280_OK;
+}
+
+/* Caller holds the bus lock */
+static bme280_error_t read_burst(bme280_ctx_t *ctx, bme280_data_t *data)
+{
+    uint8_t reg;
+    uint8_t buf[BME280_VERIFIED_BURST_LEN];
+    const uint8_t *sample = buf;
+    ssize_t len = 8;
+    ssize_t ret;
+
+    /* Read 8 bytes of data from register 0xF7, or 12 from 0xF3 when verifying */
+    reg = BME280_REG_DATA;
+    if (ctx->read_mode == BME280_READ_VERIFIED) {
+        reg = BME280_REG_STATUS;
+        len = BME280_VERIFIED_BURST_LEN;
+        sample = buf + (BME280_REG_DATA - BME280_REG_STATUS);
+    }
+    if (write(ctx->fd, &reg, 1) != 1) {
+        return BME280_ERR_WRITE;
+    }
+
+    ret = read(ctx->fd, buf, (size_t)len);
+    if (ret != len) {
+        return BME280_ERR_READ;
+    }
+
+    if (ctx->read_mode == BME280_READ_VERIFIED) {
+        bme280_error_t err = verify_burst(ctx, buf);
+        if (err != BME280_OK) {
+            return err;
+        }
+    }
+
+    bme280_raw_t raw;
+    bme280_unpack_raw(sample, &raw);
+    return bme280_compensate(&ctx->calib, &raw, data, &ctx->t_fine);
+}
+
+static bme280_error_t read_sample(bme280_ctx_t *ctx, bme280_data_t *data)
+{
+    pthread_mutex_lock(&ctx->bus);
+    bme280_error_t err = read_burst(ctx, data);
+    pthread_mutex_unlock(&ctx->bus);
+    return err;
+}
+
+bme280_error_t bme280_set_read_mode(bme280_ctx_t *ctx, bme280_read_mode_t mode)
+{
+    if (ctx == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (mode != BME280_READ_DATA && mode != BME280_READ_VERIFIED) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    ctx->read_mode = (uint8_t)mode;
+    return BME280_OK;
+}
+
+
+/*******************************************************************************
+ * Split-Phase Sampling Functions
+ ******************************************************************************/
+
+/* Caller holds the bus lock */
+static bme280_error_t trigger_forced(bme280_ctx_t *ctx)
+{
+    uint8_t cmd[2];
+
+    /* Unconfigured: 1x oversampling everywhere; ctrl_hum applies at the ctrl_meas write */
+    uint8_t meas = ctx->ctrl_meas & (uint8_t)~BME280_MODE_MASK;
+    if (meas == 0) {
+        meas = BME280_CTRL_MEAS_NORMAL & (uint8_t)~BME280_MODE_MASK;
+        cmd[0] = BME280_REG_CTRL_HUM;
+        cmd[1] = BME280_OSRS_HUM_1X;
+        if (write(ctx->fd, cmd, 2) != 2) {
+            return BME280_ERR_WRITE;
+        }
+        ctx->ctrl_hum = cmd[1];
+    }
+
+    cmd[0] = BME280_REG_CTRL_MEAS;
+    cmd[1] = meas | BME280_MODE_FORCED;
+    if (write(ctx->fd, cmd, 2) != 2) {
+        return BME280_ERR_WRITE;
+    }
+    ctx->ctrl_meas = cmd[1];
+
+    ctx->sample_ready_us = bme280_time_us() + measure_time_us(ctx->ctrl_meas, ctx->ctrl_hum);
+    ctx->sample_state = BME280_SAMPLE_CONVERTING;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_start_sample(bme280_ctx_t *ctx, uint64_t *ready_us)
+{
+    if (ctx == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (ctx->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    pthread_mutex_lock(&ctx->bus);
+    bme280_error_t err = BME280_ERR_BUSY;
+    if (ctx->sample_state == BME280_SAMPLE_IDLE) {
+        uint8_t ctrl_meas = ctx->ctrl_meas;
+        err = trigger_forced(ctx);
+
+        /* E.g. a normal-mode sensor has stopped its continuous conversions */
+        if (ctx->ctrl_meas != ctrl_meas) {
+            pthread_mutex_lock(&ctx->flight.lock);
+            invalidate_cache(ctx);
+            ctx->cache.odr_us = bme280_odr_period_us(ctx);
+            pthread_mutex_unlock(&ctx->flight.lock);
+        }
+    }
+    pthread_mutex_unlock(&ctx->bus);
+
+    if (err == BME280_OK && ready_us != NULL) {
+        *ready_us = ctx->sample_ready_us;
+    }
+    return err;
+}
+
+bme280_error_t bme280_poll_sample(bme280_ctx_t *ctx, int *ready)
+{
+    if (ctx == NULL || ready == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    *ready = 0;
+    if (ctx->fd < 0 || ctx->sample_state == BME280_SAMPLE_IDLE) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (ctx->sample_state == BME280_SAMPLE_READY) {
+        *ready = 1;
+        return BME280_OK;
+    }
+
+    if (bme280_time_us() < ctx->sample_ready_us) {
+        return BME280_OK;
+    }
+
+    uint8_t reg = BME280_REG_STATUS;
+    uint8_t status;
+    bme280_error_t err = BME280_OK;
+    pthread_mutex_lock(&ctx->bus);
+    if (write(ctx->fd, &reg, 1) != 1) {
+        err = BME280_ERR_WRITE;
+    } else if (read(ctx->fd, &status, 1) != 1) {
+        err = BME280_ERR_READ;
+    }
+    pthread_mutex_unlock(&ctx->bus);
+    if (err != BME280_OK) {
+        return err;
+    }
+
+    if ((status & (BME280_STATUS_MEASURING | BME280_STATUS_IM_UPDATE)) == 0) {
+        ctx->sample_state = BME280_SAMPLE_READY;
+        *ready = 1;
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_finish_sample(bme280_ctx_t *ctx, bme280_data_t *data)
+{
+    if (ctx == NULL || data == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (ctx->fd < 0 || ctx->sample_state == BME280_SAMPLE_IDLE) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    /* The datasheet maximum has passed even if nobody polled */
+    if (ctx->sample_state == BME280_SAMPLE_CONVERTING && bme280_time_us() < ctx->sample_ready_us) {
+        return BME280_ERR_BUSY;
+    }
+
+    /* A bus error or a still-running conversion leaves the sample to retry */
+    bme280_error_t err = read_sample(ctx, data);
+    if (err != BME280_ERR_WRITE && err != BME280_ERR_READ && err != BME280_ERR_BUSY) {
+        ctx->sample_state = BME280_SAMPLE_IDLE;
+    }
+    return err;
+}
+
+bme280_sample_state_t bme280_sample_state(const bme280_ctx_t *ctx)
+{
+    if (ctx == NULL) {
+        return BME280_SAMPLE_IDLE;
+    }
+    return (bme280_sample_state_t)ctx->sample_state;
+}
+
+/*******************************************************************************
+ * Read Cache Functions
+ ******************************************************************************/
+
+uint32_t bme280_odr_period_us(const bme280_ctx_t *ctx)
+{
+    if (ctx == NULL) {
+        return 0;
+    }
+
+    uint8_t mode = ctx->ctrl_meas & 0x03;
+    if (mode == 0x00) {
+        return 0;  /* Sleep mode: no conversions */
+    }
+
+    uint32_t meas_us = measure_time_us(ctx->ctrl_meas, ctx->ctrl_hum);
+
+    if (mode != 0x03) {
+        return meas_us;  /* Forced mode: one conversion per trigger */
+    }
+
+    return meas_us + standby_us[(ctx->config >> 5) & 0x07];
+}
+
+bme280_error_t bme280_set_cache_ttl(bme280_ctx_t *ctx, uint32_t ttl_us)
+{
+    if (ctx == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (ctx->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    pthread_mutex_lock(&ctx->flight.lock);
+    ctx->cache.ttl_us = ttl_us;
+    invalidate_cache(ctx);
+    pthread_mutex_unlock(&ctx->flight.lock);
+    return BME280_OK;
+}
+
+bme280_error_t bme280_get_cache_stats(const bme280_ctx_t *ctx, bme280_cache_stats_t *stats)
+{
+    if (ctx == NULL || stats == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (ctx->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    /* The lock is not part of the observable state */
+    pthread_mutex_t *lock = (pthread_mutex_t *)&ctx->flight.lock;
+    pthread_mutex_lock(lock);
+    *stats = ctx->cache.stats;
+    pthread_mutex_unlock(lock);
+    return BME280_OK;
+}
+
+bme280_error_t bme280_read_data_cached(bme280_ctx_t *ctx, bme280_data_t *data,
+                                       uint32_t *age_us)
+{
+    if (ctx == NULL || data == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (ctx->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    bme280_flight_t *flight = &ctx->flight;
+    pthread_mutex_lock(&flight->lock);
+
+    uint32_t ttl = ctx->cache.ttl_us;
+    if (ttl == BME280_CACHE_TTL_AUTO) {
+        ttl = ctx->cache.odr_us;
+    }
+
+    /* Serve from the cache while the last sample is younger than the TTL */
+    if (ttl != BME280_CACHE_TTL_OFF && ctx->cache.valid) {
+        uint64_t age = bme280_time_us() - ctx->cache.stamp_us;
+        if (age < ttl) {
+            *data = ctx->cache.data;
+            ctx->cache.stats.hits++;
+            pthread_mutex_unlock(&flight->lock);
+            if (age_us != NULL) {
+                *age_us = (uint32_t)age;
+            }
+            return BME280_OK;
+        }
+    }
+
+    /* Another caller owns the bus read: wait for it and share its result */
+    if (flight->in_flight) {
+        uint32_t generation = flight->generation;
+        while (flight->generation == generation) {
+            pthread_cond_wait(&flight->done, &flight->lock);
+        }
+        ctx->cache.stats.shared++;
+        bme280_error_t shared_err = flight->err;
+        if (shared_err == BME280_OK) {
+            *data = flight->data;
+        }
+        pthread_mutex_unlock(&flight->lock);
+        if (age_us != NULL) {
+            *age_us = 0;
+        }
+        return shared_err;
+    }
+
+    flight->in_flight = 1;
+    ctx->cache.stats.misses++;
+    uint32_t epoch = ctx->cache.epoch;
+    pthread_mutex_unlock(&flight->lock);
+
+    /* Bus transaction runs outside the flight lock so waiters only block on the condvar */
+    bme280_data_t sample = { 0.0f, 0.0f, 0.0f, 0.0f };
+    bme280_error_t err = read_sample(ctx, &sample);
+
+    pthread_mutex_lock(&flight->lock);
+    flight->err = err;
+    flight->data = sample;
+    flight->generation++;
+    flight->in_flight = 0;
+    /* Not cached if the configuration or TTL changed while the bus was read */
+    if (err == BME280_OK && ttl != BME280_CACHE_TTL_OFF && ctx->cache.epoch == epoch) {
+        ctx->cache.data = sample;
+        ctx->cache.stamp_us = bme280_time_us();
+        ctx->cache.valid = 1;
+    }
+    pthread_cond_broadcast(&flight->done);
+    pthread_mutex_unlock(&flight->lock);
+
+    if (err != BME280_OK) {
+        return err;
+    }
+
+    *data = sample;
+    if (age_us != NULL) {
+        *age_us = 0;
+    }
+
+    return BME280_OK;
+}
+
+bme280_error_t bme280_read_data(bme280_ctx_t *ctx, bme280_data_t *data)
+{
+    return bme280_read_data_cached(ctx, data, NULL);
+}
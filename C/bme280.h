@@ -11,7 +11,9 @@
 #ifndef BME280_H
 #define BME280_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <pthread.h>
 
 /*******************************************************************************
  * Default Constants
@@ -34,9 +36,35 @@
 #define BME280_REG_CTRL_MEAS         0xF4  /* Measurement control */
 #define BME280_REG_CONFIG            0xF5  /* Configuration */
 
-/* Data registers */
+/* Status and data registers */
+#define BME280_REG_STATUS            0xF3  /* measuring[3], im_update[0] */
 #define BME280_REG_DATA              0xF7  /* 8 bytes: P, T, H */
 
+/* Verified reads fetch status through data: F3 F4 F5 (F6 reserved) F7..FE */
+#define BME280_VERIFIED_BURST_LEN    12
+
+/*******************************************************************************
+ * Configuration Value Constants
+ ******************************************************************************/
+
+#define BME280_OSRS_HUM_1X           0x01  /* Humidity oversampling 1x */
+#define BME280_CTRL_MEAS_NORMAL      0x27  /* Normal mode, T/P oversampling 1x */
+#define BME280_STANDBY_1000MS        0xA0  /* Standby time 1000ms, filter off */
+
+#define BME280_STATUS_MEASURING      0x08  /* Conversion running */
+#define BME280_STATUS_IM_UPDATE      0x01  /* NVM being copied to image registers */
+#define BME280_MODE_MASK             0x03  /* ctrl_meas[1:0] */
+#define BME280_MODE_FORCED           0x01
+#define BME280_MODE_NORMAL           0x03
+#define BME280_CONFIG_MASK           0xFD  /* config without reserved bit 1 */
+
+/*******************************************************************************
+ * Read Cache Constants
+ ******************************************************************************/
+
+#define BME280_CACHE_TTL_OFF         0u           /* Every read hits the bus */
+#define BME280_CACHE_TTL_AUTO        0xFFFFFFFFu  /* TTL = one ODR period */
+
 /*******************************************************************************
  * Error Code Enumeration
  ******************************************************************************/
@@ -48,9 +76,43 @@ typedef enum {
     BME280_ERR_WRITE,        /* I2C write operation failed */
     BME280_ERR_READ,         /* I2C read operation failed */
     BME280_ERR_NULL_PTR,     /* NULL pointer passed to function */
-    BME280_ERR_NOT_INIT      /* Device not initialized */
+    BME280_ERR_NOT_INIT,     /* Device not initialized */
+    BME280_ERR_INVALID_ARG,  /* Argument out of range */
+    BME280_ERR_BUSY,         /* Conversion or NVM copy in progress */
+    BME280_ERR_CONFIG        /* Sensor settings differ from those written (reset?) */
 } bme280_error_t;
 
+/**
+ * Split-phase sample state
+ */
+typedef enum {
+    BME280_SAMPLE_IDLE = 0,      /* No conversion started */
+    BME280_SAMPLE_CONVERTING,    /* Triggered; result not yet seen ready */
+    BME280_SAMPLE_READY          /* Conversion done; bme280_finish_sample() reads it */
+} bme280_sample_state_t;
+
+/**
+ * What a data read fetches
+ */
+typedef enum {
+    BME280_READ_DATA = 0,    /* 8-byte burst from 0xF7 */
+    BME280_READ_VERIFIED     /* 12-byte burst from 0xF3, checked against shadow registers */
+} bme280_read_mode_t;
+
+
+/*******************************************************************************
+ * Allocator Structure
+ ******************************************************************************/
+
+/**
+ * Memory source behind bme280_alloc()/bme280_free()
+ * alloc returns size bytes aligned to align (a power of two), or NULL.
+ */
+typedef struct {
+    void *(*alloc)(void *user, size_t size, size_t align);
+    void  (*free)(void *user, void *ptr);
+    void  *user;
+} bme280_allocator_t;
 
 /*******************************************************************************
  * Calibration Data Structures
@@ -115,6 +177,53 @@ typedef struct {
     float humidity_rh;     /* Relative humidity percentage */
 } bme280_data_t;
 
+/**
+ * Raw ADC values unpacked from the data registers
+ */
+typedef struct {
+    int32_t adc_t;   /* 20-bit temperature */
+    int32_t adc_p;   /* 20-bit pressure */
+    int32_t adc_h;   /* 16-bit humidity */
+} bme280_raw_t;
+
+/*******************************************************************************
+ * Read Cache Structures
+ ******************************************************************************/
+
+/**
+ * Read cache hit/miss counters
+ */
+typedef struct {
+    uint32_t hits;     /* Reads served from the cache */
+    uint32_t misses;   /* Reads that went to the bus */
+    uint32_t shared;   /* Reads that joined another caller's bus transaction */
+} bme280_cache_stats_t;
+
+/**
+ * Last compensated sample and its capture time
+ */
+typedef struct {
+    uint32_t             ttl_us;    /* Max age in microseconds (or TTL_OFF/TTL_AUTO) */
+    int                  valid;     /* Non-zero once a sample has been captured */
+    uint32_t             epoch;     /* Bumped on invalidation; older reads are not cached */
+    uint32_t             odr_us;    /* ODR period of the shadow registers, for TTL_AUTO */
+    uint64_t             stamp_us;  /* Monotonic capture time of the sample */
+    bme280_data_t        data;      /* Cached compensated sample */
+    bme280_cache_stats_t stats;     /* Hit/miss counters */
+} bme280_cache_t;
+
+/**
+ * Single-flight slot: concurrent readers wait on the in-flight transaction
+ */
+typedef struct {
+    pthread_mutex_t lock;        /* Guards the slot and the read cache */
+    pthread_cond_t  done;        /* Signalled when a transaction completes */
+    int             in_flight;   /* Non-zero while a caller owns the bus read */
+    uint32_t        generation;  /* Incremented per completed transaction */
+    bme280_error_t  err;         /* Result of the last transaction */
+    bme280_data_t   data;        /* Sample of the last transaction */
+} bme280_flight_t;
+
 /*******************************************************************************
  * Context Structure
  ******************************************************************************/
@@ -123,10 +232,19 @@ typedef struct {
  * BME280 device context
  */
 typedef struct {
-    int            fd;       /* I2C file descriptor (-1 if not open) */
-    uint8_t        address;  /* I2C device address */
-    bme280_calib_t calib;    /* Calibration coefficients */
-    int32_t        t_fine;   /* Fine temperature for compensation */
+    int            fd;         /* I2C file descriptor (-1 if not open) */
+    uint8_t        address;    /* I2C device address */
+    bme280_calib_t calib;      /* Calibration coefficients */
+    int32_t        t_fine;     /* Fine temperature for compensation */
+    uint8_t        ctrl_hum;   /* Last value written to ctrl_hum */
+    uint8_t        ctrl_meas;  /* Last value written to ctrl_meas */
+    uint8_t        config;     /* Last value written to config */
+    uint8_t        read_mode;  /* bme280_read_mode_t */
+    uint8_t        sample_state;     /* bme280_sample_state_t */
+    uint64_t       sample_ready_us;  /* Earliest completion of the started conversion */
+    bme280_cache_t cache;      /* Read-through sample cache */
+    pthread_mutex_t bus;       /* Held for every register transaction on fd */
+    bme280_flight_t flight;    /* Concurrent read coalescing */
 } bme280_ctx_t;
 
 /*******************************************************************************
@@ -142,6 +260,17 @@ typedef struct {
  */
 bme280_error_t bme280_init(bme280_ctx_t *ctx, const char *bus_path, uint8_t address);
 
+/**
+ * Initialize context around an already-open I2C file descriptor
+ * The slave address must already be set on fd. Ownership of fd passes to
+ * the context and it is closed by bme280_close().
+ * @param ctx     Pointer to context structure (caller-allocated)
+ * @param fd      Open I2C file descriptor
+ * @param address I2C device address (recorded only)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_attach(bme280_ctx_t *ctx, int fd, uint8_t address);
+
 /**
  * Read calibration coefficients from sensor
  * @param ctx Pointer to initialized context
@@ -164,6 +293,178 @@ bme280_error_t bme280_configure(bme280_ctx_t *ctx);
  */
 bme280_error_t bme280_read_data(bme280_ctx_t *ctx, bme280_data_t *data);
 
+/**
+ * Choose what each data read fetches and checks
+ * In BME280_READ_VERIFIED mode every read is one 12-byte burst from 0xF3
+ * that also returns status, ctrl_meas and config. The read fails with
+ * BME280_ERR_BUSY while a forced conversion or NVM copy is running (a
+ * normal-mode conversion is not an error: the data registers are shadowed
+ * until the burst read ends), and with
+ * BME280_ERR_CONFIG when ctrl_meas or config no longer hold what was last
+ * written (e.g. after a brown-out reset); call bme280_configure() again.
+ * A forced-mode sensor that has returned to sleep is not a mismatch.
+ * @param ctx  Pointer to context
+ * @param mode BME280_READ_DATA (default) or BME280_READ_VERIFIED
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_set_read_mode(bme280_ctx_t *ctx, bme280_read_mode_t mode);
+
+/**
+ * Read measurements through the cache, reporting the sample age
+ * A sample younger than the cache TTL is returned without bus traffic.
+ * Callers arriving while another thread's bus read is in flight wait for
+ * it and receive the same result instead of issuing their own.
+ * @param ctx    Pointer to initialized context with calibration data
+ * @param data   Pointer to structure to receive computed values
+ * @param age_us Optional; receives the sample age in microseconds (0 on a miss)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_read_data_cached(bme280_ctx_t *ctx, bme280_data_t *data,
+                                       uint32_t *age_us);
+
+/**
+ * Set the maximum age of cached samples
+ * @param ctx    Pointer to context
+ * @param ttl_us Max age in microseconds, BME280_CACHE_TTL_OFF to disable,
+ *               or BME280_CACHE_TTL_AUTO to follow the configured ODR
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_set_cache_ttl(bme280_ctx_t *ctx, uint32_t ttl_us);
+
+/**
+ * Get read cache hit/miss counters
+ * @param ctx   Pointer to context
+ * @param stats Pointer to structure to receive the counters
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_get_cache_stats(const bme280_ctx_t *ctx, bme280_cache_stats_t *stats);
+
+/**
+ * Trigger one forced-mode conversion without waiting for it
+ * Uses the configured oversampling (1x if none was configured). The
+ * sensor is left in forced mode: one configured by bme280_configure()
+ * stops its normal-mode conversions, and the read cache is invalidated;
+ * call bme280_configure() again to return to normal mode. The caller's
+ * event loop waits; nothing here sleeps. A context runs one split-phase
+ * sample at a time and is not meant to be shared by threads while it does.
+ * @param ctx      Pointer to initialized context with calibration data
+ * @param ready_us Optional; receives the earliest completion time (bme280_time_us() clock)
+ * @return BME280_OK on success, BME280_ERR_BUSY if a sample is already in progress,
+ *         other error code on failure
+ */
+bme280_error_t bme280_start_sample(bme280_ctx_t *ctx, uint64_t *ready_us);
+
+/**
+ * Check whether the started conversion has finished
+ * Before the earliest completion time this answers without bus traffic;
+ * after it, one status register read decides.
+ * @param ctx   Pointer to context with a sample started
+ * @param ready Receives 1 when bme280_finish_sample() can be called, else 0
+ * @return BME280_OK on success, BME280_ERR_NOT_INIT if no sample was started,
+ *         other error code on failure
+ */
+bme280_error_t bme280_poll_sample(bme280_ctx_t *ctx, int *ready);
+
+/**
+ * Read and compensate the finished conversion; the context returns to idle
+ * May be called without polling once the completion time has passed. On
+ * BME280_ERR_WRITE, BME280_ERR_READ or BME280_ERR_BUSY the sample stays
+ * started and the call can be retried; bme280_configure() abandons it.
+ * @param ctx  Pointer to context with a sample started
+ * @param data Pointer to structure to receive computed values
+ * @return BME280_OK on success, BME280_ERR_BUSY before the completion time,
+ *         BME280_ERR_NOT_INIT if no sample was started, other error code on failure
+ */
+bme280_error_t bme280_finish_sample(bme280_ctx_t *ctx, bme280_data_t *data);
+
+/**
+ * Get the split-phase state of a context
+ * @param ctx Pointer to context
+ * @return Current state (BME280_SAMPLE_IDLE if ctx is NULL)
+ */
+bme280_sample_state_t bme280_sample_state(const bme280_ctx_t *ctx);
+
+/**
+ * Compute the output data period of the configured normal mode
+ * Period = maximum measurement time (datasheet 9.1) + standby time. Reads
+ * the shadow registers unlocked: call it from the thread that configures
+ * the sensor (BME280_CACHE_TTL_AUTO uses a copy taken under the lock).
+ * @param ctx Pointer to context
+ * @return Period in microseconds, or 0 if ctx is NULL
+ */
+uint32_t bme280_odr_period_us(const bme280_ctx_t *ctx);
+
+/**
+ * Read the monotonic clock used for sample timestamps
+ * @return Microseconds since an arbitrary fixed point
+ */
+uint64_t bme280_time_us(void);
+
+/**
+ * Parse calibration coefficients from raw register contents
+ * @param calib Pointer to structure to receive coefficients
+ * @param tp    24 bytes read from 0x88 (T1-T3, P1-P9)
+ * @param h1    Byte read from 0xA1 (H1)
+ * @param hum   7 bytes read from 0xE1 (H2-H6)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_parse_calibration(bme280_calib_t *calib, const uint8_t *tp,
+                                        uint8_t h1, const uint8_t *hum);
+
+/**
+ * Build the calibration register image; inverse of bme280_parse_calibration()
+ * @param calib Coefficients
+ * @param regs  32 bytes: 0x88..0x9F, 0xA1, 0xE1..0xE7
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_pack_calibration(const bme280_calib_t *calib, uint8_t *regs);
+
+/**
+ * Unpack the 8-byte data burst read from 0xF7
+ * @param buf 8 bytes: P[19:0], T[19:0], H[15:0]
+ * @param raw Pointer to structure to receive the ADC values
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_unpack_raw(const uint8_t *buf, bme280_raw_t *raw);
+
+/**
+ * Compensate raw ADC values (datasheet floating-point formulas)
+ * @param calib  Calibration coefficients
+ * @param raw    Raw ADC values
+ * @param data   Pointer to structure to receive computed values
+ * @param t_fine Optional; receives the fine temperature
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_compensate(const bme280_calib_t *calib, const bme280_raw_t *raw,
+                                 bme280_data_t *data, int32_t *t_fine);
+
+/**
+ * Install the allocator behind bme280_alloc()
+ * The library keeps its state in caller-allocated structures and does not
+ * allocate on its own; this is for callers that place large structures
+ * (UDP receivers, segment readers) with bme280_alloc(). Call once at
+ * startup, before any other thread uses the library. The default allocator
+ * uses posix_memalign()/free(). Memory must be returned to the allocator
+ * that provided it.
+ * @param allocator Allocator to copy, or NULL to restore the default
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_set_allocator(const bme280_allocator_t *allocator);
+
+/**
+ * Allocate memory through the installed allocator
+ * @param size  Bytes to allocate
+ * @param align Alignment (power of two), or 0 for malloc alignment
+ * @return Pointer to the memory, or NULL on failure
+ */
+void *bme280_alloc(size_t size, size_t align);
+
+/**
+ * Return memory from bme280_alloc() to the installed allocator
+ * @param ptr Pointer from bme280_alloc(), or NULL
+ */
+void bme280_free(void *ptr);
+
 /**
  * Close I2C connection and release resources
  * @param ctx Pointer to context to close
@@ -0,0 +1,203 @@
+/**
+ * BME280 Historian Compression Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#include "bme280_compress.h"
+
+#include <math.h>
+#include <string.h>
+
+/*******************************************************************************
+ * Filter Helpers
+ ******************************************************************************/
+
+static void emit(bme280_compressor_t *c, const bme280_point_t *point,
+                 bme280_point_t *out, int *emitted)
+{
+    c->archived = *point;
+    c->started = 1;
+    c->stats.points_out++;
+    *out = *point;
+    *emitted = 1;
+}
+
+/*
+ * Close the current segment at the held point's time. The value is taken
+ * on the middle of the doors rather than the raw sample: every slope
+ * between the doors keeps all points since the archive within the
+ * deviation, the raw held value does not always.
+ */
+static void emit_segment(bme280_compressor_t *c, bme280_point_t *out, int *emitted)
+{
+    double dt = (double)(c->held.timestamp_us - c->archived.timestamp_us);
+    bme280_point_t end = {
+        c->held.timestamp_us,
+        (float)((double)c->archived.value + 0.5 * (c->slope_max + c->slope_min) * dt)
+    };
+
+    c->pending = 0;
+    emit(c, &end, out, emitted);
+}
+
+/* Open both doors from the archived point towards a new point */
+static void open_doors(bme280_compressor_t *c, const bme280_point_t *point)
+{
+    double dt = (double)(point->timestamp_us - c->archived.timestamp_us);
+    double upper = (double)c->archived.value + c->deviation;
+    double lower = (double)c->archived.value - c->deviation;
+
+    c->slope_max = ((double)point->value - upper) / dt;
+    c->slope_min = ((double)point->value - lower) / dt;
+}
+
+/* Narrow the doors; returns non-zero if they still overlap */
+static int doors_open(bme280_compressor_t *c, const bme280_point_t *point)
+{
+    double dt = (double)(point->timestamp_us - c->archived.timestamp_us);
+    double upper = ((double)point->value - ((double)c->archived.value + c->deviation)) / dt;
+    double lower = ((double)point->value - ((double)c->archived.value - c->deviation)) / dt;
+    double slope_max = upper > c->slope_max ? upper : c->slope_max;
+    double slope_min = lower < c->slope_min ? lower : c->slope_min;
+
+    if (slope_max > slope_min) {
+        return 0;
+    }
+    c->slope_max = slope_max;
+    c->slope_min = slope_min;
+    return 1;
+}
+
+/*******************************************************************************
+ * Compression API Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_compress_init(bme280_compressor_t *c, bme280_compress_mode_t mode,
+                                    float deviation, uint64_t max_interval_us)
+{
+    if (c == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(c, 0, sizeof(*c));
+
+    if ((mode != BME280_COMPRESS_DEADBAND && mode != BME280_COMPRESS_SWINGING_DOOR)
+        || !(deviation >= 0.0f) || isinf(deviation)) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    c->mode = mode;
+    c->deviation = deviation;
+    c->max_interval_us = max_interval_us;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_compress_push(bme280_compressor_t *c, const bme280_point_t *point,
+                                    bme280_point_t *out, int *emitted)
+{
+    if (c == NULL || point == NULL || out == NULL || emitted == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    *emitted = 0;
+
+    if (c->started && point->timestamp_us <= c->held.timestamp_us) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    c->stats.points_in++;
+
+    if (!c->started) {
+        c->held = *point;
+        c->pending = 0;
+        emit(c, point, out, emitted);
+        return BME280_OK;
+    }
+
+    int overdue = c->max_interval_us > 0
+        && point->timestamp_us - c->archived.timestamp_us >= c->max_interval_us;
+
+    if (c->mode == BME280_COMPRESS_DEADBAND) {
+        c->held = *point;
+        c->pending = 1;
+        if (overdue || fabsf(point->value - c->archived.value) > c->deviation) {
+            c->pending = 0;
+            emit(c, point, out, emitted);
+        }
+        return BME280_OK;
+    }
+
+    /* Swinging door: the first point after an archive only opens the doors */
+    if (!c->pending) {
+        open_doors(c, point);
+    } else if (overdue || !doors_open(c, point)) {
+        emit_segment(c, out, emitted);
+        open_doors(c, point);
+    }
+    c->held = *point;
+    c->pending = 1;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_compress_flush(bme280_compressor_t *c, bme280_point_t *out, int *emitted)
+{
+    if (c == NULL || out == NULL || emitted == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    *emitted = 0;
+    if (c->pending) {
+        if (c->mode == BME280_COMPRESS_SWINGING_DOOR) {
+            emit_segment(c, out, emitted);
+        } else {
+            c->pending = 0;
+            emit(c, &c->held, out, emitted);
+        }
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_compress_sample_init(bme280_compress_sample_t *cs, bme280_compress_mode_t mode,
+                                           const float deviation[BME280_CHANNEL_COUNT],
+                                           uint64_t max_interval_us)
+{
+    if (cs == NULL || deviation == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    for (int i = 0; i < BME280_CHANNEL_COUNT; i++) {
+        bme280_error_t err = bme280_compress_init(&cs->channels[i], mode, deviation[i], max_interval_us);
+        if (err != BME280_OK) {
+            return err;
+        }
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_compress_sample_push(bme280_compress_sample_t *cs, uint64_t timestamp_us,
+                                           const bme280_data_t *data, bme280_point_cb_t cb, void *user)
+{
+    if (cs == NULL || data == NULL || cb == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    const float values[BME280_CHANNEL_COUNT] = {
+        data->temperature_c, data->pressure_hpa, data->humidity_rh
+    };
+
+    for (int i = 0; i < BME280_CHANNEL_COUNT; i++) {
+        bme280_point_t point = { timestamp_us, values[i] };
+        bme280_point_t out;
+        int emitted;
+        bme280_error_t err = bme280_compress_push(&cs->channels[i], &point, &out, &emitted);
+        if (err != BME280_OK) {
+            return err;
+        }
+        if (emitted) {
+            cb(user, (bme280_channel_t)i, &out);
+        }
+    }
+    return BME280_OK;
+}
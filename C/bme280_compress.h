@@ -0,0 +1,154 @@
+/**
+ * BME280 Historian Compression
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Exception and compression filters as used by process historians, applied
+ * per channel to the compensated stream. Only the points needed to rebuild
+ * the signal within a configured deviation are emitted:
+ *
+ *   Deadband       emit a point when it differs from the last emitted one
+ *                  by more than the deviation; rebuild by holding the
+ *                  last value.
+ *   Swinging door  emit a point only when no straight line from the last
+ *                  emitted point can stay within the deviation of every
+ *                  point since; rebuild by linear interpolation. Emitted
+ *                  values sit on the middle of the doors, so they may
+ *                  differ from the raw sample by up to the deviation.
+ *
+ * Both filters can also force a point after max_interval_us so a quiet
+ * channel still shows it is alive.
+ */
+
+#ifndef BME280_COMPRESS_H
+#define BME280_COMPRESS_H
+
+#include "bme280.h"
+
+/*******************************************************************************
+ * Compression Structures
+ ******************************************************************************/
+
+/**
+ * Filter type
+ */
+typedef enum {
+    BME280_COMPRESS_DEADBAND = 0,
+    BME280_COMPRESS_SWINGING_DOOR
+} bme280_compress_mode_t;
+
+/**
+ * Timestamped value of one channel
+ */
+typedef struct {
+    uint64_t timestamp_us;
+    float    value;
+} bme280_point_t;
+
+/**
+ * Compressor counters
+ */
+typedef struct {
+    uint64_t points_in;    /* Points offered */
+    uint64_t points_out;   /* Points emitted */
+} bme280_compress_stats_t;
+
+/**
+ * Compressor state for one channel
+ */
+typedef struct {
+    bme280_compress_mode_t  mode;
+    float                   deviation;        /* Reconstruction error bound */
+    uint64_t                max_interval_us;  /* Force a point after this long (0 = never) */
+    int                     started;          /* A point has been emitted */
+    int                     pending;          /* held has not been emitted */
+    bme280_point_t          archived;         /* Last emitted point */
+    bme280_point_t          held;             /* Last offered point */
+    double                  slope_max;        /* Swinging door: steepest upper door */
+    double                  slope_min;        /* Swinging door: shallowest lower door */
+    bme280_compress_stats_t stats;
+} bme280_compressor_t;
+
+/**
+ * Channels of a compensated sample
+ */
+typedef enum {
+    BME280_CHANNEL_TEMPERATURE = 0,
+    BME280_CHANNEL_PRESSURE,
+    BME280_CHANNEL_HUMIDITY,
+    BME280_CHANNEL_COUNT
+} bme280_channel_t;
+
+/**
+ * Called for each emitted point of a channel
+ */
+typedef void (*bme280_point_cb_t)(void *user, bme280_channel_t channel, const bme280_point_t *point);
+
+/**
+ * One compressor per channel of a sensor
+ */
+typedef struct {
+    bme280_compressor_t channels[BME280_CHANNEL_COUNT];
+} bme280_compress_sample_t;
+
+/*******************************************************************************
+ * Compression API Functions
+ ******************************************************************************/
+
+/**
+ * Initialize a channel compressor
+ * @param c               Pointer to compressor (caller-allocated)
+ * @param mode            Filter type
+ * @param deviation       Error bound in channel units (>= 0)
+ * @param max_interval_us Force a point after this long (0 = never)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_compress_init(bme280_compressor_t *c, bme280_compress_mode_t mode,
+                                    float deviation, uint64_t max_interval_us);
+
+/**
+ * Offer the next point; timestamps must increase
+ * @param c       Pointer to initialized compressor
+ * @param point   Point to offer
+ * @param out     Receives the emitted point, if any
+ * @param emitted Set to 1 if out holds a point, else 0
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_compress_push(bme280_compressor_t *c, const bme280_point_t *point,
+                                    bme280_point_t *out, int *emitted);
+
+/**
+ * Emit the last offered point if it has not been emitted (end of stream)
+ * @param c       Pointer to initialized compressor
+ * @param out     Receives the emitted point, if any
+ * @param emitted Set to 1 if out holds a point, else 0
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_compress_flush(bme280_compressor_t *c, bme280_point_t *out, int *emitted);
+
+/**
+ * Initialize all channels of a sensor with the same filter
+ * @param cs              Pointer to channel set (caller-allocated)
+ * @param mode            Filter type
+ * @param deviation       Error bounds indexed by bme280_channel_t
+ * @param max_interval_us Force a point after this long (0 = never)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_compress_sample_init(bme280_compress_sample_t *cs, bme280_compress_mode_t mode,
+                                           const float deviation[BME280_CHANNEL_COUNT],
+                                           uint64_t max_interval_us);
+
+/**
+ * Offer a compensated sample to every channel
+ * @param cs           Pointer to initialized channel set
+ * @param timestamp_us Sample time
+ * @param data         Sample
+ * @param cb           Called for each emitted point
+ * @param user         Passed to cb
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_compress_sample_push(bme280_compress_sample_t *cs, uint64_t timestamp_us,
+                                           const bme280_data_t *data, bme280_point_cb_t cb, void *user);
+
+#endif /* BME280_COMPRESS_H */
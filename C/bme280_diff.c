@@ -0,0 +1,392 @@
+/**
+ * BME280 Cross-Sensor Differential Encoding Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#include "bme280_diff.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DIFF_FLAG_KEYFRAME   0x01
+#define DIFF_FLAG_REFERENCE  0x02
+
+/*******************************************************************************
+ * Bit Stream Helpers
+ ******************************************************************************/
+
+typedef struct {
+    uint8_t       *buf;
+    const uint8_t *in;
+    size_t         cap;
+    size_t         pos;      /* Byte position */
+    uint64_t       acc;      /* Pending bits, LSB first */
+    uint32_t       nbits;
+    int            overflow;
+} bitstream_t;
+
+static void put_byte(bitstream_t *s, uint8_t b)
+{
+    if (s->pos < s->cap) {
+        s->buf[s->pos] = b;
+    } else {
+        s->overflow = 1;
+    }
+    s->pos++;
+}
+
+static int get_byte(bitstream_t *s, uint8_t *b)
+{
+    if (s->pos >= s->cap) {
+        s->overflow = 1;
+        return 0;
+    }
+    *b = s->in[s->pos++];
+    return 1;
+}
+
+static void put_varint(bitstream_t *s, uint64_t v)
+{
+    while (v >= 0x80) {
+        put_byte(s, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    put_byte(s, (uint8_t)v);
+}
+
+static uint64_t get_varint(bitstream_t *s)
+{
+    uint64_t v = 0;
+    uint8_t b = 0x80;
+    for (uint32_t shift = 0; shift < 64 && (b & 0x80); shift += 7) {
+        if (!get_byte(s, &b)) {
+            return 0;
+        }
+        v |= (uint64_t)(b & 0x7F) << shift;
+    }
+    if (b & 0x80) {
+        s->overflow = 1;
+    }
+    return v;
+}
+
+static void put_bits(bitstream_t *s, uint64_t v, uint32_t width)
+{
+    s->acc |= v << s->nbits;
+    s->nbits += width;
+    while (s->nbits >= 8) {
+        put_byte(s, (uint8_t)s->acc);
+        s->acc >>= 8;
+        s->nbits -= 8;
+    }
+}
+
+static uint64_t get_bits(bitstream_t *s, uint32_t width)
+{
+    while (s->nbits < width) {
+        uint8_t b = 0;
+        get_byte(s, &b);
+        s->acc |= (uint64_t)b << s->nbits;
+        s->nbits += 8;
+    }
+    uint64_t v = width ? s->acc & ((~0ULL) >> (64 - width)) : 0;
+    s->acc >>= width;
+    s->nbits -= width;
+    return v;
+}
+
+/* Drop or flush partial bits so the next field starts on a byte */
+static void align(bitstream_t *s)
+{
+    if (s->buf != NULL && s->nbits > 0) {
+        put_byte(s, (uint8_t)s->acc);
+    }
+    s->acc = 0;
+    s->nbits = 0;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static uint32_t bit_width(uint64_t v)
+{
+    uint32_t w = 0;
+    while (v) {
+        w++;
+        v >>= 1;
+    }
+    return w;
+}
+
+/*******************************************************************************
+ * Coding Helpers
+ ******************************************************************************/
+
+static void raw_channels(const bme280_raw_t *raw, int32_t out[3])
+{
+    out[0] = raw->adc_t;
+    out[1] = raw->adc_p;
+    out[2] = raw->adc_h;
+}
+
+/* Present sensor with the smallest total distance to the others */
+static uint32_t pick_medoid(const bme280_diff_t *d, const bme280_raw_t *raw, const uint8_t *p)
+{
+    uint32_t best = 0;
+    int64_t best_cost = -1;
+
+    for (uint32_t i = 0; i < d->count; i++) {
+        if (!p[i]) {
+            continue;
+        }
+        int64_t cost = 0;
+        for (uint32_t j = 0; j < d->count; j++) {
+            if (p[j]) {
+                cost += llabs((int64_t)raw[i].adc_t - raw[j].adc_t)
+                      + llabs((int64_t)raw[i].adc_p - raw[j].adc_p)
+                      + llabs((int64_t)raw[i].adc_h - raw[j].adc_h);
+            }
+        }
+        if (best_cost < 0 || cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+/*******************************************************************************
+ * Differential Encoding API Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_diff_init(bme280_diff_t *d, bme280_diff_mode_t mode, uint32_t count,
+                                uint32_t reference, uint32_t keyframe_interval)
+{
+    if (d == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(d, 0, sizeof(*d));
+
+    if ((mode != BME280_DIFF_DELTA && mode != BME280_DIFF_REFERENCE)
+        || count == 0 || count > BME280_DIFF_MAX_SENSORS
+        || (reference != BME280_DIFF_AUTO_REF && reference >= count)) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    d->mode = mode;
+    d->count = count;
+    d->reference_choice = reference;
+    d->keyframe_interval = keyframe_interval;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_diff_encode(bme280_diff_t *d, const bme280_raw_t *raw, const uint8_t *present,
+                                  uint8_t *out, size_t cap, size_t *len)
+{
+    uint8_t p[BME280_DIFF_MAX_SENSORS];
+    int32_t val[BME280_DIFF_MAX_SENSORS][3];
+    int64_t coded[BME280_DIFF_MAX_SENSORS][3];
+
+    if (d == NULL || raw == NULL || out == NULL || len == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (d->count == 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    for (uint32_t i = 0; i < d->count; i++) {
+        p[i] = present == NULL || present[i];
+    }
+
+    int reference_mode = d->mode == BME280_DIFF_REFERENCE;
+    int key = !d->started || (d->keyframe_interval > 0 && d->since_keyframe >= d->keyframe_interval)
+        || (reference_mode && !p[d->reference]);
+
+    if (key) {
+        d->reference = (d->reference_choice != BME280_DIFF_AUTO_REF && p[d->reference_choice])
+            ? d->reference_choice : pick_medoid(d, raw, p);
+    }
+
+    int32_t ref[3];
+    raw_channels(&raw[d->reference], ref);
+    for (uint32_t i = 0; i < d->count; i++) {
+        if (!p[i]) {
+            continue;
+        }
+        raw_channels(&raw[i], val[i]);
+        for (int c = 0; c < 3; c++) {
+            if (reference_mode && i != d->reference) {
+                val[i][c] -= ref[c];
+            }
+            coded[i][c] = (key || !d->valid[i]) ? val[i][c] : (int64_t)val[i][c] - d->prev[i][c];
+        }
+    }
+
+    bitstream_t s = { out, NULL, cap, 0, 0, 0, 0 };
+    put_byte(&s, (uint8_t)((key ? DIFF_FLAG_KEYFRAME : 0) | (reference_mode ? DIFF_FLAG_REFERENCE : 0)));
+    if (key) {
+        put_varint(&s, d->count);
+        put_varint(&s, d->reference);
+    }
+    for (uint32_t i = 0; i < d->count; i++) {
+        put_bits(&s, p[i], 1);
+    }
+    align(&s);
+
+    int ref_alone = reference_mode && p[d->reference];
+    if (ref_alone) {
+        for (int c = 0; c < 3; c++) {
+            put_varint(&s, zigzag(coded[d->reference][c]));
+        }
+    }
+
+    for (int c = 0; c < 3; c++) {
+        uint32_t width = 0;
+        for (uint32_t i = 0; i < d->count; i++) {
+            if (p[i] && !(ref_alone && i == d->reference)) {
+                uint32_t w = bit_width(zigzag(coded[i][c]));
+                width = w > width ? w : width;
+            }
+        }
+        put_byte(&s, (uint8_t)width);
+        for (uint32_t i = 0; i < d->count; i++) {
+            if (p[i] && !(ref_alone && i == d->reference)) {
+                put_bits(&s, zigzag(coded[i][c]), width);
+            }
+        }
+        align(&s);
+    }
+
+    if (s.overflow) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    /* Commit history only once the sweep is fully coded */
+    for (uint32_t i = 0; i < d->count; i++) {
+        d->valid[i] = p[i];
+        if (p[i]) {
+            memcpy(d->prev[i], val[i], sizeof(d->prev[i]));
+        }
+    }
+    d->started = 1;
+    d->since_keyframe = key ? 1 : d->since_keyframe + 1;
+    *len = s.pos;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_diff_decode(bme280_diff_t *d, const uint8_t *in, size_t len,
+                                  bme280_raw_t *raw, uint8_t *present, size_t *consumed)
+{
+    uint8_t p[BME280_DIFF_MAX_SENSORS];
+    int32_t val[BME280_DIFF_MAX_SENSORS][3];
+    int64_t coded[BME280_DIFF_MAX_SENSORS][3];
+
+    if (d == NULL || in == NULL || raw == NULL || present == NULL || consumed == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (d->count == 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    bitstream_t s = { NULL, in, len, 0, 0, 0, 0 };
+    uint8_t flags = 0;
+    get_byte(&s, &flags);
+
+    int key = flags & DIFF_FLAG_KEYFRAME;
+    int reference_mode = d->mode == BME280_DIFF_REFERENCE;
+    if (s.overflow || ((flags & DIFF_FLAG_REFERENCE) != 0) != reference_mode) {
+        return BME280_ERR_READ;
+    }
+    if (!key && !d->started) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    uint32_t reference = d->reference;
+    if (key) {
+        uint64_t count = get_varint(&s);
+        uint64_t ref = get_varint(&s);
+        if (s.overflow || count != d->count || ref >= d->count) {
+            return BME280_ERR_READ;
+        }
+        reference = (uint32_t)ref;
+    }
+    for (uint32_t i = 0; i < d->count; i++) {
+        p[i] = (uint8_t)get_bits(&s, 1);
+    }
+    align(&s);
+
+    int ref_alone = reference_mode && p[reference];
+    if (reference_mode && !key && !ref_alone) {
+        return BME280_ERR_READ;
+    }
+    if (ref_alone) {
+        for (int c = 0; c < 3; c++) {
+            coded[reference][c] = unzigzag(get_varint(&s));
+        }
+    }
+
+    for (int c = 0; c < 3; c++) {
+        uint8_t width = 0;
+        get_byte(&s, &width);
+        if (width > 56) {
+            return BME280_ERR_READ;
+        }
+        for (uint32_t i = 0; i < d->count; i++) {
+            if (p[i] && !(ref_alone && i == reference)) {
+                coded[i][c] = unzigzag(get_bits(&s, width));
+            }
+        }
+        align(&s);
+    }
+
+    if (s.overflow) {
+        return BME280_ERR_READ;
+    }
+
+    /* Reference first: the others are residuals against it */
+    int32_t ref[3] = { 0, 0, 0 };
+    for (uint32_t n = 0; n < d->count; n++) {
+        uint32_t i = (n == 0) ? reference : (n <= reference ? n - 1 : n);
+        if (!p[i]) {
+            continue;
+        }
+        for (int c = 0; c < 3; c++) {
+            val[i][c] = (int32_t)((key || !d->valid[i]) ? coded[i][c] : d->prev[i][c] + coded[i][c]);
+        }
+        int32_t abs_val[3];
+        for (int c = 0; c < 3; c++) {
+            abs_val[c] = (reference_mode && i != reference) ? val[i][c] + ref[c] : val[i][c];
+        }
+        if (i == reference) {
+            memcpy(ref, abs_val, sizeof(ref));
+        }
+        raw[i].adc_t = abs_val[0];
+        raw[i].adc_p = abs_val[1];
+        raw[i].adc_h = abs_val[2];
+    }
+
+    for (uint32_t i = 0; i < d->count; i++) {
+        present[i] = p[i];
+        d->valid[i] = p[i];
+        if (p[i]) {
+            memcpy(d->prev[i], val[i], sizeof(d->prev[i]));
+        }
+    }
+    d->reference = reference;
+    d->started = 1;
+    d->since_keyframe = key ? 1 : d->since_keyframe + 1;
+    *consumed = s.pos;
+    return BME280_OK;
+}
@@ -0,0 +1,114 @@
+/**
+ * BME280 Cross-Sensor Differential Encoding
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Compact encoding of time-aligned sweeps of raw ADC values from a group
+ * of co-located sensors. In reference mode one sensor of the group is
+ * coded on its own and every other sensor only as its residual against
+ * that reference; since co-located sensors follow the same weather, the
+ * residuals barely move and their sweep-to-sweep change packs into a few
+ * bits. Delta mode codes each sensor against its own previous value and is
+ * kept for comparison and for groups that are not co-located.
+ *
+ * Each channel of a sweep is bit-packed with one width chosen for that
+ * sweep, so the output is ready for a general-purpose entropy coder.
+ * Keyframes (the first sweep and every keyframe_interval-th) code absolute
+ * values and allow decoding to start there.
+ *
+ * Sweep layout:
+ *   u8 flags (bit 0 keyframe, bit 1 reference mode)
+ *   keyframe only: varint sensor count, varint reference index
+ *   presence bitmap, one bit per sensor
+ *   reference mode: reference sensor as 3 zigzag varints
+ *   per channel (T, P, H): u8 width, then width bits per remaining present
+ *   sensor, zigzag-coded, padded to a byte
+ */
+
+#ifndef BME280_DIFF_H
+#define BME280_DIFF_H
+
+#include "bme280.h"
+
+#include <stddef.h>
+
+/*******************************************************************************
+ * Differential Encoding Constants
+ ******************************************************************************/
+
+#define BME280_DIFF_MAX_SENSORS   64          /* Sensors per group */
+#define BME280_DIFF_MAX_BYTES     1024        /* Upper bound on one encoded sweep */
+#define BME280_DIFF_AUTO_REF      0xFFFFFFFFu /* Pick the most central sensor */
+
+/*******************************************************************************
+ * Differential Encoding Structures
+ ******************************************************************************/
+
+/**
+ * Coding mode
+ */
+typedef enum {
+    BME280_DIFF_DELTA = 0,     /* Each sensor against its previous sweep */
+    BME280_DIFF_REFERENCE      /* Residuals against a reference sensor */
+} bme280_diff_mode_t;
+
+/**
+ * Encoder or decoder state (both sides track the same history)
+ */
+typedef struct {
+    bme280_diff_mode_t mode;
+    uint32_t           count;              /* Sensors in the group */
+    uint32_t           reference_choice;   /* Fixed index or BME280_DIFF_AUTO_REF */
+    uint32_t           reference;          /* Reference used since the last keyframe */
+    uint32_t           keyframe_interval;  /* Sweeps between keyframes (0 = only the first) */
+    uint32_t           since_keyframe;
+    int                started;            /* A keyframe has been coded */
+    uint8_t            valid[BME280_DIFF_MAX_SENSORS];   /* Present in the previous sweep */
+    int32_t            prev[BME280_DIFF_MAX_SENSORS][3]; /* Previous coded values */
+} bme280_diff_t;
+
+/*******************************************************************************
+ * Differential Encoding API Functions
+ ******************************************************************************/
+
+/**
+ * Initialize an encoder or decoder
+ * @param d                 Pointer to state (caller-allocated)
+ * @param mode              Coding mode
+ * @param count             Sensors in the group (1..BME280_DIFF_MAX_SENSORS)
+ * @param reference         Reference sensor index or BME280_DIFF_AUTO_REF
+ * @param keyframe_interval Sweeps between keyframes (0 = only the first)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_diff_init(bme280_diff_t *d, bme280_diff_mode_t mode, uint32_t count,
+                                uint32_t reference, uint32_t keyframe_interval);
+
+/**
+ * Encode one sweep
+ * @param d       Pointer to encoder state
+ * @param raw     Raw values, one per sensor
+ * @param present Optional per-sensor flags; NULL means all present
+ * @param out     Output buffer
+ * @param cap     Size of out (BME280_DIFF_MAX_BYTES always suffices)
+ * @param len     Receives the encoded length
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_diff_encode(bme280_diff_t *d, const bme280_raw_t *raw, const uint8_t *present,
+                                  uint8_t *out, size_t cap, size_t *len);
+
+/**
+ * Decode one sweep
+ * @param d        Pointer to decoder state
+ * @param in       Encoded sweep
+ * @param len      Bytes available
+ * @param raw      Receives raw values, one per sensor (absent ones untouched)
+ * @param present  Receives per-sensor presence flags
+ * @param consumed Receives the number of bytes used
+ * @return BME280_OK on success, BME280_ERR_READ on malformed input,
+ *         BME280_ERR_NOT_INIT if decoding did not start at a keyframe
+ */
+bme280_error_t bme280_diff_decode(bme280_diff_t *d, const uint8_t *in, size_t len,
+                                  bme280_raw_t *raw, uint8_t *present, size_t *consumed);
+
+#endif /* BME280_DIFF_H */
@@ -0,0 +1,94 @@
+/**
+ * BME280 Whole-Sweep Frame Publisher Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#include "bme280_frame.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/* The middle slot carries a frame index plus a flag set by each publish */
+#define FRAME_INDEX_MASK  0x3u
+#define FRAME_FRESH       0x4u
+
+/*******************************************************************************
+ * Publisher Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_frame_init(bme280_frame_pub_t *pub)
+{
+    if (pub == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(pub, 0, sizeof(*pub));
+    pub->back = 0;
+    pub->middle = 1;
+    pub->front = 2;
+    return BME280_OK;
+}
+
+bme280_frame_t *bme280_frame_back(bme280_frame_pub_t *pub)
+{
+    if (pub == NULL) {
+        return NULL;
+    }
+
+    return &pub->frames[pub->back];
+}
+
+bme280_error_t bme280_frame_publish(bme280_frame_pub_t *pub)
+{
+    if (pub == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_frame_t *frame = &pub->frames[pub->back];
+    frame->sequence = ++pub->sequence;
+    frame->timestamp_us = bme280_time_us();
+
+    /* Release the filled frame and take whichever one the consumer left */
+    uint32_t prev = __atomic_exchange_n(&pub->middle, pub->back | FRAME_FRESH,
+                                        __ATOMIC_ACQ_REL);
+    pub->back = prev & FRAME_INDEX_MASK;
+    return BME280_OK;
+}
+
+const bme280_frame_t *bme280_frame_latest(bme280_frame_pub_t *pub)
+{
+    if (pub == NULL) {
+        return NULL;
+    }
+
+    /* Swap only when a newer frame exists; otherwise keep the current one */
+    if (__atomic_load_n(&pub->middle, __ATOMIC_ACQUIRE) & FRAME_FRESH) {
+        uint32_t prev = __atomic_exchange_n(&pub->middle, pub->front, __ATOMIC_ACQ_REL);
+        pub->front = prev & FRAME_INDEX_MASK;
+    }
+
+    const bme280_frame_t *frame = &pub->frames[pub->front];
+    return (frame->sequence == 0) ? NULL : frame;
+}
+
+bme280_error_t bme280_frame_sweep(bme280_frame_pub_t *pub, bme280_ctx_t *const *ctxs,
+                                  uint32_t count)
+{
+    if (pub == NULL || (ctxs == NULL && count > 0)) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (count > BME280_FRAME_MAX_SENSORS) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    bme280_frame_t *frame = &pub->frames[pub->back];
+    frame->count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        frame->status[i] = bme280_read_data(ctxs[i], &frame->samples[i]);
+    }
+
+    return bme280_frame_publish(pub);
+}
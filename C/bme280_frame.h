@@ -0,0 +1,95 @@
+/**
+ * BME280 Whole-Sweep Frame Publisher
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Triple buffer of multi-sensor frames. A single producer fills the back
+ * frame with one sweep over all sensors and publishes it atomically; a
+ * single consumer picks up the latest complete frame without waiting and
+ * without copying. Consumers never observe a mix of two sweeps.
+ */
+
+#ifndef BME280_FRAME_H
+#define BME280_FRAME_H
+
+#include "bme280.h"
+
+/*******************************************************************************
+ * Frame Constants
+ ******************************************************************************/
+
+#define BME280_FRAME_MAX_SENSORS  64  /* Sensors per sweep */
+
+/*******************************************************************************
+ * Frame Structures
+ ******************************************************************************/
+
+/**
+ * One complete sweep over all sensors
+ */
+typedef struct {
+    uint64_t       sequence;       /* Sweep number, starting at 1 */
+    uint64_t       timestamp_us;   /* Monotonic time the sweep completed */
+    uint32_t       count;          /* Sensors in this sweep */
+    bme280_error_t status[BME280_FRAME_MAX_SENSORS];   /* Per-sensor read result */
+    bme280_data_t  samples[BME280_FRAME_MAX_SENSORS];  /* Valid where status is OK */
+} bme280_frame_t;
+
+/**
+ * Triple-buffer publisher state
+ */
+typedef struct {
+    bme280_frame_t frames[3];  /* Back, middle and front frames */
+    uint32_t       middle;     /* Shared slot: frame index | fresh flag */
+    uint32_t       back;       /* Frame index owned by the producer */
+    uint32_t       front;      /* Frame index owned by the consumer */
+    uint64_t       sequence;   /* Last published sweep number */
+} bme280_frame_pub_t;
+
+/*******************************************************************************
+ * Publisher API Functions
+ ******************************************************************************/
+
+/**
+ * Initialize an empty publisher
+ * @param pub Pointer to publisher (caller-allocated)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_frame_init(bme280_frame_pub_t *pub);
+
+/**
+ * Get the frame the producer may fill (producer side only)
+ * @param pub Pointer to initialized publisher
+ * @return Pointer to the back frame, or NULL if pub is NULL
+ */
+bme280_frame_t *bme280_frame_back(bme280_frame_pub_t *pub);
+
+/**
+ * Publish the back frame as the latest complete sweep (producer side only)
+ * Stamps the sequence number and completion time.
+ * @param pub Pointer to initialized publisher
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_frame_publish(bme280_frame_pub_t *pub);
+
+/**
+ * Get the latest complete frame (consumer side only)
+ * The returned frame stays valid and unchanged until the next call.
+ * @param pub Pointer to initialized publisher
+ * @return Pointer to the latest frame, or NULL if nothing was published yet
+ */
+const bme280_frame_t *bme280_frame_latest(bme280_frame_pub_t *pub);
+
+/**
+ * Read every sensor into the back frame and publish it
+ * Per-sensor failures are recorded in the frame status array.
+ * @param pub   Pointer to initialized publisher
+ * @param ctxs  Array of initialized sensor contexts
+ * @param count Number of contexts (at most BME280_FRAME_MAX_SENSORS)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_frame_sweep(bme280_frame_pub_t *pub, bme280_ctx_t *const *ctxs,
+                                  uint32_t count);
+
+#endif /* BME280_FRAME_H */
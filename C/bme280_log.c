@@ -0,0 +1,250 @@
+/**
+ * BME280 Persistent Sample Log Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bme280_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*******************************************************************************
+ * Encoding Helpers
+ ******************************************************************************/
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_f32(uint8_t *p, float f)
+{
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    put_u32(p, v);
+}
+
+static float get_f32(const uint8_t *p)
+{
+    uint32_t v = get_u32(p);
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+uint32_t bme280_crc32(uint32_t crc, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+void bme280_log_encode(const bme280_log_record_t *rec, uint8_t *buf)
+{
+    put_u32(buf, (uint32_t)rec->timestamp_us);
+    put_u32(buf + 4, (uint32_t)(rec->timestamp_us >> 32));
+    put_u32(buf + 8, rec->sensor);
+    put_u32(buf + 12, (uint32_t)rec->status);
+    put_f32(buf + 16, rec->data.temperature_c);
+    put_f32(buf + 20, rec->data.pressure_hpa);
+    put_f32(buf + 24, rec->data.humidity_rh);
+    put_u32(buf + 28, bme280_crc32(0, buf, 28));
+}
+
+bme280_error_t bme280_log_decode(const uint8_t *buf, bme280_log_record_t *rec)
+{
+    if (get_u32(buf + 28) != bme280_crc32(0, buf, 28)) {
+        return BME280_ERR_READ;
+    }
+
+    rec->timestamp_us = (uint64_t)get_u32(buf) | ((uint64_t)get_u32(buf + 4) << 32);
+    rec->sensor = get_u32(buf + 8);
+    rec->status = (bme280_error_t)(int32_t)get_u32(buf + 12);
+    rec->data.temperature_c = get_f32(buf + 16);
+    rec->data.temperature_f = rec->data.temperature_c * 1.8f + 32.0f;
+    rec->data.pressure_hpa = get_f32(buf + 20);
+    rec->data.humidity_rh = get_f32(buf + 24);
+    return BME280_OK;
+}
+
+/*******************************************************************************
+ * Log API Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_log_open(bme280_log_t *log, const char *path)
+{
+    if (log == NULL || path == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    log->fd = -1;
+    log->count = 0;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return BME280_ERR_READ;
+    }
+
+    /* Drop a partial record, then a trailing record whose CRC does not match */
+    uint64_t count = (uint64_t)st.st_size / BME280_LOG_RECORD_SIZE;
+    if (count > 0) {
+        uint8_t buf[BME280_LOG_RECORD_SIZE];
+        bme280_log_record_t rec;
+        off_t last = (off_t)((count - 1) * BME280_LOG_RECORD_SIZE);
+        if (pread(fd, buf, sizeof(buf), last) != (ssize_t)sizeof(buf)) {
+            close(fd);
+            return BME280_ERR_READ;
+        }
+        if (bme280_log_decode(buf, &rec) != BME280_OK) {
+            count--;
+        }
+    }
+    if ((uint64_t)st.st_size != count * BME280_LOG_RECORD_SIZE
+        && ftruncate(fd, (off_t)(count * BME280_LOG_RECORD_SIZE)) != 0) {
+        close(fd);
+        return BME280_ERR_WRITE;
+    }
+
+    log->fd = fd;
+    log->count = count;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_log_append(bme280_log_t *log, const bme280_log_record_t *rec)
+{
+    if (log == NULL || rec == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (log->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    uint8_t buf[BME280_LOG_RECORD_SIZE];
+    bme280_log_encode(rec, buf);
+
+    ssize_t n;
+    do {
+        n = write(log->fd, buf, sizeof(buf));
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(buf)) {
+        /*
+         * Cut a torn record off so the next append lands on a record
+         * boundary. The boundary comes from the file size, not log->count,
+         * so records appended through other handles survive.
+         */
+        struct stat st;
+        if (fstat(log->fd, &st) == 0 && st.st_size % BME280_LOG_RECORD_SIZE != 0) {
+            int trimmed = ftruncate(log->fd, st.st_size - st.st_size % BME280_LOG_RECORD_SIZE);
+            (void)trimmed;
+        }
+        return BME280_ERR_WRITE;
+    }
+
+    log->count++;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_log_sync(bme280_log_t *log)
+{
+    if (log == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (log->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    return fdatasync(log->fd) == 0 ? BME280_OK : BME280_ERR_WRITE;
+}
+
+bme280_error_t bme280_log_read(bme280_log_t *log, uint64_t index,
+                               bme280_log_record_t *recs, uint32_t max, uint32_t *n)
+{
+    if (log == NULL || recs == NULL || n == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    *n = 0;
+    if (log->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    uint8_t buf[BME280_LOG_RECORD_SIZE * 16];
+    while (*n < max) {
+        uint32_t want = max - *n;
+        if (want > 16) {
+            want = 16;
+        }
+
+        ssize_t got = pread(log->fd, buf, want * BME280_LOG_RECORD_SIZE,
+                            (off_t)((index + *n) * BME280_LOG_RECORD_SIZE));
+        if (got < 0) {
+            return BME280_ERR_READ;
+        }
+
+        uint32_t whole = (uint32_t)got / BME280_LOG_RECORD_SIZE;
+        for (uint32_t i = 0; i < whole; i++) {
+            if (bme280_log_decode(buf + i * BME280_LOG_RECORD_SIZE, &recs[*n]) != BME280_OK) {
+                return BME280_ERR_READ;
+            }
+            (*n)++;
+        }
+        if (whole < want) {
+            break;
+        }
+    }
+    return BME280_OK;
+}
+
+uint64_t bme280_log_count(bme280_log_t *log)
+{
+    struct stat st;
+
+    if (log == NULL || log->fd < 0) {
+        return 0;
+    }
+
+    if (fstat(log->fd, &st) == 0) {
+        log->count = (uint64_t)st.st_size / BME280_LOG_RECORD_SIZE;
+    }
+    return log->count;
+}
+
+void bme280_log_close(bme280_log_t *log)
+{
+    if (log == NULL || log->fd < 0) {
+        return;
+    }
+
+    close(log->fd);
+    log->fd = -1;
+}
@@ -0,0 +1,129 @@
+/**
+ * BME280 Persistent Sample Log
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Append-only file of fixed-size sample records. Records are encoded
+ * little-endian regardless of host so a log can be copied between
+ * machines or mapped from other languages. Each record carries a CRC-32,
+ * so a record torn by a crash is detected and trimmed on reopen; byte
+ * offsets into the log are therefore stable and always record-aligned.
+ *
+ * Record layout (32 bytes, little-endian):
+ *   u64 timestamp_us, u32 sensor, i32 status,
+ *   f32 temperature_c, f32 pressure_hpa, f32 humidity_rh, u32 crc32
+ */
+
+#ifndef BME280_LOG_H
+#define BME280_LOG_H
+
+#include "bme280.h"
+
+#include <stddef.h>
+
+/*******************************************************************************
+ * Log Constants
+ ******************************************************************************/
+
+#define BME280_LOG_RECORD_SIZE  32  /* Bytes per encoded record */
+
+/*******************************************************************************
+ * Log Structures
+ ******************************************************************************/
+
+/**
+ * Decoded log record
+ */
+typedef struct {
+    uint64_t       timestamp_us;  /* Sample time */
+    uint32_t       sensor;        /* Caller-defined sensor identifier */
+    bme280_error_t status;        /* Read result; data is valid when OK */
+    bme280_data_t  data;          /* Compensated sample (temperature_f derived) */
+} bme280_log_record_t;
+
+/**
+ * Open log handle
+ */
+typedef struct {
+    int      fd;      /* Log file descriptor (-1 if closed) */
+    uint64_t count;   /* Records in the log */
+} bme280_log_t;
+
+/*******************************************************************************
+ * Log API Functions
+ ******************************************************************************/
+
+/**
+ * Open (creating if needed) a log file and trim any torn trailing record
+ * @param log  Pointer to handle (caller-allocated)
+ * @param path File path
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_log_open(bme280_log_t *log, const char *path);
+
+/**
+ * Append one record
+ * @param log Pointer to open log
+ * @param rec Record to append
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_log_append(bme280_log_t *log, const bme280_log_record_t *rec);
+
+/**
+ * Flush appended records to stable storage
+ * @param log Pointer to open log
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_log_sync(bme280_log_t *log);
+
+/**
+ * Read consecutive records
+ * @param log   Pointer to open log
+ * @param index First record index
+ * @param recs  Destination array
+ * @param max   Capacity of recs
+ * @param n     Receives the number of records read
+ * @return BME280_OK on success, BME280_ERR_READ on a bad CRC or I/O error
+ */
+bme280_error_t bme280_log_read(bme280_log_t *log, uint64_t index,
+                               bme280_log_record_t *recs, uint32_t max, uint32_t *n);
+
+/**
+ * Get the number of complete records, including ones appended by other handles
+ * @param log Pointer to open log
+ * @return Record count (0 if log is NULL or closed)
+ */
+uint64_t bme280_log_count(bme280_log_t *log);
+
+/**
+ * Encode a record into its on-disk form
+ * @param rec Record to encode
+ * @param buf Destination of BME280_LOG_RECORD_SIZE bytes
+ */
+void bme280_log_encode(const bme280_log_record_t *rec, uint8_t *buf);
+
+/**
+ * Decode a record from its on-disk form
+ * @param buf Source of BME280_LOG_RECORD_SIZE bytes
+ * @param rec Pointer to structure to receive the record
+ * @return BME280_OK on success, BME280_ERR_READ if the CRC does not match
+ */
+bme280_error_t bme280_log_decode(const uint8_t *buf, bme280_log_record_t *rec);
+
+/**
+ * CRC-32 (IEEE 802.3, reflected) of a buffer
+ * @param crc  Running CRC (0 to start)
+ * @param buf  Data
+ * @param len  Length in bytes
+ * @return Updated CRC
+ */
+uint32_t bme280_crc32(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * Close the log
+ * @param log Pointer to log handle
+ */
+void bme280_log_close(bme280_log_t *log);
+
+#endif /* BME280_LOG_H */
@@ -0,0 +1,526 @@
+/**
+ * BME280 Batched MQTT Publisher Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bme280_mqtt.h"
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* MQTT 3.1.1 control packet types (upper nibble of the first byte) */
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH_Q1  0x32
+#define MQTT_PUBACK      0x40
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+#define MQTT_DUP         0x08
+
+/*******************************************************************************
+ * Encoding Helpers
+ ******************************************************************************/
+
+static void put_u16_le(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32_le(uint8_t *p, uint32_t v)
+{
+    put_u16_le(p, (uint16_t)v);
+    put_u16_le(p + 2, (uint16_t)(v >> 16));
+}
+
+static void put_u64_le(uint8_t *p, uint64_t v)
+{
+    put_u32_le(p, (uint32_t)v);
+    put_u32_le(p + 4, (uint32_t)(v >> 32));
+}
+
+/* MQTT strings and packet identifiers are big-endian */
+static uint8_t *put_u16_be(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+    return p + 2;
+}
+
+static uint8_t *put_remaining_length(uint8_t *p, uint32_t len)
+{
+    do {
+        uint8_t byte = len % 128;
+        len /= 128;
+        *p++ = (uint8_t)(len > 0 ? byte | 0x80 : byte);
+    } while (len > 0);
+    return p;
+}
+
+static int32_t scale_round(float value, float scale, int32_t lo, int32_t hi)
+{
+    long v = lroundf(value * scale);
+    return (int32_t)(v < lo ? lo : (v > hi ? hi : v));
+}
+
+/*******************************************************************************
+ * Transport Helpers
+ ******************************************************************************/
+
+static int wait_fd(int fd, short events, int timeout_ms)
+{
+    struct pollfd pfd = { fd, events, 0 };
+    int rc;
+    do {
+        rc = poll(&pfd, 1, timeout_ms);
+    } while (rc < 0 && errno == EINTR);
+    return rc;
+}
+
+/* The stream is unusable (torn packet or dead broker): force a reconnect */
+static void drop_connection(bme280_mqtt_t *sink)
+{
+    close(sink->fd);
+    sink->fd = -1;
+}
+
+static bme280_error_t send_all(bme280_mqtt_t *sink, const uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(sink->fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN || errno == EWOULDBLOCK)
+                && wait_fd(sink->fd, POLLOUT, (int)sink->config.ack_timeout_ms) > 0) {
+                continue;
+            }
+            drop_connection(sink);
+            return BME280_ERR_WRITE;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+
+    sink->last_tx_us = bme280_time_us();
+    return BME280_OK;
+}
+
+static void handle_packet(bme280_mqtt_t *sink, const uint8_t *pkt, uint32_t body_off, uint32_t body_len)
+{
+    const uint8_t *body = pkt + body_off;
+
+    switch (pkt[0] & 0xF0) {
+    case MQTT_CONNACK:
+        if (body_len >= 2) {
+            sink->connack = body[1];
+        }
+        break;
+    case MQTT_PUBACK:
+        if (body_len >= 2) {
+            uint16_t id = (uint16_t)((body[0] << 8) | body[1]);
+            for (uint32_t i = 0; i < BME280_MQTT_MAX_INFLIGHT; i++) {
+                if (sink->window[i].packet_id == id) {
+                    sink->window[i].packet_id = 0;
+                    sink->inflight--;
+                    sink->stats.acks++;
+                    break;
+                }
+            }
+        }
+        break;
+    case MQTT_PINGRESP:
+        sink->ping_sent_us = 0;
+        break;
+    default:
+        /* Anything else carries nothing we track */
+        break;
+    }
+}
+
+/*
+ * Read whatever the broker has sent, waiting up to timeout_ms for the first
+ * byte, and dispatch every complete packet. EOF, a socket error or a
+ * malformed packet leaves nothing to resynchronise on, so the connection
+ * is dropped.
+ */
+static bme280_error_t receive(bme280_mqtt_t *sink, int timeout_ms)
+{
+    int ready = wait_fd(sink->fd, POLLIN, timeout_ms);
+    if (ready < 0) {
+        drop_connection(sink);
+        return BME280_ERR_READ;
+    }
+    if (ready == 0) {
+        return BME280_OK;
+    }
+
+    ssize_t n = recv(sink->fd, sink->rx + sink->rx_len, sizeof(sink->rx) - sink->rx_len,
+                     MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return BME280_OK;
+    }
+    if (n <= 0) {
+        drop_connection(sink);
+        return BME280_ERR_READ;
+    }
+    sink->rx_len += (uint32_t)n;
+
+    for (;;) {
+        uint32_t len = 0;
+        uint32_t shift = 0;
+        uint32_t pos = 1;
+        int complete = 0;
+
+        while (pos < sink->rx_len && pos <= 4) {
+            uint8_t byte = sink->rx[pos++];
+            len |= (uint32_t)(byte & 0x7F) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0) {
+                complete = 1;
+                break;
+            }
+        }
+        if (!complete) {
+            /* Broker packets we expect are tiny; a longer header is a protocol error */
+            if (pos > 4) {
+                drop_connection(sink);
+                return BME280_ERR_READ;
+            }
+            return BME280_OK;
+        }
+        if (pos + len > sizeof(sink->rx)) {
+            drop_connection(sink);
+            return BME280_ERR_READ;
+        }
+        if (pos + len > sink->rx_len) {
+            return BME280_OK;
+        }
+
+        handle_packet(sink, sink->rx, pos, len);
+        sink->rx_len -= pos + len;
+        memmove(sink->rx, sink->rx + pos + len, sink->rx_len);
+    }
+}
+
+/* Wait until fewer than limit packets are unacknowledged */
+static bme280_error_t wait_inflight_below(bme280_mqtt_t *sink, uint32_t limit)
+{
+    uint64_t deadline = bme280_time_us() + (uint64_t)sink->config.ack_timeout_ms * 1000u;
+
+    while (sink->inflight >= limit) {
+        uint64_t now = bme280_time_us();
+        if (now >= deadline) {
+            return BME280_ERR_READ;
+        }
+        bme280_error_t err = receive(sink, (int)((deadline - now + 999) / 1000));
+        if (err != BME280_OK) {
+            return err;
+        }
+    }
+    return BME280_OK;
+}
+
+/*******************************************************************************
+ * Batching
+ ******************************************************************************/
+
+static bme280_error_t flush_batch(bme280_mqtt_t *sink, bme280_mqtt_batch_t *batch)
+{
+    if (batch->count == 0) {
+        return BME280_OK;
+    }
+
+    if (sink->inflight >= sink->config.max_inflight) {
+        sink->stats.stalls++;
+        bme280_error_t err = wait_inflight_below(sink, sink->config.max_inflight);
+        if (err != BME280_OK) {
+            return err;
+        }
+    }
+
+    bme280_mqtt_inflight_t *slot = NULL;
+    for (uint32_t i = 0; i < BME280_MQTT_MAX_INFLIGHT; i++) {
+        if (sink->window[i].packet_id == 0) {
+            slot = &sink->window[i];
+            break;
+        }
+    }
+
+    if (++sink->next_id == 0) {
+        sink->next_id = 1;
+    }
+
+    uint16_t topic_len = (uint16_t)strlen(batch->topic);
+    uint8_t *p = slot->packet;
+    *p++ = MQTT_PUBLISH_Q1;
+    p = put_remaining_length(p, 2u + topic_len + 2u + batch->len);
+    p = put_u16_be(p, topic_len);
+    memcpy(p, batch->topic, topic_len);
+    p = put_u16_be(p + topic_len, sink->next_id);
+    memcpy(p, batch->payload, batch->len);
+    slot->len = (uint32_t)(p - slot->packet) + batch->len;
+
+    slot->packet_id = sink->next_id;
+    sink->inflight++;
+    batch->len = 0;
+    batch->count = 0;
+
+    /* Once in the window the packet is resent on reconnect, so a failed send is not lost */
+    sink->stats.packets++;
+    return send_all(sink, slot->packet, slot->len);
+}
+
+static bme280_mqtt_batch_t *find_batch(bme280_mqtt_t *sink, const char *topic)
+{
+    for (uint32_t i = 0; i < sink->topic_count; i++) {
+        if (strcmp(sink->batches[i].topic, topic) == 0) {
+            return &sink->batches[i];
+        }
+    }
+
+    if (sink->topic_count == BME280_MQTT_MAX_TOPICS || strlen(topic) >= BME280_MQTT_TOPIC_LEN) {
+        return NULL;
+    }
+
+    bme280_mqtt_batch_t *batch = &sink->batches[sink->topic_count++];
+    strcpy(batch->topic, topic);
+    batch->len = 0;
+    batch->count = 0;
+    return batch;
+}
+
+/*******************************************************************************
+ * MQTT Sink API Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_mqtt_init(bme280_mqtt_t *sink, const char *client_id,
+                                const bme280_mqtt_config_t *config)
+{
+    if (sink == NULL || client_id == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(sink, 0, sizeof(*sink));
+    sink->fd = -1;
+    sink->connack = -1;
+
+    if (config != NULL) {
+        sink->config = *config;
+    } else {
+        sink->config.max_inflight = BME280_MQTT_MAX_INFLIGHT;
+        sink->config.max_batch_bytes = BME280_MQTT_PAYLOAD_MAX;
+        sink->config.max_batch_age_us = 1000000u;
+        sink->config.ack_timeout_ms = 5000u;
+    }
+
+    size_t id_len = strlen(client_id);
+    if (id_len == 0 || id_len >= sizeof(sink->client_id)
+        || sink->config.max_inflight == 0
+        || sink->config.max_inflight > BME280_MQTT_MAX_INFLIGHT
+        || sink->config.max_batch_bytes < BME280_MQTT_HEADER_SIZE + BME280_MQTT_RECORD_SIZE
+        || sink->config.max_batch_bytes > BME280_MQTT_PAYLOAD_MAX) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    memcpy(sink->client_id, client_id, id_len + 1);
+    return BME280_OK;
+}
+
+bme280_error_t bme280_mqtt_connect(bme280_mqtt_t *sink, int fd)
+{
+    if (sink == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    sink->fd = fd;
+    sink->rx_len = 0;
+    sink->connack = -1;
+    sink->ping_sent_us = 0;
+
+    /* Clean session off so the broker keeps QoS1 state across reconnects */
+    uint16_t id_len = (uint16_t)strlen(sink->client_id);
+    uint8_t pkt[16 + sizeof(sink->client_id)];
+    uint8_t *p = pkt;
+    *p++ = MQTT_CONNECT;
+    p = put_remaining_length(p, 10u + 2u + id_len);
+    p = put_u16_be(p, 4);
+    memcpy(p, "MQTT", 4);
+    p += 4;
+    *p++ = 4;     /* Protocol level 3.1.1 */
+    *p++ = 0x00;  /* Connect flags */
+    p = put_u16_be(p, sink->config.keepalive_s);
+    p = put_u16_be(p, id_len);
+    memcpy(p, sink->client_id, id_len);
+    p += id_len;
+
+    bme280_error_t err = send_all(sink, pkt, (size_t)(p - pkt));
+    uint64_t deadline = bme280_time_us() + (uint64_t)sink->config.ack_timeout_ms * 1000u;
+    while (err == BME280_OK && sink->connack < 0) {
+        uint64_t now = bme280_time_us();
+        if (now >= deadline) {
+            err = BME280_ERR_READ;
+            break;
+        }
+        err = receive(sink, (int)((deadline - now + 999) / 1000));
+    }
+    if (err != BME280_OK) {
+        /* send_all() and receive() drop on their own failures; a timeout does not */
+        if (sink->fd >= 0) {
+            drop_connection(sink);
+        }
+        return err;
+    }
+    if (sink->connack != 0) {
+        /* Refused: the broker closes its end anyway */
+        drop_connection(sink);
+        return BME280_ERR_NOT_INIT;
+    }
+
+    for (uint32_t i = 0; i < BME280_MQTT_MAX_INFLIGHT && err == BME280_OK; i++) {
+        bme280_mqtt_inflight_t *slot = &sink->window[i];
+        if (slot->packet_id != 0) {
+            slot->packet[0] |= MQTT_DUP;
+            sink->stats.resent++;
+            err = send_all(sink, slot->packet, slot->len);
+        }
+    }
+    return err;
+}
+
+bme280_error_t bme280_mqtt_publish(bme280_mqtt_t *sink, const char *topic,
+                                   const bme280_data_t *data, uint64_t timestamp_us)
+{
+    if (sink == NULL || topic == NULL || data == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (sink->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    bme280_mqtt_batch_t *batch = find_batch(sink, topic);
+    if (batch == NULL) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    /* Still full after an earlier failed flush: no room until it goes out */
+    if (batch->count > 0 && batch->len + BME280_MQTT_RECORD_SIZE > sink->config.max_batch_bytes) {
+        bme280_error_t err = flush_batch(sink, batch);
+        if (err != BME280_OK) {
+            return batch->count > 0 ? BME280_ERR_BUSY : err;
+        }
+    }
+
+    /* Offsets are unsigned 32-bit: start a new batch if this sample does not fit */
+    if (batch->count > 0
+        && (timestamp_us < batch->base_us || timestamp_us - batch->base_us > UINT32_MAX)) {
+        bme280_error_t err = flush_batch(sink, batch);
+        if (err != BME280_OK) {
+            return err;
+        }
+    }
+
+    if (batch->count == 0) {
+        batch->payload[0] = BME280_MQTT_PAYLOAD_VERSION;
+        batch->payload[1] = 0;
+        put_u64_le(batch->payload + 4, timestamp_us);
+        batch->base_us = timestamp_us;
+        batch->len = BME280_MQTT_HEADER_SIZE;
+    }
+
+    uint8_t *rec = batch->payload + batch->len;
+    put_u16_le(rec, (uint16_t)scale_round(data->temperature_c, 100.0f, INT16_MIN, INT16_MAX));
+    put_u16_le(rec + 2, (uint16_t)scale_round(data->humidity_rh, 100.0f, 0, UINT16_MAX));
+    put_u32_le(rec + 4, (uint32_t)scale_round(data->pressure_hpa, 100.0f, 0, INT32_MAX));
+    put_u32_le(rec + 8, (uint32_t)(timestamp_us - batch->base_us));
+    batch->len += BME280_MQTT_RECORD_SIZE;
+    batch->count++;
+    put_u16_le(batch->payload + 2, (uint16_t)batch->count);
+    sink->stats.samples++;
+
+    if (batch->len + BME280_MQTT_RECORD_SIZE > sink->config.max_batch_bytes) {
+        return flush_batch(sink, batch);
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_mqtt_poll(bme280_mqtt_t *sink, uint64_t now_us)
+{
+    if (sink == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (sink->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    bme280_error_t err = receive(sink, 0);
+
+    /* A broker that stopped answering pings is gone even if the socket looks open */
+    if (err == BME280_OK && sink->ping_sent_us != 0
+        && now_us - sink->ping_sent_us >= (uint64_t)sink->config.ack_timeout_ms * 1000u) {
+        drop_connection(sink);
+        return BME280_ERR_READ;
+    }
+
+    for (uint32_t i = 0; i < sink->topic_count && err == BME280_OK; i++) {
+        bme280_mqtt_batch_t *batch = &sink->batches[i];
+        if (batch->count > 0 && now_us - batch->base_us >= sink->config.max_batch_age_us) {
+            err = flush_batch(sink, batch);
+        }
+    }
+
+    if (err == BME280_OK && sink->config.keepalive_s > 0 && sink->ping_sent_us == 0
+        && now_us - sink->last_tx_us >= (uint64_t)sink->config.keepalive_s * 500000u) {
+        static const uint8_t ping[2] = { MQTT_PINGREQ, 0 };
+        err = send_all(sink, ping, sizeof(ping));
+        sink->ping_sent_us = now_us;
+    }
+    return err;
+}
+
+bme280_error_t bme280_mqtt_flush(bme280_mqtt_t *sink)
+{
+    if (sink == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (sink->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    for (uint32_t i = 0; i < sink->topic_count; i++) {
+        bme280_error_t err = flush_batch(sink, &sink->batches[i]);
+        if (err != BME280_OK) {
+            return err;
+        }
+    }
+    return wait_inflight_below(sink, 1);
+}
+
+void bme280_mqtt_close(bme280_mqtt_t *sink)
+{
+    if (sink == NULL || sink->fd < 0) {
+        return;
+    }
+
+    static const uint8_t disconnect[2] = { MQTT_DISCONNECT, 0 };
+    send(sink->fd, disconnect, sizeof(disconnect), MSG_NOSIGNAL);
+    close(sink->fd);
+    sink->fd = -1;
+}
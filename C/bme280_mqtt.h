@@ -0,0 +1,182 @@
+/**
+ * BME280 Batched MQTT Publisher
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Minimal MQTT 3.1.1 client that packs many samples into one QoS1 PUBLISH
+ * per topic. Samples are appended to a per-topic batch which is flushed
+ * when it reaches the size limit or the age limit. At most max_inflight
+ * PUBLISH packets wait for PUBACK at any time; when the window is full the
+ * sink waits for an acknowledgement before sending more, so a slow broker
+ * applies backpressure instead of growing memory. Unacknowledged packets
+ * are resent with the DUP flag after a reconnect.
+ *
+ * A failed send may leave a partial packet on the stream, a failed receive
+ * (EOF, socket error, malformed packet) leaves nothing to resynchronise on,
+ * and a broker that misses a PINGRESP deadline is presumed gone; in each
+ * case the sink closes the socket (fd becomes -1) and the caller must
+ * reconnect. A flush that merely times out waiting for PUBACK keeps it.
+ *
+ * The caller owns the transport: connect a TCP socket to the broker and
+ * hand its descriptor to bme280_mqtt_connect().
+ *
+ * Payload layout (little-endian):
+ *   header  u8 version, u8 reserved, u16 count, u64 base_us
+ *   record  i16 temperature (0.01 C), u16 humidity (0.01 %RH),
+ *           u32 pressure (Pa), u32 offset from base_us (us)
+ */
+
+#ifndef BME280_MQTT_H
+#define BME280_MQTT_H
+
+#include "bme280.h"
+
+#include <stddef.h>
+
+/*******************************************************************************
+ * MQTT Sink Constants
+ ******************************************************************************/
+
+#define BME280_MQTT_MAX_TOPICS       8     /* Distinct topics per sink */
+#define BME280_MQTT_TOPIC_LEN        64    /* Max topic length incl. NUL */
+#define BME280_MQTT_PAYLOAD_MAX      1024  /* Max batch payload bytes */
+#define BME280_MQTT_MAX_INFLIGHT     16    /* Upper bound on the QoS1 window */
+#define BME280_MQTT_PAYLOAD_VERSION  1
+#define BME280_MQTT_HEADER_SIZE      12    /* Payload header bytes */
+#define BME280_MQTT_RECORD_SIZE      12    /* Bytes per packed sample */
+
+/* Largest PUBLISH packet: fixed header + topic + packet id + payload */
+#define BME280_MQTT_PACKET_MAX  (5 + 2 + BME280_MQTT_TOPIC_LEN + 2 + BME280_MQTT_PAYLOAD_MAX)
+
+/*******************************************************************************
+ * MQTT Sink Structures
+ ******************************************************************************/
+
+/**
+ * Publisher limits
+ */
+typedef struct {
+    uint32_t max_inflight;      /* Unacknowledged PUBLISH packets (1..16) */
+    uint32_t max_batch_bytes;   /* Flush a topic once its payload reaches this */
+    uint32_t max_batch_age_us;  /* Flush a topic once its oldest sample is this old */
+    uint32_t ack_timeout_ms;    /* Give up waiting for PUBACK after this long */
+    uint16_t keepalive_s;       /* MQTT keepalive (0 = disabled) */
+} bme280_mqtt_config_t;
+
+/**
+ * Publisher counters
+ */
+typedef struct {
+    uint64_t samples;   /* Samples accepted */
+    uint64_t packets;   /* PUBLISH packets sent */
+    uint64_t acks;      /* PUBACKs received */
+    uint64_t resent;    /* PUBLISH packets resent after reconnect */
+    uint64_t stalls;    /* Times the window was full */
+} bme280_mqtt_stats_t;
+
+/**
+ * Pending batch for one topic
+ */
+typedef struct {
+    char     topic[BME280_MQTT_TOPIC_LEN];
+    uint8_t  payload[BME280_MQTT_PAYLOAD_MAX];
+    uint32_t len;       /* Payload bytes (0 = empty) */
+    uint32_t count;     /* Samples in the batch */
+    uint64_t base_us;   /* Timestamp of the first sample */
+} bme280_mqtt_batch_t;
+
+/**
+ * Encoded PUBLISH awaiting PUBACK
+ */
+typedef struct {
+    uint16_t packet_id;  /* 0 = slot free */
+    uint32_t len;
+    uint8_t  packet[BME280_MQTT_PACKET_MAX];
+} bme280_mqtt_inflight_t;
+
+/**
+ * MQTT sink state
+ */
+typedef struct {
+    int                    fd;           /* Broker socket (-1 if not attached) */
+    bme280_mqtt_config_t   config;
+    char                   client_id[24];
+    uint16_t               next_id;      /* Next packet identifier */
+    uint32_t               inflight;     /* Occupied window slots */
+    uint64_t               last_tx_us;   /* For keepalive pings */
+    uint64_t               ping_sent_us; /* Unanswered PINGREQ time (0 = none) */
+    int                    connack;      /* CONNACK return code (-1 = none yet) */
+    uint32_t               rx_len;       /* Buffered inbound bytes */
+    uint8_t                rx[64];       /* Partial inbound packet */
+    uint32_t               topic_count;
+    bme280_mqtt_batch_t    batches[BME280_MQTT_MAX_TOPICS];
+    bme280_mqtt_inflight_t window[BME280_MQTT_MAX_INFLIGHT];
+    bme280_mqtt_stats_t    stats;
+} bme280_mqtt_t;
+
+/*******************************************************************************
+ * MQTT Sink API Functions
+ ******************************************************************************/
+
+/**
+ * Initialize an unconnected sink
+ * @param sink      Pointer to sink (caller-allocated)
+ * @param client_id MQTT client identifier (1 to 23 characters)
+ * @param config    Limits; NULL selects 16 in flight, full payloads, 1 s age
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_mqtt_init(bme280_mqtt_t *sink, const char *client_id,
+                                const bme280_mqtt_config_t *config);
+
+/**
+ * Send CONNECT and wait for CONNACK, then resend unacknowledged packets
+ * Call again with a new socket after a disconnect. On failure the sink
+ * closes fd and is left disconnected.
+ * @param sink Pointer to initialized sink
+ * @param fd   Connected stream socket to the broker
+ * @return BME280_OK on success, BME280_ERR_NOT_INIT if the broker refused
+ *         the connection, other error code on failure
+ */
+bme280_error_t bme280_mqtt_connect(bme280_mqtt_t *sink, int fd);
+
+/**
+ * Append a sample to a topic batch, flushing it if the size limit is hit
+ * If an earlier flush failed, the full batch is retried first and the
+ * sample is refused while it still cannot go out.
+ * @param sink         Pointer to connected sink
+ * @param topic        Topic name
+ * @param data         Compensated sample
+ * @param timestamp_us Sample time (e.g. bme280_time_us())
+ * @return BME280_OK on success, BME280_ERR_BUSY if the sample was refused
+ *         because the batch is full and the window stays full, other error
+ *         code on failure
+ */
+bme280_error_t bme280_mqtt_publish(bme280_mqtt_t *sink, const char *topic,
+                                   const bme280_data_t *data, uint64_t timestamp_us);
+
+/**
+ * Process PUBACKs, flush batches past the age limit and send keepalives
+ * Never blocks unless a flush finds the window full. A PINGREQ not
+ * answered within ack_timeout_ms closes the connection.
+ * @param sink   Pointer to connected sink
+ * @param now_us Current monotonic time
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_mqtt_poll(bme280_mqtt_t *sink, uint64_t now_us);
+
+/**
+ * Send every pending batch and wait until all are acknowledged
+ * @param sink Pointer to connected sink
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_mqtt_flush(bme280_mqtt_t *sink);
+
+/**
+ * Send DISCONNECT and close the broker socket
+ * Unacknowledged packets are kept for the next bme280_mqtt_connect().
+ * @param sink Pointer to sink
+ */
+void bme280_mqtt_close(bme280_mqtt_t *sink);
+
+#endif /* BME280_MQTT_H */
@@ -0,0 +1,419 @@
+/**
+ * BME280 Shared-Memory Sample Ring Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+/* syscall() for futex is a GNU extension */
+#define _GNU_SOURCE
+
+#include "bme280_ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/* Attempts to wait for the writer to finish creating the ring */
+#define RING_INIT_RETRIES  1000
+
+/*******************************************************************************
+ * Helpers
+ ******************************************************************************/
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int owner_alive(pid_t pid)
+{
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+/* Shared (not process-private) futex: waiters live in other processes */
+static void futex_wait(uint32_t *word, uint32_t expected, uint64_t timeout_us)
+{
+    struct timespec ts = { (time_t)(timeout_us / 1000000u), (long)(timeout_us % 1000000u) * 1000L };
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, &ts, NULL, 0);
+}
+
+static void futex_wake_all(uint32_t *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static uint8_t *slot_at(const bme280_ring_t *ring, uint64_t seq)
+{
+    return ring->records + (size_t)(seq & ring->mask) * BME280_LOG_RECORD_SIZE;
+}
+
+/*******************************************************************************
+ * Ring Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_ring_create(bme280_ring_t *ring, const char *name, uint32_t capacity)
+{
+    if (ring == NULL || name == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    if (capacity < BME280_RING_MIN_CAPACITY || capacity > BME280_RING_MAX_CAPACITY
+        || (capacity & (capacity - 1)) != 0) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    /* Consumers of a previous ring keep their mapping but see no new records */
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    size_t size = BME280_RING_DATA_OFFSET + (size_t)capacity * BME280_LOG_RECORD_SIZE;
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return BME280_ERR_WRITE;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        shm_unlink(name);
+        return BME280_ERR_READ;
+    }
+
+    bme280_ring_header_t *hdr = map;
+    hdr->version = BME280_RING_VERSION;
+    hdr->capacity = capacity;
+    hdr->record_size = BME280_LOG_RECORD_SIZE;
+    __atomic_store_n(&hdr->magic, BME280_RING_MAGIC, __ATOMIC_RELEASE);
+
+    ring->fd = fd;
+    ring->hdr = hdr;
+    ring->records = (uint8_t *)map + BME280_RING_DATA_OFFSET;
+    ring->size = size;
+    ring->mask = capacity - 1;
+    ring->writer = 1;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_ring_open(bme280_ring_t *ring, const char *name)
+{
+    if (ring == NULL || name == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    /* The writer sizes the segment once, so any non-zero size is final */
+    struct stat st;
+    int retries = RING_INIT_RETRIES;
+    while (fstat(fd, &st) == 0 && st.st_size == 0 && --retries > 0) {
+        sleep_ms(1);
+    }
+    if (retries == 0 || (size_t)st.st_size <= BME280_RING_DATA_OFFSET) {
+        close(fd);
+        return BME280_ERR_NOT_INIT;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return BME280_ERR_READ;
+    }
+
+    bme280_ring_header_t *hdr = map;
+    retries = RING_INIT_RETRIES;
+    while (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != BME280_RING_MAGIC && --retries > 0) {
+        sleep_ms(1);
+    }
+    if (retries == 0 || hdr->version != BME280_RING_VERSION
+        || hdr->record_size != BME280_LOG_RECORD_SIZE
+        || size != BME280_RING_DATA_OFFSET + (size_t)hdr->capacity * BME280_LOG_RECORD_SIZE) {
+        munmap(map, size);
+        close(fd);
+        return BME280_ERR_NOT_INIT;
+    }
+
+    ring->fd = fd;
+    ring->hdr = hdr;
+    ring->records = (uint8_t *)map + BME280_RING_DATA_OFFSET;
+    ring->size = size;
+    ring->mask = hdr->capacity - 1;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_ring_publish(bme280_ring_t *ring, const bme280_log_record_t *recs,
+                                   uint32_t count)
+{
+    if (ring == NULL || (recs == NULL && count > 0)) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (ring->hdr == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (!ring->writer) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    bme280_ring_header_t *hdr = ring->hdr;
+    uint64_t head = __atomic_load_n(&hdr->head, __ATOMIC_RELAXED);
+
+    for (uint32_t i = 0; i < count; i++) {
+        /*
+         * Slot head still holds record head - capacity; head was published
+         * before this write, so a reader that sees torn data here also sees
+         * a head that tells it so in bme280_ring_release().
+         */
+        bme280_log_encode(&recs[i], slot_at(ring, head));
+        head++;
+        __atomic_store_n(&hdr->head, head, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    /* Pairs with the waiter's increment-then-check in bme280_ring_wait() */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (count > 0 && __atomic_load_n(&hdr->waiters, __ATOMIC_RELAXED) > 0) {
+        __atomic_fetch_add(&hdr->wake, 1, __ATOMIC_RELEASE);
+        futex_wake_all(&hdr->wake);
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_ring_join(bme280_ring_t *ring, bme280_ring_consumer_t *consumer)
+{
+    if (ring == NULL || consumer == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(consumer, 0, sizeof(*consumer));
+
+    if (ring->hdr == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    uint32_t pid = (uint32_t)getpid();
+    for (int i = 0; i < BME280_RING_MAX_CONSUMERS; i++) {
+        bme280_ring_cursor_t *slot = &ring->hdr->consumers[i];
+        uint32_t owner = __atomic_load_n(&slot->pid, __ATOMIC_ACQUIRE);
+
+        /* Reclaim slots left behind by processes that exited without leaving */
+        if (owner != 0 && (owner == pid || owner_alive((pid_t)owner))) {
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&slot->pid, &owner, pid, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            consumer->ring = ring;
+            consumer->slot = slot;
+            consumer->cursor = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+            __atomic_store_n(&slot->cursor, consumer->cursor, __ATOMIC_RELAXED);
+            __atomic_store_n(&slot->lost, 0, __ATOMIC_RELAXED);
+            return BME280_OK;
+        }
+    }
+    return BME280_ERR_INVALID_ARG;
+}
+
+bme280_error_t bme280_ring_peek(bme280_ring_consumer_t *consumer, const uint8_t **recs,
+                                uint32_t *n, uint64_t *lost)
+{
+    if (consumer == NULL || recs == NULL || n == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (consumer->slot == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    bme280_ring_t *ring = consumer->ring;
+    uint64_t capacity = (uint64_t)ring->mask + 1;
+    uint64_t head = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+    uint64_t skipped = 0;
+
+    /* Lapped: the oldest slot may already be under the writer */
+    if (head - consumer->cursor >= capacity) {
+        skipped = head - capacity + 1 - consumer->cursor;
+        consumer->cursor += skipped;
+        __atomic_fetch_add(&consumer->slot->lost, skipped, __ATOMIC_RELAXED);
+        __atomic_store_n(&consumer->slot->cursor, consumer->cursor, __ATOMIC_RELAXED);
+    }
+
+    uint64_t avail = head - consumer->cursor;
+    uint64_t to_end = capacity - (consumer->cursor & ring->mask);
+    consumer->held = (uint32_t)(avail < to_end ? avail : to_end);
+
+    *recs = slot_at(ring, consumer->cursor);
+    *n = consumer->held;
+    if (lost != NULL) {
+        *lost = skipped;
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_ring_release(bme280_ring_consumer_t *consumer, uint32_t n)
+{
+    if (consumer == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (consumer->slot == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (n > consumer->held) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    /* Order the record reads before the head check (seqlock-style validation) */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&consumer->ring->hdr->head, __ATOMIC_RELAXED);
+    consumer->held = 0;
+
+    /* Once head reaches cursor + capacity the writer may be in the oldest slot */
+    if (n > 0 && head - consumer->cursor >= (uint64_t)consumer->ring->mask + 1) {
+        return BME280_ERR_READ;
+    }
+
+    consumer->cursor += n;
+    __atomic_store_n(&consumer->slot->cursor, consumer->cursor, __ATOMIC_RELAXED);
+    return BME280_OK;
+}
+
+bme280_error_t bme280_ring_read(bme280_ring_consumer_t *consumer, bme280_log_record_t *recs,
+                                uint32_t max, uint32_t *n, uint64_t *lost)
+{
+    if (consumer == NULL || recs == NULL || n == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (consumer->slot == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    uint32_t got = 0;
+    uint64_t skipped = 0;
+
+    while (got < max) {
+        const uint8_t *src;
+        uint32_t avail;
+        uint64_t lapped;
+        bme280_error_t err = bme280_ring_peek(consumer, &src, &avail, &lapped);
+        if (err != BME280_OK) {
+            return err;
+        }
+        skipped += lapped;
+        if (avail == 0) {
+            break;
+        }
+
+        uint32_t take = avail < max - got ? avail : max - got;
+        int torn = 0;
+        for (uint32_t i = 0; i < take; i++) {
+            if (bme280_log_decode(src + (size_t)i * BME280_LOG_RECORD_SIZE, &recs[got + i])
+                != BME280_OK) {
+                torn = 1;
+            }
+        }
+
+        /* Overwritten while copying: drop them, the next peek counts the loss */
+        if (bme280_ring_release(consumer, take) != BME280_OK) {
+            continue;
+        }
+        if (torn) {
+            return BME280_ERR_READ;
+        }
+        got += take;
+    }
+
+    *n = got;
+    if (lost != NULL) {
+        *lost = skipped;
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_ring_wait(bme280_ring_consumer_t *consumer, uint32_t timeout_ms)
+{
+    if (consumer == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (consumer->slot == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    bme280_ring_header_t *hdr = consumer->ring->hdr;
+    uint64_t deadline = bme280_time_us() + (uint64_t)timeout_ms * 1000u;
+
+    for (;;) {
+        if (__atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) != consumer->cursor) {
+            return BME280_OK;
+        }
+        uint64_t now = bme280_time_us();
+        if (now >= deadline) {
+            return BME280_ERR_BUSY;
+        }
+
+        /* Announce, then re-check: the writer either sees us or we see its head */
+        __atomic_fetch_add(&hdr->waiters, 1, __ATOMIC_SEQ_CST);
+        uint32_t wake = __atomic_load_n(&hdr->wake, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&hdr->head, __ATOMIC_SEQ_CST) == consumer->cursor) {
+            futex_wait(&hdr->wake, wake, deadline - now);
+        }
+        __atomic_fetch_sub(&hdr->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void bme280_ring_leave(bme280_ring_consumer_t *consumer)
+{
+    if (consumer == NULL || consumer->slot == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&consumer->slot->pid, 0, __ATOMIC_RELEASE);
+    consumer->slot = NULL;
+    consumer->held = 0;
+}
+
+void bme280_ring_close(bme280_ring_t *ring)
+{
+    if (ring == NULL || ring->hdr == NULL) {
+        return;
+    }
+
+    munmap(ring->hdr, ring->size);
+    close(ring->fd);
+    ring->hdr = NULL;
+    ring->records = NULL;
+    ring->fd = -1;
+}
+
+void bme280_ring_unlink(const char *name)
+{
+    if (name != NULL) {
+        shm_unlink(name);
+    }
+}
@@ -0,0 +1,191 @@
+/**
+ * BME280 Shared-Memory Sample Ring
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Single-producer, multi-consumer ring of sample records in POSIX shared
+ * memory. The acquisition process publishes every sample; loggers and
+ * filters in other processes each follow the stream with their own cursor,
+ * reading records in place. The writer never waits for consumers: a
+ * consumer that falls more than a ring behind loses the oldest records
+ * and is told how many. Idle consumers sleep on a process-shared futex.
+ *
+ * Slots hold the 32-byte record encoding of bme280_log.h, so a ring and a
+ * log file can be read with the same decoder (or NumPy dtype).
+ */
+
+#ifndef BME280_RING_H
+#define BME280_RING_H
+
+#include "bme280.h"
+#include "bme280_log.h"
+
+/*******************************************************************************
+ * Ring Constants
+ ******************************************************************************/
+
+#define BME280_RING_MAGIC          0x474E5242u  /* "BRNG" */
+#define BME280_RING_VERSION        1u
+#define BME280_RING_MAX_CONSUMERS  16
+#define BME280_RING_MIN_CAPACITY   16           /* Records; capacity is a power of two */
+#define BME280_RING_MAX_CAPACITY   (1u << 24)
+#define BME280_RING_DATA_OFFSET    2048         /* Header size; records start here */
+
+/*******************************************************************************
+ * Ring Structures
+ ******************************************************************************/
+
+/**
+ * Consumer slot in shared memory (one cache line)
+ */
+typedef struct {
+    uint32_t pid;        /* Owning process, 0 if free */
+    uint32_t reserved;
+    uint64_t cursor;     /* Sequence of the next record to read */
+    uint64_t lost;       /* Records overwritten before they were read */
+    uint8_t  pad[40];
+} bme280_ring_cursor_t;
+
+/**
+ * Shared-memory header; records follow at BME280_RING_DATA_OFFSET
+ */
+typedef struct {
+    uint32_t             magic;        /* BME280_RING_MAGIC once initialized */
+    uint32_t             version;      /* BME280_RING_VERSION */
+    uint32_t             capacity;     /* Records in the ring */
+    uint32_t             record_size;  /* BME280_LOG_RECORD_SIZE */
+    uint8_t              pad0[48];
+    uint64_t             head;         /* Sequence of the next record to publish */
+    uint8_t              pad1[56];
+    uint32_t             wake;         /* Futex word, bumped when waiters exist */
+    uint32_t             waiters;      /* Consumers sleeping on wake */
+    uint8_t              pad2[56];
+    bme280_ring_cursor_t consumers[BME280_RING_MAX_CONSUMERS];
+} bme280_ring_header_t;
+
+/**
+ * Per-process handle on a ring
+ */
+typedef struct {
+    int                   fd;       /* Shared memory fd (-1 if not open) */
+    bme280_ring_header_t *hdr;      /* Mapped ring */
+    uint8_t              *records;  /* First record slot */
+    size_t                size;     /* Mapped bytes */
+    uint32_t              mask;     /* capacity - 1 */
+    int                   writer;   /* Non-zero for the handle that created the ring */
+} bme280_ring_t;
+
+/**
+ * A consumer's position in a ring
+ */
+typedef struct {
+    bme280_ring_t        *ring;
+    bme280_ring_cursor_t *slot;    /* NULL if not joined */
+    uint64_t              cursor;  /* Local copy of slot->cursor */
+    uint32_t              held;    /* Records handed out by peek, not yet released */
+} bme280_ring_consumer_t;
+
+/*******************************************************************************
+ * Ring API Functions
+ ******************************************************************************/
+
+/**
+ * Create (or recreate) a named ring as its single writer
+ * @param ring     Pointer to handle (caller-allocated)
+ * @param name     Shared memory name, e.g. "/bme280-ring"
+ * @param capacity Records, a power of two in [MIN_CAPACITY, MAX_CAPACITY]
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_ring_create(bme280_ring_t *ring, const char *name, uint32_t capacity);
+
+/**
+ * Map an existing ring for consuming
+ * @param ring Pointer to handle (caller-allocated)
+ * @param name Shared memory name
+ * @return BME280_OK on success, BME280_ERR_NOT_INIT if the ring is absent or incompatible
+ */
+bme280_error_t bme280_ring_open(bme280_ring_t *ring, const char *name);
+
+/**
+ * Publish records (writer only); wakes sleeping consumers once per call
+ * @param ring  Pointer to ring created by this process
+ * @param recs  Records to publish
+ * @param count Number of records
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_ring_publish(bme280_ring_t *ring, const bme280_log_record_t *recs,
+                                   uint32_t count);
+
+/**
+ * Take a consumer slot, starting at the next record published
+ * Slots of processes that have exited are reclaimed.
+ * @param ring     Pointer to open ring
+ * @param consumer Pointer to consumer (caller-allocated)
+ * @return BME280_OK on success, BME280_ERR_INVALID_ARG if all slots are taken
+ */
+bme280_error_t bme280_ring_join(bme280_ring_t *ring, bme280_ring_consumer_t *consumer);
+
+/**
+ * Get the next unread records in place, without copying
+ * Records are 32-byte encodings (decode with bme280_log_decode()). At most
+ * the records up to the end of the ring are returned; call again after
+ * release for the rest. If the writer lapped the consumer, the cursor jumps
+ * forward and the skipped count is added to the consumer's lost counter.
+ * @param consumer Pointer to joined consumer
+ * @param recs     Receives a pointer to the first record
+ * @param n        Receives the number of records (0 if none)
+ * @param lost     Optional; receives records skipped by this call
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_ring_peek(bme280_ring_consumer_t *consumer, const uint8_t **recs,
+                                uint32_t *n, uint64_t *lost);
+
+/**
+ * Finish with records obtained from peek and advance the cursor
+ * @param consumer Pointer to joined consumer
+ * @param n        Records consumed (at most those returned by peek)
+ * @return BME280_OK if they were intact while in use, BME280_ERR_READ if
+ *         the writer overwrote them meanwhile (the data must be discarded)
+ */
+bme280_error_t bme280_ring_release(bme280_ring_consumer_t *consumer, uint32_t n);
+
+/**
+ * Copy and decode the next unread records
+ * @param consumer Pointer to joined consumer
+ * @param recs     Array to receive the records
+ * @param max      Capacity of recs
+ * @param n        Receives the number of records read
+ * @param lost     Optional; receives records skipped because the writer lapped
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_ring_read(bme280_ring_consumer_t *consumer, bme280_log_record_t *recs,
+                                uint32_t max, uint32_t *n, uint64_t *lost);
+
+/**
+ * Sleep until a record is available to this consumer
+ * @param consumer   Pointer to joined consumer
+ * @param timeout_ms Maximum wait (0 = just check)
+ * @return BME280_OK if records are available, BME280_ERR_BUSY on timeout
+ */
+bme280_error_t bme280_ring_wait(bme280_ring_consumer_t *consumer, uint32_t timeout_ms);
+
+/**
+ * Give up a consumer slot
+ * @param consumer Pointer to consumer
+ */
+void bme280_ring_leave(bme280_ring_consumer_t *consumer);
+
+/**
+ * Unmap the ring; the shared memory stays until bme280_ring_unlink()
+ * @param ring Pointer to ring
+ */
+void bme280_ring_close(bme280_ring_t *ring);
+
+/**
+ * Remove a named ring
+ * @param name Shared memory name
+ */
+void bme280_ring_unlink(const char *name);
+
+#endif /* BME280_RING_H */
@@ -0,0 +1,458 @@
+/**
+ * BME280 Raw Sample Segments Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bme280_segment.h"
+#include "bme280_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*******************************************************************************
+ * Encoding Helpers
+ ******************************************************************************/
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int write_at(int fd, const uint8_t *buf, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+static int read_at(int fd, uint8_t *buf, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+ * Writer
+ ******************************************************************************/
+
+static bme280_error_t write_block(bme280_segment_writer_t *w)
+{
+    uint8_t header[BME280_SEGMENT_BLOCK_HEADER];
+    size_t len = (size_t)w->block.count * BME280_SEGMENT_RECORD_SIZE;
+
+    if (w->block.count == 0) {
+        return BME280_OK;
+    }
+
+    put_u64(header, w->block.first_us);
+    put_u64(header + 8, w->block.last_us);
+    put_u16(header + 16, w->block.min_sensor);
+    put_u16(header + 18, w->block.max_sensor);
+    put_u32(header + 20, w->block.count);
+    put_u32(header + 24, bme280_crc32(0, w->records, len));
+    put_u32(header + 28, 0);
+
+    /*
+     * Written at the end of the last good block, so a retry overwrites
+     * whatever a failed attempt left; the block stays in memory until then.
+     */
+    if (write_at(w->fd, header, sizeof(header), w->committed) != 0
+        || write_at(w->fd, &w->records[0][0], len, w->committed + sizeof(header)) != 0) {
+        /* Best effort: readers stop at a short block anyway */
+        int trimmed = ftruncate(w->fd, (off_t)w->committed);
+        (void)trimmed;
+        return BME280_ERR_WRITE;
+    }
+
+    w->committed += sizeof(header) + len;
+    w->block.count = 0;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_segment_create(bme280_segment_writer_t *w, const char *path,
+                                     const bme280_calib_t *calib, uint32_t sensors,
+                                     uint32_t block_records)
+{
+    if (w == NULL || path == NULL || calib == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    w->fd = -1;
+    if (sensors == 0 || sensors > BME280_SEGMENT_MAX_SENSORS
+        || block_records == 0 || block_records > BME280_SEGMENT_MAX_BLOCK) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    uint8_t header[BME280_SEGMENT_HEADER_SIZE];
+    put_u32(header, BME280_SEGMENT_MAGIC);
+    put_u16(header + 4, BME280_SEGMENT_VERSION);
+    put_u16(header + 6, (uint16_t)sensors);
+    put_u32(header + 8, block_records);
+    put_u32(header + 12, 0);
+    if (write_all(fd, header, sizeof(header)) != 0) {
+        close(fd);
+        return BME280_ERR_WRITE;
+    }
+
+    for (uint32_t i = 0; i < sensors; i++) {
+        uint8_t regs[BME280_SEGMENT_CALIB_SIZE];
+        bme280_pack_calibration(&calib[i], regs);
+        if (write_all(fd, regs, sizeof(regs)) != 0) {
+            close(fd);
+            return BME280_ERR_WRITE;
+        }
+    }
+
+    w->fd = fd;
+    w->sensors = sensors;
+    w->block_records = block_records;
+    w->committed = BME280_SEGMENT_HEADER_SIZE + (uint64_t)sensors * BME280_SEGMENT_CALIB_SIZE;
+    w->block.last_us = 0;
+    w->block.count = 0;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_segment_append(bme280_segment_writer_t *w, uint64_t timestamp_us,
+                                     uint32_t sensor, const uint8_t burst[8])
+{
+    if (w == NULL || burst == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (w->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (sensor >= w->sensors || timestamp_us < w->block.last_us) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    /*
+     * A full block is still here if writing it failed: retry before adding.
+     * Offsets are 32-bit, so a block spans at most ~71 minutes.
+     */
+    if (w->block.count == w->block_records
+        || (w->block.count > 0 && timestamp_us - w->block.first_us > UINT32_MAX)) {
+        bme280_error_t err = write_block(w);
+        if (err != BME280_OK) {
+            return err;
+        }
+    }
+
+    if (w->block.count == 0) {
+        w->block.first_us = timestamp_us;
+        w->block.min_sensor = (uint16_t)sensor;
+        w->block.max_sensor = (uint16_t)sensor;
+    }
+    if (sensor < w->block.min_sensor) {
+        w->block.min_sensor = (uint16_t)sensor;
+    }
+    if (sensor > w->block.max_sensor) {
+        w->block.max_sensor = (uint16_t)sensor;
+    }
+    w->block.last_us = timestamp_us;
+
+    uint8_t *rec = w->records[w->block.count++];
+    put_u32(rec, (uint32_t)(timestamp_us - w->block.first_us));
+    put_u16(rec + 4, (uint16_t)sensor);
+    put_u16(rec + 6, 0);
+    memcpy(rec + 8, burst, 8);
+
+    if (w->block.count == w->block_records) {
+        return write_block(w);
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_segment_finish(bme280_segment_writer_t *w)
+{
+    if (w == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (w->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    bme280_error_t err = write_block(w);
+    if (close(w->fd) != 0 && err == BME280_OK) {
+        err = BME280_ERR_WRITE;
+    }
+    w->fd = -1;
+    return err;
+}
+
+/*******************************************************************************
+ * Reader
+ ******************************************************************************/
+
+bme280_error_t bme280_segment_open(bme280_segment_reader_t *r, const char *path)
+{
+    if (r == NULL || path == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    r->fd = -1;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    uint8_t header[BME280_SEGMENT_HEADER_SIZE];
+    if (read_at(fd, header, sizeof(header), 0) != 0) {
+        close(fd);
+        return BME280_ERR_READ;
+    }
+
+    uint32_t sensors = get_u16(header + 6);
+    if (get_u32(header) != BME280_SEGMENT_MAGIC
+        || get_u16(header + 4) != BME280_SEGMENT_VERSION
+        || sensors == 0 || sensors > BME280_SEGMENT_MAX_SENSORS) {
+        close(fd);
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    for (uint32_t i = 0; i < sensors; i++) {
+        uint8_t regs[BME280_SEGMENT_CALIB_SIZE];
+        if (read_at(fd, regs, sizeof(regs),
+                    BME280_SEGMENT_HEADER_SIZE + (uint64_t)i * BME280_SEGMENT_CALIB_SIZE) != 0) {
+            close(fd);
+            return BME280_ERR_READ;
+        }
+        bme280_parse_calibration(&r->calib[i], regs, regs[24], regs + 25);
+    }
+
+    r->fd = fd;
+    r->sensors = sensors;
+    r->data_start = BME280_SEGMENT_HEADER_SIZE + (uint64_t)sensors * BME280_SEGMENT_CALIB_SIZE;
+    memset(&r->stats, 0, sizeof(r->stats));
+    return bme280_segment_seek(r, NULL);
+}
+
+bme280_error_t bme280_segment_seek(bme280_segment_reader_t *r, const bme280_segment_query_t *query)
+{
+    if (r == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (r->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (query != NULL) {
+        r->query = *query;
+    } else {
+        r->query.ts_min = 0;
+        r->query.ts_max = UINT64_MAX;
+        r->query.sensor_min = 0;
+        r->query.sensor_max = UINT32_MAX;
+    }
+    r->next_block = r->data_start;
+    r->block.count = 0;
+    r->index = 0;
+    return BME280_OK;
+}
+
+/* Load the next block that can hold matching records; 0 at the end */
+static int load_block(bme280_segment_reader_t *r)
+{
+    const bme280_segment_query_t *q = &r->query;
+    uint8_t header[BME280_SEGMENT_BLOCK_HEADER];
+
+    for (;;) {
+        if (r->next_block == UINT64_MAX) {
+            return 0;
+        }
+
+        ssize_t n = pread(r->fd, header, sizeof(header), (off_t)r->next_block);
+        if (n < (ssize_t)sizeof(header)) {
+            return n < 0 ? -1 : 0;  /* A short header is an unfinished segment */
+        }
+
+        bme280_segment_block_t block;
+        block.first_us = get_u64(header);
+        block.last_us = get_u64(header + 8);
+        block.min_sensor = get_u16(header + 16);
+        block.max_sensor = get_u16(header + 18);
+        block.count = get_u32(header + 20);
+        if (block.count == 0 || block.count > BME280_SEGMENT_MAX_BLOCK) {
+            return -1;
+        }
+
+        uint64_t payload = r->next_block + sizeof(header);
+        size_t len = (size_t)block.count * BME280_SEGMENT_RECORD_SIZE;
+        r->next_block = payload + len;
+
+        /* Blocks are in time order: nothing later can match */
+        if (block.first_us > q->ts_max) {
+            return 0;
+        }
+        if (block.last_us < q->ts_min
+            || block.max_sensor < q->sensor_min || block.min_sensor > q->sensor_max) {
+            r->stats.blocks_skipped++;
+            continue;
+        }
+
+        if (read_at(r->fd, &r->records[0][0], len, payload) != 0) {
+            /* A block cut short by the end of the file is an unfinished segment */
+            struct stat st;
+            if (fstat(r->fd, &st) == 0 && payload + len > (uint64_t)st.st_size) {
+                r->next_block = UINT64_MAX;
+                return 0;
+            }
+            return -1;
+        }
+        if (bme280_crc32(0, r->records, len) != get_u32(header + 24)) {
+            return -1;
+        }
+
+        r->stats.blocks_read++;
+        r->block = block;
+        r->index = 0;
+        return 1;
+    }
+}
+
+int bme280_segment_next(bme280_segment_reader_t *r, bme280_segment_record_t *rec)
+{
+    if (r == NULL || rec == NULL || r->fd < 0) {
+        return -1;
+    }
+
+    const bme280_segment_query_t *q = &r->query;
+    for (;;) {
+        if (r->index >= r->block.count) {
+            int loaded = load_block(r);
+            if (loaded <= 0) {
+                r->block.count = 0;
+                return loaded;
+            }
+        }
+
+        const uint8_t *p = r->records[r->index++];
+        uint64_t ts = r->block.first_us + get_u32(p);
+        uint32_t sensor = get_u16(p + 4);
+        if (ts > q->ts_max) {
+            r->block.count = 0;
+            r->next_block = UINT64_MAX;  /* Later records are later still */
+            return 0;
+        }
+        if (ts < q->ts_min || sensor < q->sensor_min || sensor > q->sensor_max) {
+            continue;
+        }
+
+        rec->timestamp_us = ts;
+        rec->sensor = (uint16_t)sensor;
+        memcpy(rec->burst, p + 8, sizeof(rec->burst));
+        return 1;
+    }
+}
+
+bme280_error_t bme280_segment_compensate(const bme280_segment_reader_t *r,
+                                         const bme280_segment_record_t *rec, bme280_data_t *data)
+{
+    if (r == NULL || rec == NULL || data == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (r->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (rec->sensor >= r->sensors) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    bme280_raw_t raw;
+    bme280_unpack_raw(rec->burst, &raw);
+    return bme280_compensate(&r->calib[rec->sensor], &raw, data, NULL);
+}
+
+void bme280_segment_close(bme280_segment_reader_t *r)
+{
+    if (r == NULL || r->fd < 0) {
+        return;
+    }
+
+    close(r->fd);
+    r->fd = -1;
+}
@@ -0,0 +1,191 @@
+/**
+ * BME280 Raw Sample Segments
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Segment files hold raw data-register bursts exactly as read from each
+ * sensor, together with the calibration of every sensor, so compensation
+ * can be redone (or improved) when the data is read back. Records are
+ * grouped in blocks; each block header carries its time and sensor-id
+ * ranges, so a scan for a time window or a sensor skips blocks that
+ * cannot match without reading them.
+ *
+ * File layout (little-endian):
+ *   header   u32 magic, u16 version, u16 sensors, u32 block_records,
+ *            u32 reserved, then sensors x 32 calibration bytes
+ *            (0x88..0x9F, 0xA1, 0xE1..0xE7)
+ *   blocks   u64 first_us, u64 last_us, u16 min_sensor, u16 max_sensor,
+ *            u32 count, u32 crc32 of the records, u32 reserved,
+ *            then count records of
+ *            u32 offset from first_us, u16 sensor, u16 reserved, u8 burst[8]
+ * Records are appended in time order. A block cut short by the end of the
+ * file (a crash mid-write) ends the segment like a short header does.
+ */
+
+#ifndef BME280_SEGMENT_H
+#define BME280_SEGMENT_H
+
+#include "bme280.h"
+
+/*******************************************************************************
+ * Segment Constants
+ ******************************************************************************/
+
+#define BME280_SEGMENT_MAGIC         0x53383242u  /* "B28S" */
+#define BME280_SEGMENT_VERSION       1
+#define BME280_SEGMENT_MAX_SENSORS   256
+#define BME280_SEGMENT_MAX_BLOCK     4096  /* Upper bound on records per block */
+#define BME280_SEGMENT_CALIB_SIZE    32
+#define BME280_SEGMENT_HEADER_SIZE   16
+#define BME280_SEGMENT_BLOCK_HEADER  32
+#define BME280_SEGMENT_RECORD_SIZE   16
+
+/*******************************************************************************
+ * Segment Structures
+ ******************************************************************************/
+
+/**
+ * One raw record, compensated on request
+ */
+typedef struct {
+    uint64_t timestamp_us;
+    uint16_t sensor;
+    uint8_t  burst[8];   /* Registers 0xF7..0xFE */
+} bme280_segment_record_t;
+
+/**
+ * Time and sensor bounds of a scan (inclusive)
+ */
+typedef struct {
+    uint64_t ts_min;
+    uint64_t ts_max;
+    uint32_t sensor_min;
+    uint32_t sensor_max;
+} bme280_segment_query_t;
+
+/**
+ * Block header as stored
+ */
+typedef struct {
+    uint64_t first_us;
+    uint64_t last_us;
+    uint16_t min_sensor;
+    uint16_t max_sensor;
+    uint32_t count;
+} bme280_segment_block_t;
+
+/**
+ * Segment writer
+ */
+typedef struct {
+    int                     fd;          /* -1 if not open */
+    uint32_t                sensors;
+    uint32_t                block_records;
+    uint64_t                committed;   /* File size after the last block written */
+    bme280_segment_block_t  block;       /* Block being filled */
+    uint8_t                 records[BME280_SEGMENT_MAX_BLOCK][BME280_SEGMENT_RECORD_SIZE];
+} bme280_segment_writer_t;
+
+/**
+ * Segment reader counters
+ */
+typedef struct {
+    uint64_t blocks_read;
+    uint64_t blocks_skipped;
+} bme280_segment_stats_t;
+
+/**
+ * Segment reader
+ */
+typedef struct {
+    int                     fd;           /* -1 if not open */
+    uint32_t                sensors;
+    uint64_t                data_start;   /* Offset of the first block */
+    bme280_calib_t          calib[BME280_SEGMENT_MAX_SENSORS];
+    bme280_segment_query_t  query;
+    uint64_t                next_block;   /* Offset of the next block header */
+    bme280_segment_block_t  block;        /* Block being scanned */
+    uint32_t                index;        /* Next record in the block */
+    uint8_t                 records[BME280_SEGMENT_MAX_BLOCK][BME280_SEGMENT_RECORD_SIZE];
+    bme280_segment_stats_t  stats;
+} bme280_segment_reader_t;
+
+/*******************************************************************************
+ * Segment API Functions
+ ******************************************************************************/
+
+/**
+ * Create a segment file
+ * @param w             Pointer to writer (caller-allocated)
+ * @param path          File path (truncated if it exists)
+ * @param calib         Calibration of each sensor, indexed by sensor id
+ * @param sensors       Number of sensors (1..BME280_SEGMENT_MAX_SENSORS)
+ * @param block_records Records per block (1..BME280_SEGMENT_MAX_BLOCK)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_segment_create(bme280_segment_writer_t *w, const char *path,
+                                     const bme280_calib_t *calib, uint32_t sensors,
+                                     uint32_t block_records);
+
+/**
+ * Append a raw burst
+ * A block that could not be written stays buffered and is retried by the
+ * next append (or finish); while it is full, appends fail without adding.
+ * @param w            Pointer to open writer
+ * @param timestamp_us Sample time (not earlier than the previous record)
+ * @param sensor       Sensor id
+ * @param burst        Registers 0xF7..0xFE
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_segment_append(bme280_segment_writer_t *w, uint64_t timestamp_us,
+                                     uint32_t sensor, const uint8_t burst[8]);
+
+/**
+ * Write the last block and close the file
+ * @param w Pointer to writer
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_segment_finish(bme280_segment_writer_t *w);
+
+/**
+ * Open a segment file for scanning
+ * @param r    Pointer to reader (caller-allocated)
+ * @param path File path
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_segment_open(bme280_segment_reader_t *r, const char *path);
+
+/**
+ * Start a scan; blocks outside the bounds are skipped
+ * @param r     Pointer to open reader
+ * @param query Bounds, or NULL for everything
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_segment_seek(bme280_segment_reader_t *r, const bme280_segment_query_t *query);
+
+/**
+ * Get the next record within the scan bounds
+ * @param r   Pointer to open reader
+ * @param rec Receives the record
+ * @return 1 if a record was returned, 0 at the end, negative on a read or CRC error
+ */
+int bme280_segment_next(bme280_segment_reader_t *r, bme280_segment_record_t *rec);
+
+/**
+ * Compensate a record with its sensor's stored calibration
+ * @param r    Pointer to open reader
+ * @param rec  Record from this reader
+ * @param data Pointer to structure to receive the compensated sample
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_segment_compensate(const bme280_segment_reader_t *r,
+                                         const bme280_segment_record_t *rec, bme280_data_t *data);
+
+/**
+ * Close the reader
+ * @param r Pointer to reader
+ */
+void bme280_segment_close(bme280_segment_reader_t *r);
+
+#endif /* BME280_SEGMENT_H */
@@ -0,0 +1,383 @@
+/**
+ * BME280 Fleet Sharding Registry Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bme280_shard.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Attempts to wait for another process to finish creating the registry */
+#define SHARD_INIT_RETRIES  1000
+
+/*******************************************************************************
+ * Lease Word Helpers
+ ******************************************************************************/
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(bme280_time_us() / 1000u);
+}
+
+static uint64_t lease_make(pid_t pid, uint32_t expiry_ms)
+{
+    return ((uint64_t)(uint32_t)pid << 32) | expiry_ms;
+}
+
+static pid_t lease_owner(uint64_t lease)
+{
+    return (pid_t)(lease >> 32);
+}
+
+/* Wrap-safe: leases are far shorter than the 24-day half range */
+static int lease_live(uint64_t lease, uint32_t now)
+{
+    return lease != 0 && (int32_t)((uint32_t)lease - now) > 0;
+}
+
+static int owner_alive(pid_t pid)
+{
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/*******************************************************************************
+ * Registry Initialization Helpers
+ ******************************************************************************/
+
+/* Fill in a registry nobody else can see yet; magic goes last */
+static void init_registry(bme280_shard_registry_t *reg, const char *const *bus_paths,
+                          uint32_t count)
+{
+    memset(reg->slots, 0, sizeof(reg->slots));
+    reg->version = BME280_SHARD_VERSION;
+    reg->bus_count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        strncpy(reg->slots[i].bus_path, bus_paths[i], BME280_SHARD_PATH_LEN - 1);
+    }
+    __atomic_store_n(&reg->magic, BME280_SHARD_MAGIC, __ATOMIC_RELEASE);
+}
+
+static int wait_magic(const bme280_shard_registry_t *reg)
+{
+    int retries = SHARD_INIT_RETRIES;
+    while (__atomic_load_n(&reg->magic, __ATOMIC_ACQUIRE) != BME280_SHARD_MAGIC
+           && --retries > 0) {
+        sleep_ms(1);
+    }
+    return retries > 0;
+}
+
+/* A joiner may pass no list to adopt the recorded one, else the same list */
+static int same_buses(const bme280_shard_registry_t *reg, const char *const *bus_paths,
+                      uint32_t count)
+{
+    if (count == 0) {
+        return 1;
+    }
+    if (count != reg->bus_count) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (strncmp(reg->slots[i].bus_path, bus_paths[i], BME280_SHARD_PATH_LEN - 1) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Initialize the registry unless someone else does. The creator claims the
+ * creator word first; a joiner that waits out the timeout takes it over
+ * from a creator that died before publishing magic.
+ */
+static bme280_error_t settle_registry(bme280_shard_registry_t *reg, pid_t self, int creator,
+                                      const char *const *bus_paths, uint32_t count)
+{
+    uint32_t expected = 0;
+
+    if (creator && __atomic_compare_exchange_n(&reg->creator, &expected, (uint32_t)self, 0,
+                                               __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        init_registry(reg, bus_paths, count);
+        return BME280_OK;
+    }
+
+    while (!wait_magic(reg)) {
+        expected = __atomic_load_n(&reg->creator, __ATOMIC_ACQUIRE);
+        pid_t owner = (pid_t)expected;
+        if (owner != 0 && owner != self && owner_alive(owner)) {
+            return BME280_ERR_NOT_INIT;
+        }
+        if (__atomic_compare_exchange_n(&reg->creator, &expected, (uint32_t)self, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            init_registry(reg, bus_paths, count);
+            return BME280_OK;
+        }
+    }
+
+    if (reg->version != BME280_SHARD_VERSION) {
+        return BME280_ERR_NOT_INIT;
+    }
+    if (!same_buses(reg, bus_paths, count)) {
+        return BME280_ERR_INVALID_ARG;
+    }
+    return BME280_OK;
+}
+
+/*******************************************************************************
+ * Registry Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_shard_open(bme280_shard_t *shard, const char *name,
+                                 const char *const *bus_paths, uint32_t count,
+                                 uint32_t lease_ms)
+{
+    if (shard == NULL || name == NULL || (bus_paths == NULL && count > 0)) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    shard->fd = -1;
+    shard->reg = NULL;
+    shard->pid = getpid();
+    shard->lease_ms = lease_ms;
+
+    if (count > BME280_SHARD_MAX_BUSES || lease_ms == 0) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    int creator = 1;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        creator = 0;
+        fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    if (creator) {
+        if (ftruncate(fd, sizeof(bme280_shard_registry_t)) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return BME280_ERR_WRITE;
+        }
+    } else {
+        /* Wait until the creator has sized the segment before mapping it */
+        struct stat st;
+        int retries = SHARD_INIT_RETRIES;
+        while (fstat(fd, &st) == 0 && (size_t)st.st_size < sizeof(bme280_shard_registry_t)
+               && --retries > 0) {
+            sleep_ms(1);
+        }
+        /* The creator died before sizing it; the same size is harmless if it did not */
+        if (retries == 0 && ftruncate(fd, sizeof(bme280_shard_registry_t)) != 0) {
+            close(fd);
+            return BME280_ERR_NOT_INIT;
+        }
+    }
+
+    bme280_shard_registry_t *reg = mmap(NULL, sizeof(*reg), PROT_READ | PROT_WRITE,
+                                        MAP_SHARED, fd, 0);
+    if (reg == MAP_FAILED) {
+        close(fd);
+        return BME280_ERR_READ;
+    }
+
+    bme280_error_t err = settle_registry(reg, shard->pid, creator, bus_paths, count);
+    if (err != BME280_OK) {
+        munmap(reg, sizeof(*reg));
+        close(fd);
+        return err;
+    }
+
+    shard->fd = fd;
+    shard->reg = reg;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_shard_claim(bme280_shard_t *shard, uint32_t max, uint32_t *claimed)
+{
+    if (shard == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (shard->reg == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    uint32_t now = now_ms();
+    uint32_t owned = 0;
+    uint32_t fresh = 0;
+
+    for (uint32_t i = 0; i < shard->reg->bus_count; i++) {
+        uint64_t lease = __atomic_load_n(&shard->reg->slots[i].lease, __ATOMIC_ACQUIRE);
+        if (lease_live(lease, now) && lease_owner(lease) == shard->pid) {
+            owned++;
+        }
+    }
+
+    for (uint32_t i = 0; i < shard->reg->bus_count && owned < max; i++) {
+        bme280_shard_slot_t *slot = &shard->reg->slots[i];
+        uint64_t lease = __atomic_load_n(&slot->lease, __ATOMIC_ACQUIRE);
+
+        /* Skip buses held by a live lease of a live process */
+        if (lease_live(lease, now)
+            && (lease_owner(lease) == shard->pid || owner_alive(lease_owner(lease)))) {
+            continue;
+        }
+
+        uint64_t mine = lease_make(shard->pid, now + shard->lease_ms);
+        if (__atomic_compare_exchange_n(&slot->lease, &lease, mine, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_fetch_add(&slot->stats.claims, 1, __ATOMIC_RELAXED);
+            owned++;
+            fresh++;
+        }
+    }
+
+    if (claimed != NULL) {
+        *claimed = fresh;
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_shard_renew(bme280_shard_t *shard, uint32_t *owned)
+{
+    if (shard == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (shard->reg == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    uint32_t now = now_ms();
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < shard->reg->bus_count; i++) {
+        bme280_shard_slot_t *slot = &shard->reg->slots[i];
+        uint64_t lease = __atomic_load_n(&slot->lease, __ATOMIC_ACQUIRE);
+        if (lease == 0 || lease_owner(lease) != shard->pid) {
+            continue;
+        }
+
+        /* Fails if another shard took over an expired lease in the meantime */
+        uint64_t mine = lease_make(shard->pid, now + shard->lease_ms);
+        if (__atomic_compare_exchange_n(&slot->lease, &lease, mine, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            count++;
+        }
+    }
+
+    if (owned != NULL) {
+        *owned = count;
+    }
+    return BME280_OK;
+}
+
+int bme280_shard_owns(const bme280_shard_t *shard, uint32_t bus)
+{
+    if (shard == NULL || shard->reg == NULL || bus >= shard->reg->bus_count) {
+        return 0;
+    }
+
+    uint64_t lease = __atomic_load_n(&shard->reg->slots[bus].lease, __ATOMIC_ACQUIRE);
+    return lease_live(lease, now_ms()) && lease_owner(lease) == shard->pid;
+}
+
+const char *bme280_shard_bus_path(const bme280_shard_t *shard, uint32_t bus)
+{
+    if (shard == NULL || shard->reg == NULL || bus >= shard->reg->bus_count) {
+        return NULL;
+    }
+
+    return shard->reg->slots[bus].bus_path;
+}
+
+bme280_error_t bme280_shard_record(bme280_shard_t *shard, uint32_t bus, bme280_error_t err)
+{
+    if (shard == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (shard->reg == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (bus >= shard->reg->bus_count) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    bme280_shard_stats_t *stats = &shard->reg->slots[bus].stats;
+    if (err == BME280_OK) {
+        __atomic_fetch_add(&stats->reads, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&stats->errors, 1, __ATOMIC_RELAXED);
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_shard_totals(const bme280_shard_t *shard, bme280_shard_stats_t *totals)
+{
+    if (shard == NULL || totals == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (shard->reg == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    memset(totals, 0, sizeof(*totals));
+    for (uint32_t i = 0; i < shard->reg->bus_count; i++) {
+        const bme280_shard_stats_t *stats = &shard->reg->slots[i].stats;
+        totals->reads += __atomic_load_n(&stats->reads, __ATOMIC_RELAXED);
+        totals->errors += __atomic_load_n(&stats->errors, __ATOMIC_RELAXED);
+        totals->claims += __atomic_load_n(&stats->claims, __ATOMIC_RELAXED);
+    }
+    return BME280_OK;
+}
+
+void bme280_shard_close(bme280_shard_t *shard)
+{
+    if (shard == NULL || shard->reg == NULL) {
+        return;
+    }
+
+    /* Hand owned buses back immediately rather than waiting for expiry */
+    for (uint32_t i = 0; i < shard->reg->bus_count; i++) {
+        bme280_shard_slot_t *slot = &shard->reg->slots[i];
+        uint64_t lease = __atomic_load_n(&slot->lease, __ATOMIC_ACQUIRE);
+        if (lease != 0 && lease_owner(lease) == shard->pid) {
+            __atomic_compare_exchange_n(&slot->lease, &lease, 0, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    munmap(shard->reg, sizeof(*shard->reg));
+    close(shard->fd);
+    shard->reg = NULL;
+    shard->fd = -1;
+}
+
+void bme280_shard_unlink(const char *name)
+{
+    if (name != NULL) {
+        shm_unlink(name);
+    }
+}
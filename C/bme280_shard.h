@@ -0,0 +1,159 @@
+/**
+ * BME280 Fleet Sharding Registry
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Lets several acquisition processes split a set of I2C buses between them
+ * without double-polling. The registry lives in POSIX shared memory; each
+ * bus slot carries a lease (owner pid + expiry) that a shard claims and
+ * renews with compare-and-swap. Buses whose lease expired or whose owner
+ * process died are reclaimed by the next shard that asks. Per-bus read and
+ * error counters live in the same segment, so fleet totals can be read
+ * from any process.
+ */
+
+#ifndef BME280_SHARD_H
+#define BME280_SHARD_H
+
+#include "bme280.h"
+
+#include <sys/types.h>
+
+/*******************************************************************************
+ * Registry Constants
+ ******************************************************************************/
+
+#define BME280_SHARD_MAX_BUSES     64          /* Bus slots per registry */
+#define BME280_SHARD_PATH_LEN      32          /* Max bus path length incl. NUL */
+#define BME280_SHARD_MAGIC         0x42534852u /* "BSHR" */
+#define BME280_SHARD_VERSION       1u
+
+/*******************************************************************************
+ * Registry Structures
+ ******************************************************************************/
+
+/**
+ * Per-bus counters, updated atomically by the owning shard
+ */
+typedef struct {
+    uint64_t reads;          /* Successful sensor reads */
+    uint64_t errors;         /* Failed sensor reads */
+    uint64_t claims;         /* Times the bus changed owner */
+} bme280_shard_stats_t;
+
+/**
+ * One bus slot in shared memory
+ */
+typedef struct {
+    char                 bus_path[BME280_SHARD_PATH_LEN];  /* e.g. "/dev/i2c-1" */
+    uint64_t             lease;  /* owner pid << 32 | expiry in ms (0 = free) */
+    bme280_shard_stats_t stats;  /* Counters for this bus */
+} bme280_shard_slot_t;
+
+/**
+ * Shared-memory registry layout
+ */
+typedef struct {
+    uint32_t            magic;      /* BME280_SHARD_MAGIC once initialized */
+    uint32_t            version;    /* BME280_SHARD_VERSION */
+    uint32_t            bus_count;  /* Slots in use */
+    uint32_t            creator;    /* Pid initializing the registry, set before magic */
+    bme280_shard_slot_t slots[BME280_SHARD_MAX_BUSES];
+} bme280_shard_registry_t;
+
+/**
+ * Per-process handle on a registry
+ */
+typedef struct {
+    int                      fd;        /* Shared memory fd (-1 if not open) */
+    bme280_shard_registry_t *reg;       /* Mapped registry */
+    pid_t                    pid;       /* Owner identity of this shard */
+    uint32_t                 lease_ms;  /* Lease length for claims and renewals */
+} bme280_shard_t;
+
+/*******************************************************************************
+ * Registry API Functions
+ ******************************************************************************/
+
+/**
+ * Open (creating if needed) a named registry
+ * The first process to create the registry records the bus list; later
+ * processes pass the same list, or none (count 0) to adopt the recorded
+ * one. If the creator dies before the registry is initialized, the next
+ * process to open it times out waiting and then initializes it instead.
+ * @param shard     Pointer to handle (caller-allocated)
+ * @param name      Shared memory object name (e.g. "/bme280-fleet")
+ * @param bus_paths Bus device paths
+ * @param count     Number of bus paths (at most BME280_SHARD_MAX_BUSES)
+ * @param lease_ms  Lease length; owners must renew more often than this
+ * @return BME280_OK on success, BME280_ERR_INVALID_ARG if the registry
+ *         records a different bus list, other error code on failure
+ */
+bme280_error_t bme280_shard_open(bme280_shard_t *shard, const char *name,
+                                 const char *const *bus_paths, uint32_t count,
+                                 uint32_t lease_ms);
+
+/**
+ * Claim free, expired or orphaned buses
+ * @param shard   Pointer to open handle
+ * @param max     Stop after owning this many buses in total
+ * @param claimed Optional; receives the number of buses newly claimed
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_shard_claim(bme280_shard_t *shard, uint32_t max, uint32_t *claimed);
+
+/**
+ * Extend the leases of every bus this shard owns
+ * @param shard Pointer to open handle
+ * @param owned Optional; receives the number of buses still owned
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_shard_renew(bme280_shard_t *shard, uint32_t *owned);
+
+/**
+ * Check whether this shard currently holds a live lease on a bus
+ * @param shard Pointer to open handle
+ * @param bus   Slot index
+ * @return Non-zero if owned
+ */
+int bme280_shard_owns(const bme280_shard_t *shard, uint32_t bus);
+
+/**
+ * Get the device path of a bus slot
+ * @param shard Pointer to open handle
+ * @param bus   Slot index
+ * @return Bus path, or NULL if out of range
+ */
+const char *bme280_shard_bus_path(const bme280_shard_t *shard, uint32_t bus);
+
+/**
+ * Record the outcome of a sensor read on an owned bus
+ * @param shard Pointer to open handle
+ * @param bus   Slot index
+ * @param err   Result of the read
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_shard_record(bme280_shard_t *shard, uint32_t bus, bme280_error_t err);
+
+/**
+ * Sum counters over every bus in the registry
+ * @param shard  Pointer to open handle
+ * @param totals Pointer to structure to receive the totals
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_shard_totals(const bme280_shard_t *shard, bme280_shard_stats_t *totals);
+
+/**
+ * Release all leases held by this shard and unmap the registry
+ * @param shard Pointer to handle to close
+ */
+void bme280_shard_close(bme280_shard_t *shard);
+
+/**
+ * Remove a named registry from the system
+ * @param name Shared memory object name
+ */
+void bme280_shard_unlink(const char *name);
+
+#endif /* BME280_SHARD_H */
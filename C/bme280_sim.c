@@ -0,0 +1,340 @@
+/**
+ * BME280 Out-of-Process Register Simulator Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+/* MAP_ANONYMOUS is not in POSIX.1-2008 */
+#define _GNU_SOURCE
+
+#include "bme280_sim.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define SIM_REG_CHIP_ID   0xD0
+#define SIM_REG_RESET     0xE0
+#define SIM_RESET_VALUE   0xB6
+#define SIM_MAX_MESSAGE   64
+
+/*******************************************************************************
+ * Register Model
+ ******************************************************************************/
+
+typedef struct {
+    uint8_t             regs[256];
+    uint8_t             burst[8];
+    uint32_t            conversion_us;
+    uint64_t            ready_us;   /* End of the pending forced conversion, 0 if none */
+    uint8_t             pointer;
+    bme280_sim_stats_t *stats;
+} sim_state_t;
+
+/* Data registers after power-on or soft reset (0x80000 / 0x8000 = "no data") */
+static void reset_registers(sim_state_t *st)
+{
+    static const uint8_t data_reset[8] = { 0x80, 0x00, 0x00, 0x80, 0x00, 0x00, 0x80, 0x00 };
+
+    st->regs[BME280_REG_CTRL_HUM] = 0;
+    st->regs[BME280_REG_STATUS] = 0;
+    st->regs[BME280_REG_CTRL_MEAS] = 0;
+    st->regs[BME280_REG_CONFIG] = 0;
+    memcpy(&st->regs[BME280_REG_DATA], data_reset, sizeof(data_reset));
+    st->ready_us = 0;
+}
+
+static void init_state(sim_state_t *st, const bme280_sim_config_t *config,
+                       bme280_sim_stats_t *stats)
+{
+    memset(st, 0, sizeof(*st));
+    memcpy(&st->regs[BME280_REG_CALIB_TEMP_PRESS], config->calib, 24);
+    st->regs[BME280_REG_CALIB_HUM1] = config->calib[24];
+    memcpy(&st->regs[BME280_REG_CALIB_HUM2], config->calib + 25, 7);
+    st->regs[SIM_REG_CHIP_ID] = BME280_SIM_CHIP_ID;
+    memcpy(st->burst, config->burst, sizeof(st->burst));
+    st->conversion_us = config->conversion_us;
+    st->stats = stats;
+    reset_registers(st);
+}
+
+/* Latch the sample; a forced conversion then drops the mode back to sleep */
+static void complete_conversion(sim_state_t *st)
+{
+    memcpy(&st->regs[BME280_REG_DATA], st->burst, sizeof(st->burst));
+    st->regs[BME280_REG_STATUS] &= (uint8_t)~BME280_STATUS_MEASURING;
+    if ((st->regs[BME280_REG_CTRL_MEAS] & BME280_MODE_MASK) != BME280_MODE_NORMAL) {
+        st->regs[BME280_REG_CTRL_MEAS] &= (uint8_t)~BME280_MODE_MASK;
+    }
+    st->ready_us = 0;
+}
+
+static void settle(sim_state_t *st)
+{
+    if (st->ready_us != 0 && bme280_time_us() >= st->ready_us) {
+        complete_conversion(st);
+    }
+}
+
+static void write_register(sim_state_t *st, uint8_t reg, uint8_t value)
+{
+    __atomic_add_fetch(&st->stats->register_writes, 1, __ATOMIC_RELAXED);
+    settle(st);
+
+    switch (reg) {
+    case SIM_REG_RESET:
+        if (value == SIM_RESET_VALUE) {
+            reset_registers(st);
+        }
+        break;
+    case BME280_REG_CTRL_HUM:
+        st->regs[reg] = value & 0x07;
+        break;
+    case BME280_REG_CONFIG:
+        st->regs[reg] = value;
+        break;
+    case BME280_REG_CTRL_MEAS:
+        st->regs[reg] = value;
+        if ((value & BME280_MODE_MASK) == 0) {
+            break;
+        }
+        __atomic_add_fetch(&st->stats->conversions, 1, __ATOMIC_RELAXED);
+        if ((value & BME280_MODE_MASK) == BME280_MODE_NORMAL || st->conversion_us == 0) {
+            complete_conversion(st);
+        } else {
+            st->regs[BME280_REG_STATUS] |= BME280_STATUS_MEASURING;
+            st->ready_us = bme280_time_us() + st->conversion_us;
+        }
+        break;
+    default:
+        break;  /* Read-only */
+    }
+}
+
+/* Serve one client until it disconnects */
+static void serve(int fd, sim_state_t *st)
+{
+    uint8_t msg[SIM_MAX_MESSAGE];
+
+    for (;;) {
+        ssize_t n = recv(fd, msg, sizeof(msg), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        __atomic_add_fetch(&st->stats->messages, 1, __ATOMIC_RELAXED);
+
+        if (n == 1) {
+            /* Pointer write: answer with the register window for the next read() */
+            size_t len = 256u - msg[0];
+            if (len > BME280_SIM_READ_WINDOW) {
+                len = BME280_SIM_READ_WINDOW;
+            }
+            st->pointer = msg[0];
+            settle(st);
+            __atomic_add_fetch(&st->stats->replies, 1, __ATOMIC_RELAXED);
+            if (send(fd, &st->regs[st->pointer], len, MSG_NOSIGNAL) < 0) {
+                return;
+            }
+            continue;
+        }
+
+        for (ssize_t i = 0; i + 1 < n; i += 2) {
+            write_register(st, msg[i], msg[i + 1]);
+        }
+    }
+}
+
+/*******************************************************************************
+ * Simulator Functions
+ ******************************************************************************/
+
+static bme280_error_t map_stats(bme280_sim_t *sim)
+{
+    sim->pid = -1;
+    sim->fd = -1;
+    sim->path[0] = '\0';
+
+    void *stats = mmap(NULL, sizeof(bme280_sim_stats_t), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED) {
+        sim->stats = NULL;
+        return BME280_ERR_BUS_OPEN;
+    }
+    memset(stats, 0, sizeof(bme280_sim_stats_t));
+    sim->stats = stats;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_sim_spawn(bme280_sim_t *sim, const bme280_sim_config_t *config)
+{
+    if (sim == NULL || config == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (map_stats(sim) != BME280_OK) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0) {
+        bme280_sim_stop(sim);
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    sim_state_t st;
+    init_state(&st, config, sim->stats);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(sv[0]);
+        serve(sv[1], &st);
+        _exit(0);
+    }
+    close(sv[1]);
+    if (pid < 0) {
+        close(sv[0]);
+        bme280_sim_stop(sim);
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    sim->pid = pid;
+    sim->fd = sv[0];
+    return BME280_OK;
+}
+
+bme280_error_t bme280_sim_listen(bme280_sim_t *sim, const char *path,
+                                 const bme280_sim_config_t *config)
+{
+    if (sim == NULL || path == NULL || config == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (strlen(path) >= BME280_SIM_PATH_LEN) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    if (map_stats(sim) != BME280_OK) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    /* Bound before the fork, so clients can connect as soon as this returns */
+    int lfd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    unlink(path);
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 4) != 0) {
+        if (lfd >= 0) {
+            close(lfd);
+        }
+        bme280_sim_stop(sim);
+        return BME280_ERR_BUS_OPEN;
+    }
+    strncpy(sim->path, path, sizeof(sim->path) - 1);
+    sim->path[sizeof(sim->path) - 1] = '\0';
+
+    sim_state_t st;
+    init_state(&st, config, sim->stats);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (;;) {
+            int fd = accept(lfd, NULL, NULL);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                _exit(1);
+            }
+            serve(fd, &st);
+            close(fd);
+        }
+    }
+    close(lfd);
+    if (pid < 0) {
+        bme280_sim_stop(sim);
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    sim->pid = pid;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_sim_connect(const char *path, int *fd)
+{
+    if (path == NULL || fd == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    *fd = -1;
+    if (strlen(path) >= BME280_SIM_PATH_LEN) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int s = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (s < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+    if (connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(s);
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    *fd = s;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_sim_get_stats(const bme280_sim_t *sim, bme280_sim_stats_t *stats)
+{
+    if (sim == NULL || stats == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (sim->stats == NULL) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    stats->messages = __atomic_load_n(&sim->stats->messages, __ATOMIC_RELAXED);
+    stats->replies = __atomic_load_n(&sim->stats->replies, __ATOMIC_RELAXED);
+    stats->register_writes = __atomic_load_n(&sim->stats->register_writes, __ATOMIC_RELAXED);
+    stats->conversions = __atomic_load_n(&sim->stats->conversions, __ATOMIC_RELAXED);
+    return BME280_OK;
+}
+
+void bme280_sim_stop(bme280_sim_t *sim)
+{
+    if (sim == NULL) {
+        return;
+    }
+
+    if (sim->pid > 0) {
+        kill(sim->pid, SIGTERM);
+        waitpid(sim->pid, NULL, 0);
+        sim->pid = -1;
+    }
+    if (sim->path[0] != '\0') {
+        unlink(sim->path);
+        sim->path[0] = '\0';
+    }
+    if (sim->stats != NULL) {
+        munmap(sim->stats, sizeof(*sim->stats));
+        sim->stats = NULL;
+    }
+    sim->fd = -1;
+}
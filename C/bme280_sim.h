@@ -0,0 +1,121 @@
+/**
+ * BME280 Out-of-Process Register Simulator
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * A simulated sensor in its own process, serving register transactions over
+ * a SOCK_SEQPACKET Unix socket with i2c-dev semantics, so the unchanged
+ * library read path (bme280_attach() on the socket fd) pays real blocking
+ * syscalls and context switches but no bus time:
+ *   - a 1-byte message sets the register pointer; the simulator answers with
+ *     one message holding the next BME280_SIM_READ_WINDOW registers, and the
+ *     client's read(fd, buf, n) takes the first n bytes of it
+ *   - a longer message is (register, value) pairs, as the chip expects
+ * Writing forced or normal mode to ctrl_meas starts a conversion that latches
+ * the configured burst into 0xF7..0xFE; forced mode reports measuring in the
+ * status register until the conversion time has passed.
+ *
+ * The simulator counts what it served in shared memory, which is also the
+ * client's syscall count: one write() per message, one read() per reply.
+ */
+
+#ifndef BME280_SIM_H
+#define BME280_SIM_H
+
+#include <sys/types.h>
+
+#include "bme280.h"
+
+/*******************************************************************************
+ * Simulator Constants
+ ******************************************************************************/
+
+#define BME280_SIM_READ_WINDOW  32    /* Register bytes returned per pointer write */
+#define BME280_SIM_CHIP_ID      0x60  /* Value of register 0xD0 */
+#define BME280_SIM_PATH_LEN     108   /* sun_path size */
+
+/*******************************************************************************
+ * Simulator Structures
+ ******************************************************************************/
+
+/**
+ * Simulated part
+ */
+typedef struct {
+    uint8_t  calib[32];       /* Registers 0x88..0x9F, 0xA1, 0xE1..0xE7 */
+    uint8_t  burst[8];        /* Registers 0xF7..0xFE after each conversion */
+    uint32_t conversion_us;   /* Forced conversion time (0 = immediate) */
+} bme280_sim_config_t;
+
+/**
+ * Transactions served (shared with the simulator process)
+ */
+typedef struct {
+    uint64_t messages;         /* Messages received = client write() calls */
+    uint64_t replies;          /* Register windows sent = client read() calls */
+    uint64_t register_writes;  /* (register, value) pairs applied */
+    uint64_t conversions;      /* Conversions started */
+} bme280_sim_stats_t;
+
+/**
+ * Running simulator
+ */
+typedef struct {
+    pid_t               pid;                        /* Simulator process (-1 if stopped) */
+    int                 fd;                         /* Client end from spawn, -1 for listen */
+    char                path[BME280_SIM_PATH_LEN];  /* Socket path from listen, else empty */
+    bme280_sim_stats_t *stats;                      /* Shared counters */
+} bme280_sim_t;
+
+/*******************************************************************************
+ * Simulator API Functions
+ ******************************************************************************/
+
+/**
+ * Start a simulator process connected to this one through a socketpair
+ * Attach a context to sim->fd with bme280_attach(); the descriptor then
+ * belongs to the context and is closed by bme280_close().
+ * @param sim    Pointer to simulator (caller-allocated)
+ * @param config Simulated part
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_sim_spawn(bme280_sim_t *sim, const bme280_sim_config_t *config);
+
+/**
+ * Start a simulator process listening on a Unix socket path
+ * Connections are served one at a time and share the register state.
+ * @param sim    Pointer to simulator (caller-allocated)
+ * @param path   Socket path (replaced if it exists)
+ * @param config Simulated part
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_sim_listen(bme280_sim_t *sim, const char *path,
+                                 const bme280_sim_config_t *config);
+
+/**
+ * Connect to a listening simulator
+ * @param path Socket path
+ * @param fd   Receives a descriptor for bme280_attach()
+ * @return BME280_OK on success, BME280_ERR_BUS_OPEN if nothing is listening
+ */
+bme280_error_t bme280_sim_connect(const char *path, int *fd);
+
+/**
+ * Copy the transaction counters
+ * Register writes are counted when the simulator gets to them, so they are
+ * exact only after a later read has returned.
+ * @param sim   Pointer to running simulator
+ * @param stats Receives the counters
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_sim_get_stats(const bme280_sim_t *sim, bme280_sim_stats_t *stats);
+
+/**
+ * Stop the simulator process and release its resources
+ * Client descriptors are left alone: close them (bme280_close()) first.
+ * @param sim Pointer to simulator
+ */
+void bme280_sim_stop(bme280_sim_t *sim);
+
+#endif /* BME280_SIM_H */
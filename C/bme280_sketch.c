@@ -0,0 +1,314 @@
+/**
+ * BME280 Quantile Sketch Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#include "bme280_sketch.h"
+
+#include <math.h>
+#include <string.h>
+
+/*******************************************************************************
+ * Store Helpers
+ ******************************************************************************/
+
+/* Highest bin in use; only called on a non-empty store */
+static int32_t store_top(const bme280_sketch_store_t *st)
+{
+    int32_t i = BME280_SKETCH_BINS - 1;
+    while (i > 0 && st->bins[i] == 0) {
+        i--;
+    }
+    return i;
+}
+
+static void store_add(bme280_sketch_store_t *st, int32_t k, uint32_t n)
+{
+    if (st->count == 0) {
+        memset(st->bins, 0, sizeof(st->bins));
+        st->offset = k - BME280_SKETCH_BINS / 2;
+    } else if (k < st->offset) {
+        /* Slide the range down if the top still fits, else fold into the lowest bin */
+        int32_t top = st->offset + store_top(st);
+        if (top - k < BME280_SKETCH_BINS) {
+            int32_t shift = st->offset - k;
+            memmove(st->bins + shift, st->bins, (size_t)(BME280_SKETCH_BINS - shift) * sizeof(st->bins[0]));
+            memset(st->bins, 0, (size_t)shift * sizeof(st->bins[0]));
+            st->offset = k;
+        } else {
+            k = st->offset;
+        }
+    } else if (k >= st->offset + BME280_SKETCH_BINS) {
+        /* Slide the range up, folding the smallest magnitudes together */
+        int32_t shift = k - (st->offset + BME280_SKETCH_BINS - 1);
+        if (shift >= BME280_SKETCH_BINS) {
+            uint32_t all = 0;
+            for (int32_t i = 0; i < BME280_SKETCH_BINS; i++) {
+                all += st->bins[i];
+            }
+            memset(st->bins, 0, sizeof(st->bins));
+            st->bins[0] = all;
+        } else {
+            uint32_t folded = 0;
+            for (int32_t i = 0; i <= shift; i++) {
+                folded += st->bins[i];
+            }
+            memmove(st->bins, st->bins + shift, (size_t)(BME280_SKETCH_BINS - shift) * sizeof(st->bins[0]));
+            memset(st->bins + BME280_SKETCH_BINS - shift, 0, (size_t)shift * sizeof(st->bins[0]));
+            st->bins[0] = folded;
+        }
+        st->offset += shift;
+    }
+
+    st->bins[k - st->offset] += n;
+    st->count += n;
+}
+
+static int32_t bucket_index(const bme280_sketch_t *sk, double magnitude)
+{
+    return (int32_t)ceil(log(magnitude) / sk->ln_gamma);
+}
+
+static double bucket_value(const bme280_sketch_t *sk, int32_t k)
+{
+    return 2.0 * exp((double)k * sk->ln_gamma) / (1.0 + sk->gamma);
+}
+
+/*******************************************************************************
+ * Sketch API Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_sketch_init(bme280_sketch_t *sk, double alpha)
+{
+    if (sk == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (!(alpha > 0.0 && alpha < 1.0)) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    memset(sk, 0, sizeof(*sk));
+    sk->alpha = alpha;
+    sk->gamma = (1.0 + alpha) / (1.0 - alpha);
+    sk->ln_gamma = log(sk->gamma);
+    sk->min = INFINITY;
+    sk->max = -INFINITY;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_sketch_add(bme280_sketch_t *sk, double value)
+{
+    if (sk == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (sk->gamma == 0.0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (!isfinite(value)) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    if (value > BME280_SKETCH_MIN_VALUE) {
+        store_add(&sk->positive, bucket_index(sk, value), 1);
+    } else if (value < -BME280_SKETCH_MIN_VALUE) {
+        store_add(&sk->negative, bucket_index(sk, -value), 1);
+    } else {
+        sk->zeros++;
+    }
+
+    sk->count++;
+    sk->sum += value;
+    if (value < sk->min) {
+        sk->min = value;
+    }
+    if (value > sk->max) {
+        sk->max = value;
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_sketch_merge(bme280_sketch_t *dst, const bme280_sketch_t *src)
+{
+    if (dst == NULL || src == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (dst->gamma == 0.0 || src->gamma == 0.0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (dst->alpha != src->alpha) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    /* Highest first so the destination range settles before lower bins fold */
+    for (int32_t i = BME280_SKETCH_BINS - 1; i >= 0; i--) {
+        if (src->positive.count > 0 && src->positive.bins[i] != 0) {
+            store_add(&dst->positive, src->positive.offset + i, src->positive.bins[i]);
+        }
+        if (src->negative.count > 0 && src->negative.bins[i] != 0) {
+            store_add(&dst->negative, src->negative.offset + i, src->negative.bins[i]);
+        }
+    }
+
+    dst->count += src->count;
+    dst->zeros += src->zeros;
+    dst->sum += src->sum;
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_sketch_quantile(const bme280_sketch_t *sk, double q, double *value)
+{
+    if (sk == NULL || value == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (sk->gamma == 0.0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (!(q >= 0.0 && q <= 1.0) || sk->count == 0) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    /* The extremes are known exactly */
+    if (q == 0.0 || q == 1.0) {
+        *value = q == 0.0 ? sk->min : sk->max;
+        return BME280_OK;
+    }
+
+    double rank = q * (double)(sk->count - 1);
+    double seen = 0.0;
+    double estimate = 0.0;
+    int found = 0;
+
+    /* Most negative first: negative store from its largest magnitude down */
+    for (int32_t i = BME280_SKETCH_BINS - 1; i >= 0 && !found && sk->negative.count > 0; i--) {
+        seen += sk->negative.bins[i];
+        if (seen > rank) {
+            estimate = -bucket_value(sk, sk->negative.offset + i);
+            found = 1;
+        }
+    }
+    if (!found) {
+        seen += (double)sk->zeros;
+        found = seen > rank;
+    }
+    for (int32_t i = 0; i < BME280_SKETCH_BINS && !found && sk->positive.count > 0; i++) {
+        seen += sk->positive.bins[i];
+        if (seen > rank) {
+            estimate = bucket_value(sk, sk->positive.offset + i);
+            found = 1;
+        }
+    }
+
+    if (estimate < sk->min) {
+        estimate = sk->min;
+    }
+    if (estimate > sk->max) {
+        estimate = sk->max;
+    }
+    *value = estimate;
+    return BME280_OK;
+}
+
+/*******************************************************************************
+ * Channel Set Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_sketch_set_init(bme280_sketch_set_t *set, double alpha, uint64_t start_us)
+{
+    if (set == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    set->start_us = start_us;
+    bme280_error_t err = bme280_sketch_init(&set->temperature, alpha);
+    if (err == BME280_OK) {
+        err = bme280_sketch_init(&set->pressure, alpha);
+    }
+    if (err == BME280_OK) {
+        err = bme280_sketch_init(&set->humidity, alpha);
+    }
+    return err;
+}
+
+bme280_error_t bme280_sketch_set_add(bme280_sketch_set_t *set, const bme280_data_t *data)
+{
+    if (set == NULL || data == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = bme280_sketch_add(&set->temperature, data->temperature_c);
+    if (err == BME280_OK) {
+        err = bme280_sketch_add(&set->pressure, data->pressure_hpa);
+    }
+    if (err == BME280_OK) {
+        err = bme280_sketch_add(&set->humidity, data->humidity_rh);
+    }
+    return err;
+}
+
+bme280_error_t bme280_sketch_set_merge(bme280_sketch_set_t *dst, const bme280_sketch_set_t *src)
+{
+    if (dst == NULL || src == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = bme280_sketch_merge(&dst->temperature, &src->temperature);
+    if (err == BME280_OK) {
+        err = bme280_sketch_merge(&dst->pressure, &src->pressure);
+    }
+    if (err == BME280_OK) {
+        err = bme280_sketch_merge(&dst->humidity, &src->humidity);
+    }
+    if (err == BME280_OK && src->start_us < dst->start_us) {
+        dst->start_us = src->start_us;
+    }
+    return err;
+}
+
+bme280_error_t bme280_sketch_set_roll(bme280_sketch_set_t *set, uint64_t window_us,
+                                      uint64_t timestamp_us, const bme280_data_t *data,
+                                      bme280_sketch_set_t *closed, int *rolled)
+{
+    if (set == NULL || data == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (window_us == 0) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    uint64_t start = timestamp_us - timestamp_us % window_us;
+    int done = 0;
+
+    if (start > set->start_us) {
+        if (set->temperature.count > 0) {
+            if (closed != NULL) {
+                *closed = *set;
+            }
+            done = 1;
+        }
+        bme280_error_t err = bme280_sketch_set_init(set, set->temperature.alpha, start);
+        if (err != BME280_OK) {
+            return err;
+        }
+    }
+
+    if (rolled != NULL) {
+        *rolled = done;
+    }
+    return bme280_sketch_set_add(set, data);
+}
@@ -0,0 +1,150 @@
+/**
+ * BME280 Quantile Sketch
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * DDSketch with fixed memory. Values are counted in logarithmic buckets
+ * so every quantile is returned within the configured relative accuracy
+ * of a real sample value, whatever the distribution. Positive and negative
+ * values have their own store of BME280_SKETCH_BINS buckets; when a store
+ * would span more than that, its smallest-magnitude buckets are folded
+ * together, which only costs accuracy far below the values of interest
+ * (below about 0.003 with 1% accuracy when the largest value is 85). Inserts are a
+ * log() and an increment; sketches with the same accuracy merge exactly,
+ * so hourly sketches can be combined across sensors or into daily ones.
+ */
+
+#ifndef BME280_SKETCH_H
+#define BME280_SKETCH_H
+
+#include "bme280.h"
+
+/*******************************************************************************
+ * Sketch Constants
+ ******************************************************************************/
+
+#define BME280_SKETCH_BINS           512    /* Buckets per sign */
+#define BME280_SKETCH_DEFAULT_ALPHA  0.01   /* 1% relative accuracy */
+#define BME280_SKETCH_MIN_VALUE      1e-9   /* Magnitudes below this count as zero */
+
+/*******************************************************************************
+ * Sketch Structures
+ ******************************************************************************/
+
+/**
+ * Buckets for one sign
+ */
+typedef struct {
+    int32_t  offset;                     /* Bucket index held by bins[0] */
+    uint64_t count;                      /* Values in this store */
+    uint32_t bins[BME280_SKETCH_BINS];
+} bme280_sketch_store_t;
+
+/**
+ * Quantile sketch for one channel
+ */
+typedef struct {
+    double                alpha;       /* Relative accuracy */
+    double                gamma;       /* (1 + alpha) / (1 - alpha) */
+    double                ln_gamma;
+    uint64_t              count;       /* Values added */
+    uint64_t              zeros;       /* Values with magnitude below MIN_VALUE */
+    double                min;
+    double                max;
+    double                sum;
+    bme280_sketch_store_t positive;
+    bme280_sketch_store_t negative;    /* Indexed by magnitude */
+} bme280_sketch_t;
+
+/**
+ * Sketches of every channel for one sensor over one window
+ */
+typedef struct {
+    uint64_t        start_us;      /* Window start (multiple of the window length) */
+    bme280_sketch_t temperature;   /* Celsius */
+    bme280_sketch_t pressure;      /* hPa */
+    bme280_sketch_t humidity;      /* %RH */
+} bme280_sketch_set_t;
+
+/*******************************************************************************
+ * Sketch API Functions
+ ******************************************************************************/
+
+/**
+ * Initialize an empty sketch
+ * @param sk    Pointer to sketch (caller-allocated)
+ * @param alpha Relative accuracy, 0 < alpha < 1 (e.g. BME280_SKETCH_DEFAULT_ALPHA)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_sketch_init(bme280_sketch_t *sk, double alpha);
+
+/**
+ * Add one value
+ * @param sk    Pointer to initialized sketch
+ * @param value Value to add
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_sketch_add(bme280_sketch_t *sk, double value);
+
+/**
+ * Add every value of src into dst
+ * @param dst Pointer to initialized sketch
+ * @param src Pointer to sketch with the same accuracy
+ * @return BME280_OK on success, BME280_ERR_INVALID_ARG if accuracies differ
+ */
+bme280_error_t bme280_sketch_merge(bme280_sketch_t *dst, const bme280_sketch_t *src);
+
+/**
+ * Estimate a quantile
+ * @param sk    Pointer to initialized sketch
+ * @param q     Quantile in [0, 1] (0.5 = median)
+ * @param value Receives the estimate
+ * @return BME280_OK on success, BME280_ERR_INVALID_ARG if q is out of
+ *         range or the sketch is empty
+ */
+bme280_error_t bme280_sketch_quantile(const bme280_sketch_t *sk, double q, double *value);
+
+/**
+ * Initialize an empty channel set for the window starting at start_us
+ * @param set      Pointer to set (caller-allocated)
+ * @param alpha    Relative accuracy of every channel
+ * @param start_us Window start
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_sketch_set_init(bme280_sketch_set_t *set, double alpha, uint64_t start_us);
+
+/**
+ * Add a compensated sample to every channel
+ * @param set  Pointer to initialized set
+ * @param data Sample to add
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_sketch_set_add(bme280_sketch_set_t *set, const bme280_data_t *data);
+
+/**
+ * Merge every channel of src into dst (e.g. across sensors or windows)
+ * @param dst Pointer to initialized set
+ * @param src Pointer to set with the same accuracy
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_sketch_set_merge(bme280_sketch_set_t *dst, const bme280_sketch_set_t *src);
+
+/**
+ * Add a timestamped sample to a rolling window
+ * When the sample belongs to a later window, the finished window is copied
+ * to closed (if not NULL) and the set restarts empty. Samples older than
+ * the current window are counted in it.
+ * @param set          Pointer to initialized set
+ * @param window_us    Window length (e.g. 3600000000 for hourly)
+ * @param timestamp_us Sample time
+ * @param data         Sample to add
+ * @param closed       Optional; receives the finished window
+ * @param rolled       Optional; set to 1 if a window was closed, else 0
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_sketch_set_roll(bme280_sketch_set_t *set, uint64_t window_us,
+                                      uint64_t timestamp_us, const bme280_data_t *data,
+                                      bme280_sketch_set_t *closed, int *rolled);
+
+#endif /* BME280_SKETCH_H */
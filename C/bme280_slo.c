@@ -0,0 +1,223 @@
+/**
+ * BME280 Latency and Freshness SLO Monitor Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#include "bme280_slo.h"
+
+#include <string.h>
+
+/*******************************************************************************
+ * Window Helpers
+ ******************************************************************************/
+
+/* Sum good/bad over the newest n buckets ending at bucket number now */
+static void window_sum(const bme280_slo_sensor_t *s, bme280_slo_kind_t kind, uint64_t now,
+                       uint32_t n, uint32_t *good, uint32_t *bad)
+{
+    *good = 0;
+    *bad = 0;
+    for (uint32_t i = 0; i < BME280_SLO_BUCKETS; i++) {
+        if (s->epoch[i] <= now && now - s->epoch[i] < n) {
+            *good += s->good[kind][i];
+            *bad += s->bad[kind][i];
+        }
+    }
+}
+
+static float burn_rate(uint32_t good, uint32_t bad, float objective)
+{
+    uint32_t total = good + bad;
+    float budget = 1.0f - objective;
+
+    if (total == 0) {
+        return 0.0f;
+    }
+    if (budget <= 0.0f) {
+        return bad > 0 ? 1e9f : 0.0f;
+    }
+    return ((float)bad / (float)total) / budget;
+}
+
+static void fill_status(const bme280_slo_t *slo, uint32_t sensor, bme280_slo_kind_t kind,
+                        uint64_t now_us, bme280_slo_alert_t *status)
+{
+    const bme280_slo_sensor_t *s = &slo->sensors[sensor];
+    uint64_t now = now_us / slo->bucket_us;
+    uint32_t good;
+    uint32_t bad;
+
+    window_sum(s, kind, now, slo->short_buckets, &good, &bad);
+    status->burn_short = burn_rate(good, bad, s->budget.objective);
+    window_sum(s, kind, now, BME280_SLO_BUCKETS, &good, &bad);
+    status->burn_long = burn_rate(good, bad, s->budget.objective);
+    status->sensor = sensor;
+    status->kind = kind;
+    status->firing = s->firing[kind];
+    status->bad = bad;
+    status->total = good + bad;
+    status->timestamp_us = now_us;
+}
+
+static void record(bme280_slo_t *slo, uint32_t sensor, bme280_slo_kind_t kind,
+                   uint64_t now_us, int good)
+{
+    bme280_slo_sensor_t *s = &slo->sensors[sensor];
+    uint64_t now = now_us / slo->bucket_us;
+    uint32_t slot = (uint32_t)(now % BME280_SLO_BUCKETS);
+
+    /* Reuse a slot left over from an earlier pass round the ring */
+    if (s->epoch[slot] != now) {
+        s->epoch[slot] = now;
+        for (int k = 0; k < BME280_SLO_KINDS; k++) {
+            s->good[k][slot] = 0;
+            s->bad[k][slot] = 0;
+        }
+    }
+    if (good) {
+        s->good[kind][slot]++;
+    } else {
+        s->bad[kind][slot]++;
+    }
+
+    bme280_slo_alert_t alert;
+    fill_status(slo, sensor, kind, now_us, &alert);
+
+    int firing = s->firing[kind];
+    if (!firing && alert.total >= slo->config.min_events
+        && alert.burn_long >= slo->config.burn_threshold
+        && alert.burn_short >= slo->config.burn_threshold) {
+        firing = 1;
+    } else if (firing && alert.burn_short < slo->config.burn_threshold) {
+        firing = 0;
+    }
+
+    if (firing != s->firing[kind]) {
+        s->firing[kind] = firing;
+        alert.firing = firing;
+        if (slo->cb != NULL) {
+            slo->cb(slo->user, &alert);
+        }
+    }
+}
+
+/*******************************************************************************
+ * SLO API Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_slo_init(bme280_slo_t *slo, const bme280_slo_config_t *config,
+                               bme280_slo_alert_cb_t cb, void *user)
+{
+    if (slo == NULL || config == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(slo, 0, sizeof(*slo));
+
+    if (config->window_us < BME280_SLO_BUCKETS || config->short_window_us > config->window_us
+        || config->burn_threshold <= 0.0f) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    slo->config = *config;
+    slo->bucket_us = config->window_us / BME280_SLO_BUCKETS;
+    slo->short_buckets = (uint32_t)((config->short_window_us + slo->bucket_us - 1) / slo->bucket_us);
+    if (slo->short_buckets == 0) {
+        slo->short_buckets = 1;
+    }
+    slo->cb = cb;
+    slo->user = user;
+
+    for (uint32_t i = 0; i < BME280_SLO_MAX_SENSORS; i++) {
+        bme280_slo_sensor_t *s = &slo->sensors[i];
+        s->budget.latency_budget_us = 1000000u;
+        s->budget.freshness_budget_us = 10000000u;
+        s->budget.objective = 0.99f;
+        /* No slot holds a real bucket until first written */
+        for (uint32_t b = 0; b < BME280_SLO_BUCKETS; b++) {
+            s->epoch[b] = UINT64_MAX;
+        }
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_slo_set_budget(bme280_slo_t *slo, uint32_t sensor,
+                                     const bme280_slo_budget_t *budget)
+{
+    if (slo == NULL || budget == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (slo->bucket_us == 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (sensor >= BME280_SLO_MAX_SENSORS || budget->objective < 0.0f || budget->objective > 1.0f) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    slo->sensors[sensor].budget = *budget;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_slo_record_read(bme280_slo_t *slo, uint32_t sensor, uint64_t trigger_us,
+                                      uint64_t available_us, bme280_error_t err)
+{
+    if (slo == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (slo->bucket_us == 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (sensor >= BME280_SLO_MAX_SENSORS || available_us < trigger_us) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    int good = err == BME280_OK
+        && available_us - trigger_us <= slo->sensors[sensor].budget.latency_budget_us;
+    record(slo, sensor, BME280_SLO_LATENCY, available_us, good);
+    return BME280_OK;
+}
+
+bme280_error_t bme280_slo_record_freshness(bme280_slo_t *slo, uint32_t sensor,
+                                           uint64_t sample_us, uint64_t now_us)
+{
+    if (slo == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (slo->bucket_us == 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (sensor >= BME280_SLO_MAX_SENSORS || now_us < sample_us) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    int good = now_us - sample_us <= slo->sensors[sensor].budget.freshness_budget_us;
+    record(slo, sensor, BME280_SLO_FRESHNESS, now_us, good);
+    return BME280_OK;
+}
+
+bme280_error_t bme280_slo_status(const bme280_slo_t *slo, uint32_t sensor, bme280_slo_kind_t kind,
+                                 uint64_t now_us, bme280_slo_alert_t *status)
+{
+    if (slo == NULL || status == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (slo->bucket_us == 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (sensor >= BME280_SLO_MAX_SENSORS || kind >= BME280_SLO_KINDS) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    fill_status(slo, sensor, kind, now_us, status);
+    return BME280_OK;
+}
@@ -0,0 +1,165 @@
+/**
+ * BME280 Latency and Freshness SLO Monitor
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Tracks two service levels per sensor: read latency (trigger to sample
+ * available) and freshness (age of the sample a consumer is handed). Each
+ * event is good or bad against the sensor's budget; counts are kept in a
+ * ring of time buckets covering the long window. The burn rate is the bad
+ * fraction divided by the error budget (1 - objective). An alert fires
+ * when both the long and the short window burn faster than the threshold,
+ * and clears when the short window drops back below it, so a degraded bus
+ * or mux is reported within the short window while one-off glitches are
+ * not. Alerts are edge-triggered through a callback; current values can
+ * also be polled for metrics export.
+ *
+ * The monitor is not locked; feed it from the acquisition thread.
+ */
+
+#ifndef BME280_SLO_H
+#define BME280_SLO_H
+
+#include "bme280.h"
+
+/*******************************************************************************
+ * SLO Constants
+ ******************************************************************************/
+
+#define BME280_SLO_MAX_SENSORS  64  /* Sensors per monitor */
+#define BME280_SLO_BUCKETS      60  /* Buckets per long window */
+
+/*******************************************************************************
+ * SLO Structures
+ ******************************************************************************/
+
+/**
+ * Service level being measured
+ */
+typedef enum {
+    BME280_SLO_LATENCY = 0,    /* Trigger to sample available */
+    BME280_SLO_FRESHNESS,      /* Age of the sample when consumed */
+    BME280_SLO_KINDS
+} bme280_slo_kind_t;
+
+/**
+ * Per-sensor budget
+ */
+typedef struct {
+    uint32_t latency_budget_us;    /* Reads slower than this (or failed) are bad */
+    uint32_t freshness_budget_us;  /* Samples older than this when consumed are bad */
+    float    objective;            /* Fraction of good events promised, e.g. 0.99 */
+} bme280_slo_budget_t;
+
+/**
+ * Monitor configuration
+ */
+typedef struct {
+    uint64_t window_us;        /* Long window, split into BME280_SLO_BUCKETS */
+    uint64_t short_window_us;  /* Short window (at least one bucket) */
+    float    burn_threshold;   /* Burn rate that fires an alert */
+    uint32_t min_events;       /* Long-window events needed before alerting */
+} bme280_slo_config_t;
+
+/**
+ * Alert raised or cleared for one sensor and service level
+ */
+typedef struct {
+    uint32_t          sensor;
+    bme280_slo_kind_t kind;
+    int               firing;        /* 1 = raised, 0 = cleared */
+    float             burn_long;     /* Burn rate over the long window */
+    float             burn_short;    /* Burn rate over the short window */
+    uint32_t          bad;           /* Bad events in the long window */
+    uint32_t          total;         /* Events in the long window */
+    uint64_t          timestamp_us;  /* Time of the triggering event */
+} bme280_slo_alert_t;
+
+typedef void (*bme280_slo_alert_cb_t)(void *user, const bme280_slo_alert_t *alert);
+
+/**
+ * Per-sensor window state
+ */
+typedef struct {
+    bme280_slo_budget_t budget;
+    uint64_t            epoch[BME280_SLO_BUCKETS];  /* Bucket number held by each slot */
+    uint32_t            good[BME280_SLO_KINDS][BME280_SLO_BUCKETS];
+    uint32_t            bad[BME280_SLO_KINDS][BME280_SLO_BUCKETS];
+    int                 firing[BME280_SLO_KINDS];
+} bme280_slo_sensor_t;
+
+/**
+ * Monitor state
+ */
+typedef struct {
+    bme280_slo_config_t   config;
+    uint64_t              bucket_us;      /* Width of one bucket */
+    uint32_t              short_buckets;  /* Buckets in the short window */
+    bme280_slo_alert_cb_t cb;
+    void                 *user;
+    bme280_slo_sensor_t   sensors[BME280_SLO_MAX_SENSORS];
+} bme280_slo_t;
+
+/*******************************************************************************
+ * SLO API Functions
+ ******************************************************************************/
+
+/**
+ * Initialize a monitor; every sensor starts with a 99% objective and
+ * budgets of one second latency and ten seconds freshness
+ * @param slo    Pointer to monitor (caller-allocated)
+ * @param config Windows and threshold
+ * @param cb     Alert callback (may be NULL to poll only)
+ * @param user   Passed to cb
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_slo_init(bme280_slo_t *slo, const bme280_slo_config_t *config,
+                               bme280_slo_alert_cb_t cb, void *user);
+
+/**
+ * Set the budget of one sensor
+ * @param slo    Pointer to initialized monitor
+ * @param sensor Sensor index
+ * @param budget Budget to apply
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_slo_set_budget(bme280_slo_t *slo, uint32_t sensor,
+                                     const bme280_slo_budget_t *budget);
+
+/**
+ * Record a read attempt
+ * @param slo          Pointer to initialized monitor
+ * @param sensor       Sensor index
+ * @param trigger_us   When the read (or forced conversion) was started
+ * @param available_us When the sample became available to consumers
+ * @param err          Result of the read; failures always count as bad
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_slo_record_read(bme280_slo_t *slo, uint32_t sensor, uint64_t trigger_us,
+                                      uint64_t available_us, bme280_error_t err);
+
+/**
+ * Record a consumer picking up a sample
+ * @param slo       Pointer to initialized monitor
+ * @param sensor    Sensor index
+ * @param sample_us When the sample was taken
+ * @param now_us    Current time
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_slo_record_freshness(bme280_slo_t *slo, uint32_t sensor,
+                                           uint64_t sample_us, uint64_t now_us);
+
+/**
+ * Get the current window counts and burn rates, e.g. for metrics export
+ * @param slo    Pointer to initialized monitor
+ * @param sensor Sensor index
+ * @param kind   Service level
+ * @param now_us Current time
+ * @param status Pointer to structure to receive the values
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_slo_status(const bme280_slo_t *slo, uint32_t sensor, bme280_slo_kind_t kind,
+                                 uint64_t now_us, bme280_slo_alert_t *status);
+
+#endif /* BME280_SLO_H */
@@ -0,0 +1,835 @@
+/**
+ * BME280 Pipeline State Snapshots Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bme280_snapshot.h"
+#include "bme280_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*******************************************************************************
+ * Section Layouts
+ ******************************************************************************/
+
+#define HEADER_SIZE          (8 + BME280_SNAPSHOT_BOOT_ID_LEN)
+#define SECTION_HEADER_SIZE  12
+#define TRAILER_SIZE         8
+
+/* Payload sizes of the current section versions */
+#define CTX_VERSION          1
+#define CTX_SIZE             (32 + 4 + 4 + 4)
+#define SLO_VERSION          1
+#define SLO_SENSOR_SIZE      (12 + BME280_SLO_BUCKETS * 8 \
+                              + 2 * BME280_SLO_KINDS * BME280_SLO_BUCKETS * 4 + BME280_SLO_KINDS * 4)
+#define SLO_SIZE             (8 + 24 + BME280_SLO_MAX_SENSORS * SLO_SENSOR_SIZE)
+#define SKETCH_VERSION       1
+#define SKETCH_SIZE          (48 + 4 + 2 * (12 + BME280_SKETCH_BINS * 4))
+#define SKETCH_SET_SIZE      (8 + 3 * SKETCH_SIZE)
+#define COMPRESS_VERSION     1
+#define COMPRESSOR_SIZE      76
+#define COMPRESS_SIZE        (BME280_CHANNEL_COUNT * COMPRESSOR_SIZE)
+
+/*******************************************************************************
+ * Encoding Helpers
+ ******************************************************************************/
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Kernel boot id (a UUID), all zeros if unavailable */
+static void read_boot_id(uint8_t *id)
+{
+    char text[40];
+    ssize_t len = -1;
+
+    memset(id, 0, BME280_SNAPSHOT_BOOT_ID_LEN);
+    int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY);
+    if (fd >= 0) {
+        len = read(fd, text, sizeof(text) - 1);
+        close(fd);
+    }
+
+    uint32_t nibbles = 0;
+    for (ssize_t i = 0; i < len && nibbles < 2 * BME280_SNAPSHOT_BOOT_ID_LEN; i++) {
+        char c = text[i];
+        int v;
+        if (c >= '0' && c <= '9') {
+            v = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            v = c - 'a' + 10;
+        } else {
+            continue;
+        }
+        id[nibbles / 2] |= (uint8_t)(nibbles % 2 == 0 ? v << 4 : v);
+        nibbles++;
+    }
+}
+
+/*******************************************************************************
+ * Buffered Writer
+ ******************************************************************************/
+
+static void w_flush(bme280_snapshot_writer_t *w)
+{
+    const uint8_t *p = w->buf;
+    uint32_t len = w->fill;
+
+    while (len > 0 && w->err == BME280_OK) {
+        ssize_t n = write(w->fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            w->err = BME280_ERR_WRITE;
+            break;
+        }
+        p += n;
+        len -= (uint32_t)n;
+    }
+    w->fill = 0;
+}
+
+static void w_bytes(bme280_snapshot_writer_t *w, const uint8_t *p, size_t len)
+{
+    w->crc = bme280_crc32(w->crc, p, len);
+    while (len > 0) {
+        if (w->fill == sizeof(w->buf)) {
+            w_flush(w);
+        }
+        size_t n = sizeof(w->buf) - w->fill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(w->buf + w->fill, p, n);
+        w->fill += (uint32_t)n;
+        p += n;
+        len -= n;
+    }
+}
+
+static void w_u8(bme280_snapshot_writer_t *w, uint8_t v)
+{
+    w_bytes(w, &v, 1);
+}
+
+static void w_u16(bme280_snapshot_writer_t *w, uint16_t v)
+{
+    uint8_t b[2];
+    put_u16(b, v);
+    w_bytes(w, b, sizeof(b));
+}
+
+static void w_u32(bme280_snapshot_writer_t *w, uint32_t v)
+{
+    uint8_t b[4];
+    put_u32(b, v);
+    w_bytes(w, b, sizeof(b));
+}
+
+static void w_u64(bme280_snapshot_writer_t *w, uint64_t v)
+{
+    w_u32(w, (uint32_t)v);
+    w_u32(w, (uint32_t)(v >> 32));
+}
+
+static void w_f32(bme280_snapshot_writer_t *w, float f)
+{
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    w_u32(w, v);
+}
+
+static void w_f64(bme280_snapshot_writer_t *w, double f)
+{
+    uint64_t v;
+    memcpy(&v, &f, sizeof(v));
+    w_u64(w, v);
+}
+
+static bme280_error_t w_section(bme280_snapshot_writer_t *w, bme280_snapshot_section_t type,
+                                uint8_t version, uint32_t id, uint32_t length)
+{
+    if (w->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (w->sections >= BME280_SNAPSHOT_MAX_SECTIONS) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    w_u16(w, (uint16_t)type);
+    w_u8(w, version);
+    w_u8(w, 0);
+    w_u32(w, id);
+    w_u32(w, length);
+    w->sections++;
+    return BME280_OK;
+}
+
+/*******************************************************************************
+ * Buffered Reader
+ ******************************************************************************/
+
+static void r_bytes(bme280_snapshot_reader_t *r, uint8_t *p, size_t len)
+{
+    while (len > 0) {
+        if (r->next == r->fill) {
+            uint64_t want = r->end - r->pos;
+            if (want > sizeof(r->buf)) {
+                want = sizeof(r->buf);
+            }
+            ssize_t n = want > 0 ? pread(r->fd, r->buf, (size_t)want, (off_t)r->pos) : 0;
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                r->short_read = 1;
+                memset(p, 0, len);
+                return;
+            }
+            r->pos += (uint64_t)n;
+            r->fill = (uint32_t)n;
+            r->next = 0;
+        }
+        size_t n = r->fill - r->next;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(p, r->buf + r->next, n);
+        r->next += (uint32_t)n;
+        p += n;
+        len -= n;
+    }
+}
+
+static void r_seek(bme280_snapshot_reader_t *r, uint64_t offset, uint64_t length)
+{
+    r->pos = offset;
+    r->end = offset + length;
+    r->fill = 0;
+    r->next = 0;
+    r->short_read = 0;
+}
+
+static uint8_t r_u8(bme280_snapshot_reader_t *r)
+{
+    uint8_t v;
+    r_bytes(r, &v, 1);
+    return v;
+}
+
+static uint32_t r_u32(bme280_snapshot_reader_t *r)
+{
+    uint8_t b[4];
+    r_bytes(r, b, sizeof(b));
+    return get_u32(b);
+}
+
+static uint16_t r_u16(bme280_snapshot_reader_t *r)
+{
+    uint8_t b[2];
+    r_bytes(r, b, sizeof(b));
+    return get_u16(b);
+}
+
+static uint64_t r_u64(bme280_snapshot_reader_t *r)
+{
+    uint64_t lo = r_u32(r);
+    return lo | ((uint64_t)r_u32(r) << 32);
+}
+
+static float r_f32(bme280_snapshot_reader_t *r)
+{
+    uint32_t v = r_u32(r);
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+static double r_f64(bme280_snapshot_reader_t *r)
+{
+    uint64_t v = r_u64(r);
+    double f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+/* Position the reader on a section of the expected version and size */
+static bme280_error_t r_find(bme280_snapshot_reader_t *r, bme280_snapshot_section_t type,
+                             uint8_t version, uint32_t id, uint32_t length)
+{
+    if (r->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    for (uint32_t i = 0; i < r->sections; i++) {
+        const bme280_snapshot_entry_t *e = &r->entries[i];
+        if (e->type != (uint16_t)type || e->id != id) {
+            continue;
+        }
+        if (e->version != version || e->length != length) {
+            return BME280_ERR_INVALID_ARG;
+        }
+        r_seek(r, e->offset, e->length);
+        return BME280_OK;
+    }
+    return BME280_ERR_NOT_INIT;
+}
+
+/*******************************************************************************
+ * Writing
+ ******************************************************************************/
+
+bme280_error_t bme280_snapshot_begin(bme280_snapshot_writer_t *w, const char *path)
+{
+    char tmp[BME280_SNAPSHOT_PATH_LEN + 4];
+
+    if (w == NULL || path == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    w->fd = -1;
+    if (strlen(path) >= BME280_SNAPSHOT_PATH_LEN) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    strcpy(w->path, path);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    w->fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    w->crc = 0;
+    w->sections = 0;
+    w->fill = 0;
+    w->err = BME280_OK;
+
+    uint8_t boot_id[BME280_SNAPSHOT_BOOT_ID_LEN];
+    read_boot_id(boot_id);
+    w_u32(w, BME280_SNAPSHOT_MAGIC);
+    w_u16(w, BME280_SNAPSHOT_VERSION);
+    w_u16(w, 0);
+    w_bytes(w, boot_id, sizeof(boot_id));
+    return BME280_OK;
+}
+
+bme280_error_t bme280_snapshot_put_ctx(bme280_snapshot_writer_t *w, uint32_t id,
+                                       const bme280_ctx_t *ctx)
+{
+    if (w == NULL || ctx == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = w_section(w, BME280_SNAPSHOT_CTX, CTX_VERSION, id, CTX_SIZE);
+    if (err != BME280_OK) {
+        return err;
+    }
+
+    uint8_t regs[32];
+    bme280_pack_calibration(&ctx->calib, regs);
+    w_bytes(w, regs, sizeof(regs));
+    w_u32(w, (uint32_t)ctx->t_fine);
+    w_u8(w, ctx->ctrl_hum);
+    w_u8(w, ctx->ctrl_meas);
+    w_u8(w, ctx->config);
+    w_u8(w, 0);
+    w_u32(w, ctx->cache.ttl_us);
+    return w->err;
+}
+
+bme280_error_t bme280_snapshot_put_slo(bme280_snapshot_writer_t *w, const bme280_slo_t *slo)
+{
+    if (w == NULL || slo == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = w_section(w, BME280_SNAPSHOT_SLO, SLO_VERSION, 0, SLO_SIZE);
+    if (err != BME280_OK) {
+        return err;
+    }
+
+    /* Dimensions first, so a build with other limits rejects the section */
+    w_u16(w, BME280_SLO_MAX_SENSORS);
+    w_u16(w, BME280_SLO_BUCKETS);
+    w_u16(w, BME280_SLO_KINDS);
+    w_u16(w, 0);
+
+    w_u64(w, slo->config.window_us);
+    w_u64(w, slo->config.short_window_us);
+    w_f32(w, slo->config.burn_threshold);
+    w_u32(w, slo->config.min_events);
+
+    for (uint32_t i = 0; i < BME280_SLO_MAX_SENSORS; i++) {
+        const bme280_slo_sensor_t *s = &slo->sensors[i];
+        w_u32(w, s->budget.latency_budget_us);
+        w_u32(w, s->budget.freshness_budget_us);
+        w_f32(w, s->budget.objective);
+        for (uint32_t b = 0; b < BME280_SLO_BUCKETS; b++) {
+            w_u64(w, s->epoch[b]);
+        }
+        for (uint32_t k = 0; k < BME280_SLO_KINDS; k++) {
+            for (uint32_t b = 0; b < BME280_SLO_BUCKETS; b++) {
+                w_u32(w, s->good[k][b]);
+                w_u32(w, s->bad[k][b]);
+            }
+        }
+        for (uint32_t k = 0; k < BME280_SLO_KINDS; k++) {
+            w_u32(w, (uint32_t)s->firing[k]);
+        }
+    }
+    return w->err;
+}
+
+static void w_sketch_store(bme280_snapshot_writer_t *w, const bme280_sketch_store_t *st)
+{
+    w_u32(w, (uint32_t)st->offset);
+    w_u64(w, st->count);
+    for (uint32_t i = 0; i < BME280_SKETCH_BINS; i++) {
+        w_u32(w, st->bins[i]);
+    }
+}
+
+static void w_sketch(bme280_snapshot_writer_t *w, const bme280_sketch_t *sk)
+{
+    w_f64(w, sk->alpha);
+    w_u64(w, sk->count);
+    w_u64(w, sk->zeros);
+    w_f64(w, sk->min);
+    w_f64(w, sk->max);
+    w_f64(w, sk->sum);
+    w_u32(w, BME280_SKETCH_BINS);
+    w_sketch_store(w, &sk->positive);
+    w_sketch_store(w, &sk->negative);
+}
+
+bme280_error_t bme280_snapshot_put_sketch_set(bme280_snapshot_writer_t *w, uint32_t id,
+                                              const bme280_sketch_set_t *set)
+{
+    if (w == NULL || set == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = w_section(w, BME280_SNAPSHOT_SKETCH_SET, SKETCH_VERSION, id, SKETCH_SET_SIZE);
+    if (err != BME280_OK) {
+        return err;
+    }
+
+    w_u64(w, set->start_us);
+    w_sketch(w, &set->temperature);
+    w_sketch(w, &set->pressure);
+    w_sketch(w, &set->humidity);
+    return w->err;
+}
+
+bme280_error_t bme280_snapshot_put_compress(bme280_snapshot_writer_t *w, uint32_t id,
+                                            const bme280_compress_sample_t *cs)
+{
+    if (w == NULL || cs == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = w_section(w, BME280_SNAPSHOT_COMPRESS, COMPRESS_VERSION, id, COMPRESS_SIZE);
+    if (err != BME280_OK) {
+        return err;
+    }
+
+    for (int ch = 0; ch < BME280_CHANNEL_COUNT; ch++) {
+        const bme280_compressor_t *c = &cs->channels[ch];
+        w_u32(w, (uint32_t)c->mode);
+        w_f32(w, c->deviation);
+        w_u64(w, c->max_interval_us);
+        w_u8(w, (uint8_t)c->started);
+        w_u8(w, (uint8_t)c->pending);
+        w_u16(w, 0);
+        w_u64(w, c->archived.timestamp_us);
+        w_f32(w, c->archived.value);
+        w_u64(w, c->held.timestamp_us);
+        w_f32(w, c->held.value);
+        w_f64(w, c->slope_max);
+        w_f64(w, c->slope_min);
+        w_u64(w, c->stats.points_in);
+        w_u64(w, c->stats.points_out);
+    }
+    return w->err;
+}
+
+bme280_error_t bme280_snapshot_commit(bme280_snapshot_writer_t *w)
+{
+    char tmp[BME280_SNAPSHOT_PATH_LEN + 4];
+
+    if (w == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (w->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    w_u32(w, w->sections);
+    uint8_t crc[4];
+    put_u32(crc, w->crc);
+    w_bytes(w, crc, sizeof(crc));
+    w_flush(w);
+
+    if (w->err == BME280_OK && fdatasync(w->fd) != 0) {
+        w->err = BME280_ERR_WRITE;
+    }
+    if (close(w->fd) != 0 && w->err == BME280_OK) {
+        w->err = BME280_ERR_WRITE;
+    }
+    w->fd = -1;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", w->path);
+    if (w->err != BME280_OK) {
+        unlink(tmp);
+        return w->err;
+    }
+    if (rename(tmp, w->path) != 0) {
+        unlink(tmp);
+        return BME280_ERR_WRITE;
+    }
+    return BME280_OK;
+}
+
+void bme280_snapshot_abort(bme280_snapshot_writer_t *w)
+{
+    char tmp[BME280_SNAPSHOT_PATH_LEN + 4];
+
+    if (w == NULL || w->fd < 0) {
+        return;
+    }
+
+    close(w->fd);
+    w->fd = -1;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", w->path);
+    unlink(tmp);
+}
+
+/*******************************************************************************
+ * Reading
+ ******************************************************************************/
+
+bme280_error_t bme280_snapshot_open(bme280_snapshot_reader_t *r, const char *path)
+{
+    if (r == NULL || path == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    r->fd = open(path, O_RDONLY);
+    r->sections = 0;
+    r->same_boot = 0;
+    if (r->fd < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    struct stat st;
+    if (fstat(r->fd, &st) != 0 || st.st_size < HEADER_SIZE + TRAILER_SIZE) {
+        bme280_snapshot_close(r);
+        return BME280_ERR_READ;
+    }
+    uint64_t size = (uint64_t)st.st_size;
+
+    /* Whole-file CRC before anything is trusted */
+    uint32_t crc = 0;
+    r_seek(r, 0, size - 4);
+    while (r->pos < r->end && !r->short_read) {
+        uint8_t chunk[BME280_SNAPSHOT_BUFFER];
+        uint64_t n = r->end - r->pos;
+        if (n > sizeof(chunk)) {
+            n = sizeof(chunk);
+        }
+        r_bytes(r, chunk, (size_t)n);
+        crc = bme280_crc32(crc, chunk, (size_t)n);
+    }
+    r_seek(r, size - 4, 4);
+    uint32_t stored = r_u32(r);
+    if (r->short_read || crc != stored) {
+        bme280_snapshot_close(r);
+        return BME280_ERR_READ;
+    }
+
+    r_seek(r, 0, HEADER_SIZE);
+    if (r_u32(r) != BME280_SNAPSHOT_MAGIC) {
+        bme280_snapshot_close(r);
+        return BME280_ERR_READ;
+    }
+    if (r_u16(r) != BME280_SNAPSHOT_VERSION) {
+        bme280_snapshot_close(r);
+        return BME280_ERR_INVALID_ARG;
+    }
+    (void)r_u16(r);
+
+    uint8_t saved[BME280_SNAPSHOT_BOOT_ID_LEN];
+    uint8_t current[BME280_SNAPSHOT_BOOT_ID_LEN];
+    r_bytes(r, saved, sizeof(saved));
+    read_boot_id(current);
+    r->same_boot = memcmp(saved, current, sizeof(saved)) == 0;
+
+    /* Index the sections */
+    uint64_t at = HEADER_SIZE;
+    uint64_t body_end = size - TRAILER_SIZE;
+    while (at < body_end) {
+        if (r->sections == BME280_SNAPSHOT_MAX_SECTIONS || body_end - at < SECTION_HEADER_SIZE) {
+            bme280_snapshot_close(r);
+            return BME280_ERR_READ;
+        }
+        bme280_snapshot_entry_t *e = &r->entries[r->sections];
+        r_seek(r, at, SECTION_HEADER_SIZE);
+        e->type = r_u16(r);
+        e->version = r_u8(r);
+        (void)r_u8(r);
+        e->id = r_u32(r);
+        e->length = r_u32(r);
+        e->offset = at + SECTION_HEADER_SIZE;
+        if (r->short_read || e->length > body_end - e->offset) {
+            bme280_snapshot_close(r);
+            return BME280_ERR_READ;
+        }
+        at = e->offset + e->length;
+        r->sections++;
+    }
+
+    r_seek(r, body_end, 4);
+    if (r_u32(r) != r->sections) {
+        bme280_snapshot_close(r);
+        return BME280_ERR_READ;
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_snapshot_get_ctx(bme280_snapshot_reader_t *r, uint32_t id, bme280_ctx_t *ctx)
+{
+    if (r == NULL || ctx == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = r_find(r, BME280_SNAPSHOT_CTX, CTX_VERSION, id, CTX_SIZE);
+    if (err != BME280_OK) {
+        return err;
+    }
+
+    uint8_t regs[32];
+    r_bytes(r, regs, sizeof(regs));
+    int32_t t_fine = (int32_t)r_u32(r);
+    uint8_t ctrl_hum = r_u8(r);
+    uint8_t ctrl_meas = r_u8(r);
+    uint8_t config = r_u8(r);
+    (void)r_u8(r);
+    uint32_t ttl_us = r_u32(r);
+    if (r->short_read) {
+        return BME280_ERR_READ;
+    }
+
+    bme280_parse_calibration(&ctx->calib, regs, regs[24], regs + 25);
+    ctx->t_fine = t_fine;
+    ctx->ctrl_hum = ctrl_hum;
+    ctx->ctrl_meas = ctrl_meas;
+    ctx->config = config;
+    ctx->cache.ttl_us = ttl_us;
+    ctx->cache.valid = 0;
+    ctx->cache.odr_us = bme280_odr_period_us(ctx);
+    return BME280_OK;
+}
+
+bme280_error_t bme280_snapshot_get_slo(bme280_snapshot_reader_t *r, bme280_slo_t *slo)
+{
+    if (r == NULL || slo == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = r_find(r, BME280_SNAPSHOT_SLO, SLO_VERSION, 0, SLO_SIZE);
+    if (err != BME280_OK) {
+        return err;
+    }
+    if (!r->same_boot) {
+        return BME280_ERR_NOT_INIT;  /* Timestamps are from another monotonic clock */
+    }
+
+    uint16_t sensors = r_u16(r);
+    uint16_t buckets = r_u16(r);
+    uint16_t kinds = r_u16(r);
+    (void)r_u16(r);
+    if (sensors != BME280_SLO_MAX_SENSORS || buckets != BME280_SLO_BUCKETS
+        || kinds != BME280_SLO_KINDS) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    bme280_slo_config_t config;
+    config.window_us = r_u64(r);
+    config.short_window_us = r_u64(r);
+    config.burn_threshold = r_f32(r);
+    config.min_events = r_u32(r);
+    if (r->short_read) {
+        return BME280_ERR_READ;
+    }
+
+    /* Re-derive bucket geometry; the alert callback stays as initialized */
+    err = bme280_slo_init(slo, &config, slo->cb, slo->user);
+    if (err != BME280_OK) {
+        return err;
+    }
+
+    for (uint32_t i = 0; i < BME280_SLO_MAX_SENSORS; i++) {
+        bme280_slo_sensor_t *s = &slo->sensors[i];
+        s->budget.latency_budget_us = r_u32(r);
+        s->budget.freshness_budget_us = r_u32(r);
+        s->budget.objective = r_f32(r);
+        for (uint32_t b = 0; b < BME280_SLO_BUCKETS; b++) {
+            s->epoch[b] = r_u64(r);
+        }
+        for (uint32_t k = 0; k < BME280_SLO_KINDS; k++) {
+            for (uint32_t b = 0; b < BME280_SLO_BUCKETS; b++) {
+                s->good[k][b] = r_u32(r);
+                s->bad[k][b] = r_u32(r);
+            }
+        }
+        for (uint32_t k = 0; k < BME280_SLO_KINDS; k++) {
+            s->firing[k] = (int)r_u32(r);
+        }
+    }
+    return r->short_read ? BME280_ERR_READ : BME280_OK;
+}
+
+static bme280_error_t r_sketch(bme280_snapshot_reader_t *r, bme280_sketch_t *sk)
+{
+    bme280_sketch_t tmp;
+
+    double alpha = r_f64(r);
+    if (bme280_sketch_init(&tmp, alpha) != BME280_OK) {
+        return BME280_ERR_READ;
+    }
+    tmp.count = r_u64(r);
+    tmp.zeros = r_u64(r);
+    tmp.min = r_f64(r);
+    tmp.max = r_f64(r);
+    tmp.sum = r_f64(r);
+    if (r_u32(r) != BME280_SKETCH_BINS) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    bme280_sketch_store_t *stores[2] = { &tmp.positive, &tmp.negative };
+    for (int s = 0; s < 2; s++) {
+        stores[s]->offset = (int32_t)r_u32(r);
+        stores[s]->count = r_u64(r);
+        for (uint32_t i = 0; i < BME280_SKETCH_BINS; i++) {
+            stores[s]->bins[i] = r_u32(r);
+        }
+    }
+    if (r->short_read) {
+        return BME280_ERR_READ;
+    }
+
+    *sk = tmp;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_snapshot_get_sketch_set(bme280_snapshot_reader_t *r, uint32_t id,
+                                              bme280_sketch_set_t *set)
+{
+    if (r == NULL || set == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = r_find(r, BME280_SNAPSHOT_SKETCH_SET, SKETCH_VERSION, id, SKETCH_SET_SIZE);
+    if (err != BME280_OK) {
+        return err;
+    }
+    if (!r->same_boot) {
+        return BME280_ERR_NOT_INIT;  /* Timestamps are from another monotonic clock */
+    }
+
+    set->start_us = r_u64(r);
+    if ((err = r_sketch(r, &set->temperature)) != BME280_OK
+        || (err = r_sketch(r, &set->pressure)) != BME280_OK
+        || (err = r_sketch(r, &set->humidity)) != BME280_OK) {
+        return err;
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_snapshot_get_compress(bme280_snapshot_reader_t *r, uint32_t id,
+                                            bme280_compress_sample_t *cs)
+{
+    if (r == NULL || cs == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    bme280_error_t err = r_find(r, BME280_SNAPSHOT_COMPRESS, COMPRESS_VERSION, id, COMPRESS_SIZE);
+    if (err != BME280_OK) {
+        return err;
+    }
+    if (!r->same_boot) {
+        return BME280_ERR_NOT_INIT;  /* Timestamps are from another monotonic clock */
+    }
+
+    bme280_compress_sample_t tmp;
+    for (int ch = 0; ch < BME280_CHANNEL_COUNT; ch++) {
+        bme280_compressor_t *c = &tmp.channels[ch];
+        uint32_t mode = r_u32(r);
+        if (mode != BME280_COMPRESS_DEADBAND && mode != BME280_COMPRESS_SWINGING_DOOR) {
+            return BME280_ERR_INVALID_ARG;
+        }
+        c->mode = (bme280_compress_mode_t)mode;
+        c->deviation = r_f32(r);
+        c->max_interval_us = r_u64(r);
+        c->started = r_u8(r);
+        c->pending = r_u8(r);
+        (void)r_u16(r);
+        c->archived.timestamp_us = r_u64(r);
+        c->archived.value = r_f32(r);
+        c->held.timestamp_us = r_u64(r);
+        c->held.value = r_f32(r);
+        c->slope_max = r_f64(r);
+        c->slope_min = r_f64(r);
+        c->stats.points_in = r_u64(r);
+        c->stats.points_out = r_u64(r);
+    }
+    if (r->short_read) {
+        return BME280_ERR_READ;
+    }
+
+    *cs = tmp;
+    return BME280_OK;
+}
+
+void bme280_snapshot_close(bme280_snapshot_reader_t *r)
+{
+    if (r == NULL || r->fd < 0) {
+        return;
+    }
+
+    close(r->fd);
+    r->fd = -1;
+}
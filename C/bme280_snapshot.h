@@ -0,0 +1,220 @@
+/**
+ * BME280 Pipeline State Snapshots
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Saves per-sensor pipeline state to one versioned file so a restarted
+ * daemon resumes with warm state: calibration and shadow registers of
+ * each context, SLO windows, quantile sketch windows and compressor
+ * state. The file is written beside the target and renamed over it on
+ * commit, so a crash mid-write leaves the previous snapshot in place.
+ *
+ * File layout (little-endian):
+ *   header   u32 magic, u16 version, u16 reserved, 16-byte boot id
+ *   sections u16 type, u8 section version, u8 reserved, u32 id, u32 length,
+ *            then length bytes of fields in declaration order
+ *   trailer  u32 section count, u32 crc32 of everything before it
+ * Unknown section types are ignored on restore. Differential encoders are
+ * not saved: their decoder is elsewhere, so they restart with a keyframe.
+ * Timestamps are restored as saved; they stay comparable across a daemon
+ * restart on the same boot (bme280_time_us() is monotonic), but not across
+ * a reboot, which restarts the clock. The header records the kernel boot id
+ * and the time-bearing sections (SLO, sketch window, compressors) are not
+ * restored from a snapshot taken on another boot.
+ */
+
+#ifndef BME280_SNAPSHOT_H
+#define BME280_SNAPSHOT_H
+
+#include "bme280.h"
+#include "bme280_slo.h"
+#include "bme280_sketch.h"
+#include "bme280_compress.h"
+
+/*******************************************************************************
+ * Snapshot Constants
+ ******************************************************************************/
+
+#define BME280_SNAPSHOT_MAGIC         0x50383242u  /* "B28P" */
+#define BME280_SNAPSHOT_VERSION       2
+#define BME280_SNAPSHOT_BOOT_ID_LEN   16
+#define BME280_SNAPSHOT_PATH_LEN      256
+#define BME280_SNAPSHOT_MAX_SECTIONS  1024
+#define BME280_SNAPSHOT_BUFFER        4096
+
+/*******************************************************************************
+ * Snapshot Structures
+ ******************************************************************************/
+
+/**
+ * Section types
+ */
+typedef enum {
+    BME280_SNAPSHOT_CTX = 1,         /* Calibration, shadow registers, cache TTL */
+    BME280_SNAPSHOT_SLO,             /* Whole SLO monitor */
+    BME280_SNAPSHOT_SKETCH_SET,      /* One sensor's sketch window */
+    BME280_SNAPSHOT_COMPRESS         /* One sensor's compressors */
+} bme280_snapshot_section_t;
+
+/**
+ * Snapshot writer
+ */
+typedef struct {
+    int            fd;                               /* -1 if not open */
+    char           path[BME280_SNAPSHOT_PATH_LEN];   /* Target; written as path + ".tmp" */
+    uint32_t       crc;
+    uint32_t       sections;
+    uint32_t       fill;                             /* Bytes staged in buf */
+    bme280_error_t err;                              /* First write error, kept until commit */
+    uint8_t        buf[BME280_SNAPSHOT_BUFFER];
+} bme280_snapshot_writer_t;
+
+/**
+ * Location of one section in an open snapshot
+ */
+typedef struct {
+    uint16_t type;
+    uint8_t  version;
+    uint32_t id;
+    uint64_t offset;   /* First payload byte */
+    uint32_t length;
+} bme280_snapshot_entry_t;
+
+/**
+ * Snapshot reader
+ */
+typedef struct {
+    int                     fd;         /* -1 if not open */
+    uint32_t                sections;
+    int                     same_boot;  /* Saved on this boot: timestamps are comparable */
+    bme280_snapshot_entry_t entries[BME280_SNAPSHOT_MAX_SECTIONS];
+    uint64_t                pos;        /* Buffered read position */
+    uint64_t                end;        /* End of the section being decoded */
+    uint32_t                fill;
+    uint32_t                next;
+    int                     short_read;
+    uint8_t                 buf[BME280_SNAPSHOT_BUFFER];
+} bme280_snapshot_reader_t;
+
+/*******************************************************************************
+ * Snapshot API Functions
+ ******************************************************************************/
+
+/**
+ * Start writing a snapshot
+ * @param w    Pointer to writer (caller-allocated)
+ * @param path Snapshot file; replaced only by bme280_snapshot_commit()
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_snapshot_begin(bme280_snapshot_writer_t *w, const char *path);
+
+/**
+ * Save a context's calibration, shadow registers and cache TTL
+ * @param w   Pointer to writer
+ * @param id  Sensor id
+ * @param ctx Context with calibration read
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_snapshot_put_ctx(bme280_snapshot_writer_t *w, uint32_t id,
+                                       const bme280_ctx_t *ctx);
+
+/**
+ * Save an SLO monitor (configuration, budgets and windows)
+ * @param w   Pointer to writer
+ * @param slo SLO monitor
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_snapshot_put_slo(bme280_snapshot_writer_t *w, const bme280_slo_t *slo);
+
+/**
+ * Save a sketch window
+ * @param w   Pointer to writer
+ * @param id  Sensor id
+ * @param set Sketch set
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_snapshot_put_sketch_set(bme280_snapshot_writer_t *w, uint32_t id,
+                                              const bme280_sketch_set_t *set);
+
+/**
+ * Save the compressors of one sensor
+ * @param w  Pointer to writer
+ * @param id Sensor id
+ * @param cs Compressors
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_snapshot_put_compress(bme280_snapshot_writer_t *w, uint32_t id,
+                                            const bme280_compress_sample_t *cs);
+
+/**
+ * Finish the snapshot: write the trailer, sync and replace the target file
+ * @param w Pointer to writer
+ * @return BME280_OK on success, error code of the first failure otherwise
+ */
+bme280_error_t bme280_snapshot_commit(bme280_snapshot_writer_t *w);
+
+/**
+ * Discard an unfinished snapshot, leaving the previous one in place
+ * @param w Pointer to writer
+ */
+void bme280_snapshot_abort(bme280_snapshot_writer_t *w);
+
+/**
+ * Open a snapshot and verify its version and CRC
+ * @param r    Pointer to reader (caller-allocated)
+ * @param path Snapshot file
+ * @return BME280_OK on success, BME280_ERR_BUS_OPEN if missing,
+ *         BME280_ERR_READ if damaged, BME280_ERR_INVALID_ARG for another version
+ */
+bme280_error_t bme280_snapshot_open(bme280_snapshot_reader_t *r, const char *path);
+
+/**
+ * Restore a context's calibration, shadow registers and cache TTL
+ * The cached sample itself is not restored.
+ * @param r   Pointer to open reader
+ * @param id  Sensor id
+ * @param ctx Context to update (bus state is left alone)
+ * @return BME280_OK on success, BME280_ERR_NOT_INIT if the snapshot has no
+ *         such section, other error code on failure
+ */
+bme280_error_t bme280_snapshot_get_ctx(bme280_snapshot_reader_t *r, uint32_t id, bme280_ctx_t *ctx);
+
+/**
+ * Restore an SLO monitor; its alert callback is kept
+ * @param r   Pointer to open reader
+ * @param slo SLO monitor initialized with bme280_slo_init()
+ * @return BME280_OK on success, BME280_ERR_NOT_INIT if the snapshot has no
+ *         such section or was saved on another boot, other error code on failure
+ */
+bme280_error_t bme280_snapshot_get_slo(bme280_snapshot_reader_t *r, bme280_slo_t *slo);
+
+/**
+ * Restore a sketch window
+ * @param r   Pointer to open reader
+ * @param id  Sensor id
+ * @param set Sketch set to overwrite
+ * @return BME280_OK on success, BME280_ERR_NOT_INIT if the snapshot has no
+ *         such section or was saved on another boot, other error code on failure
+ */
+bme280_error_t bme280_snapshot_get_sketch_set(bme280_snapshot_reader_t *r, uint32_t id,
+                                              bme280_sketch_set_t *set);
+
+/**
+ * Restore the compressors of one sensor
+ * @param r  Pointer to open reader
+ * @param id Sensor id
+ * @param cs Compressors to overwrite
+ * @return BME280_OK on success, BME280_ERR_NOT_INIT if the snapshot has no
+ *         such section or was saved on another boot, other error code on failure
+ */
+bme280_error_t bme280_snapshot_get_compress(bme280_snapshot_reader_t *r, uint32_t id,
+                                            bme280_compress_sample_t *cs);
+
+/**
+ * Close the reader
+ * @param r Pointer to reader
+ */
+void bme280_snapshot_close(bme280_snapshot_reader_t *r);
+
+#endif /* BME280_SNAPSHOT_H */
@@ -0,0 +1,420 @@
+/**
+ * BME280 UDP Sample Stream Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+/* sendmmsg() and recvmmsg() are GNU extensions */
+#define _GNU_SOURCE
+
+#include "bme280_udp.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+ * Encoding Helpers
+ ******************************************************************************/
+
+static void put_le(uint8_t *p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/*******************************************************************************
+ * Sink Functions
+ ******************************************************************************/
+
+/* Differs between runs of a sender, so a receiver can tell a restart from a late frame */
+static uint32_t make_epoch(void)
+{
+    struct timespec rt;
+    struct timespec mono;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+
+    uint64_t x = (uint64_t)rt.tv_sec * 1000000000u + (uint64_t)rt.tv_nsec;
+    x ^= ((uint64_t)mono.tv_nsec << 32) ^ (uint64_t)getpid();
+    x = (x ^ (x >> 33)) * 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    return (uint32_t)x != 0 ? (uint32_t)x : 1u;
+}
+
+bme280_error_t bme280_udp_sink_init(bme280_udp_sink_t *sink, int fd,
+                                    const struct sockaddr *dest, socklen_t dest_len,
+                                    uint32_t stream, uint32_t per_frame)
+{
+    if (sink == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(sink, 0, sizeof(*sink));
+    sink->fd = fd;
+
+    if (fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (per_frame == 0 || per_frame > BME280_UDP_MAX_RECORDS
+        || (dest != NULL && dest_len > sizeof(sink->dest))) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    if (dest != NULL) {
+        memcpy(&sink->dest, dest, dest_len);
+        sink->dest_len = dest_len;
+    }
+    sink->stream = stream;
+    sink->per_frame = per_frame;
+    sink->epoch = make_epoch();
+    return BME280_OK;
+}
+
+static void seal_frame(bme280_udp_sink_t *sink)
+{
+    uint8_t *frame = sink->frames[sink->ready];
+
+    put_le(frame, BME280_UDP_MAGIC, 4);
+    put_le(frame + 4, BME280_UDP_VERSION, 2);
+    put_le(frame + 6, sink->count, 2);
+    put_le(frame + 8, sink->stream, 4);
+    put_le(frame + 12, sink->epoch, 4);
+    put_le(frame + 16, sink->sequence++, 8);
+    sink->lens[sink->ready++] = (uint16_t)(BME280_UDP_HEADER_SIZE + sink->count * BME280_LOG_RECORD_SIZE);
+    sink->count = 0;
+}
+
+static bme280_error_t send_ready(bme280_udp_sink_t *sink)
+{
+    struct mmsghdr msgs[BME280_UDP_MAX_BATCH];
+    struct iovec iov[BME280_UDP_MAX_BATCH];
+    uint32_t done = 0;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (uint32_t i = 0; i < sink->ready; i++) {
+        iov[i].iov_base = sink->frames[i];
+        iov[i].iov_len = sink->lens[i];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        if (sink->dest_len > 0) {
+            msgs[i].msg_hdr.msg_name = &sink->dest;
+            msgs[i].msg_hdr.msg_namelen = sink->dest_len;
+        }
+    }
+
+    while (done < sink->ready) {
+        int n = sendmmsg(sink->fd, msgs + done, sink->ready - done, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            /* Datagrams are best effort: drop the batch rather than wedge the sink */
+            sink->ready = 0;
+            return BME280_ERR_WRITE;
+        }
+        sink->stats.syscalls++;
+        done += (uint32_t)n;
+    }
+
+    sink->stats.frames += sink->ready;
+    sink->ready = 0;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_udp_sink_add(bme280_udp_sink_t *sink, const bme280_log_record_t *rec)
+{
+    if (sink == NULL || rec == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (sink->fd < 0 || sink->per_frame == 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    uint8_t *frame = sink->frames[sink->ready];
+    bme280_log_encode(rec, frame + BME280_UDP_HEADER_SIZE + sink->count * BME280_LOG_RECORD_SIZE);
+    sink->count++;
+    sink->stats.records++;
+
+    if (sink->count == sink->per_frame) {
+        seal_frame(sink);
+        if (sink->ready == BME280_UDP_MAX_BATCH) {
+            return send_ready(sink);
+        }
+    }
+    return BME280_OK;
+}
+
+bme280_error_t bme280_udp_sink_flush(bme280_udp_sink_t *sink)
+{
+    if (sink == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (sink->fd < 0 || sink->per_frame == 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (sink->count > 0) {
+        seal_frame(sink);
+    }
+    return sink->ready > 0 ? send_ready(sink) : BME280_OK;
+}
+
+/*******************************************************************************
+ * Receiver Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_udp_receiver_init(bme280_udp_receiver_t *rx, int fd, uint32_t window,
+                                        bme280_udp_record_cb_t cb, void *user)
+{
+    if (rx == NULL || cb == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(rx, 0, sizeof(*rx));
+    rx->fd = fd;
+
+    if (fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (window == 0 || window > BME280_UDP_MAX_WINDOW) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    rx->window = window;
+    rx->cb = cb;
+    rx->user = user;
+    return BME280_OK;
+}
+
+static void deliver(bme280_udp_receiver_t *rx, bme280_udp_stream_t *st, const uint8_t *frame)
+{
+    uint32_t count = (uint32_t)get_le(frame + 6, 2);
+
+    for (uint32_t i = 0; i < count; i++) {
+        bme280_log_record_t rec;
+        bme280_log_decode(frame + BME280_UDP_HEADER_SIZE + i * BME280_LOG_RECORD_SIZE, &rec);
+        rx->cb(rx->user, st->stream, st->next, &rec);
+    }
+    rx->stats.frames++;
+    rx->stats.records += count;
+    st->next++;
+}
+
+/* Move past st->next, delivering it if held and counting it lost otherwise */
+static void advance(bme280_udp_receiver_t *rx, bme280_udp_stream_t *st)
+{
+    uint32_t slot = (uint32_t)(st->next % rx->window);
+
+    if (st->lens[slot] != 0 && st->seqs[slot] == st->next) {
+        st->lens[slot] = 0;
+        st->held--;
+        deliver(rx, st, st->slots[slot]);
+    } else {
+        rx->stats.lost++;
+        st->next++;
+    }
+}
+
+/* Deliver held frames that are now in order */
+static void drain(bme280_udp_receiver_t *rx, bme280_udp_stream_t *st)
+{
+    for (;;) {
+        uint32_t slot = (uint32_t)(st->next % rx->window);
+        if (st->lens[slot] == 0 || st->seqs[slot] != st->next) {
+            return;
+        }
+        advance(rx, st);
+    }
+}
+
+static bme280_udp_stream_t *find_stream(bme280_udp_receiver_t *rx, uint32_t stream,
+                                        uint32_t epoch, uint64_t seq)
+{
+    bme280_udp_stream_t *free_slot = NULL;
+
+    for (uint32_t i = 0; i < BME280_UDP_MAX_STREAMS; i++) {
+        bme280_udp_stream_t *st = &rx->streams[i];
+        if (st->active && st->stream == stream) {
+            return st;
+        }
+        if (!st->active && free_slot == NULL) {
+            free_slot = st;
+        }
+    }
+
+    if (free_slot != NULL) {
+        free_slot->active = 1;
+        free_slot->stream = stream;
+        free_slot->epoch = epoch;
+        free_slot->prev_epoch = epoch;
+        free_slot->next = seq;
+    }
+    return free_slot;
+}
+
+static void accept_frame(bme280_udp_receiver_t *rx, const uint8_t *frame, size_t len)
+{
+    if (len < BME280_UDP_HEADER_SIZE
+        || get_le(frame, 4) != BME280_UDP_MAGIC
+        || get_le(frame + 4, 2) != BME280_UDP_VERSION) {
+        rx->stats.corrupt++;
+        return;
+    }
+
+    uint32_t count = (uint32_t)get_le(frame + 6, 2);
+    if (count > BME280_UDP_MAX_RECORDS
+        || len != BME280_UDP_HEADER_SIZE + count * BME280_LOG_RECORD_SIZE) {
+        rx->stats.corrupt++;
+        return;
+    }
+
+    /* Check every record now so delivery cannot fail part-way through a frame */
+    for (uint32_t i = 0; i < count; i++) {
+        bme280_log_record_t rec;
+        if (bme280_log_decode(frame + BME280_UDP_HEADER_SIZE + i * BME280_LOG_RECORD_SIZE, &rec)
+            != BME280_OK) {
+            rx->stats.corrupt++;
+            return;
+        }
+    }
+
+    uint32_t epoch = (uint32_t)get_le(frame + 12, 4);
+    uint64_t seq = get_le(frame + 16, 8);
+    bme280_udp_stream_t *st = find_stream(rx, (uint32_t)get_le(frame + 8, 4), epoch, seq);
+    if (st == NULL) {
+        rx->stats.corrupt++;
+        return;
+    }
+
+    /* The sender restarted its sequence: finish the old run and follow the new one */
+    if (epoch != st->epoch) {
+        if (epoch == st->prev_epoch) {
+            rx->stats.late++;
+            return;
+        }
+        while (st->held > 0) {
+            advance(rx, st);
+        }
+        st->prev_epoch = st->epoch;
+        st->epoch = epoch;
+        st->next = seq;
+        rx->stats.restarts++;
+    }
+
+    if (seq < st->next) {
+        rx->stats.late++;
+        return;
+    }
+
+    /* Too far ahead: deliver what is held, then skip the rest of the gap in one step */
+    if (seq - st->next >= rx->window) {
+        while (st->held > 0) {
+            advance(rx, st);
+        }
+        uint64_t first = seq - rx->window + 1;
+        if (st->next < first) {
+            rx->stats.lost += first - st->next;
+            st->next = first;
+        }
+    }
+
+    if (seq == st->next) {
+        deliver(rx, st, frame);
+        drain(rx, st);
+        return;
+    }
+
+    uint32_t slot = (uint32_t)(seq % rx->window);
+    if (st->lens[slot] != 0) {
+        rx->stats.late++;
+        return;
+    }
+    memcpy(st->slots[slot], frame, len);
+    st->lens[slot] = (uint16_t)len;
+    st->seqs[slot] = seq;
+    st->held++;
+    rx->stats.reordered++;
+}
+
+bme280_error_t bme280_udp_receiver_poll(bme280_udp_receiver_t *rx, int timeout_ms)
+{
+    struct mmsghdr msgs[BME280_UDP_MAX_BATCH];
+    struct iovec iov[BME280_UDP_MAX_BATCH];
+
+    if (rx == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (rx->fd < 0 || rx->window == 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    struct pollfd pfd = { rx->fd, POLLIN, 0 };
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready < 0) {
+        return errno == EINTR ? BME280_OK : BME280_ERR_READ;
+    }
+
+    while (ready > 0) {
+        memset(msgs, 0, sizeof(msgs));
+        for (uint32_t i = 0; i < BME280_UDP_MAX_BATCH; i++) {
+            iov[i].iov_base = rx->rx[i];
+            iov[i].iov_len = BME280_UDP_FRAME_MAX;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = recvmmsg(rx->fd, msgs, BME280_UDP_MAX_BATCH, MSG_DONTWAIT, NULL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                break;
+            }
+            return BME280_ERR_READ;
+        }
+        rx->stats.syscalls++;
+
+        for (int i = 0; i < n; i++) {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                rx->stats.corrupt++;
+                continue;
+            }
+            accept_frame(rx, rx->rx[i], msgs[i].msg_len);
+        }
+        if (n < BME280_UDP_MAX_BATCH) {
+            break;
+        }
+    }
+    return BME280_OK;
+}
+
+void bme280_udp_receiver_flush(bme280_udp_receiver_t *rx)
+{
+    if (rx == NULL || rx->window == 0) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < BME280_UDP_MAX_STREAMS; i++) {
+        bme280_udp_stream_t *st = &rx->streams[i];
+        while (st->active && st->held > 0) {
+            advance(rx, st);
+        }
+    }
+}
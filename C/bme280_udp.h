@@ -0,0 +1,188 @@
+/**
+ * BME280 UDP Sample Stream
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Batched datagram stream from gateways to an aggregator. The sink packs
+ * log records into frames that fit one Ethernet MTU, numbers each frame
+ * with a per-stream sequence and hands up to BME280_UDP_MAX_BATCH frames
+ * to the kernel in one sendmmsg() call. Destinations may be unicast or
+ * multicast; the caller creates and configures the socket.
+ *
+ * The receiver drains up to BME280_UDP_MAX_BATCH datagrams per
+ * recvmmsg() call, restores sequence order within a reorder window per
+ * stream and counts the frames that never arrived. Each sink run stamps
+ * its frames with a fresh epoch; when a stream's epoch changes (the
+ * sender restarted and its sequence began again at 0) the receiver
+ * delivers what it held from the old run and follows the new one.
+ *
+ * Frame layout (little-endian):
+ *   header  u32 magic, u16 version, u16 count, u32 stream, u32 epoch,
+ *           u64 sequence
+ *   records count x BME280_LOG_RECORD_SIZE bytes (see bme280_log.h)
+ */
+
+#ifndef BME280_UDP_H
+#define BME280_UDP_H
+
+#include "bme280_log.h"
+
+#include <sys/socket.h>
+
+/*******************************************************************************
+ * UDP Stream Constants
+ ******************************************************************************/
+
+#define BME280_UDP_MAGIC        0x55383242u  /* "B28U" */
+#define BME280_UDP_VERSION      1
+#define BME280_UDP_HEADER_SIZE  24
+#define BME280_UDP_MAX_RECORDS  43   /* Records per frame: 24 + 43 * 32 = 1400 bytes */
+#define BME280_UDP_FRAME_MAX    (BME280_UDP_HEADER_SIZE + BME280_UDP_MAX_RECORDS * BME280_LOG_RECORD_SIZE)
+#define BME280_UDP_MAX_BATCH    16   /* Frames per sendmmsg/recvmmsg call */
+#define BME280_UDP_MAX_STREAMS  16   /* Senders tracked by one receiver */
+#define BME280_UDP_MAX_WINDOW   16   /* Upper bound on the reorder window */
+
+/*******************************************************************************
+ * UDP Stream Structures
+ ******************************************************************************/
+
+/**
+ * Sink counters
+ */
+typedef struct {
+    uint64_t records;    /* Records queued */
+    uint64_t frames;     /* Frames sent */
+    uint64_t syscalls;   /* sendmmsg calls */
+} bme280_udp_sink_stats_t;
+
+/**
+ * Sending side
+ */
+typedef struct {
+    int                     fd;         /* Datagram socket */
+    struct sockaddr_storage dest;       /* Destination (unused if dest_len is 0) */
+    socklen_t               dest_len;
+    uint32_t                stream;     /* Stream identifier of this sender */
+    uint32_t                epoch;      /* Run identifier, new per init (may be overridden) */
+    uint32_t                per_frame;  /* Records per frame */
+    uint64_t                sequence;   /* Sequence of the frame being filled */
+    uint32_t                ready;      /* Sealed frames waiting for sendmmsg */
+    uint32_t                count;      /* Records in the frame being filled */
+    uint16_t                lens[BME280_UDP_MAX_BATCH];
+    uint8_t                 frames[BME280_UDP_MAX_BATCH][BME280_UDP_FRAME_MAX];
+    bme280_udp_sink_stats_t stats;
+} bme280_udp_sink_t;
+
+/**
+ * Called for each record, in sequence order per stream
+ */
+typedef void (*bme280_udp_record_cb_t)(void *user, uint32_t stream, uint64_t sequence,
+                                       const bme280_log_record_t *rec);
+
+/**
+ * Receiver counters
+ */
+typedef struct {
+    uint64_t frames;     /* Frames delivered */
+    uint64_t records;    /* Records delivered */
+    uint64_t lost;       /* Frames skipped as missing */
+    uint64_t reordered;  /* Frames held back until their predecessors arrived */
+    uint64_t late;       /* Duplicates and frames that arrived after being skipped */
+    uint64_t restarts;   /* Streams that started over with a new epoch */
+    uint64_t corrupt;    /* Malformed frames or records with a bad CRC */
+    uint64_t syscalls;   /* recvmmsg calls */
+} bme280_udp_rx_stats_t;
+
+/**
+ * Per-stream reorder state
+ */
+typedef struct {
+    uint32_t stream;
+    int      active;
+    uint32_t epoch;       /* Sender run being followed */
+    uint32_t prev_epoch;  /* Run before it; its stragglers count as late */
+    uint64_t next;      /* Next sequence to deliver */
+    uint32_t held;      /* Frames waiting in slots */
+    uint16_t lens[BME280_UDP_MAX_WINDOW];   /* 0 = slot empty */
+    uint64_t seqs[BME280_UDP_MAX_WINDOW];
+    uint8_t  slots[BME280_UDP_MAX_WINDOW][BME280_UDP_FRAME_MAX];
+} bme280_udp_stream_t;
+
+/**
+ * Receiving side
+ */
+typedef struct {
+    int                    fd;        /* Bound datagram socket */
+    uint32_t               window;    /* Reorder window in frames */
+    bme280_udp_record_cb_t cb;
+    void                  *user;
+    bme280_udp_stream_t    streams[BME280_UDP_MAX_STREAMS];
+    uint8_t                rx[BME280_UDP_MAX_BATCH][BME280_UDP_FRAME_MAX];
+    bme280_udp_rx_stats_t  stats;
+} bme280_udp_receiver_t;
+
+/*******************************************************************************
+ * Sink API Functions
+ ******************************************************************************/
+
+/**
+ * Initialize a sink
+ * @param sink      Pointer to sink (caller-allocated)
+ * @param fd        Datagram socket
+ * @param dest      Destination address, or NULL if fd is connected
+ * @param dest_len  Size of dest
+ * @param stream    Stream identifier, unique per sender
+ * @param per_frame Records per frame (1..BME280_UDP_MAX_RECORDS)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_udp_sink_init(bme280_udp_sink_t *sink, int fd,
+                                    const struct sockaddr *dest, socklen_t dest_len,
+                                    uint32_t stream, uint32_t per_frame);
+
+/**
+ * Queue a record; full frames are sent once a batch of them is ready
+ * @param sink Pointer to initialized sink
+ * @param rec  Record to send
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_udp_sink_add(bme280_udp_sink_t *sink, const bme280_log_record_t *rec);
+
+/**
+ * Seal the partial frame and send every queued frame
+ * @param sink Pointer to initialized sink
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_udp_sink_flush(bme280_udp_sink_t *sink);
+
+/*******************************************************************************
+ * Receiver API Functions
+ ******************************************************************************/
+
+/**
+ * Initialize a receiver
+ * @param rx     Pointer to receiver (caller-allocated)
+ * @param fd     Bound datagram socket
+ * @param window Reorder window in frames (1..BME280_UDP_MAX_WINDOW)
+ * @param cb     Record callback
+ * @param user   Passed to cb
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_udp_receiver_init(bme280_udp_receiver_t *rx, int fd, uint32_t window,
+                                        bme280_udp_record_cb_t cb, void *user);
+
+/**
+ * Receive pending datagrams and deliver records that are in order
+ * @param rx         Pointer to initialized receiver
+ * @param timeout_ms Longest wait for the first datagram (0 = don't wait)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_udp_receiver_poll(bme280_udp_receiver_t *rx, int timeout_ms);
+
+/**
+ * Give up on missing frames and deliver everything held back
+ * @param rx Pointer to initialized receiver
+ */
+void bme280_udp_receiver_flush(bme280_udp_receiver_t *rx);
+
+#endif /* BME280_UDP_H */
@@ -0,0 +1,388 @@
+/**
+ * BME280 Store-and-Forward Uplink Implementation
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bme280_uplink.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define UPLINK_BATCH_BYTES_MAX  (BME280_UPLINK_MAX_BATCH * BME280_LOG_RECORD_SIZE)
+#define UPLINK_SIDECAR_SIZE     12  /* u64 offset + u32 crc32 */
+
+/*******************************************************************************
+ * Encoding Helpers
+ ******************************************************************************/
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*******************************************************************************
+ * Transport Helpers
+ ******************************************************************************/
+
+static int send_all(int fd, const uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = recv(fd, buf, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void persist_ack(bme280_uplink_t *up)
+{
+    uint8_t buf[UPLINK_SIDECAR_SIZE];
+
+    put_u64(buf, up->acked);
+    put_u32(buf + 8, bme280_crc32(0, buf, 8));
+    /* A lost update only costs a resend; the collector drops the overlap */
+    if (pwrite(up->ack_fd, buf, sizeof(buf), 0) != (ssize_t)sizeof(buf)) {
+        return;
+    }
+}
+
+static void handle_ack(bme280_uplink_t *up, uint64_t end)
+{
+    up->stats.acks++;
+
+    while (up->inflight > 0 && up->ends[up->head] <= end) {
+        up->head = (up->head + 1) % BME280_UPLINK_MAX_INFLIGHT;
+        up->inflight--;
+    }
+    if (end > up->acked) {
+        up->acked = end;
+        persist_ack(up);
+    }
+    /* The collector already holds more than we sent: skip ahead */
+    if (end > up->sent) {
+        up->sent = end;
+    }
+}
+
+static bme280_error_t send_batch(bme280_uplink_t *up, uint64_t log_bytes)
+{
+    uint8_t buf[BME280_UPLINK_HEADER_SIZE + UPLINK_BATCH_BYTES_MAX];
+    uint64_t len = log_bytes - up->sent;
+    uint64_t max = (uint64_t)up->config.batch_records * BME280_LOG_RECORD_SIZE;
+    if (len > max) {
+        len = max;
+    }
+
+    ssize_t got = pread(up->log->fd, buf + BME280_UPLINK_HEADER_SIZE, (size_t)len, (off_t)up->sent);
+    if (got != (ssize_t)len) {
+        return BME280_ERR_READ;
+    }
+
+    put_u64(buf, up->sent);
+    put_u32(buf + 8, (uint32_t)len);
+    if (send_all(up->fd, buf, BME280_UPLINK_HEADER_SIZE + (size_t)len) != 0) {
+        return BME280_ERR_WRITE;
+    }
+
+    up->sent += len;
+    up->ends[(up->head + up->inflight) % BME280_UPLINK_MAX_INFLIGHT] = up->sent;
+    up->inflight++;
+    up->stats.batches++;
+    up->stats.bytes += len;
+    return BME280_OK;
+}
+
+/*******************************************************************************
+ * Uplink API Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_uplink_open(bme280_uplink_t *up, bme280_log_t *log,
+                                  const char *ack_path, const bme280_uplink_config_t *config)
+{
+    if (up == NULL || log == NULL || ack_path == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(up, 0, sizeof(*up));
+    up->fd = -1;
+    up->ack_fd = -1;
+    up->log = log;
+    up->config.batch_records = 64;
+    up->config.max_inflight = 4;
+    if (config != NULL) {
+        up->config = *config;
+    }
+
+    if (log->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    if (up->config.batch_records == 0 || up->config.batch_records > BME280_UPLINK_MAX_BATCH
+        || up->config.max_inflight == 0 || up->config.max_inflight > BME280_UPLINK_MAX_INFLIGHT) {
+        return BME280_ERR_INVALID_ARG;
+    }
+
+    int fd = open(ack_path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return BME280_ERR_BUS_OPEN;
+    }
+
+    /* A missing or damaged sidecar means nothing was acknowledged */
+    uint8_t buf[UPLINK_SIDECAR_SIZE];
+    if (pread(fd, buf, sizeof(buf), 0) == (ssize_t)sizeof(buf)
+        && get_u32(buf + 8) == bme280_crc32(0, buf, 8)) {
+        uint64_t log_bytes = bme280_log_count(log) * BME280_LOG_RECORD_SIZE;
+        up->acked = get_u64(buf);
+        up->acked -= up->acked % BME280_LOG_RECORD_SIZE;
+        if (up->acked > log_bytes) {
+            up->acked = log_bytes;
+        }
+    }
+
+    up->ack_fd = fd;
+    up->sent = up->acked;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_uplink_connect(bme280_uplink_t *up, int fd)
+{
+    if (up == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (up->ack_fd < 0 || fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    bme280_uplink_disconnect(up);
+    up->fd = fd;
+    up->sent = up->acked;
+    up->head = 0;
+    up->inflight = 0;
+    up->rx_len = 0;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_uplink_pump(bme280_uplink_t *up, int timeout_ms)
+{
+    if (up == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (up->fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    uint64_t log_bytes = bme280_log_count(up->log) * BME280_LOG_RECORD_SIZE;
+    while (up->inflight < up->config.max_inflight && up->sent < log_bytes) {
+        bme280_error_t err = send_batch(up, log_bytes);
+        if (err != BME280_OK) {
+            return err;
+        }
+    }
+
+    if (up->inflight == 0) {
+        return BME280_OK;
+    }
+
+    struct pollfd pfd = { up->fd, POLLIN, 0 };
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready < 0 && errno != EINTR) {
+        return BME280_ERR_READ;
+    }
+
+    /* Drain every acknowledgement that has arrived */
+    while (ready > 0) {
+        ssize_t n = recv(up->fd, up->rx + up->rx_len, sizeof(up->rx) - up->rx_len, MSG_DONTWAIT);
+        if (n == 0) {
+            return BME280_ERR_READ;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                break;
+            }
+            return BME280_ERR_READ;
+        }
+        up->rx_len += (uint32_t)n;
+        if (up->rx_len == sizeof(up->rx)) {
+            handle_ack(up, get_u64(up->rx));
+            up->rx_len = 0;
+        }
+    }
+    return BME280_OK;
+}
+
+uint64_t bme280_uplink_pending(bme280_uplink_t *up)
+{
+    if (up == NULL || up->log == NULL) {
+        return 0;
+    }
+
+    uint64_t log_bytes = bme280_log_count(up->log) * BME280_LOG_RECORD_SIZE;
+    return log_bytes > up->acked ? log_bytes - up->acked : 0;
+}
+
+void bme280_uplink_disconnect(bme280_uplink_t *up)
+{
+    if (up == NULL || up->fd < 0) {
+        return;
+    }
+
+    close(up->fd);
+    up->fd = -1;
+}
+
+void bme280_uplink_close(bme280_uplink_t *up)
+{
+    if (up == NULL) {
+        return;
+    }
+
+    bme280_uplink_disconnect(up);
+    if (up->ack_fd >= 0) {
+        close(up->ack_fd);
+        up->ack_fd = -1;
+    }
+}
+
+/*******************************************************************************
+ * Reference Collector API Functions
+ ******************************************************************************/
+
+bme280_error_t bme280_collector_open(bme280_collector_t *col, const char *path)
+{
+    if (col == NULL || path == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    memset(col, 0, sizeof(*col));
+    bme280_error_t err = bme280_log_open(&col->log, path);
+    if (err != BME280_OK) {
+        return err;
+    }
+
+    col->end = col->log.count * BME280_LOG_RECORD_SIZE;
+    return BME280_OK;
+}
+
+bme280_error_t bme280_collector_serve(bme280_collector_t *col, int fd)
+{
+    uint8_t hdr[BME280_UPLINK_HEADER_SIZE];
+    uint8_t buf[UPLINK_BATCH_BYTES_MAX];
+
+    if (col == NULL) {
+        return BME280_ERR_NULL_PTR;
+    }
+
+    if (col->log.fd < 0 || fd < 0) {
+        return BME280_ERR_NOT_INIT;
+    }
+
+    while (recv_all(fd, hdr, sizeof(hdr)) == 0) {
+        uint64_t offset = get_u64(hdr);
+        uint32_t len = get_u32(hdr + 8);
+
+        /* Batches are whole records and may only overlap what is stored */
+        if (len == 0 || len > sizeof(buf) || len % BME280_LOG_RECORD_SIZE != 0
+            || offset % BME280_LOG_RECORD_SIZE != 0 || offset > col->end) {
+            return BME280_ERR_INVALID_ARG;
+        }
+        if (recv_all(fd, buf, len) != 0) {
+            return BME280_ERR_READ;
+        }
+
+        uint64_t skip = col->end - offset;
+        if (skip > len) {
+            skip = len;
+        }
+        for (uint32_t i = (uint32_t)skip; i < len; i += BME280_LOG_RECORD_SIZE) {
+            bme280_log_record_t rec;
+            if (bme280_log_decode(buf + i, &rec) != BME280_OK) {
+                return BME280_ERR_READ;
+            }
+        }
+
+        if (skip < len) {
+            size_t fresh = len - (size_t)skip;
+            if (write(col->log.fd, buf + skip, fresh) != (ssize_t)fresh
+                || bme280_log_sync(&col->log) != BME280_OK) {
+                /* Back to the acknowledged end, so the resent batch is not stored twice */
+                int trimmed = ftruncate(col->log.fd, (off_t)col->end);
+                (void)trimmed;
+                return BME280_ERR_WRITE;
+            }
+            col->end += fresh;
+            col->log.count += fresh / BME280_LOG_RECORD_SIZE;
+            col->stats.bytes += fresh;
+        }
+        col->stats.batches++;
+        col->stats.duplicates += skip;
+
+        uint8_t ack[8];
+        put_u64(ack, col->end);
+        if (send_all(fd, ack, sizeof(ack)) != 0) {
+            return BME280_ERR_WRITE;
+        }
+    }
+    return BME280_OK;
+}
+
+void bme280_collector_close(bme280_collector_t *col)
+{
+    if (col != NULL) {
+        bme280_log_close(&col->log);
+    }
+}
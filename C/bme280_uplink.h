@@ -0,0 +1,169 @@
+/**
+ * BME280 Store-and-Forward Uplink
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Streams a sample log to a collector over a stream socket. The uplink
+ * sends the log as batches tagged with their byte offset and keeps up to
+ * max_inflight batches unacknowledged. The collector appends each batch
+ * durably and replies with the byte offset its copy now ends at. The uplink
+ * persists the highest acknowledged offset in a small sidecar file, so
+ * after a disconnect or restart it resumes from that offset without
+ * rescanning the log. Bytes the collector already holds (an acknowledgement
+ * lost before it was persisted) are dropped by the collector, so its copy
+ * never contains duplicates.
+ *
+ * Wire format (little-endian):
+ *   uplink -> collector  u64 offset, u32 length, length bytes of log records
+ *   collector -> uplink  u64 end offset after the batch was stored
+ */
+
+#ifndef BME280_UPLINK_H
+#define BME280_UPLINK_H
+
+#include "bme280_log.h"
+
+/*******************************************************************************
+ * Uplink Constants
+ ******************************************************************************/
+
+#define BME280_UPLINK_MAX_INFLIGHT  16   /* Upper bound on unacknowledged batches */
+#define BME280_UPLINK_MAX_BATCH     128  /* Upper bound on records per batch */
+#define BME280_UPLINK_HEADER_SIZE   12   /* Batch header bytes */
+
+/*******************************************************************************
+ * Uplink Structures
+ ******************************************************************************/
+
+/**
+ * Uplink limits
+ */
+typedef struct {
+    uint32_t batch_records;   /* Records per batch (1..128) */
+    uint32_t max_inflight;    /* Unacknowledged batches (1..16) */
+} bme280_uplink_config_t;
+
+/**
+ * Uplink counters
+ */
+typedef struct {
+    uint64_t batches;   /* Batches sent */
+    uint64_t bytes;     /* Record bytes sent */
+    uint64_t acks;      /* Acknowledgements received */
+} bme280_uplink_stats_t;
+
+/**
+ * Uplink state
+ */
+typedef struct {
+    int                    fd;        /* Collector socket (-1 if disconnected) */
+    int                    ack_fd;    /* Sidecar holding the acknowledged offset */
+    bme280_log_t          *log;       /* Source log */
+    bme280_uplink_config_t config;
+    uint64_t               acked;     /* Bytes acknowledged by the collector */
+    uint64_t               sent;      /* Bytes sent on this connection */
+    uint64_t               ends[BME280_UPLINK_MAX_INFLIGHT];  /* End offsets in flight */
+    uint32_t               head;      /* Oldest in-flight batch */
+    uint32_t               inflight;  /* Batches awaiting acknowledgement */
+    uint32_t               rx_len;    /* Buffered acknowledgement bytes */
+    uint8_t                rx[8];
+    bme280_uplink_stats_t  stats;
+} bme280_uplink_t;
+
+/**
+ * Collector counters
+ */
+typedef struct {
+    uint64_t batches;     /* Batches received */
+    uint64_t bytes;       /* New bytes stored */
+    uint64_t duplicates;  /* Bytes dropped because they were already stored */
+} bme280_collector_stats_t;
+
+/**
+ * Reference collector state
+ */
+typedef struct {
+    bme280_log_t             log;  /* Collector copy of the log */
+    uint64_t                 end;  /* Bytes stored */
+    bme280_collector_stats_t stats;
+} bme280_collector_t;
+
+/*******************************************************************************
+ * Uplink API Functions
+ ******************************************************************************/
+
+/**
+ * Open an uplink over a log, loading the acknowledged offset from its sidecar
+ * @param up       Pointer to uplink (caller-allocated)
+ * @param log      Open source log (must outlive the uplink)
+ * @param ack_path Sidecar file path (created if missing)
+ * @param config   Limits; NULL selects 64-record batches, 4 in flight
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_uplink_open(bme280_uplink_t *up, bme280_log_t *log,
+                                  const char *ack_path, const bme280_uplink_config_t *config);
+
+/**
+ * Start streaming on a connected collector socket from the acknowledged offset
+ * @param up Pointer to open uplink
+ * @param fd Connected stream socket
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_uplink_connect(bme280_uplink_t *up, int fd);
+
+/**
+ * Send batches until the window is full, then collect acknowledgements
+ * @param up         Pointer to connected uplink
+ * @param timeout_ms Longest wait for an acknowledgement (0 = don't wait)
+ * @return BME280_OK on success, BME280_ERR_READ/WRITE if the connection failed
+ */
+bme280_error_t bme280_uplink_pump(bme280_uplink_t *up, int timeout_ms);
+
+/**
+ * Get the number of log bytes not yet acknowledged
+ * @param up Pointer to open uplink
+ * @return Pending bytes
+ */
+uint64_t bme280_uplink_pending(bme280_uplink_t *up);
+
+/**
+ * Drop the collector connection, keeping the acknowledged offset
+ * @param up Pointer to uplink
+ */
+void bme280_uplink_disconnect(bme280_uplink_t *up);
+
+/**
+ * Disconnect and close the sidecar
+ * @param up Pointer to uplink
+ */
+void bme280_uplink_close(bme280_uplink_t *up);
+
+/*******************************************************************************
+ * Reference Collector API Functions
+ ******************************************************************************/
+
+/**
+ * Open the collector's copy of the log
+ * @param col  Pointer to collector (caller-allocated)
+ * @param path File path (created if missing)
+ * @return BME280_OK on success, error code on failure
+ */
+bme280_error_t bme280_collector_open(bme280_collector_t *col, const char *path);
+
+/**
+ * Serve one uplink connection until it closes
+ * @param col Pointer to open collector
+ * @param fd  Connected stream socket
+ * @return BME280_OK when the uplink disconnected cleanly, error code on a
+ *         protocol violation or storage failure
+ */
+bme280_error_t bme280_collector_serve(bme280_collector_t *col, int fd);
+
+/**
+ * Close the collector
+ * @param col Pointer to collector
+ */
+void bme280_collector_close(bme280_collector_t *col);
+
+#endif /* BME280_UPLINK_H */
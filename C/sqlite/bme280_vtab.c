@@ -0,0 +1,513 @@
+/**
+ * BME280 Segment Virtual Table (SQLite loadable extension)
+ *
+ * Distributed with a free-will license.
+ * Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+ *
+ * Exposes raw sample segments (bme280_segment.h) as a read-only table:
+ *
+ *   .load ./bme280_vtab sqlite3_bme280_init
+ *   CREATE VIRTUAL TABLE samples USING bme280_segments('a.seg', 'b.seg');
+ *   SELECT sensor, avg(temperature_c) FROM samples
+ *    WHERE ts_us BETWEEN 1000000 AND 2000000 AND sensor = 3;
+ *
+ * Columns: ts_us, sensor, temperature_c, temperature_f, pressure_hpa,
+ * humidity_rh, adc_t, adc_p, adc_h. Bounds on ts_us and sensor are passed
+ * to the segment reader, which skips whole blocks outside them; SQLite
+ * still re-checks every constraint. Values are compensated only when a
+ * compensated column is actually read.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <sqlite3ext.h>
+SQLITE_EXTENSION_INIT1
+
+#include "bme280_segment.h"
+
+#include <math.h>
+#include <string.h>
+
+/*******************************************************************************
+ * Table Definitions
+ ******************************************************************************/
+
+enum {
+    COL_TS_US = 0,
+    COL_SENSOR,
+    COL_TEMPERATURE_C,
+    COL_TEMPERATURE_F,
+    COL_PRESSURE_HPA,
+    COL_HUMIDITY_RH,
+    COL_ADC_T,
+    COL_ADC_P,
+    COL_ADC_H
+};
+
+static const char schema[] =
+    "CREATE TABLE x(ts_us INTEGER, sensor INTEGER, temperature_c REAL, temperature_f REAL,"
+    " pressure_hpa REAL, humidity_rh REAL, adc_t INTEGER, adc_p INTEGER, adc_h INTEGER)";
+
+/* Pushed-down bounds, one argv value each, in this order */
+enum {
+    BOUND_TS_EQ = 0,
+    BOUND_TS_MIN,
+    BOUND_TS_MAX,
+    BOUND_SENSOR_EQ,
+    BOUND_SENSOR_MIN,
+    BOUND_SENSOR_MAX,
+    BOUND_COUNT
+};
+
+static const char *const bound_names[BOUND_COUNT] = {
+    "ts=", "ts>", "ts<", "sensor=", "sensor>", "sensor<"
+};
+
+typedef struct {
+    sqlite3_vtab base;
+    int          count;    /* Number of segment files */
+    char       **paths;
+} segment_vtab_t;
+
+typedef struct {
+    sqlite3_vtab_cursor     base;
+    bme280_segment_reader_t reader;
+    int                     segment;     /* Index of the open segment, -1 if none */
+    bme280_segment_query_t  query;
+    int                     eof;
+    sqlite3_int64           rowid;
+    bme280_segment_record_t rec;
+    int                     compensated; /* data is valid for rec */
+    bme280_data_t           data;
+} segment_cursor_t;
+
+/*******************************************************************************
+ * Table Lifetime
+ ******************************************************************************/
+
+static void free_vtab(segment_vtab_t *vt)
+{
+    for (int i = 0; i < vt->count; i++) {
+        sqlite3_free(vt->paths[i]);
+    }
+    sqlite3_free(vt->paths);
+    sqlite3_free(vt);
+}
+
+/* Strip one level of SQL quoting from a module argument */
+static char *unquote(const char *arg)
+{
+    size_t len = strlen(arg);
+    char quote = arg[0];
+
+    if (len < 2 || (quote != '\'' && quote != '"') || arg[len - 1] != quote) {
+        return sqlite3_mprintf("%s", arg);
+    }
+
+    char *out = sqlite3_malloc64(len);
+    if (out == NULL) {
+        return NULL;
+    }
+    size_t n = 0;
+    for (size_t i = 1; i < len - 1; i++) {
+        out[n++] = arg[i];
+        if (arg[i] == quote && arg[i + 1] == quote) {
+            i++;
+        }
+    }
+    out[n] = '\0';
+    return out;
+}
+
+static int segment_connect(sqlite3 *db, void *aux, int argc, const char *const *argv,
+                           sqlite3_vtab **out, char **err)
+{
+    (void)aux;
+
+    if (argc < 4) {
+        *err = sqlite3_mprintf("bme280_segments: at least one segment path is required");
+        return SQLITE_ERROR;
+    }
+
+    segment_vtab_t *vt = sqlite3_malloc(sizeof(*vt));
+    if (vt == NULL) {
+        return SQLITE_NOMEM;
+    }
+    memset(vt, 0, sizeof(*vt));
+
+    vt->paths = sqlite3_malloc64(sizeof(char *) * (sqlite3_uint64)(argc - 3));
+    if (vt->paths == NULL) {
+        free_vtab(vt);
+        return SQLITE_NOMEM;
+    }
+    for (int i = 3; i < argc; i++) {
+        vt->paths[vt->count] = unquote(argv[i]);
+        if (vt->paths[vt->count] == NULL) {
+            free_vtab(vt);
+            return SQLITE_NOMEM;
+        }
+        vt->count++;
+    }
+
+    /* Fail at CREATE time on a missing or foreign file */
+    bme280_segment_reader_t *probe = sqlite3_malloc(sizeof(*probe));
+    if (probe == NULL) {
+        free_vtab(vt);
+        return SQLITE_NOMEM;
+    }
+    for (int i = 0; i < vt->count; i++) {
+        bme280_error_t e = bme280_segment_open(probe, vt->paths[i]);
+        if (e != BME280_OK) {
+            *err = sqlite3_mprintf("bme280_segments: %s: %s", vt->paths[i], bme280_error_string(e));
+            sqlite3_free(probe);
+            free_vtab(vt);
+            return SQLITE_ERROR;
+        }
+        bme280_segment_close(probe);
+    }
+    sqlite3_free(probe);
+
+    int rc = sqlite3_declare_vtab(db, schema);
+    if (rc != SQLITE_OK) {
+        free_vtab(vt);
+        return rc;
+    }
+    sqlite3_vtab_config(db, SQLITE_VTAB_DIRECTONLY);
+
+    *out = &vt->base;
+    return SQLITE_OK;
+}
+
+static int segment_disconnect(sqlite3_vtab *vtab)
+{
+    free_vtab((segment_vtab_t *)vtab);
+    return SQLITE_OK;
+}
+
+/*******************************************************************************
+ * Query Planning
+ ******************************************************************************/
+
+static int segment_best_index(sqlite3_vtab *vtab, sqlite3_index_info *info)
+{
+    int slot[BOUND_COUNT];
+    (void)vtab;
+
+    for (int b = 0; b < BOUND_COUNT; b++) {
+        slot[b] = -1;
+    }
+
+    for (int i = 0; i < info->nConstraint; i++) {
+        const struct sqlite3_index_constraint *c = &info->aConstraint[i];
+        int base;
+
+        if (!c->usable) {
+            continue;
+        }
+        if (c->iColumn == COL_TS_US) {
+            base = BOUND_TS_EQ;
+        } else if (c->iColumn == COL_SENSOR) {
+            base = BOUND_SENSOR_EQ;
+        } else {
+            continue;
+        }
+
+        switch (c->op) {
+        case SQLITE_INDEX_CONSTRAINT_EQ:
+            slot[base] = i;
+            break;
+        case SQLITE_INDEX_CONSTRAINT_GT:
+        case SQLITE_INDEX_CONSTRAINT_GE:
+            slot[base + 1] = i;
+            break;
+        case SQLITE_INDEX_CONSTRAINT_LT:
+        case SQLITE_INDEX_CONSTRAINT_LE:
+            slot[base + 2] = i;
+            break;
+        default:
+            break;
+        }
+    }
+
+    /* Pass the chosen bounds in slot order; idxNum says which are present */
+    double cost = 1e6;
+    char plan[64] = "";
+    int argv_index = 1;
+    info->idxNum = 0;
+    for (int b = 0; b < BOUND_COUNT; b++) {
+        if (slot[b] < 0) {
+            continue;
+        }
+        info->idxNum |= 1 << b;
+        info->aConstraintUsage[slot[b]].argvIndex = argv_index++;
+        if (plan[0] != '\0') {
+            strcat(plan, ",");
+        }
+        strcat(plan, bound_names[b]);
+        cost *= (b == BOUND_TS_EQ || b == BOUND_SENSOR_EQ) ? 0.01 : 0.25;
+    }
+
+    if (plan[0] != '\0') {
+        info->idxStr = sqlite3_mprintf("%s", plan);
+        if (info->idxStr == NULL) {
+            return SQLITE_NOMEM;
+        }
+        info->needToFreeIdxStr = 1;
+    }
+    info->estimatedCost = cost;
+    info->estimatedRows = (sqlite3_int64)cost;
+    return SQLITE_OK;
+}
+
+/*******************************************************************************
+ * Scanning
+ ******************************************************************************/
+
+static int segment_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **out)
+{
+    (void)vtab;
+
+    segment_cursor_t *cur = sqlite3_malloc(sizeof(*cur));
+    if (cur == NULL) {
+        return SQLITE_NOMEM;
+    }
+    memset(cur, 0, sizeof(*cur));
+    cur->reader.fd = -1;
+    cur->segment = -1;
+    cur->eof = 1;
+
+    *out = &cur->base;
+    return SQLITE_OK;
+}
+
+static int segment_close(sqlite3_vtab_cursor *cursor)
+{
+    segment_cursor_t *cur = (segment_cursor_t *)cursor;
+    bme280_segment_close(&cur->reader);
+    sqlite3_free(cur);
+    return SQLITE_OK;
+}
+
+/* Advance to the next matching record, opening later segments as needed */
+static int segment_advance(segment_cursor_t *cur)
+{
+    segment_vtab_t *vt = (segment_vtab_t *)cur->base.pVtab;
+
+    cur->compensated = 0;
+    for (;;) {
+        if (cur->segment >= 0) {
+            int got = bme280_segment_next(&cur->reader, &cur->rec);
+            if (got > 0) {
+                cur->rowid++;
+                return SQLITE_OK;
+            }
+            if (got < 0) {
+                sqlite3_free(vt->base.zErrMsg);
+                vt->base.zErrMsg = sqlite3_mprintf("bme280_segments: %s: bad block",
+                                                   vt->paths[cur->segment]);
+                return SQLITE_CORRUPT_VTAB;
+            }
+            bme280_segment_close(&cur->reader);
+        }
+
+        if (cur->segment + 1 >= vt->count) {
+            cur->eof = 1;
+            return SQLITE_OK;
+        }
+        cur->segment++;
+        if (bme280_segment_open(&cur->reader, vt->paths[cur->segment]) != BME280_OK
+            || bme280_segment_seek(&cur->reader, &cur->query) != BME280_OK) {
+            sqlite3_free(vt->base.zErrMsg);
+            vt->base.zErrMsg = sqlite3_mprintf("bme280_segments: cannot open %s",
+                                               vt->paths[cur->segment]);
+            return SQLITE_ERROR;
+        }
+    }
+}
+
+/*
+ * Narrow [*lo, *hi] by one bound. Bounds are inclusive and may be wider
+ * than the constraint (SQLite re-checks); returns 0 if nothing can match.
+ */
+static int apply_bound(sqlite3_value *value, int which, sqlite3_uint64 limit,
+                       sqlite3_uint64 *lo, sqlite3_uint64 *hi)
+{
+    int type = sqlite3_value_numeric_type(value);
+    double lower, upper;
+
+    if (type == SQLITE_INTEGER) {
+        lower = upper = (double)sqlite3_value_int64(value);
+    } else if (type == SQLITE_FLOAT) {
+        lower = ceil(sqlite3_value_double(value));
+        upper = floor(sqlite3_value_double(value));
+    } else {
+        return type != SQLITE_NULL;  /* NULL matches nothing; leave text to SQLite */
+    }
+
+    if (which != 2) {  /* '=' or lower bound */
+        if (lower > (double)limit) {
+            return 0;
+        }
+        if (lower > 0 && (sqlite3_uint64)lower > *lo) {
+            *lo = (sqlite3_uint64)lower;
+        }
+    }
+    if (which != 1) {  /* '=' or upper bound */
+        if (upper < 0) {
+            return 0;
+        }
+        if (upper < (double)limit && (sqlite3_uint64)upper < *hi) {
+            *hi = (sqlite3_uint64)upper;
+        }
+    }
+    return 1;
+}
+
+static int segment_filter(sqlite3_vtab_cursor *cursor, int idx_num, const char *idx_str,
+                          int argc, sqlite3_value **argv)
+{
+    segment_cursor_t *cur = (segment_cursor_t *)cursor;
+    sqlite3_uint64 ts_lo = 0, ts_hi = UINT64_MAX;
+    sqlite3_uint64 sensor_lo = 0, sensor_hi = UINT32_MAX;
+    int match = 1;
+    int arg = 0;
+    (void)idx_str;
+
+    for (int b = 0; b < BOUND_COUNT && arg < argc; b++) {
+        if ((idx_num & (1 << b)) == 0) {
+            continue;
+        }
+        int which = b % 3;  /* 0 '=', 1 lower, 2 upper */
+        if (b < BOUND_SENSOR_EQ) {
+            match &= apply_bound(argv[arg++], which, UINT64_MAX, &ts_lo, &ts_hi);
+        } else {
+            match &= apply_bound(argv[arg++], which, UINT32_MAX, &sensor_lo, &sensor_hi);
+        }
+    }
+
+    bme280_segment_close(&cur->reader);
+    cur->segment = -1;
+    cur->rowid = 0;
+    cur->eof = 0;
+    cur->query.ts_min = ts_lo;
+    cur->query.ts_max = ts_hi;
+    cur->query.sensor_min = (uint32_t)sensor_lo;
+    cur->query.sensor_max = (uint32_t)sensor_hi;
+
+    if (!match || ts_lo > ts_hi || sensor_lo > sensor_hi) {
+        cur->eof = 1;
+        return SQLITE_OK;
+    }
+    return segment_advance(cur);
+}
+
+static int segment_next(sqlite3_vtab_cursor *cursor)
+{
+    return segment_advance((segment_cursor_t *)cursor);
+}
+
+static int segment_eof(sqlite3_vtab_cursor *cursor)
+{
+    return ((segment_cursor_t *)cursor)->eof;
+}
+
+static int segment_column(sqlite3_vtab_cursor *cursor, sqlite3_context *ctx, int column)
+{
+    segment_cursor_t *cur = (segment_cursor_t *)cursor;
+    bme280_raw_t raw;
+
+    switch (column) {
+    case COL_TS_US:
+        sqlite3_result_int64(ctx, (sqlite3_int64)cur->rec.timestamp_us);
+        return SQLITE_OK;
+    case COL_SENSOR:
+        sqlite3_result_int(ctx, cur->rec.sensor);
+        return SQLITE_OK;
+    case COL_ADC_T:
+    case COL_ADC_P:
+    case COL_ADC_H:
+        bme280_unpack_raw(cur->rec.burst, &raw);
+        sqlite3_result_int(ctx, column == COL_ADC_T ? raw.adc_t
+                                : column == COL_ADC_P ? raw.adc_p : raw.adc_h);
+        return SQLITE_OK;
+    default:
+        break;
+    }
+
+    if (!cur->compensated) {
+        if (bme280_segment_compensate(&cur->reader, &cur->rec, &cur->data) != BME280_OK) {
+            sqlite3_result_null(ctx);
+            return SQLITE_OK;
+        }
+        cur->compensated = 1;
+    }
+
+    switch (column) {
+    case COL_TEMPERATURE_C:
+        sqlite3_result_double(ctx, cur->data.temperature_c);
+        break;
+    case COL_TEMPERATURE_F:
+        sqlite3_result_double(ctx, cur->data.temperature_f);
+        break;
+    case COL_PRESSURE_HPA:
+        sqlite3_result_double(ctx, cur->data.pressure_hpa);
+        break;
+    case COL_HUMIDITY_RH:
+        sqlite3_result_double(ctx, cur->data.humidity_rh);
+        break;
+    default:
+        sqlite3_result_null(ctx);
+        break;
+    }
+    return SQLITE_OK;
+}
+
+static int segment_rowid(sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid)
+{
+    *rowid = ((segment_cursor_t *)cursor)->rowid;
+    return SQLITE_OK;
+}
+
+/*******************************************************************************
+ * Extension Entry Point
+ ******************************************************************************/
+
+static sqlite3_module segment_module = {
+    0,                    /* iVersion */
+    segment_connect,      /* xCreate */
+    segment_connect,      /* xConnect */
+    segment_best_index,   /* xBestIndex */
+    segment_disconnect,   /* xDisconnect */
+    segment_disconnect,   /* xDestroy */
+    segment_open,         /* xOpen */
+    segment_close,        /* xClose */
+    segment_filter,       /* xFilter */
+    segment_next,         /* xNext */
+    segment_eof,          /* xEof */
+    segment_column,       /* xColumn */
+    segment_rowid,        /* xRowid */
+    NULL,                 /* xUpdate */
+    NULL,                 /* xBegin */
+    NULL,                 /* xSync */
+    NULL,                 /* xCommit */
+    NULL,                 /* xRollback */
+    NULL,                 /* xFindFunction */
+    NULL,                 /* xRename */
+    NULL,                 /* xSavepoint */
+    NULL,                 /* xRelease */
+    NULL,                 /* xRollbackTo */
+    NULL,                 /* xShadowName */
+#if SQLITE_VERSION_NUMBER >= 3044000
+    NULL,                 /* xIntegrity */
+#endif
+};
+
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int sqlite3_bme280_init(sqlite3 *db, char **err, const sqlite3_api_routines *api)
+{
+    (void)err;
+    SQLITE_EXTENSION_INIT2(api);
+    return sqlite3_create_module(db, "bme280_segments", &segment_module, NULL);
+}
@@ -0,0 +1,192 @@
+/**
+ * BME280 Segment Virtual Table Check
+ *
+ * Writes a small multi-sensor segment, loads the extension into an
+ * in-memory database and compares query results and query plans against
+ * a direct scan with the segment reader.
+ *
+ * Usage: check_vtab ./bme280_vtab.so
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sqlite3.h>
+
+#include "bme280_segment.h"
+
+#define SENSORS      4
+#define SAMPLES      1000   /* Per sensor, one per second */
+#define BLOCK        64
+
+static const uint8_t calib_tp[24] = {
+    0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC, 0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B,
+    0x27, 0x0B, 0x8C, 0x00, 0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17
+};
+static const uint8_t calib_h1 = 75;
+static const uint8_t calib_hum[7] = { 0x6A, 0x01, 0x00, 0x13, 0x25, 0x03, 0x1E };
+
+static int failures = 0;
+
+#define CHECK(cond, what) do { \
+    if (!(cond)) { \
+        printf("FAIL: %s (line %d)\n", what, __LINE__); \
+        failures++; \
+    } else { \
+        printf("ok:   %s\n", what); \
+    } \
+} while (0)
+
+static sqlite3_int64 query_int(sqlite3 *db, const char *sql)
+{
+    sqlite3_stmt *stmt;
+    sqlite3_int64 v = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        printf("prepare: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        v = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return v;
+}
+
+static double query_double(sqlite3 *db, const char *sql)
+{
+    sqlite3_stmt *stmt;
+    double v = -1.0;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        printf("prepare: %s\n", sqlite3_errmsg(db));
+        return v;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        v = sqlite3_column_double(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return v;
+}
+
+/* Non-zero if the query plan mentions needle */
+static int plan_has(sqlite3 *db, const char *sql, const char *needle)
+{
+    char explain[512];
+    sqlite3_stmt *stmt;
+    int found = 0;
+
+    snprintf(explain, sizeof(explain), "EXPLAIN QUERY PLAN %s", sql);
+    if (sqlite3_prepare_v2(db, explain, -1, &stmt, NULL) != SQLITE_OK) {
+        return 0;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *detail = (const char *)sqlite3_column_text(stmt, 3);
+        if (detail != NULL && strstr(detail, needle) != NULL) {
+            found = 1;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+static bme280_segment_writer_t writer;
+static bme280_segment_reader_t reader;
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s path/to/bme280_vtab.so\n", argv[0]);
+        return 1;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bme280-vtab-%ld.seg", (long)getpid());
+
+    bme280_calib_t calib[SENSORS];
+    for (int s = 0; s < SENSORS; s++) {
+        bme280_parse_calibration(&calib[s], calib_tp, calib_h1, calib_hum);
+        calib[s].temp.dig_T2 = (int16_t)(calib[s].temp.dig_T2 + s * 40);  /* Per-part trim */
+    }
+
+    if (bme280_segment_create(&writer, path, calib, SENSORS, BLOCK) != BME280_OK) {
+        printf("FAIL: create %s\n", path);
+        return 1;
+    }
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        for (uint32_t s = 0; s < SENSORS; s++) {
+            uint32_t adc_t = 519888 + i * 7 + s * 300;
+            uint8_t burst[8] = { 0x65, 0x5A, 0xC0,
+                                 (uint8_t)(adc_t >> 12), (uint8_t)(adc_t >> 4),
+                                 (uint8_t)(adc_t << 4), 0x75, (uint8_t)(0x30 + s) };
+            bme280_segment_append(&writer, 1000000ull * (i + 1) + s, s, burst);
+        }
+    }
+    bme280_segment_finish(&writer);
+
+    sqlite3 *db;
+    char *err = NULL;
+    sqlite3_open(":memory:", &db);
+    sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, NULL);
+    if (sqlite3_load_extension(db, argv[1], "sqlite3_bme280_init", &err) != SQLITE_OK) {
+        printf("FAIL: load %s: %s\n", argv[1], err ? err : "?");
+        sqlite3_free(err);
+        unlink(path);
+        return 1;
+    }
+
+    char sql[512];
+    snprintf(sql, sizeof(sql), "CREATE VIRTUAL TABLE samples USING bme280_segments('%s')", path);
+    CHECK(sqlite3_exec(db, sql, NULL, NULL, NULL) == SQLITE_OK, "create virtual table");
+    CHECK(sqlite3_exec(db, "CREATE VIRTUAL TABLE bad USING bme280_segments('/nonexistent.seg')",
+                       NULL, NULL, NULL) == SQLITE_ERROR, "missing segment rejected");
+
+    CHECK(query_int(db, "SELECT count(*) FROM samples") == SENSORS * SAMPLES, "full scan count");
+
+    /* ts_us of sensor s at second i is (i + 1) * 1e6 + s */
+    const char *range = "SELECT count(*) FROM samples"
+                        " WHERE ts_us BETWEEN 200000000 AND 300000003 AND sensor = 2";
+    CHECK(query_int(db, range) == 101, "time range and sensor");
+    CHECK(plan_has(db, range, "ts>,ts<,sensor="), "range and sensor pushed down");
+
+    CHECK(query_int(db, "SELECT count(*) FROM samples WHERE ts_us > 999000000") == 7,
+          "strict lower bound");
+    CHECK(query_int(db, "SELECT count(*) FROM samples WHERE ts_us < 2000000.5") == 5,
+          "fractional upper bound");
+    CHECK(query_int(db, "SELECT count(*) FROM samples WHERE sensor = 9") == 0,
+          "unknown sensor");
+    CHECK(query_int(db, "SELECT count(*) FROM samples WHERE ts_us = NULL") == 0,
+          "NULL bound");
+    CHECK(query_int(db, "SELECT count(*) FROM samples WHERE sensor >= 1 AND sensor < 3") == 2 * SAMPLES,
+          "sensor range");
+    CHECK(query_int(db, "SELECT max(adc_h) FROM samples") == 0x7533, "raw columns");
+
+    /* Compensated averages must match a direct scan with the reader */
+    double direct = 0.0;
+    uint32_t n = 0;
+    bme280_segment_query_t q = { 500000000u, 600000000u, 3, 3 };
+    bme280_segment_record_t rec;
+    bme280_data_t data;
+    bme280_segment_open(&reader, path);
+    bme280_segment_seek(&reader, &q);
+    while (bme280_segment_next(&reader, &rec) > 0) {
+        bme280_segment_compensate(&reader, &rec, &data);
+        direct += data.temperature_c;
+        n++;
+    }
+    bme280_segment_close(&reader);
+    direct /= n;
+
+    double avg = query_double(db, "SELECT avg(temperature_c) FROM samples"
+                                  " WHERE ts_us >= 500000000 AND ts_us <= 600000000 AND sensor = 3");
+    CHECK(n == 100 && avg > direct - 1e-4 && avg < direct + 1e-4, "compensated on scan");
+    CHECK(query_double(db, "SELECT min(temperature_c) FROM samples WHERE sensor = 3")
+          > query_double(db, "SELECT min(temperature_c) FROM samples WHERE sensor = 0"),
+          "per-sensor calibration");
+
+    sqlite3_close(db);
+    unlink(path);
+
+    printf("%s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
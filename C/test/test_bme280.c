@@ -6,14 +6,42 @@
  * Feature: bme280-c-enhancement
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <time.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "bme280.h"
+#include "bme280_frame.h"
+#include "bme280_shard.h"
+#include "bme280_mqtt.h"
+#include "bme280_log.h"
+#include "bme280_uplink.h"
+#include "bme280_udp.h"
+#include "bme280_slo.h"
+#include "bme280_sketch.h"
+#include "bme280_compress.h"
+#include "bme280_diff.h"
+#include "bme280_segment.h"
+#include "bme280_snapshot.h"
+#include "bme280_ring.h"
+#include "bme280_sim.h"
 
 /*******************************************************************************
  * Test Framework Macros
@@ -248,41 +276,16 @@ static int property_test_compensation_formula(void) {
         ctx.calib.hum.dig_H5 = ref_calib.dig_H5;
         ctx.calib.hum.dig_H6 = ref_calib.dig_H6;
         
-        /* Simulate what bme280_read_data does internally for compensation */
-        /* Temperature compensation */
-        float var1 = (((float)adc_t) / 16384.0f - ((float)ctx.calib.temp.dig_T1) / 1024.0f) 
-                     * ((float)ctx.calib.temp.dig_T2);
-        float var2 = ((((float)adc_t) / 131072.0f - ((float)ctx.calib.temp.dig_T1) / 8192.0f) 
-                     * (((float)adc_t) / 131072.0f - ((float)ctx.calib.temp.dig_T1) / 8192.0f)) 
-                     * ((float)ctx.calib.temp.dig_T3);
-        ctx.t_fine = (int32_t)(var1 + var2);
-        float temperature_c = (var1 + var2) / 5120.0f;
-
-        /* Pressure compensation */
-        var1 = ((float)ctx.t_fine / 2.0f) - 64000.0f;
-        var2 = var1 * var1 * ((float)ctx.calib.press.dig_P6) / 32768.0f;
-        var2 = var2 + var1 * ((float)ctx.calib.press.dig_P5) * 2.0f;
-        var2 = (var2 / 4.0f) + (((float)ctx.calib.press.dig_P4) * 65536.0f);
-        var1 = (((float)ctx.calib.press.dig_P3) * var1 * var1 / 524288.0f 
-               + ((float)ctx.calib.press.dig_P2) * var1) / 524288.0f;
-        var1 = (1.0f + var1 / 32768.0f) * ((float)ctx.calib.press.dig_P1);
-        
-        float p = 1048576.0f - (float)adc_p;
-        p = (p - (var2 / 4096.0f)) * 6250.0f / var1;
-        var1 = ((float)ctx.calib.press.dig_P9) * p * p / 2147483648.0f;
-        var2 = p * ((float)ctx.calib.press.dig_P8) / 32768.0f;
-        float pressure_hpa = (p + (var1 + var2 + ((float)ctx.calib.press.dig_P7)) / 16.0f) / 100.0f;
-
-        /* Humidity compensation */
-        float var_H = ((float)ctx.t_fine) - 76800.0f;
-        var_H = (adc_h - (ctx.calib.hum.dig_H4 * 64.0f + ctx.calib.hum.dig_H5 / 16384.0f * var_H)) 
-                * (ctx.calib.hum.dig_H2 / 65536.0f 
-                * (1.0f + ctx.calib.hum.dig_H6 / 67108864.0f * var_H 
-                * (1.0f + ctx.calib.hum.dig_H3 / 67108864.0f * var_H)));
-        float humidity_rh = var_H * (1.0f - ctx.calib.hum.dig_H1 * var_H / 524288.0f);
-
-        if (humidity_rh > 100.0f) humidity_rh = 100.0f;
-        else if (humidity_rh < 0.0f) humidity_rh = 0.0f;
+        /* Run the driver's compensation on the same inputs */
+        bme280_raw_t raw = { adc_t, adc_p, adc_h };
+        bme280_data_t data;
+        if (bme280_compensate(&ctx.calib, &raw, &data, &ctx.t_fine) != BME280_OK) {
+            printf("\n    Iteration %d: bme280_compensate failed\n", i);
+            return TEST_FAIL;
+        }
+        float temperature_c = data.temperature_c;
+        float pressure_hpa = data.pressure_hpa;
+        float humidity_rh = data.humidity_rh;
         
         /* Compare results */
         if (fabsf(temperature_c - ref_result.temperature_c) > TEMP_TOLERANCE) {
@@ -327,7 +330,10 @@ static int property_test_error_string_completeness(void) {
         BME280_ERR_WRITE,
         BME280_ERR_READ,
         BME280_ERR_NULL_PTR,
-        BME280_ERR_NOT_INIT
+        BME280_ERR_NOT_INIT,
+        BME280_ERR_INVALID_ARG,
+        BME280_ERR_BUSY,
+        BME280_ERR_CONFIG
     };
     
     int num_codes = sizeof(error_codes) / sizeof(error_codes[0]);
@@ -356,7 +362,10 @@ static int property_test_error_string_completeness(void) {
                (error_codes[i] == BME280_ERR_WRITE) ? "BME280_ERR_WRITE" :
                (error_codes[i] == BME280_ERR_READ) ? "BME280_ERR_READ" :
                (error_codes[i] == BME280_ERR_NULL_PTR) ? "BME280_ERR_NULL_PTR" :
-               (error_codes[i] == BME280_ERR_NOT_INIT) ? "BME280_ERR_NOT_INIT" : "UNKNOWN",
+               (error_codes[i] == BME280_ERR_NOT_INIT) ? "BME280_ERR_NOT_INIT" :
+               (error_codes[i] == BME280_ERR_INVALID_ARG) ? "BME280_ERR_INVALID_ARG" :
+               (error_codes[i] == BME280_ERR_BUSY) ? "BME280_ERR_BUSY" :
+               (error_codes[i] == BME280_ERR_CONFIG) ? "BME280_ERR_CONFIG" : "UNKNOWN",
                str);
     }
     
@@ -514,41 +523,3398 @@ static int test_not_initialized_error(void) {
 }
 
 
+/*******************************************************************************
+ * Register Decoding Tests
+ ******************************************************************************/
+
+/**
+ * Test: Calibration bytes decode into signed/unsigned coefficients
+ */
+static int test_parse_calibration(void) {
+    bme280_calib_t calib;
+    uint8_t tp[24];
+    uint8_t hum[7] = { 0x6A, 0x01, 0x00, 0x13, 0x25, 0x03, 0x1E };
+
+    for (int i = 0; i < 24; i += 2) {
+        tp[i] = 0x70;
+        tp[i + 1] = 0xD0;
+    }
+
+    ASSERT(bme280_parse_calibration(&calib, tp, 75, hum) == BME280_OK);
+    ASSERT(calib.temp.dig_T1 == 0xD070);
+    ASSERT(calib.temp.dig_T2 == (int16_t)0xD070);
+    ASSERT(calib.press.dig_P1 == 0xD070);
+    ASSERT(calib.press.dig_P9 == (int16_t)0xD070);
+    ASSERT(calib.hum.dig_H1 == 75);
+    ASSERT(calib.hum.dig_H2 == 362);
+    ASSERT(calib.hum.dig_H3 == 0);
+    ASSERT(calib.hum.dig_H4 == 0x135);  /* 0xE4 << 4 | 0xE5[3:0] */
+    ASSERT(calib.hum.dig_H5 == 0x032);  /* 0xE6 << 4 | 0xE5[7:4] */
+    ASSERT(calib.hum.dig_H6 == 30);
+
+    ASSERT(bme280_parse_calibration(NULL, tp, 0, hum) == BME280_ERR_NULL_PTR);
+    return TEST_PASS;
+}
+
+/**
+ * Test: Packed calibration registers parse back to the same coefficients
+ */
+static int test_pack_calibration(void) {
+    bme280_calib_t calib;
+    bme280_calib_t back;
+    uint8_t regs[32];
+    uint8_t tp[24];
+    uint8_t hum[7] = { 0x6A, 0x01, 0x00, 0x13, 0x25, 0x03, 0x1E };
+
+    for (int i = 0; i < 24; i++) {
+        tp[i] = (uint8_t)(0x61 + i * 7);
+    }
+
+    ASSERT(bme280_parse_calibration(&calib, tp, 75, hum) == BME280_OK);
+    ASSERT(bme280_pack_calibration(&calib, regs) == BME280_OK);
+    ASSERT(memcmp(regs, tp, sizeof(tp)) == 0);
+    ASSERT(regs[24] == 75);
+    ASSERT(memcmp(regs + 25, hum, sizeof(hum)) == 0);
+    ASSERT(bme280_parse_calibration(&back, regs, regs[24], regs + 25) == BME280_OK);
+    ASSERT(memcmp(&back.temp, &calib.temp, sizeof(calib.temp)) == 0);
+    ASSERT(memcmp(&back.press, &calib.press, sizeof(calib.press)) == 0);
+    ASSERT(back.hum.dig_H4 == calib.hum.dig_H4 && back.hum.dig_H5 == calib.hum.dig_H5);
+
+    ASSERT(bme280_pack_calibration(NULL, regs) == BME280_ERR_NULL_PTR);
+    return TEST_PASS;
+}
+
+/**
+ * Test: Data burst unpacks into 20/20/16-bit ADC values
+ */
+static int test_unpack_raw(void) {
+    const uint8_t buf[8] = { 0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00, 0x75, 0x30 };
+    bme280_raw_t raw;
+
+    ASSERT(bme280_unpack_raw(buf, &raw) == BME280_OK);
+    ASSERT(raw.adc_p == 415148);
+    ASSERT(raw.adc_t == 519888);
+    ASSERT(raw.adc_h == 30000);
+    return TEST_PASS;
+}
+
+
+/*******************************************************************************
+ * Fake Bus Helpers
+ *
+ * The driver only issues write()/read() on its fd, so one end of a socketpair
+ * stands in for the I2C bus. Bytes queued on the peer end are what the next
+ * read() returns; register pointer writes land on the peer and are ignored.
+ ******************************************************************************/
+
+static void fake_bus_calibrate(bme280_ctx_t *ctx) {
+    /* Datasheet example temperature/pressure trimming plus typical humidity */
+    ctx->calib.temp.dig_T1 = 27504;
+    ctx->calib.temp.dig_T2 = 26435;
+    ctx->calib.temp.dig_T3 = -1000;
+    ctx->calib.press.dig_P1 = 36477;
+    ctx->calib.press.dig_P2 = -10685;
+    ctx->calib.press.dig_P3 = 3024;
+    ctx->calib.press.dig_P4 = 2855;
+    ctx->calib.press.dig_P5 = 140;
+    ctx->calib.press.dig_P6 = -7;
+    ctx->calib.press.dig_P7 = 15500;
+    ctx->calib.press.dig_P8 = -14600;
+    ctx->calib.press.dig_P9 = 6000;
+    ctx->calib.hum.dig_H1 = 75;
+    ctx->calib.hum.dig_H2 = 362;
+    ctx->calib.hum.dig_H3 = 0;
+    ctx->calib.hum.dig_H4 = 313;
+    ctx->calib.hum.dig_H5 = 50;
+    ctx->calib.hum.dig_H6 = 30;
+}
+
+static int fake_bus_open(bme280_ctx_t *ctx, int *peer) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        return -1;
+    }
+    /* Non-blocking so an unexpected bus read fails instead of hanging */
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+    if (bme280_attach(ctx, sv[0], BME280_DEFAULT_ADDRESS) != BME280_OK) {
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    fake_bus_calibrate(ctx);
+    *peer = sv[1];
+    return 0;
+}
+
+static int fake_bus_push_burst(int peer, int32_t adc_t, int32_t adc_p, int32_t adc_h) {
+    uint8_t buf[8];
+    buf[0] = (uint8_t)(adc_p >> 12);
+    buf[1] = (uint8_t)(adc_p >> 4);
+    buf[2] = (uint8_t)(adc_p << 4);
+    buf[3] = (uint8_t)(adc_t >> 12);
+    buf[4] = (uint8_t)(adc_t >> 4);
+    buf[5] = (uint8_t)(adc_t << 4);
+    buf[6] = (uint8_t)(adc_h >> 8);
+    buf[7] = (uint8_t)adc_h;
+    return (write(peer, buf, sizeof(buf)) == (ssize_t)sizeof(buf)) ? 0 : -1;
+}
+
+static void sleep_us(long us) {
+    struct timespec ts;
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+}
+
+
+/*******************************************************************************
+ * Read Cache Tests
+ ******************************************************************************/
+
+/**
+ * Test: With the cache off every read goes to the bus
+ */
+static int test_cache_off_reads_bus(void) {
+    bme280_ctx_t ctx;
+    bme280_data_t data;
+    bme280_cache_stats_t stats;
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+    ASSERT_FLOAT_EQ(25.08f, data.temperature_c, 0.01f);
+
+    /* Nothing queued: the second read must hit the bus and fail */
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_ERR_READ);
+
+    ASSERT(bme280_get_cache_stats(&ctx, &stats) == BME280_OK);
+    ASSERT(stats.hits == 0);
+    ASSERT(stats.misses == 2);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+/**
+ * Test: Reads within the TTL are served from the cache with their age
+ */
+static int test_cache_hit_within_ttl(void) {
+    bme280_ctx_t ctx;
+    bme280_data_t first;
+    bme280_data_t second;
+    bme280_cache_stats_t stats;
+    uint32_t age = 0xFFFFFFFFu;
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+    ASSERT(bme280_set_cache_ttl(&ctx, 1000000) == BME280_OK);
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+
+    ASSERT(bme280_read_data_cached(&ctx, &first, &age) == BME280_OK);
+    ASSERT(age == 0);
+    ASSERT(bme280_read_data_cached(&ctx, &second, &age) == BME280_OK);
+    ASSERT(age < 1000000);
+    ASSERT(memcmp(&first, &second, sizeof(first)) == 0);
+
+    ASSERT(bme280_get_cache_stats(&ctx, &stats) == BME280_OK);
+    ASSERT(stats.hits == 1);
+    ASSERT(stats.misses == 1);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+/**
+ * Test: An expired sample is refreshed from the bus
+ */
+static int test_cache_expiry(void) {
+    bme280_ctx_t ctx;
+    bme280_data_t data;
+    bme280_cache_stats_t stats;
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+    ASSERT(bme280_set_cache_ttl(&ctx, 1000) == BME280_OK);
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+
+    sleep_us(5000);
+    ASSERT(fake_bus_push_burst(peer, 530000, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+    ASSERT(data.temperature_c > 25.5f);
+
+    ASSERT(bme280_get_cache_stats(&ctx, &stats) == BME280_OK);
+    ASSERT(stats.hits == 0);
+    ASSERT(stats.misses == 2);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+/**
+ * Test: Automatic TTL follows the configured output data rate
+ */
+static int test_cache_ttl_auto(void) {
+    bme280_ctx_t ctx;
+    bme280_data_t data;
+    bme280_cache_stats_t stats;
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+
+    /* Sleep mode has no ODR, so the automatic TTL disables caching */
+    ASSERT(bme280_odr_period_us(&ctx) == 0);
+
+    /* 1x oversampling everywhere: 9.3ms max measurement + 1000ms standby */
+    ASSERT(bme280_configure(&ctx) == BME280_OK);
+    ASSERT(bme280_odr_period_us(&ctx) == 1009300);
+
+    ASSERT(bme280_set_cache_ttl(&ctx, BME280_CACHE_TTL_AUTO) == BME280_OK);
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+
+    ASSERT(bme280_get_cache_stats(&ctx, &stats) == BME280_OK);
+    ASSERT(stats.hits == 1);
+    ASSERT(stats.misses == 1);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+
+/*******************************************************************************
+ * Single-Flight Tests
+ ******************************************************************************/
+
+#define FLIGHT_FOLLOWERS 4
+
+typedef struct {
+    bme280_ctx_t   *ctx;
+    bme280_data_t   data;
+    bme280_error_t  err;
+} flight_reader_t;
+
+static void *flight_reader(void *arg) {
+    flight_reader_t *reader = (flight_reader_t *)arg;
+    reader->err = bme280_read_data(reader->ctx, &reader->data);
+    return NULL;
+}
+
+/*
+ * Condition waits entered by any thread; the test link wraps
+ * pthread_cond_wait (see Makefile), so a follower is counted once it is
+ * parked on the single-flight slot.
+ */
+static uint32_t cond_waits;
+
+int __real_pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+
+int __wrap_pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+    __atomic_add_fetch(&cond_waits, 1, __ATOMIC_RELAXED);
+    return __real_pthread_cond_wait(cond, mutex);
+}
+
+static uint32_t flight_waits(void) {
+    return __atomic_load_n(&cond_waits, __ATOMIC_RELAXED);
+}
+
+/**
+ * Test: Concurrent readers share the in-flight bus transaction
+ */
+static int test_single_flight_coalesces(void) {
+    bme280_ctx_t ctx;
+    bme280_cache_stats_t stats;
+    flight_reader_t readers[FLIGHT_FOLLOWERS + 1];
+    pthread_t threads[FLIGHT_FOLLOWERS + 1];
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+
+    /* Blocking reads with a timeout: the leader parks until data is queued */
+    struct timeval timeout = { 2, 0 };
+    fcntl(ctx.fd, F_SETFL, fcntl(ctx.fd, F_GETFL) & ~O_NONBLOCK);
+    setsockopt(ctx.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    for (int i = 0; i <= FLIGHT_FOLLOWERS; i++) {
+        readers[i].ctx = &ctx;
+        readers[i].err = BME280_ERR_NOT_INIT;
+    }
+
+    /* Start the leader and wait until it owns the bus read */
+    pthread_create(&threads[0], NULL, flight_reader, &readers[0]);
+    for (int spin = 0; spin < 1000; spin++) {
+        ASSERT(bme280_get_cache_stats(&ctx, &stats) == BME280_OK);
+        if (stats.misses == 1) {
+            break;
+        }
+        sleep_us(1000);
+    }
+
+    /* Followers must all be parked on the slot before the data arrives */
+    uint32_t waits = flight_waits();
+    for (int i = 1; i <= FLIGHT_FOLLOWERS; i++) {
+        pthread_create(&threads[i], NULL, flight_reader, &readers[i]);
+    }
+    for (int spin = 0; spin < 1000 && flight_waits() - waits < FLIGHT_FOLLOWERS; spin++) {
+        sleep_us(1000);
+    }
+    ASSERT(flight_waits() - waits == FLIGHT_FOLLOWERS);
+
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    for (int i = 0; i <= FLIGHT_FOLLOWERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i <= FLIGHT_FOLLOWERS; i++) {
+        ASSERT(readers[i].err == BME280_OK);
+        ASSERT(memcmp(&readers[i].data, &readers[0].data, sizeof(bme280_data_t)) == 0);
+    }
+
+    ASSERT(bme280_get_cache_stats(&ctx, &stats) == BME280_OK);
+    ASSERT(stats.misses == 1);
+    ASSERT(stats.shared == FLIGHT_FOLLOWERS);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+
+/**
+ * Test: A sample read across an invalidation is returned but not cached
+ */
+static int test_single_flight_invalidated_read(void) {
+    bme280_ctx_t ctx;
+    bme280_cache_stats_t stats;
+    flight_reader_t reader;
+    pthread_t thread;
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+    ASSERT(bme280_set_cache_ttl(&ctx, 10000000u) == BME280_OK);
+
+    struct timeval timeout = { 2, 0 };
+    fcntl(ctx.fd, F_SETFL, fcntl(ctx.fd, F_GETFL) & ~O_NONBLOCK);
+    setsockopt(ctx.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    reader.ctx = &ctx;
+    reader.err = BME280_ERR_NOT_INIT;
+    pthread_create(&thread, NULL, flight_reader, &reader);
+    for (int spin = 0; spin < 1000; spin++) {
+        ASSERT(bme280_get_cache_stats(&ctx, &stats) == BME280_OK);
+        if (stats.misses == 1) {
+            break;
+        }
+        sleep_us(1000);
+    }
+
+    /* Invalidate while the read is on the bus */
+    ASSERT(bme280_set_cache_ttl(&ctx, 10000000u) == BME280_OK);
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    pthread_join(thread, NULL);
+    ASSERT(reader.err == BME280_OK);
+    ASSERT(ctx.cache.valid == 0);
+
+    /* So the next read goes to the bus again, and that one is cached */
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &reader.data) == BME280_OK);
+    ASSERT(bme280_read_data(&ctx, &reader.data) == BME280_OK);
+    ASSERT(bme280_get_cache_stats(&ctx, &stats) == BME280_OK);
+    ASSERT(stats.misses == 2 && stats.hits == 1);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Frame Publisher Tests
+ ******************************************************************************/
+
+/**
+ * Test: Consumer sees nothing before the first publish, then the latest frame
+ */
+static int test_frame_latest_wins(void) {
+    static bme280_frame_pub_t pub;
+
+    ASSERT(bme280_frame_init(&pub) == BME280_OK);
+    ASSERT(bme280_frame_latest(&pub) == NULL);
+
+    for (int i = 1; i <= 3; i++) {
+        bme280_frame_t *back = bme280_frame_back(&pub);
+        back->count = 1;
+        back->samples[0].temperature_c = (float)i;
+        ASSERT(bme280_frame_publish(&pub) == BME280_OK);
+    }
+
+    const bme280_frame_t *frame = bme280_frame_latest(&pub);
+    ASSERT(frame != NULL);
+    ASSERT(frame->sequence == 3);
+    ASSERT_FLOAT_EQ(3.0f, frame->samples[0].temperature_c, 0.0f);
+
+    /* The held frame is untouched while the producer keeps writing */
+    bme280_frame_t *back = bme280_frame_back(&pub);
+    ASSERT(back != frame);
+    back->samples[0].temperature_c = 4.0f;
+    ASSERT_FLOAT_EQ(3.0f, frame->samples[0].temperature_c, 0.0f);
+
+    /* No new publish: the consumer keeps the same frame */
+    ASSERT(bme280_frame_latest(&pub) == frame);
+    return TEST_PASS;
+}
+
+#define FRAME_STRESS_SWEEPS 200000
+
+static void *frame_stress_producer(void *arg) {
+    bme280_frame_pub_t *pub = (bme280_frame_pub_t *)arg;
+    for (uint32_t sweep = 1; sweep <= FRAME_STRESS_SWEEPS; sweep++) {
+        bme280_frame_t *back = bme280_frame_back(pub);
+        back->count = BME280_FRAME_MAX_SENSORS;
+        for (uint32_t i = 0; i < BME280_FRAME_MAX_SENSORS; i++) {
+            back->samples[i].temperature_c = (float)sweep;
+        }
+        bme280_frame_publish(pub);
+    }
+    return NULL;
+}
+
+/**
+ * Test: Concurrent consumer never observes a torn or out-of-order sweep
+ */
+static int test_frame_consistent_under_load(void) {
+    static bme280_frame_pub_t pub;
+    pthread_t producer;
+    uint64_t last_sequence = 0;
+
+    ASSERT(bme280_frame_init(&pub) == BME280_OK);
+    pthread_create(&producer, NULL, frame_stress_producer, &pub);
+
+    while (last_sequence < FRAME_STRESS_SWEEPS) {
+        const bme280_frame_t *frame = bme280_frame_latest(&pub);
+        if (frame == NULL) {
+            continue;
+        }
+        ASSERT(frame->sequence >= last_sequence);
+        last_sequence = frame->sequence;
+        float expected = frame->samples[0].temperature_c;
+        ASSERT_FLOAT_EQ((float)frame->sequence, expected, 0.0f);
+        for (uint32_t i = 1; i < frame->count; i++) {
+            ASSERT_FLOAT_EQ(expected, frame->samples[i].temperature_c, 0.0f);
+        }
+    }
+
+    pthread_join(producer, NULL);
+    return TEST_PASS;
+}
+
+/**
+ * Test: A sweep reads every sensor and records per-sensor status
+ */
+static int test_frame_sweep(void) {
+    static bme280_frame_pub_t pub;
+    bme280_ctx_t ok_ctx;
+    bme280_ctx_t idle_ctx;
+    int ok_peer;
+    int idle_peer;
+
+    ASSERT(fake_bus_open(&ok_ctx, &ok_peer) == 0);
+    ASSERT(fake_bus_open(&idle_ctx, &idle_peer) == 0);
+    ASSERT(fake_bus_push_burst(ok_peer, 519888, 415148, 30000) == 0);
+
+    bme280_ctx_t *const ctxs[2] = { &ok_ctx, &idle_ctx };
+    ASSERT(bme280_frame_init(&pub) == BME280_OK);
+    ASSERT(bme280_frame_sweep(&pub, ctxs, BME280_FRAME_MAX_SENSORS + 1) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_frame_sweep(&pub, ctxs, 2) == BME280_OK);
+
+    const bme280_frame_t *frame = bme280_frame_latest(&pub);
+    ASSERT(frame != NULL);
+    ASSERT(frame->count == 2);
+    ASSERT(frame->status[0] == BME280_OK);
+    ASSERT(frame->status[1] == BME280_ERR_READ);
+    ASSERT_FLOAT_EQ(25.08f, frame->samples[0].temperature_c, 0.01f);
+
+    bme280_close(&ok_ctx);
+    bme280_close(&idle_ctx);
+    close(ok_peer);
+    close(idle_peer);
+    return TEST_PASS;
+}
+
+
 /*******************************************************************************
  * Main Test Runner
  ******************************************************************************/
 
-int main(void) {
-    printf("==============================================\n");
-    printf("BME280 Driver Test Suite\n");
-    printf("Feature: bme280-c-enhancement\n");
-    printf("==============================================\n\n");
-    
-    /* Seed random number generator */
-    seed_random((uint32_t)time(NULL));
-    
-    /* Property Tests */
-    printf("Property Tests:\n");
-    printf("----------------------------------------------\n");
-    
-    printf("\nProperty 1: Compensation Formula Correctness\n");
-    printf("Validates: Requirements 1.4\n");
-    RUN_TEST(property_test_compensation_formula);
-    
-    printf("\nProperty 2: Error String Completeness\n");
-    printf("Validates: Requirements 4.6\n");
-    RUN_TEST(property_test_error_string_completeness);
-    
-    /* Unit Tests */
-    printf("\nUnit Tests:\n");
-    printf("----------------------------------------------\n");
-    
-    RUN_TEST(test_invalid_bus_path);
-    RUN_TEST(test_close_sets_fd_negative);
-    RUN_TEST(test_default_constants);
-    RUN_TEST(test_include_guards);
-    RUN_TEST(test_null_pointer_handling);
-    RUN_TEST(test_not_initialized_error);
+/*******************************************************************************
+ * Shard Registry Tests
+ ******************************************************************************/
+
+static const char *const shard_buses[3] = { "/dev/i2c-1", "/dev/i2c-2", "/dev/i2c-3" };
+
+static void shard_name(char *name, size_t len, const char *tag) {
+    snprintf(name, len, "/bme280-test-%s-%ld", tag, (long)getpid());
+}
+
+/*
+ * Fork a child that opens the registry, claims every bus, reports the claim
+ * count over a pipe and then either exits without releasing or sleeps until
+ * killed. Returns the child pid, or -1 on failure.
+ */
+static pid_t shard_spawn_owner(const char *name, uint32_t lease_ms, int linger) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        bme280_shard_t shard;
+        uint32_t claimed = 0;
+        close(fds[0]);
+        if (bme280_shard_open(&shard, name, shard_buses, 3, lease_ms) == BME280_OK) {
+            bme280_shard_claim(&shard, 3, &claimed);
+        }
+        if (write(fds[1], &claimed, sizeof(claimed)) != (ssize_t)sizeof(claimed)) {
+            _exit(1);
+        }
+        while (linger) {
+            pause();
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    uint32_t claimed = 0;
+    ssize_t n = read(fds[0], &claimed, sizeof(claimed));
+    close(fds[0]);
+    if (pid < 0 || n != (ssize_t)sizeof(claimed) || claimed != 3) {
+        if (pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+        }
+        return -1;
+    }
+    return pid;
+}
+
+static int test_shard_claim_and_totals(void) {
+    char name[64];
+    bme280_shard_t shard;
+    bme280_shard_stats_t totals;
+    uint32_t claimed = 0;
+    uint32_t owned = 0;
+
+    shard_name(name, sizeof(name), "claim");
+    bme280_shard_unlink(name);
+
+    ASSERT(bme280_shard_open(&shard, name, shard_buses, BME280_SHARD_MAX_BUSES + 1, 1000) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_shard_open(&shard, name, shard_buses, 3, 1000) == BME280_OK);
+    ASSERT(strcmp(bme280_shard_bus_path(&shard, 1), "/dev/i2c-2") == 0);
+    ASSERT(bme280_shard_bus_path(&shard, 3) == NULL);
+
+    ASSERT(bme280_shard_claim(&shard, 2, &claimed) == BME280_OK);
+    ASSERT(claimed == 2);
+    ASSERT(bme280_shard_owns(&shard, 0));
+    ASSERT(bme280_shard_owns(&shard, 1));
+    ASSERT(!bme280_shard_owns(&shard, 2));
+
+    /* Already at the limit: nothing more is taken */
+    ASSERT(bme280_shard_claim(&shard, 2, &claimed) == BME280_OK);
+    ASSERT(claimed == 0);
+    ASSERT(bme280_shard_renew(&shard, &owned) == BME280_OK);
+    ASSERT(owned == 2);
+
+    ASSERT(bme280_shard_record(&shard, 0, BME280_OK) == BME280_OK);
+    ASSERT(bme280_shard_record(&shard, 1, BME280_OK) == BME280_OK);
+    ASSERT(bme280_shard_record(&shard, 1, BME280_ERR_READ) == BME280_OK);
+    ASSERT(bme280_shard_record(&shard, 3, BME280_OK) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_shard_totals(&shard, &totals) == BME280_OK);
+    ASSERT(totals.reads == 2);
+    ASSERT(totals.errors == 1);
+    ASSERT(totals.claims == 2);
+
+    bme280_shard_close(&shard);
+    ASSERT(shard.reg == NULL);
+    bme280_shard_unlink(name);
+    return TEST_PASS;
+}
+
+static int test_shard_reclaims_dead_owner(void) {
+    char name[64];
+    bme280_shard_t shard;
+    uint32_t claimed = 0;
+
+    shard_name(name, sizeof(name), "dead");
+    bme280_shard_unlink(name);
+    ASSERT(bme280_shard_open(&shard, name, shard_buses, 3, 60000) == BME280_OK);
+
+    /* Child claims everything and exits without releasing */
+    pid_t child = shard_spawn_owner(name, 60000, 0);
+    ASSERT(child > 0);
+    ASSERT(waitpid(child, NULL, 0) == child);
+
+    ASSERT(bme280_shard_claim(&shard, 3, &claimed) == BME280_OK);
+    ASSERT(claimed == 3);
+    ASSERT(bme280_shard_owns(&shard, 2));
+
+    bme280_shard_close(&shard);
+    bme280_shard_unlink(name);
+    return TEST_PASS;
+}
+
+/* Leave a registry as a creator that died at the given stage would */
+static int shard_abandon(const char *name, int sized) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    if (sized) {
+        pid_t child = fork();
+        if (child == 0) {
+            _exit(0);
+        }
+        waitpid(child, NULL, 0);
+
+        bme280_shard_registry_t *reg = NULL;
+        if (ftruncate(fd, sizeof(*reg)) == 0) {
+            reg = mmap(NULL, sizeof(*reg), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (reg == NULL || reg == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        reg->creator = (uint32_t)child;
+        reg->bus_count = 1;
+        munmap(reg, sizeof(*reg));
+    }
+    close(fd);
+    return 0;
+}
+
+static int test_shard_takes_over_dead_creator(void) {
+    static const char *const other_buses[] = { "/dev/i2c-1", "/dev/i2c-9", "/dev/i2c-3" };
+    char name[64];
+    bme280_shard_t shard;
+    bme280_shard_t joiner;
+
+    /* Died after sizing and recording its pid, and before sizing at all */
+    for (int sized = 1; sized >= 0; sized--) {
+        shard_name(name, sizeof(name), sized ? "orphan" : "unsized");
+        bme280_shard_unlink(name);
+        ASSERT(shard_abandon(name, sized) == 0);
+        ASSERT(bme280_shard_open(&shard, name, shard_buses, 3, 1000) == BME280_OK);
+        ASSERT(shard.reg->bus_count == 3);
+        ASSERT(shard.reg->creator == (uint32_t)getpid());
+        ASSERT(strcmp(bme280_shard_bus_path(&shard, 2), "/dev/i2c-3") == 0);
+        bme280_shard_close(&shard);
+        bme280_shard_unlink(name);
+    }
+
+    /* Joiners must agree with the recorded bus list, or adopt it */
+    shard_name(name, sizeof(name), "mismatch");
+    bme280_shard_unlink(name);
+    ASSERT(bme280_shard_open(&shard, name, shard_buses, 3, 1000) == BME280_OK);
+    ASSERT(bme280_shard_open(&joiner, name, other_buses, 3, 1000) == BME280_ERR_INVALID_ARG);
+    ASSERT(joiner.reg == NULL);
+    ASSERT(bme280_shard_open(&joiner, name, shard_buses, 2, 1000) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_shard_open(&joiner, name, NULL, 0, 1000) == BME280_OK);
+    ASSERT(joiner.reg->bus_count == 3);
+    bme280_shard_close(&joiner);
+    ASSERT(bme280_shard_open(&joiner, name, shard_buses, 3, 1000) == BME280_OK);
+    bme280_shard_close(&joiner);
+
+    bme280_shard_close(&shard);
+    bme280_shard_unlink(name);
+    return TEST_PASS;
+}
+
+static int test_shard_reclaims_expired_lease(void) {
+    char name[64];
+    bme280_shard_t shard;
+    uint32_t claimed = 0;
+
+    shard_name(name, sizeof(name), "expire");
+    bme280_shard_unlink(name);
+    ASSERT(bme280_shard_open(&shard, name, shard_buses, 3, 1000) == BME280_OK);
+
+    /* Child stays alive but never renews its 20 ms leases */
+    pid_t child = shard_spawn_owner(name, 20, 1);
+    ASSERT(child > 0);
+
+    bme280_shard_claim(&shard, 3, &claimed);
+    int early = (int)claimed;
+    sleep_us(50000);
+    bme280_shard_claim(&shard, 3, &claimed);
+
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+
+    ASSERT(early == 0);
+    ASSERT(claimed == 3);
+
+    bme280_shard_close(&shard);
+    bme280_shard_unlink(name);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * MQTT Sink Tests
+ ******************************************************************************/
+
+#define MOCK_MAX_PUBLISH 16
+
+/*
+ * In-process broker on one end of a socketpair. Answers CONNECT with
+ * CONNACK, records each PUBLISH and acknowledges it (and answers PINGREQ)
+ * when ack is set.
+ */
+typedef struct {
+    int      fd;
+    int      ack;
+    int      connects;
+    int      publishes;
+    char     topic[MOCK_MAX_PUBLISH][BME280_MQTT_TOPIC_LEN];
+    uint8_t  flags[MOCK_MAX_PUBLISH];
+    uint16_t count[MOCK_MAX_PUBLISH];
+    int16_t  first_temp[MOCK_MAX_PUBLISH];
+} mock_broker_t;
+
+static int read_exact(int fd, uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Read one MQTT packet; returns the first byte or -1 at end of stream */
+static int mock_read_packet(int fd, uint8_t *body, uint32_t *len) {
+    uint8_t type;
+    uint8_t byte;
+    uint32_t shift = 0;
+
+    if (read_exact(fd, &type, 1) != 0) {
+        return -1;
+    }
+    *len = 0;
+    do {
+        if (read_exact(fd, &byte, 1) != 0) {
+            return -1;
+        }
+        *len |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    if (*len > BME280_MQTT_PACKET_MAX || read_exact(fd, body, *len) != 0) {
+        return -1;
+    }
+    return type;
+}
+
+static void *mock_broker_thread(void *arg) {
+    mock_broker_t *broker = arg;
+    static uint8_t body[BME280_MQTT_PACKET_MAX];
+    uint32_t len;
+    int type;
+
+    while ((type = mock_read_packet(broker->fd, body, &len)) >= 0) {
+        if ((type & 0xF0) == 0x10) {
+            static const uint8_t connack[4] = { 0x20, 0x02, 0x00, 0x00 };
+            broker->connects++;
+            if (write(broker->fd, connack, sizeof(connack)) != (ssize_t)sizeof(connack)) {
+                break;
+            }
+        } else if ((type & 0xF0) == 0x30) {
+            uint16_t topic_len = (uint16_t)((body[0] << 8) | body[1]);
+            const uint8_t *id = body + 2 + topic_len;
+            const uint8_t *payload = id + 2;
+            int i = broker->publishes++;
+            if (i < MOCK_MAX_PUBLISH) {
+                memcpy(broker->topic[i], body + 2, topic_len);
+                broker->topic[i][topic_len] = '\0';
+                broker->flags[i] = (uint8_t)type;
+                broker->count[i] = (uint16_t)(payload[2] | (payload[3] << 8));
+                broker->first_temp[i] = (int16_t)(payload[12] | (payload[13] << 8));
+            }
+            uint8_t puback[4] = { 0x40, 0x02, id[0], id[1] };
+            if (broker->ack && write(broker->fd, puback, sizeof(puback)) != (ssize_t)sizeof(puback)) {
+                break;
+            }
+        } else if ((type & 0xF0) == 0xC0) {
+            static const uint8_t pingresp[2] = { 0xD0, 0x00 };
+            if (broker->ack && write(broker->fd, pingresp, sizeof(pingresp)) != (ssize_t)sizeof(pingresp)) {
+                break;
+            }
+        } else if ((type & 0xF0) == 0xE0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static int mock_broker_start(mock_broker_t *broker, pthread_t *thread, int ack, int *client_fd) {
+    int sv[2];
+    memset(broker, 0, sizeof(*broker));
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        return -1;
+    }
+    broker->fd = sv[1];
+    broker->ack = ack;
+    *client_fd = sv[0];
+    return pthread_create(thread, NULL, mock_broker_thread, broker);
+}
+
+static void mock_broker_stop(mock_broker_t *broker, pthread_t thread) {
+    shutdown(broker->fd, SHUT_RDWR);
+    pthread_join(thread, NULL);
+    close(broker->fd);
+}
+
+static const bme280_data_t mqtt_sample = { 25.08f, 77.14f, 1005.12f, 41.5f };
+
+static int test_mqtt_batches_per_topic(void) {
+    static bme280_mqtt_t sink;
+    mock_broker_t broker;
+    pthread_t thread;
+    int fd;
+    bme280_mqtt_config_t config = {
+        4, BME280_MQTT_HEADER_SIZE + 4 * BME280_MQTT_RECORD_SIZE, 1000000u, 1000u, 0
+    };
+
+    ASSERT(bme280_mqtt_init(&sink, "", &config) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_mqtt_init(&sink, "gw-1", &config) == BME280_OK);
+    ASSERT(bme280_mqtt_publish(&sink, "a", &mqtt_sample, 0) == BME280_ERR_NOT_INIT);
+    ASSERT(mock_broker_start(&broker, &thread, 1, &fd) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, fd) == BME280_OK);
+
+    for (int i = 0; i < 10; i++) {
+        ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 1000u * (uint64_t)i) == BME280_OK);
+    }
+    for (int i = 0; i < 3; i++) {
+        ASSERT(bme280_mqtt_publish(&sink, "site/b", &mqtt_sample, 1000u * (uint64_t)i) == BME280_OK);
+    }
+    ASSERT(bme280_mqtt_flush(&sink) == BME280_OK);
+    bme280_mqtt_close(&sink);
+    mock_broker_stop(&broker, thread);
+
+    /* Two full batches for a, then the remainders of a and b */
+    ASSERT(broker.connects == 1);
+    ASSERT(broker.publishes == 4);
+    ASSERT(strcmp(broker.topic[0], "site/a") == 0 && broker.count[0] == 4);
+    ASSERT(strcmp(broker.topic[1], "site/a") == 0 && broker.count[1] == 4);
+    ASSERT(strcmp(broker.topic[2], "site/a") == 0 && broker.count[2] == 2);
+    ASSERT(strcmp(broker.topic[3], "site/b") == 0 && broker.count[3] == 3);
+    ASSERT(broker.first_temp[0] == 2508);
+    ASSERT(sink.stats.samples == 13);
+    ASSERT(sink.stats.packets == 4);
+    ASSERT(sink.stats.acks == 4);
+    ASSERT(sink.inflight == 0);
+    return TEST_PASS;
+}
+
+static int test_mqtt_flushes_on_age(void) {
+    static bme280_mqtt_t sink;
+    mock_broker_t broker;
+    pthread_t thread;
+    int fd;
+
+    ASSERT(bme280_mqtt_init(&sink, "gw-2", NULL) == BME280_OK);
+    ASSERT(mock_broker_start(&broker, &thread, 1, &fd) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, fd) == BME280_OK);
+
+    ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 5000000u) == BME280_OK);
+    ASSERT(bme280_mqtt_poll(&sink, 5500000u) == BME280_OK);
+    ASSERT(sink.stats.packets == 0);
+    ASSERT(bme280_mqtt_poll(&sink, 6000000u) == BME280_OK);
+    ASSERT(sink.stats.packets == 1);
+
+    ASSERT(bme280_mqtt_flush(&sink) == BME280_OK);
+    bme280_mqtt_close(&sink);
+    mock_broker_stop(&broker, thread);
+    ASSERT(broker.publishes == 1 && broker.count[0] == 1);
+    return TEST_PASS;
+}
+
+static int test_mqtt_window_and_resend(void) {
+    static bme280_mqtt_t sink;
+    mock_broker_t broker;
+    pthread_t thread;
+    int fd;
+    bme280_mqtt_config_t config = {
+        2, BME280_MQTT_HEADER_SIZE + BME280_MQTT_RECORD_SIZE, 1000000u, 50u, 0
+    };
+
+    /* Broker that never acknowledges: the third packet has no room */
+    ASSERT(bme280_mqtt_init(&sink, "gw-3", &config) == BME280_OK);
+    ASSERT(mock_broker_start(&broker, &thread, 0, &fd) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, fd) == BME280_OK);
+    ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 0) == BME280_OK);
+    ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 1) == BME280_OK);
+    ASSERT(sink.inflight == 2);
+    ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 2) == BME280_ERR_READ);
+    ASSERT(sink.stats.stalls == 1);
+    bme280_mqtt_close(&sink);
+    mock_broker_stop(&broker, thread);
+    ASSERT(broker.publishes == 2);
+
+    /* Reconnect to an acknowledging broker: both are resent as duplicates */
+    ASSERT(mock_broker_start(&broker, &thread, 1, &fd) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, fd) == BME280_OK);
+    ASSERT(bme280_mqtt_flush(&sink) == BME280_OK);
+    bme280_mqtt_close(&sink);
+    mock_broker_stop(&broker, thread);
+
+    ASSERT(sink.stats.resent == 2);
+    ASSERT(broker.publishes == 3);
+    ASSERT(broker.flags[0] == 0x3A && broker.flags[1] == 0x3A);
+    ASSERT(broker.flags[2] == 0x32 && broker.count[2] == 1);
+    ASSERT(sink.inflight == 0);
+    return TEST_PASS;
+}
+
+static int test_mqtt_stalled_broker(void) {
+    static bme280_mqtt_t sink;
+    mock_broker_t broker;
+    pthread_t thread;
+    int fd;
+    bme280_mqtt_config_t config = {
+        1, BME280_MQTT_HEADER_SIZE + 2 * BME280_MQTT_RECORD_SIZE, 1000000u, 20u, 0
+    };
+
+    /* CONNACK, then silence: the second full batch has nowhere to go */
+    ASSERT(bme280_mqtt_init(&sink, "gw-4", &config) == BME280_OK);
+    ASSERT(mock_broker_start(&broker, &thread, 0, &fd) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, fd) == BME280_OK);
+    for (int i = 0; i < 3; i++) {
+        ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, (uint64_t)i) == BME280_OK);
+    }
+    ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 3) == BME280_ERR_READ);
+
+    /* Later samples are refused instead of running past the batch */
+    for (int i = 4; i < 8; i++) {
+        ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, (uint64_t)i) == BME280_ERR_BUSY);
+        ASSERT(sink.batches[0].len <= config.max_batch_bytes);
+    }
+    ASSERT(sink.stats.samples == 4);
+    bme280_mqtt_close(&sink);
+    mock_broker_stop(&broker, thread);
+
+    /* A broker that acknowledges gets the held packet again and the full batch */
+    ASSERT(mock_broker_start(&broker, &thread, 1, &fd) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, fd) == BME280_OK);
+    ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 8) == BME280_OK);
+    ASSERT(bme280_mqtt_flush(&sink) == BME280_OK);
+    bme280_mqtt_close(&sink);
+    mock_broker_stop(&broker, thread);
+    ASSERT(broker.publishes == 3);
+    ASSERT(broker.flags[0] == 0x3A && broker.count[0] == 2);
+    ASSERT(broker.count[1] == 2 && broker.count[2] == 1);
+    return TEST_PASS;
+}
+
+static int test_mqtt_drops_dead_connection(void) {
+    static bme280_mqtt_t sink;
+    mock_broker_t broker;
+    pthread_t thread;
+    int fd;
+    bme280_mqtt_config_t config = {
+        4, BME280_MQTT_HEADER_SIZE + BME280_MQTT_RECORD_SIZE, 1000000u, 20u, 1
+    };
+
+    /* Pings answered keep the connection; an unanswered one drops it */
+    ASSERT(bme280_mqtt_init(&sink, "gw-5", &config) == BME280_OK);
+    ASSERT(mock_broker_start(&broker, &thread, 1, &fd) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, fd) == BME280_OK);
+    uint64_t now = bme280_time_us() + 600000u;
+    ASSERT(bme280_mqtt_poll(&sink, now) == BME280_OK);
+    ASSERT(sink.ping_sent_us == now);
+    sleep_us(10000);
+    ASSERT(bme280_mqtt_poll(&sink, bme280_time_us()) == BME280_OK);
+    ASSERT(sink.ping_sent_us == 0);
+    ASSERT(sink.fd >= 0);
+    bme280_mqtt_close(&sink);
+    mock_broker_stop(&broker, thread);
+
+    ASSERT(mock_broker_start(&broker, &thread, 0, &fd) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, fd) == BME280_OK);
+    now = bme280_time_us() + 600000u;
+    ASSERT(bme280_mqtt_poll(&sink, now) == BME280_OK);
+    ASSERT(bme280_mqtt_poll(&sink, now + 10000u) == BME280_OK);
+    ASSERT(bme280_mqtt_poll(&sink, now + 30000u) == BME280_ERR_READ);
+    ASSERT(sink.fd < 0);
+    ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 0) == BME280_ERR_NOT_INIT);
+    mock_broker_stop(&broker, thread);
+
+    /* A send that fails closes the socket too */
+    ASSERT(mock_broker_start(&broker, &thread, 1, &fd) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, fd) == BME280_OK);
+    mock_broker_stop(&broker, thread);
+    ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 0) == BME280_ERR_WRITE);
+    ASSERT(sink.fd < 0);
+    ASSERT(sink.inflight == 1);
+    return TEST_PASS;
+}
+
+static int test_mqtt_drops_on_receive_error(void) {
+    static bme280_mqtt_t sink;
+    static const uint8_t accepted[4] = { 0x20, 0x02, 0x00, 0x00 };
+    static const uint8_t refused[4] = { 0x20, 0x02, 0x00, 0x05 };
+    int sv[2];
+    bme280_mqtt_config_t config = {
+        4, BME280_MQTT_HEADER_SIZE + BME280_MQTT_RECORD_SIZE, 1000000u, 20u, 0
+    };
+
+    /* A refused CONNACK and a missing one both leave the sink disconnected */
+    ASSERT(bme280_mqtt_init(&sink, "gw-6", &config) == BME280_OK);
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    ASSERT(write(sv[1], refused, sizeof(refused)) == (ssize_t)sizeof(refused));
+    ASSERT(bme280_mqtt_connect(&sink, sv[0]) == BME280_ERR_NOT_INIT);
+    ASSERT(sink.fd < 0);
+    close(sv[1]);
+
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    ASSERT(bme280_mqtt_connect(&sink, sv[0]) == BME280_ERR_READ);
+    ASSERT(sink.fd < 0);
+    close(sv[1]);
+
+    /* EOF seen by poll */
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    ASSERT(write(sv[1], accepted, sizeof(accepted)) == (ssize_t)sizeof(accepted));
+    ASSERT(bme280_mqtt_connect(&sink, sv[0]) == BME280_OK);
+    close(sv[1]);
+    ASSERT(bme280_mqtt_poll(&sink, bme280_time_us()) == BME280_ERR_READ);
+    ASSERT(sink.fd < 0);
+    ASSERT(bme280_mqtt_poll(&sink, bme280_time_us()) == BME280_ERR_NOT_INIT);
+
+    /* EOF seen while flush waits for PUBACK; the packet stays for the resend */
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    ASSERT(write(sv[1], accepted, sizeof(accepted)) == (ssize_t)sizeof(accepted));
+    ASSERT(bme280_mqtt_connect(&sink, sv[0]) == BME280_OK);
+    ASSERT(bme280_mqtt_publish(&sink, "site/a", &mqtt_sample, 0) == BME280_OK);
+    close(sv[1]);
+    ASSERT(bme280_mqtt_flush(&sink) == BME280_ERR_READ);
+    ASSERT(sink.fd < 0);
+    ASSERT(sink.inflight == 1);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Sample Log and Uplink Tests
+ ******************************************************************************/
+
+static void temp_path(char *path, size_t len, const char *tag) {
+    snprintf(path, len, "/tmp/bme280-test-%s-%ld", tag, (long)getpid());
+    unlink(path);
+}
+
+static void log_fill(bme280_log_t *log, uint32_t first, uint32_t count) {
+    for (uint32_t i = first; i < first + count; i++) {
+        bme280_log_record_t rec = {
+            1000u * (uint64_t)i, i % 4, BME280_OK,
+            { 20.0f + 0.01f * (float)i, 0.0f, 1000.0f + 0.1f * (float)i, 40.0f }
+        };
+        bme280_log_append(log, &rec);
+    }
+}
+
+static int test_log_append_and_recover(void) {
+    char path[64];
+    bme280_log_t log;
+    bme280_log_record_t recs[4];
+    uint32_t n = 0;
+
+    temp_path(path, sizeof(path), "log");
+    ASSERT(bme280_log_open(&log, path) == BME280_OK);
+    log_fill(&log, 0, 3);
+    ASSERT(bme280_log_count(&log) == 3);
+    ASSERT(bme280_log_read(&log, 1, recs, 4, &n) == BME280_OK);
+    ASSERT(n == 2);
+    ASSERT(recs[0].timestamp_us == 1000u && recs[0].sensor == 1);
+    ASSERT_FLOAT_EQ(20.01f, recs[0].data.temperature_c, 0.0001f);
+    ASSERT_FLOAT_EQ(68.018f, recs[0].data.temperature_f, 0.001f);
+    bme280_log_close(&log);
+
+    /* Torn partial record is trimmed on reopen */
+    int fd = open(path, O_WRONLY | O_APPEND);
+    ASSERT(fd >= 0);
+    ASSERT(write(fd, "torn", 4) == 4);
+    close(fd);
+    ASSERT(bme280_log_open(&log, path) == BME280_OK);
+    ASSERT(log.count == 3);
+    bme280_log_close(&log);
+
+    /* A whole record with a bad CRC at the tail is trimmed too */
+    fd = open(path, O_WRONLY);
+    ASSERT(fd >= 0);
+    ASSERT(pwrite(fd, "X", 1, 2 * BME280_LOG_RECORD_SIZE + 16) == 1);
+    close(fd);
+    ASSERT(bme280_log_open(&log, path) == BME280_OK);
+    ASSERT(log.count == 2);
+    ASSERT(bme280_crc32(0, "123456789", 9) == 0xCBF43926u);
+    bme280_log_close(&log);
+
+    unlink(path);
+    return TEST_PASS;
+}
+
+/* Cap the file size at limit bytes; SIGXFSZ is ignored so writes come back short */
+static int cap_file_size(rlim_t limit, struct rlimit *saved) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_FSIZE, saved) != 0) {
+        return -1;
+    }
+    rl.rlim_cur = limit;
+    rl.rlim_max = saved->rlim_max;
+    signal(SIGXFSZ, SIG_IGN);
+    return setrlimit(RLIMIT_FSIZE, &rl);
+}
+
+static int test_log_short_write_is_trimmed(void) {
+    char path[64];
+    static bme280_collector_t col;
+    bme280_log_t log;
+    bme280_log_record_t recs[4];
+    struct rlimit saved;
+    struct stat st;
+    uint32_t n = 0;
+    int sv[2];
+
+    /* An append cut short by the size limit leaves no partial record behind */
+    temp_path(path, sizeof(path), "log-short");
+    ASSERT(bme280_log_open(&log, path) == BME280_OK);
+    log_fill(&log, 0, 3);
+    ASSERT(cap_file_size(3 * BME280_LOG_RECORD_SIZE + BME280_LOG_RECORD_SIZE / 2, &saved) == 0);
+    bme280_log_record_t rec = { 3000u, 3, BME280_OK, { 20.03f, 0.0f, 1000.3f, 40.0f } };
+    bme280_error_t err = bme280_log_append(&log, &rec);
+    setrlimit(RLIMIT_FSIZE, &saved);
+    ASSERT(err == BME280_ERR_WRITE);
+    ASSERT(fstat(log.fd, &st) == 0 && st.st_size == 3 * BME280_LOG_RECORD_SIZE);
+
+    /* The retry lands on a record boundary */
+    ASSERT(bme280_log_append(&log, &rec) == BME280_OK);
+    ASSERT(bme280_log_count(&log) == 4);
+    ASSERT(bme280_log_read(&log, 0, recs, 4, &n) == BME280_OK);
+    ASSERT(n == 4 && recs[3].timestamp_us == 3000u);
+    bme280_log_close(&log);
+
+    /* The collector cuts a torn batch back to its acknowledged end */
+    uint8_t msg[BME280_UPLINK_HEADER_SIZE + 3 * BME280_LOG_RECORD_SIZE];
+    memset(msg, 0, BME280_UPLINK_HEADER_SIZE);
+    msg[8] = (uint8_t)(3 * BME280_LOG_RECORD_SIZE);  /* u64 offset 0, u32 length */
+    for (int i = 0; i < 3; i++) {
+        rec.timestamp_us = 1000u * (uint64_t)i;
+        bme280_log_encode(&rec, msg + BME280_UPLINK_HEADER_SIZE + i * BME280_LOG_RECORD_SIZE);
+    }
+    unlink(path);
+    ASSERT(bme280_collector_open(&col, path) == BME280_OK);
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    ASSERT(write(sv[1], msg, sizeof(msg)) == (ssize_t)sizeof(msg));
+    shutdown(sv[1], SHUT_WR);
+    ASSERT(cap_file_size(2 * BME280_LOG_RECORD_SIZE + BME280_LOG_RECORD_SIZE / 2, &saved) == 0);
+    err = bme280_collector_serve(&col, sv[0]);
+    setrlimit(RLIMIT_FSIZE, &saved);
+    ASSERT(err == BME280_ERR_WRITE);
+    ASSERT(col.end == 0);
+    ASSERT(fstat(col.log.fd, &st) == 0 && st.st_size == 0);
+    close(sv[0]);
+    close(sv[1]);
+
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    ASSERT(write(sv[1], msg, sizeof(msg)) == (ssize_t)sizeof(msg));
+    shutdown(sv[1], SHUT_WR);
+    ASSERT(bme280_collector_serve(&col, sv[0]) == BME280_OK);
+    ASSERT(col.end == 3u * BME280_LOG_RECORD_SIZE);
+    ASSERT(bme280_log_read(&col.log, 0, recs, 4, &n) == BME280_OK);
+    ASSERT(n == 3 && recs[2].timestamp_us == 2000u);
+    close(sv[0]);
+    close(sv[1]);
+    bme280_collector_close(&col);
+    signal(SIGXFSZ, SIG_DFL);
+
+    unlink(path);
+    return TEST_PASS;
+}
+
+typedef struct {
+    bme280_collector_t col;
+    int                listen_fd;
+    int                sessions;
+    bme280_error_t     result;
+} collector_thread_t;
+
+static void *collector_thread(void *arg) {
+    collector_thread_t *ct = arg;
+
+    for (int i = 0; i < ct->sessions; i++) {
+        int fd = accept(ct->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            ct->result = BME280_ERR_READ;
+            break;
+        }
+        bme280_error_t err = bme280_collector_serve(&ct->col, fd);
+        if (err != BME280_OK) {
+            ct->result = err;
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+static int tcp_listen_local(uint16_t *port) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(fd, 4) != 0 || getsockname(fd, (struct sockaddr *)&addr, &len) != 0) {
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int tcp_connect_local(uint16_t port) {
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        return -1;
+    }
+    return fd;
+}
+
+static int uplink_drain(bme280_uplink_t *up) {
+    for (int i = 0; i < 1000 && bme280_uplink_pending(up) > 0; i++) {
+        if (bme280_uplink_pump(up, 100) != BME280_OK) {
+            return -1;
+        }
+    }
+    return bme280_uplink_pending(up) == 0 ? 0 : -1;
+}
+
+static int test_uplink_resumes_without_duplicates(void) {
+    char log_path[64];
+    char ack_path[64];
+    char col_path[64];
+    static collector_thread_t ct;
+    bme280_log_t log;
+    bme280_uplink_t up;
+    pthread_t thread;
+    uint16_t port = 0;
+    bme280_uplink_config_t config = { 10, 3 };
+
+    temp_path(log_path, sizeof(log_path), "uplink-log");
+    temp_path(ack_path, sizeof(ack_path), "uplink-ack");
+    temp_path(col_path, sizeof(col_path), "uplink-col");
+
+    ASSERT(bme280_log_open(&log, log_path) == BME280_OK);
+    log_fill(&log, 0, 100);
+    ASSERT(bme280_collector_open(&ct.col, col_path) == BME280_OK);
+    ct.listen_fd = tcp_listen_local(&port);
+    ct.sessions = 3;
+    ct.result = BME280_OK;
+    ASSERT(ct.listen_fd >= 0);
+    ASSERT(pthread_create(&thread, NULL, collector_thread, &ct) == 0);
+
+    /* First session: several batches go out before any acknowledgement */
+    ASSERT(bme280_uplink_open(&up, &log, ack_path, &config) == BME280_OK);
+    ASSERT(bme280_uplink_connect(&up, tcp_connect_local(port)) == BME280_OK);
+    ASSERT(bme280_uplink_pump(&up, 0) == BME280_OK);
+    ASSERT(up.stats.batches == 3);
+    ASSERT(uplink_drain(&up) == 0);
+    ASSERT(up.acked == 100u * BME280_LOG_RECORD_SIZE);
+    bme280_uplink_close(&up);
+
+    /* Restart: resumes at the persisted offset and sends only new records */
+    log_fill(&log, 100, 50);
+    ASSERT(bme280_uplink_open(&up, &log, ack_path, &config) == BME280_OK);
+    ASSERT(up.acked == 100u * BME280_LOG_RECORD_SIZE);
+    ASSERT(bme280_uplink_connect(&up, tcp_connect_local(port)) == BME280_OK);
+    ASSERT(uplink_drain(&up) == 0);
+    ASSERT(up.stats.bytes == 50u * BME280_LOG_RECORD_SIZE);
+    bme280_uplink_close(&up);
+
+    /* Lost sidecar: the first window is resent and dropped by the collector,
+     * whose acknowledgement then moves the uplink straight to the end */
+    unlink(ack_path);
+    ASSERT(bme280_uplink_open(&up, &log, ack_path, &config) == BME280_OK);
+    ASSERT(up.acked == 0);
+    ASSERT(bme280_uplink_connect(&up, tcp_connect_local(port)) == BME280_OK);
+    ASSERT(uplink_drain(&up) == 0);
+    ASSERT(up.acked == 150u * BME280_LOG_RECORD_SIZE);
+    bme280_uplink_close(&up);
+
+    pthread_join(thread, NULL);
+    close(ct.listen_fd);
+    ASSERT(ct.result == BME280_OK);
+    ASSERT(ct.col.end == 150u * BME280_LOG_RECORD_SIZE);
+    ASSERT(ct.col.stats.bytes == 150u * BME280_LOG_RECORD_SIZE);
+    ASSERT(ct.col.stats.duplicates == 3u * 10u * BME280_LOG_RECORD_SIZE);
+
+    bme280_log_record_t sent[16];
+    bme280_log_record_t stored[16];
+    uint32_t n_sent = 0;
+    uint32_t n_stored = 0;
+    for (uint64_t i = 0; i < 150; i += 16) {
+        ASSERT(bme280_log_read(&log, i, sent, 16, &n_sent) == BME280_OK);
+        ASSERT(bme280_log_read(&ct.col.log, i, stored, 16, &n_stored) == BME280_OK);
+        ASSERT(n_sent == n_stored);
+        ASSERT(memcmp(sent, stored, n_sent * sizeof(sent[0])) == 0);
+    }
+
+    bme280_collector_close(&ct.col);
+    bme280_log_close(&log);
+    unlink(log_path);
+    unlink(ack_path);
+    unlink(col_path);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * UDP Stream Tests
+ ******************************************************************************/
+
+typedef struct {
+    uint32_t count;
+    uint64_t seqs[64];
+    uint32_t sensors[128];
+} udp_capture_t;
+
+static void udp_capture(void *user, uint32_t stream, uint64_t sequence,
+                        const bme280_log_record_t *rec) {
+    udp_capture_t *cap = user;
+    (void)stream;
+    if (cap->count < 128) {
+        cap->sensors[cap->count] = rec->sensor;
+    }
+    if (cap->count < 64) {
+        cap->seqs[cap->count] = sequence;
+    }
+    cap->count++;
+}
+
+static bme280_log_record_t udp_record(uint32_t sensor) {
+    bme280_log_record_t rec = { sensor, sensor, BME280_OK, { 21.5f, 0.0f, 1001.0f, 45.0f } };
+    return rec;
+}
+
+static int test_udp_loopback_batches(void) {
+    static bme280_udp_sink_t sink;
+    static bme280_udp_receiver_t rx;
+    udp_capture_t cap;
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    memset(&cap, 0, sizeof(cap));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int rx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT(rx_fd >= 0 && tx_fd >= 0);
+    ASSERT(bind(rx_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    ASSERT(getsockname(rx_fd, (struct sockaddr *)&addr, &len) == 0);
+
+    ASSERT(bme280_udp_sink_init(&sink, tx_fd, (struct sockaddr *)&addr, len, 7,
+                                BME280_UDP_MAX_RECORDS + 1) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_udp_sink_init(&sink, tx_fd, (struct sockaddr *)&addr, len, 7, 4) == BME280_OK);
+    ASSERT(bme280_udp_receiver_init(&rx, rx_fd, 8, udp_capture, &cap) == BME280_OK);
+
+    /* 100 records = 25 frames: one full batch of 16, then 9 on flush */
+    for (uint32_t i = 0; i < 100; i++) {
+        bme280_log_record_t rec = udp_record(i);
+        ASSERT(bme280_udp_sink_add(&sink, &rec) == BME280_OK);
+    }
+    ASSERT(bme280_udp_sink_flush(&sink) == BME280_OK);
+    ASSERT(sink.stats.frames == 25);
+    ASSERT(sink.stats.syscalls == 2);
+
+    for (int i = 0; i < 100 && cap.count < 100; i++) {
+        ASSERT(bme280_udp_receiver_poll(&rx, 100) == BME280_OK);
+    }
+    ASSERT(cap.count == 100);
+    for (uint32_t i = 0; i < 100; i++) {
+        ASSERT(cap.sensors[i] == i);
+    }
+    ASSERT(rx.stats.frames == 25);
+    ASSERT(rx.stats.lost == 0);
+    ASSERT(rx.stats.syscalls < rx.stats.frames);
+
+    close(rx_fd);
+    close(tx_fd);
+    return TEST_PASS;
+}
+
+static int test_udp_reorder_and_gaps(void) {
+    static bme280_udp_sink_t sink;
+    static bme280_udp_receiver_t rx;
+    static uint8_t frames[12][BME280_UDP_FRAME_MAX];
+    ssize_t lens[12];
+    udp_capture_t cap;
+    int tx[2];
+    int net[2];
+
+    memset(&cap, 0, sizeof(cap));
+    ASSERT(socketpair(AF_UNIX, SOCK_DGRAM, 0, tx) == 0);
+    ASSERT(socketpair(AF_UNIX, SOCK_DGRAM, 0, net) == 0);
+
+    /* Capture twelve one-record frames, then replay them out of order */
+    ASSERT(bme280_udp_sink_init(&sink, tx[0], NULL, 0, 3, 1) == BME280_OK);
+    for (uint32_t i = 0; i < 12; i++) {
+        bme280_log_record_t rec = udp_record(i);
+        ASSERT(bme280_udp_sink_add(&sink, &rec) == BME280_OK);
+    }
+    ASSERT(bme280_udp_sink_flush(&sink) == BME280_OK);
+    for (int i = 0; i < 12; i++) {
+        lens[i] = recv(tx[1], frames[i], BME280_UDP_FRAME_MAX, 0);
+        ASSERT(lens[i] == BME280_UDP_HEADER_SIZE + BME280_LOG_RECORD_SIZE);
+    }
+
+    ASSERT(bme280_udp_receiver_init(&rx, net[1], 4, udp_capture, &cap) == BME280_OK);
+    static const int order[] = { 0, 2, 1, 4, 5, 2 };
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        ASSERT(send(net[0], frames[order[i]], (size_t)lens[order[i]], 0) == lens[order[i]]);
+    }
+    ASSERT(bme280_udp_receiver_poll(&rx, 100) == BME280_OK);
+
+    /* 0..2 delivered in order; 4 and 5 wait for 3; the second 2 is late */
+    ASSERT(cap.count == 3);
+    ASSERT(cap.seqs[0] == 0 && cap.seqs[1] == 1 && cap.seqs[2] == 2);
+    ASSERT(rx.stats.reordered == 3);
+    ASSERT(rx.stats.late == 1);
+
+    bme280_udp_receiver_flush(&rx);
+    ASSERT(cap.count == 5);
+    ASSERT(cap.seqs[3] == 4 && cap.seqs[4] == 5);
+    ASSERT(rx.stats.lost == 1);
+
+    /* 11 is beyond the window from 6: 6 and 7 are given up immediately */
+    ASSERT(send(net[0], frames[11], (size_t)lens[11], 0) == lens[11]);
+    ASSERT(bme280_udp_receiver_poll(&rx, 100) == BME280_OK);
+    ASSERT(rx.stats.lost == 3);
+    bme280_udp_receiver_flush(&rx);
+    ASSERT(cap.count == 6 && cap.seqs[5] == 11);
+    ASSERT(rx.stats.lost == 6);
+
+    /* Damaged frames are counted and dropped */
+    frames[6][BME280_UDP_HEADER_SIZE + 3] ^= 0xFF;
+    ASSERT(send(net[0], frames[6], (size_t)lens[6], 0) == lens[6]);
+    ASSERT(bme280_udp_receiver_poll(&rx, 100) == BME280_OK);
+    ASSERT(rx.stats.corrupt == 1);
+
+    close(tx[0]);
+    close(tx[1]);
+    close(net[0]);
+    close(net[1]);
+    return TEST_PASS;
+}
+
+static int test_udp_sender_restart(void) {
+    static bme280_udp_sink_t sink;
+    static bme280_udp_receiver_t rx;
+    udp_capture_t cap;
+    int net[2];
+
+    memset(&cap, 0, sizeof(cap));
+    ASSERT(socketpair(AF_UNIX, SOCK_DGRAM, 0, net) == 0);
+    ASSERT(bme280_udp_receiver_init(&rx, net[1], 4, udp_capture, &cap) == BME280_OK);
+
+    /* First run: frames 0..4 */
+    ASSERT(bme280_udp_sink_init(&sink, net[0], NULL, 0, 9, 1) == BME280_OK);
+    uint32_t old_epoch = sink.epoch;
+    for (uint32_t i = 0; i < 5; i++) {
+        bme280_log_record_t rec = udp_record(i);
+        ASSERT(bme280_udp_sink_add(&sink, &rec) == BME280_OK);
+    }
+    ASSERT(bme280_udp_sink_flush(&sink) == BME280_OK);
+    ASSERT(bme280_udp_receiver_poll(&rx, 100) == BME280_OK);
+    ASSERT(cap.count == 5);
+
+    /* Second run starts over at sequence 0 and is delivered, not dropped as late */
+    ASSERT(bme280_udp_sink_init(&sink, net[0], NULL, 0, 9, 1) == BME280_OK);
+    ASSERT(sink.epoch != old_epoch);
+    for (uint32_t i = 100; i < 103; i++) {
+        bme280_log_record_t rec = udp_record(i);
+        ASSERT(bme280_udp_sink_add(&sink, &rec) == BME280_OK);
+    }
+    ASSERT(bme280_udp_sink_flush(&sink) == BME280_OK);
+    ASSERT(bme280_udp_receiver_poll(&rx, 100) == BME280_OK);
+    ASSERT(cap.count == 8);
+    ASSERT(cap.sensors[5] == 100 && cap.seqs[5] == 0 && cap.seqs[7] == 2);
+    ASSERT(rx.stats.restarts == 1);
+    ASSERT(rx.stats.late == 0);
+
+    /* A straggler from the first run is late, and does not restart the stream again */
+    uint32_t new_epoch = sink.epoch;
+    sink.epoch = old_epoch;
+    sink.sequence = 5;
+    bme280_log_record_t rec = udp_record(5);
+    ASSERT(bme280_udp_sink_add(&sink, &rec) == BME280_OK);
+    ASSERT(bme280_udp_sink_flush(&sink) == BME280_OK);
+    sink.epoch = new_epoch;
+    sink.sequence = 3;
+    rec = udp_record(103);
+    ASSERT(bme280_udp_sink_add(&sink, &rec) == BME280_OK);
+    ASSERT(bme280_udp_sink_flush(&sink) == BME280_OK);
+    ASSERT(bme280_udp_receiver_poll(&rx, 100) == BME280_OK);
+    ASSERT(rx.stats.late == 1);
+    ASSERT(rx.stats.restarts == 1);
+    ASSERT(cap.count == 9 && cap.sensors[8] == 103);
+
+    /* A sequence number far ahead is one step of lost frames, not one per number */
+    sink.sequence = (uint64_t)1 << 60;
+    rec = udp_record(104);
+    ASSERT(bme280_udp_sink_add(&sink, &rec) == BME280_OK);
+    ASSERT(bme280_udp_sink_flush(&sink) == BME280_OK);
+    ASSERT(bme280_udp_receiver_poll(&rx, 100) == BME280_OK);
+    ASSERT(rx.stats.lost == ((uint64_t)1 << 60) - 3 - 4);
+    bme280_udp_receiver_flush(&rx);
+    ASSERT(cap.count == 10 && cap.sensors[9] == 104);
+
+    close(net[0]);
+    close(net[1]);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * SLO Monitor Tests
+ ******************************************************************************/
+
+typedef struct {
+    int                count;
+    bme280_slo_alert_t last;
+} slo_capture_t;
+
+static void slo_capture(void *user, const bme280_slo_alert_t *alert) {
+    slo_capture_t *cap = user;
+    cap->count++;
+    cap->last = *alert;
+}
+
+/* 60 s window of 1 s buckets, 5 s short window, alert at 2x burn */
+static const bme280_slo_config_t slo_config = { 60000000u, 5000000u, 2.0f, 10 };
+
+static int test_slo_latency_burn_alert(void) {
+    static bme280_slo_t slo;
+    slo_capture_t cap;
+    bme280_slo_alert_t status;
+    bme280_slo_budget_t budget = { 5000u, 10000000u, 0.9f };
+    uint64_t t = 100000000u;
+
+    memset(&cap, 0, sizeof(cap));
+    ASSERT(bme280_slo_init(&slo, &slo_config, slo_capture, &cap) == BME280_OK);
+    ASSERT(bme280_slo_set_budget(&slo, BME280_SLO_MAX_SENSORS, &budget) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_slo_set_budget(&slo, 3, &budget) == BME280_OK);
+
+    for (int i = 0; i < 20; i++, t += 1000) {
+        ASSERT(bme280_slo_record_read(&slo, 3, t, t + 1000, BME280_OK) == BME280_OK);
+    }
+    ASSERT(cap.count == 0);
+
+    /* 10% error budget at 2x burn: fires once more than 20% of reads are bad */
+    for (int i = 0; i < 10; i++, t += 1000) {
+        bme280_error_t err = (i % 2) ? BME280_ERR_READ : BME280_OK;
+        ASSERT(bme280_slo_record_read(&slo, 3, t, t + 9000, err) == BME280_OK);
+    }
+    ASSERT(cap.count == 1);
+    ASSERT(cap.last.firing == 1);
+    ASSERT(cap.last.sensor == 3);
+    ASSERT(cap.last.kind == BME280_SLO_LATENCY);
+    ASSERT(cap.last.bad == 6 && cap.last.total == 26);
+    ASSERT(cap.last.burn_long > 2.0f);
+
+    /* Healthy again after the short window: clears, long window still burnt */
+    t += 10000000u;
+    ASSERT(bme280_slo_record_read(&slo, 3, t, t + 1000, BME280_OK) == BME280_OK);
+    ASSERT(cap.count == 2);
+    ASSERT(cap.last.firing == 0);
+    ASSERT(cap.last.burn_short == 0.0f);
+    ASSERT(cap.last.burn_long > 2.0f);
+
+    /* Everything slides out of the long window */
+    ASSERT(bme280_slo_status(&slo, 3, BME280_SLO_LATENCY, t + 61000000u, &status) == BME280_OK);
+    ASSERT(status.total == 0);
+    ASSERT(status.burn_long == 0.0f);
+    return TEST_PASS;
+}
+
+static int test_slo_freshness_per_sensor(void) {
+    static bme280_slo_t slo;
+    slo_capture_t cap;
+    bme280_slo_alert_t status;
+    bme280_slo_budget_t budget = { 5000u, 2000000u, 0.99f };
+    uint64_t t = 50000000u;
+
+    memset(&cap, 0, sizeof(cap));
+    ASSERT(bme280_slo_init(&slo, &slo_config, slo_capture, &cap) == BME280_OK);
+    ASSERT(bme280_slo_set_budget(&slo, 5, &budget) == BME280_OK);
+    ASSERT(bme280_slo_set_budget(&slo, 6, &budget) == BME280_OK);
+
+    for (int i = 0; i < 10; i++, t += 100000) {
+        ASSERT(bme280_slo_record_freshness(&slo, 5, t - 5000000u, t) == BME280_OK);
+        ASSERT(bme280_slo_record_freshness(&slo, 6, t - 500000u, t) == BME280_OK);
+    }
+    ASSERT(cap.count == 1);
+    ASSERT(cap.last.sensor == 5);
+    ASSERT(cap.last.kind == BME280_SLO_FRESHNESS);
+    ASSERT(cap.last.total == 10);
+
+    ASSERT(bme280_slo_status(&slo, 6, BME280_SLO_FRESHNESS, t, &status) == BME280_OK);
+    ASSERT(status.firing == 0 && status.bad == 0 && status.total == 10);
+    ASSERT(bme280_slo_status(&slo, 5, BME280_SLO_LATENCY, t, &status) == BME280_OK);
+    ASSERT(status.total == 0);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Quantile Sketch Tests
+ ******************************************************************************/
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Check every percentile against the exact lower quantile of sorted values */
+static int sketch_matches(const bme280_sketch_t *sk, double *values, int n) {
+    qsort(values, (size_t)n, sizeof(values[0]), cmp_double);
+    for (int p = 0; p <= 100; p++) {
+        double q = p / 100.0;
+        double exact = values[(int)(q * (n - 1))];
+        double est;
+        if (bme280_sketch_quantile(sk, q, &est) != BME280_OK
+            || fabs(est - exact) > BME280_SKETCH_DEFAULT_ALPHA * fabs(exact) + 1e-9) {
+            printf("\n    q=%.2f exact=%.6f estimate=%.6f\n", q, exact, est);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int test_sketch_relative_accuracy(void) {
+    static bme280_sketch_t sk;
+    static double values[2000];
+    double est;
+
+    ASSERT(bme280_sketch_init(&sk, 0.0) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_sketch_init(&sk, BME280_SKETCH_DEFAULT_ALPHA) == BME280_OK);
+    ASSERT(bme280_sketch_quantile(&sk, 0.5, &est) == BME280_ERR_INVALID_ARG);
+
+    /* Outdoor temperatures around freezing: negatives, zeros and positives */
+    srand(115);
+    for (int i = 0; i < 2000; i++) {
+        values[i] = (i % 100 == 0) ? 0.0 : -25.0 + 60.0 * rand() / (double)RAND_MAX;
+        ASSERT(bme280_sketch_add(&sk, values[i]) == BME280_OK);
+    }
+    ASSERT(sk.count == 2000);
+    ASSERT(sk.zeros == 20);
+    ASSERT(sketch_matches(&sk, values, 2000));
+    ASSERT(bme280_sketch_quantile(&sk, 1.5, &est) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_sketch_add(&sk, NAN) == BME280_ERR_INVALID_ARG);
+    return TEST_PASS;
+}
+
+static int test_sketch_merge_and_collapse(void) {
+    static bme280_sketch_t a;
+    static bme280_sketch_t b;
+    static bme280_sketch_t all;
+    static bme280_sketch_t coarse;
+    static double values[1000];
+    double est;
+    double exact;
+
+    ASSERT(bme280_sketch_init(&a, BME280_SKETCH_DEFAULT_ALPHA) == BME280_OK);
+    ASSERT(bme280_sketch_init(&b, BME280_SKETCH_DEFAULT_ALPHA) == BME280_OK);
+    ASSERT(bme280_sketch_init(&all, BME280_SKETCH_DEFAULT_ALPHA) == BME280_OK);
+    ASSERT(bme280_sketch_init(&coarse, 0.05) == BME280_OK);
+
+    /* Two sensors in different rooms, merged into one report */
+    for (int i = 0; i < 500; i++) {
+        values[i] = 18.0 + i * 0.01;
+        values[500 + i] = 40.0 + i * 0.05;
+        ASSERT(bme280_sketch_add(&a, values[i]) == BME280_OK);
+        ASSERT(bme280_sketch_add(&b, values[500 + i]) == BME280_OK);
+        ASSERT(bme280_sketch_add(&all, values[i]) == BME280_OK);
+        ASSERT(bme280_sketch_add(&all, values[500 + i]) == BME280_OK);
+    }
+    ASSERT(bme280_sketch_merge(&a, &coarse) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_sketch_merge(&a, &b) == BME280_OK);
+    ASSERT(a.count == 1000);
+    for (int p = 0; p <= 100; p += 5) {
+        ASSERT(bme280_sketch_quantile(&a, p / 100.0, &est) == BME280_OK);
+        ASSERT(bme280_sketch_quantile(&all, p / 100.0, &exact) == BME280_OK);
+        ASSERT(est == exact);
+    }
+    ASSERT(sketch_matches(&a, values, 1000));
+
+    /* Twelve decades exceed the store: small values fold, large stay accurate */
+    ASSERT(bme280_sketch_init(&b, BME280_SKETCH_DEFAULT_ALPHA) == BME280_OK);
+    for (int i = 0; i < 1000; i++) {
+        values[i] = pow(10.0, -6.0 + 12.0 * i / 999.0);
+        ASSERT(bme280_sketch_add(&b, values[i]) == BME280_OK);
+    }
+    ASSERT(b.positive.count == 1000);
+    ASSERT(bme280_sketch_quantile(&b, 0.99, &est) == BME280_OK);
+    exact = values[(int)(0.99 * 999)];
+    ASSERT(fabs(est - exact) <= BME280_SKETCH_DEFAULT_ALPHA * exact);
+    ASSERT(bme280_sketch_quantile(&b, 0.0, &est) == BME280_OK);
+    ASSERT(est == values[0]);
+    ASSERT(bme280_sketch_quantile(&b, 1.0, &est) == BME280_OK);
+    ASSERT(est == values[999]);
+    return TEST_PASS;
+}
+
+static int test_sketch_set_hourly_roll(void) {
+    static bme280_sketch_set_t set;
+    static bme280_sketch_set_t closed;
+    const uint64_t hour = 3600000000u;
+    bme280_data_t data = { 21.0f, 69.8f, 1012.0f, 45.0f };
+    int rolled = -1;
+    double p50;
+
+    ASSERT(bme280_sketch_set_init(&set, BME280_SKETCH_DEFAULT_ALPHA, 0) == BME280_OK);
+    ASSERT(bme280_sketch_set_roll(&set, hour, hour / 2, &data, &closed, &rolled) == BME280_OK);
+    ASSERT(rolled == 0);
+    data.temperature_c = 23.0f;
+    ASSERT(bme280_sketch_set_roll(&set, hour, hour - 1, &data, &closed, &rolled) == BME280_OK);
+    ASSERT(rolled == 0);
+    ASSERT(bme280_sketch_set_roll(&set, hour, hour + 5, &data, &closed, &rolled) == BME280_OK);
+    ASSERT(rolled == 1);
+
+    ASSERT(closed.start_us == 0);
+    ASSERT(closed.temperature.count == 2);
+    ASSERT(closed.humidity.count == 2);
+    ASSERT(set.start_us == hour);
+    ASSERT(set.temperature.count == 1);
+    ASSERT(bme280_sketch_quantile(&closed.temperature, 0.0, &p50) == BME280_OK);
+    ASSERT_FLOAT_EQ(21.0f, (float)p50, 0.001f);
+
+    /* Daily roll-up from hourly sets */
+    ASSERT(bme280_sketch_set_merge(&closed, &set) == BME280_OK);
+    ASSERT(closed.pressure.count == 3);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Historian Compression Tests
+ ******************************************************************************/
+
+#define COMPRESS_SAMPLES 10000
+
+/* Slow diurnal-like swing with a little sensor noise, one sample per second */
+static float compress_signal(uint32_t i) {
+    float noise = (float)((i * 2654435761u) >> 24) / 255.0f * 0.02f - 0.01f;
+    return 20.0f + 2.0f * sinf(2.0f * 3.14159265f * (float)i / 3600.0f) + noise;
+}
+
+/* Run the whole signal through c; returns emitted point count */
+static uint32_t compress_run(bme280_compressor_t *c, bme280_point_t *points, uint32_t max) {
+    uint32_t n = 0;
+    bme280_point_t out;
+    int emitted;
+
+    for (uint32_t i = 0; i < COMPRESS_SAMPLES; i++) {
+        bme280_point_t p = { 1000000u * (uint64_t)i, compress_signal(i) };
+        bme280_compress_push(c, &p, &out, &emitted);
+        if (emitted && n < max) {
+            points[n++] = out;
+        }
+    }
+    bme280_compress_flush(c, &out, &emitted);
+    if (emitted && n < max) {
+        points[n++] = out;
+    }
+    return n;
+}
+
+static int test_compress_swinging_door_bound(void) {
+    static bme280_point_t points[COMPRESS_SAMPLES];
+    bme280_compressor_t sdt;
+
+    ASSERT(bme280_compress_init(&sdt, BME280_COMPRESS_SWINGING_DOOR, -1.0f, 0) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_compress_init(&sdt, BME280_COMPRESS_SWINGING_DOOR, 0.05f, 0) == BME280_OK);
+    uint32_t n = compress_run(&sdt, points, COMPRESS_SAMPLES);
+
+    ASSERT(sdt.stats.points_in == COMPRESS_SAMPLES);
+    ASSERT(sdt.stats.points_out == n);
+    ASSERT(n * 20 < COMPRESS_SAMPLES);
+    ASSERT(points[0].timestamp_us == 0);
+    ASSERT(points[n - 1].timestamp_us == 1000000u * (uint64_t)(COMPRESS_SAMPLES - 1));
+
+    /* Linear interpolation between emitted points stays within the deviation */
+    uint32_t seg = 0;
+    for (uint32_t i = 0; i < COMPRESS_SAMPLES; i++) {
+        uint64_t t = 1000000u * (uint64_t)i;
+        while (seg + 1 < n - 1 && points[seg + 1].timestamp_us < t) {
+            seg++;
+        }
+        const bme280_point_t *a = &points[seg];
+        const bme280_point_t *b = &points[seg + 1];
+        double f = (double)(t - a->timestamp_us) / (double)(b->timestamp_us - a->timestamp_us);
+        double rebuilt = a->value + f * (b->value - a->value);
+        ASSERT(fabs(rebuilt - compress_signal(i)) <= 0.05 + 1e-4);
+    }
+    return TEST_PASS;
+}
+
+static int test_compress_deadband_bound(void) {
+    static bme280_point_t points[COMPRESS_SAMPLES];
+    bme280_compressor_t db;
+
+    ASSERT(bme280_compress_init(&db, BME280_COMPRESS_DEADBAND, 0.05f, 0) == BME280_OK);
+    uint32_t n = compress_run(&db, points, COMPRESS_SAMPLES);
+    ASSERT(n * 5 < COMPRESS_SAMPLES);
+
+    /* Holding the last emitted value stays within the deviation */
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < COMPRESS_SAMPLES; i++) {
+        uint64_t t = 1000000u * (uint64_t)i;
+        while (last + 1 < n && points[last + 1].timestamp_us <= t) {
+            last++;
+        }
+        ASSERT(fabsf(points[last].value - compress_signal(i)) <= 0.05f + 1e-5f);
+    }
+    return TEST_PASS;
+}
+
+static void compress_count(void *user, bme280_channel_t channel, const bme280_point_t *point) {
+    uint32_t *counts = user;
+    (void)point;
+    counts[channel]++;
+}
+
+static int test_compress_sample_channels(void) {
+    bme280_compress_sample_t cs;
+    const float deviation[BME280_CHANNEL_COUNT] = { 0.1f, 0.05f, 0.5f };
+    uint32_t counts[BME280_CHANNEL_COUNT] = { 0, 0, 0 };
+
+    ASSERT(bme280_compress_sample_init(&cs, BME280_COMPRESS_SWINGING_DOOR, deviation, 60000000u) == BME280_OK);
+
+    /* Steady temperature, linearly falling pressure, steady humidity for 10 minutes */
+    for (uint32_t i = 0; i < 600; i++) {
+        bme280_data_t data = { 21.0f, 69.8f, 1013.0f - 0.001f * (float)i, 45.0f };
+        ASSERT(bme280_compress_sample_push(&cs, 1000000u * (uint64_t)i, &data, compress_count, counts) == BME280_OK);
+    }
+
+    /* Only the heartbeat forces points: the first, then one per minute */
+    ASSERT(counts[BME280_CHANNEL_TEMPERATURE] == 11);
+    ASSERT(counts[BME280_CHANNEL_PRESSURE] == 11);
+    ASSERT(counts[BME280_CHANNEL_HUMIDITY] == 11);
+
+    bme280_data_t data = { 21.0f, 69.8f, 1013.0f, 45.0f };
+    ASSERT(bme280_compress_sample_push(&cs, 0, &data, compress_count, counts) == BME280_ERR_INVALID_ARG);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Differential Encoding Tests
+ ******************************************************************************/
+
+#define DIFF_SENSORS 16
+#define DIFF_SWEEPS  500
+
+static uint32_t diff_rng = 117;
+
+static int32_t diff_noise(int32_t span) {
+    diff_rng = diff_rng * 1103515245u + 12345u;
+    return (int32_t)((diff_rng >> 16) % (uint32_t)(2 * span + 1)) - span;
+}
+
+/* One room: shared weather drift, fixed per-sensor offsets, small noise */
+static void diff_simulate(bme280_raw_t sweeps[DIFF_SWEEPS][DIFF_SENSORS],
+                          uint8_t present[DIFF_SWEEPS][DIFF_SENSORS]) {
+    int32_t offsets[DIFF_SENSORS][3];
+    int32_t t = 519888;
+    int32_t p = 415148;
+    int32_t h = 30000;
+
+    for (int i = 0; i < DIFF_SENSORS; i++) {
+        for (int c = 0; c < 3; c++) {
+            offsets[i][c] = diff_noise(2000);
+        }
+    }
+    for (int k = 0; k < DIFF_SWEEPS; k++) {
+        t += diff_noise(40);
+        p += diff_noise(60);
+        h += diff_noise(30);
+        for (int i = 0; i < DIFF_SENSORS; i++) {
+            sweeps[k][i].adc_t = t + offsets[i][0] + diff_noise(3);
+            sweeps[k][i].adc_p = p + offsets[i][1] + diff_noise(3);
+            sweeps[k][i].adc_h = h + offsets[i][2] + diff_noise(3);
+            /* Sensor 5 drops out now and then; so does everyone at sweep 250 */
+            present[k][i] = !((i == 5 && k % 37 == 3) || (k == 250 && i % 2 == 0));
+        }
+    }
+}
+
+/* Encode and decode every sweep; returns total bytes or 0 on mismatch */
+static size_t diff_roundtrip(bme280_diff_mode_t mode, bme280_raw_t sweeps[DIFF_SWEEPS][DIFF_SENSORS],
+                             uint8_t present[DIFF_SWEEPS][DIFF_SENSORS]) {
+    static bme280_diff_t enc;
+    static bme280_diff_t dec;
+    uint8_t buf[BME280_DIFF_MAX_BYTES];
+    size_t total = 0;
+
+    if (bme280_diff_init(&enc, mode, DIFF_SENSORS, BME280_DIFF_AUTO_REF, 100) != BME280_OK
+        || bme280_diff_init(&dec, mode, DIFF_SENSORS, BME280_DIFF_AUTO_REF, 100) != BME280_OK) {
+        return 0;
+    }
+
+    for (int k = 0; k < DIFF_SWEEPS; k++) {
+        bme280_raw_t out[DIFF_SENSORS];
+        uint8_t got[DIFF_SENSORS];
+        size_t len = 0;
+        size_t used = 0;
+
+        if (bme280_diff_encode(&enc, sweeps[k], present[k], buf, sizeof(buf), &len) != BME280_OK
+            || bme280_diff_decode(&dec, buf, len, out, got, &used) != BME280_OK
+            || used != len) {
+            return 0;
+        }
+        for (int i = 0; i < DIFF_SENSORS; i++) {
+            if (got[i] != present[k][i]
+                || (got[i] && memcmp(&out[i], &sweeps[k][i], sizeof(out[i])) != 0)) {
+                return 0;
+            }
+        }
+        total += len;
+    }
+    return total;
+}
+
+static int test_diff_roundtrip_and_gain(void) {
+    static bme280_raw_t sweeps[DIFF_SWEEPS][DIFF_SENSORS];
+    static uint8_t present[DIFF_SWEEPS][DIFF_SENSORS];
+
+    diff_simulate(sweeps, present);
+    size_t delta = diff_roundtrip(BME280_DIFF_DELTA, sweeps, present);
+    size_t reference = diff_roundtrip(BME280_DIFF_REFERENCE, sweeps, present);
+
+    ASSERT(delta > 0);
+    ASSERT(reference > 0);
+    /* Both far below 12 bytes per sensor per sweep; residuals beat deltas */
+    ASSERT(delta < (size_t)DIFF_SWEEPS * DIFF_SENSORS * 12 / 4);
+    ASSERT(reference * 20 < delta * 17);
+    return TEST_PASS;
+}
+
+static int test_diff_decode_errors(void) {
+    bme280_diff_t enc;
+    bme280_diff_t dec;
+    bme280_raw_t sweep[2] = { { 519888, 415148, 30000 }, { 519900, 415150, 30010 } };
+    bme280_raw_t out[2];
+    uint8_t got[2];
+    uint8_t buf[BME280_DIFF_MAX_BYTES];
+    uint8_t second[BME280_DIFF_MAX_BYTES];
+    size_t len;
+    size_t len2;
+    size_t used;
+
+    ASSERT(bme280_diff_init(&enc, BME280_DIFF_REFERENCE, 2, 2, 0) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_diff_init(&enc, BME280_DIFF_REFERENCE, 2, 1, 0) == BME280_OK);
+    ASSERT(bme280_diff_init(&dec, BME280_DIFF_REFERENCE, 2, 1, 0) == BME280_OK);
+    ASSERT(bme280_diff_encode(&enc, sweep, NULL, buf, 2, &len) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_diff_encode(&enc, sweep, NULL, buf, sizeof(buf), &len) == BME280_OK);
+    ASSERT(bme280_diff_encode(&enc, sweep, NULL, second, sizeof(second), &len2) == BME280_OK);
+
+    /* A delta sweep cannot be decoded before its keyframe */
+    ASSERT(bme280_diff_decode(&dec, second, len2, out, got, &used) == BME280_ERR_NOT_INIT);
+    ASSERT(bme280_diff_decode(&dec, buf, len - 1, out, got, &used) == BME280_ERR_READ);
+    ASSERT(bme280_diff_decode(&dec, buf, len, out, got, &used) == BME280_OK);
+    ASSERT(dec.reference == 1);
+    ASSERT(bme280_diff_decode(&dec, second, len2, out, got, &used) == BME280_OK);
+    ASSERT(out[0].adc_t == 519888 && out[1].adc_h == 30010);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Segment Tests
+ ******************************************************************************/
+
+#define SEGMENT_SENSORS  8
+#define SEGMENT_SWEEPS   512
+#define SEGMENT_BLOCK    32
+
+static bme280_segment_writer_t seg_writer;
+static bme280_segment_reader_t seg_reader;
+
+static void segment_burst(uint32_t sweep, uint32_t sensor, uint8_t burst[8]) {
+    uint32_t adc_t = 519888 + sweep * 3 + sensor * 100;
+    burst[0] = 0x65;
+    burst[1] = 0x5A;
+    burst[2] = 0xC0;
+    burst[3] = (uint8_t)(adc_t >> 12);
+    burst[4] = (uint8_t)(adc_t >> 4);
+    burst[5] = (uint8_t)(adc_t << 4);
+    burst[6] = 0x75;
+    burst[7] = (uint8_t)(0x30 + sensor);
+}
+
+static int test_segment_roundtrip_and_skip(void) {
+    char path[64];
+    bme280_calib_t calib[SEGMENT_SENSORS];
+    uint8_t burst[8];
+
+    temp_path(path, sizeof(path), "segment");
+    for (uint32_t s = 0; s < SEGMENT_SENSORS; s++) {
+        memset(&calib[s], 0, sizeof(calib[s]));
+        calib[s].temp.dig_T1 = 27504;
+        calib[s].temp.dig_T2 = (int16_t)(26435 + s);
+        calib[s].temp.dig_T3 = -1000;
+        calib[s].press.dig_P1 = 36477;
+        calib[s].press.dig_P2 = -10685;
+        calib[s].press.dig_P9 = 6000;
+        calib[s].hum.dig_H1 = 75;
+        calib[s].hum.dig_H2 = 362;
+        calib[s].hum.dig_H4 = (int16_t)(300 + s);   /* 12-bit fields */
+        calib[s].hum.dig_H5 = (int16_t)(50 + s);
+        calib[s].hum.dig_H6 = 30;
+    }
+
+    ASSERT(bme280_segment_create(&seg_writer, path, calib, SEGMENT_SENSORS, 0) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_segment_create(&seg_writer, path, calib, SEGMENT_SENSORS, SEGMENT_BLOCK) == BME280_OK);
+    for (uint32_t i = 0; i < SEGMENT_SWEEPS; i++) {
+        for (uint32_t s = 0; s < SEGMENT_SENSORS; s++) {
+            segment_burst(i, s, burst);
+            ASSERT(bme280_segment_append(&seg_writer, 1000000ull * i, s, burst) == BME280_OK);
+        }
+    }
+    /* Sensor 7 alone for a while: blocks whose sensor range excludes 0 */
+    for (uint32_t i = SEGMENT_SWEEPS; i < SEGMENT_SWEEPS + 4 * SEGMENT_BLOCK; i++) {
+        segment_burst(i, 7, burst);
+        ASSERT(bme280_segment_append(&seg_writer, 1000000ull * i, 7, burst) == BME280_OK);
+    }
+    ASSERT(bme280_segment_append(&seg_writer, 0, 0, burst) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_segment_append(&seg_writer, 1000000ull * 1000, SEGMENT_SENSORS, burst)
+           == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_segment_finish(&seg_writer) == BME280_OK);
+
+    ASSERT(bme280_segment_open(&seg_reader, path) == BME280_OK);
+    ASSERT(seg_reader.sensors == SEGMENT_SENSORS);
+    for (uint32_t s = 0; s < SEGMENT_SENSORS; s++) {
+        ASSERT(memcmp(&seg_reader.calib[s].temp, &calib[s].temp, sizeof(calib[s].temp)) == 0);
+        ASSERT(memcmp(&seg_reader.calib[s].press, &calib[s].press, sizeof(calib[s].press)) == 0);
+        ASSERT(seg_reader.calib[s].hum.dig_H4 == calib[s].hum.dig_H4);
+        ASSERT(seg_reader.calib[s].hum.dig_H5 == calib[s].hum.dig_H5);
+        ASSERT(seg_reader.calib[s].hum.dig_H6 == calib[s].hum.dig_H6);
+    }
+
+    /* Full scan returns every record in order */
+    bme280_segment_record_t rec;
+    uint32_t count = 0;
+    uint64_t last = 0;
+    while (bme280_segment_next(&seg_reader, &rec) > 0) {
+        ASSERT(rec.timestamp_us >= last);
+        last = rec.timestamp_us;
+        count++;
+    }
+    ASSERT(count == SEGMENT_SWEEPS * SEGMENT_SENSORS + 4 * SEGMENT_BLOCK);
+
+    /* Ten seconds of sensor 3 touches three of the 132 blocks */
+    bme280_segment_query_t q = { 100000000u, 109000000u, 3, 3 };
+    bme280_data_t data;
+    bme280_raw_t raw;
+    bme280_data_t expect;
+    memset(&seg_reader.stats, 0, sizeof(seg_reader.stats));
+    ASSERT(bme280_segment_seek(&seg_reader, &q) == BME280_OK);
+    count = 0;
+    while (bme280_segment_next(&seg_reader, &rec) > 0) {
+        ASSERT(rec.sensor == 3);
+        ASSERT(rec.timestamp_us == 1000000ull * (100 + count));
+        ASSERT(bme280_segment_compensate(&seg_reader, &rec, &data) == BME280_OK);
+        segment_burst(100 + count, 3, burst);
+        bme280_unpack_raw(burst, &raw);
+        bme280_compensate(&calib[3], &raw, &expect, NULL);
+        ASSERT_FLOAT_EQ(expect.temperature_c, data.temperature_c, 1e-6f);
+        ASSERT_FLOAT_EQ(expect.humidity_rh, data.humidity_rh, 1e-6f);
+        count++;
+    }
+    ASSERT(count == 10);
+    ASSERT(seg_reader.stats.blocks_read == 3);
+    ASSERT(seg_reader.stats.blocks_skipped == 25);   /* Then stops at the first later block */
+
+    /* Sensor 0 over everything skips the sensor-7-only tail */
+    q.ts_min = 0;
+    q.ts_max = UINT64_MAX;
+    q.sensor_min = 0;
+    q.sensor_max = 0;
+    memset(&seg_reader.stats, 0, sizeof(seg_reader.stats));
+    ASSERT(bme280_segment_seek(&seg_reader, &q) == BME280_OK);
+    count = 0;
+    while (bme280_segment_next(&seg_reader, &rec) > 0) {
+        count++;
+    }
+    ASSERT(count == SEGMENT_SWEEPS);
+    ASSERT(seg_reader.stats.blocks_read == SEGMENT_SWEEPS * SEGMENT_SENSORS / SEGMENT_BLOCK);
+    ASSERT(seg_reader.stats.blocks_skipped == 4);
+
+    bme280_segment_close(&seg_reader);
+    unlink(path);
+    return TEST_PASS;
+}
+
+static int test_segment_corruption(void) {
+    char path[64];
+    bme280_calib_t calib;
+    uint8_t burst[8] = { 0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00, 0x75, 0x30 };
+    bme280_segment_record_t rec;
+
+    temp_path(path, sizeof(path), "segment-bad");
+    memset(&calib, 0, sizeof(calib));
+    ASSERT(bme280_segment_open(&seg_reader, path) == BME280_ERR_BUS_OPEN);
+    ASSERT(bme280_segment_append(NULL, 0, 0, burst) == BME280_ERR_NULL_PTR);
+
+    ASSERT(bme280_segment_create(&seg_writer, path, &calib, 1, 4) == BME280_OK);
+    for (uint32_t i = 0; i < 8; i++) {
+        ASSERT(bme280_segment_append(&seg_writer, i, 0, burst) == BME280_OK);
+    }
+    ASSERT(bme280_segment_finish(&seg_writer) == BME280_OK);
+    ASSERT(bme280_segment_append(&seg_writer, 9, 0, burst) == BME280_ERR_NOT_INIT);
+
+    /* Flip a bit in the second block's last record */
+    int fd = open(path, O_RDWR);
+    ASSERT(fd >= 0);
+    off_t at = BME280_SEGMENT_HEADER_SIZE + BME280_SEGMENT_CALIB_SIZE
+             + 2 * BME280_SEGMENT_BLOCK_HEADER + 7 * BME280_SEGMENT_RECORD_SIZE + 10;
+    uint8_t byte = 0;
+    ASSERT(pread(fd, &byte, 1, at) == 1);
+    byte ^= 0x10;
+    ASSERT(pwrite(fd, &byte, 1, at) == 1);
+    close(fd);
+
+    ASSERT(bme280_segment_open(&seg_reader, path) == BME280_OK);
+    for (int i = 0; i < 4; i++) {
+        ASSERT(bme280_segment_next(&seg_reader, &rec) == 1);
+    }
+    ASSERT(bme280_segment_next(&seg_reader, &rec) < 0);
+    bme280_segment_close(&seg_reader);
+
+    /* A block cut short by a crash ends the scan like a short header */
+    ASSERT(bme280_segment_create(&seg_writer, path, &calib, 1, 4) == BME280_OK);
+    for (uint32_t i = 0; i < 8; i++) {
+        ASSERT(bme280_segment_append(&seg_writer, i, 0, burst) == BME280_OK);
+    }
+    ASSERT(bme280_segment_finish(&seg_writer) == BME280_OK);
+    ASSERT(truncate(path, at) == 0);
+    ASSERT(bme280_segment_open(&seg_reader, path) == BME280_OK);
+    for (int i = 0; i < 4; i++) {
+        ASSERT(bme280_segment_next(&seg_reader, &rec) == 1);
+    }
+    ASSERT(bme280_segment_next(&seg_reader, &rec) == 0);
+    ASSERT(bme280_segment_next(&seg_reader, &rec) == 0);
+    bme280_segment_close(&seg_reader);
+
+    /* Not a segment at all */
+    fd = open(path, O_WRONLY | O_TRUNC);
+    ASSERT(fd >= 0);
+    ASSERT(write(fd, "BME280 not a segment", 20) == 20);
+    close(fd);
+    ASSERT(bme280_segment_open(&seg_reader, path) == BME280_ERR_INVALID_ARG);
+
+    unlink(path);
+    return TEST_PASS;
+}
+
+static int test_segment_write_failure(void) {
+    char path[64];
+    bme280_calib_t calib;
+    uint8_t burst[8] = { 0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00, 0x75, 0x30 };
+    bme280_segment_record_t rec;
+
+    temp_path(path, sizeof(path), "segment-full");
+    memset(&calib, 0, sizeof(calib));
+    ASSERT(bme280_segment_create(&seg_writer, path, &calib, 1, 4) == BME280_OK);
+    ASSERT(bme280_segment_append(&seg_writer, 0, 0, burst) == BME280_OK);
+
+    /* Disk full: the block is kept, and nothing is added past it */
+    int file_fd = dup(seg_writer.fd);
+    int full_fd = open("/dev/full", O_WRONLY);
+    ASSERT(file_fd >= 0 && full_fd >= 0);
+    ASSERT(dup2(full_fd, seg_writer.fd) == seg_writer.fd);
+    close(full_fd);
+    for (uint32_t i = 1; i < 4; i++) {
+        bme280_error_t expect = i == 3 ? BME280_ERR_WRITE : BME280_OK;
+        ASSERT(bme280_segment_append(&seg_writer, i, 0, burst) == expect);
+    }
+    for (uint32_t i = 4; i < 20; i++) {
+        ASSERT(bme280_segment_append(&seg_writer, i, 0, burst) == BME280_ERR_WRITE);
+        ASSERT(seg_writer.block.count == 4);
+    }
+
+    /* Space again: the held block goes out first and the segment reads back whole */
+    ASSERT(dup2(file_fd, seg_writer.fd) == seg_writer.fd);
+    close(file_fd);
+    for (uint32_t i = 4; i < 6; i++) {
+        ASSERT(bme280_segment_append(&seg_writer, i, 0, burst) == BME280_OK);
+    }
+    ASSERT(bme280_segment_finish(&seg_writer) == BME280_OK);
+
+    ASSERT(bme280_segment_open(&seg_reader, path) == BME280_OK);
+    uint32_t count = 0;
+    while (bme280_segment_next(&seg_reader, &rec) > 0) {
+        ASSERT(rec.timestamp_us == count);
+        count++;
+    }
+    ASSERT(count == 6);
+    bme280_segment_close(&seg_reader);
+
+    unlink(path);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Snapshot Tests
+ ******************************************************************************/
+
+static bme280_slo_t snap_slo;
+static bme280_slo_t snap_slo_restored;
+static bme280_sketch_set_t snap_sketch;
+static bme280_sketch_set_t snap_sketch_restored;
+static bme280_snapshot_writer_t snap_writer;
+static bme280_snapshot_reader_t snap_reader;
+
+static int test_snapshot_roundtrip(void) {
+    char path[64];
+    bme280_ctx_t ctx;
+    bme280_ctx_t restored;
+    bme280_compress_sample_t cs;
+    bme280_compress_sample_t cs_restored;
+    const float dev[BME280_CHANNEL_COUNT] = { 0.05f, 0.02f, 0.5f };
+    bme280_slo_config_t cfg = { 60000000u, 5000000u, 2.0f, 10 };
+    uint32_t emitted[BME280_CHANNEL_COUNT] = { 0, 0, 0 };
+
+    temp_path(path, sizeof(path), "snapshot");
+
+    memset(&ctx, 0, sizeof(ctx));
+    fake_bus_calibrate(&ctx);
+    ctx.t_fine = 128422;
+    ctx.ctrl_hum = 0x01;
+    ctx.ctrl_meas = 0x27;
+    ctx.config = 0xA0;
+    ctx.cache.ttl_us = 250000u;
+
+    ASSERT(bme280_slo_init(&snap_slo, &cfg, NULL, NULL) == BME280_OK);
+    ASSERT(bme280_sketch_set_init(&snap_sketch, BME280_SKETCH_DEFAULT_ALPHA, 3600000000u) == BME280_OK);
+    ASSERT(bme280_compress_sample_init(&cs, BME280_COMPRESS_SWINGING_DOOR, dev, 600000000u) == BME280_OK);
+    for (uint32_t i = 0; i < 200; i++) {
+        uint64_t t = 1000000ull * i;
+        bme280_data_t d = { 20.0f + (float)i * 0.01f, 0.0f, 1013.0f - (float)i * 0.003f,
+                            40.0f + (float)(i % 7) };
+        bme280_slo_record_read(&snap_slo, i % 4, t, t + (i % 5 == 0 ? 2000000u : 1000u), BME280_OK);
+        bme280_sketch_set_add(&snap_sketch, &d);
+        ASSERT(bme280_compress_sample_push(&cs, t, &d, compress_count, emitted) == BME280_OK);
+    }
+
+    ASSERT(bme280_snapshot_begin(&snap_writer, path) == BME280_OK);
+    ASSERT(bme280_snapshot_put_ctx(&snap_writer, 7, &ctx) == BME280_OK);
+    ASSERT(bme280_snapshot_put_slo(&snap_writer, &snap_slo) == BME280_OK);
+    ASSERT(bme280_snapshot_put_sketch_set(&snap_writer, 7, &snap_sketch) == BME280_OK);
+    ASSERT(bme280_snapshot_put_compress(&snap_writer, 7, &cs) == BME280_OK);
+    ASSERT(bme280_snapshot_commit(&snap_writer) == BME280_OK);
+
+    /* Restore into cold state */
+    memset(&restored, 0, sizeof(restored));
+    restored.cache.valid = 1;
+    ASSERT(bme280_slo_init(&snap_slo_restored, &cfg, NULL, NULL) == BME280_OK);
+    ASSERT(bme280_snapshot_open(&snap_reader, path) == BME280_OK);
+    ASSERT(snap_reader.sections == 4);
+    ASSERT(bme280_snapshot_get_ctx(&snap_reader, 7, &restored) == BME280_OK);
+    ASSERT(bme280_snapshot_get_ctx(&snap_reader, 8, &restored) == BME280_ERR_NOT_INIT);
+    ASSERT(bme280_snapshot_get_slo(&snap_reader, &snap_slo_restored) == BME280_OK);
+    ASSERT(bme280_snapshot_get_sketch_set(&snap_reader, 7, &snap_sketch_restored) == BME280_OK);
+    ASSERT(bme280_snapshot_get_compress(&snap_reader, 7, &cs_restored) == BME280_OK);
+    bme280_snapshot_close(&snap_reader);
+
+    ASSERT(memcmp(&restored.calib.temp, &ctx.calib.temp, sizeof(ctx.calib.temp)) == 0);
+    ASSERT(memcmp(&restored.calib.press, &ctx.calib.press, sizeof(ctx.calib.press)) == 0);
+    ASSERT(restored.calib.hum.dig_H4 == ctx.calib.hum.dig_H4);
+    ASSERT(restored.calib.hum.dig_H5 == ctx.calib.hum.dig_H5);
+    ASSERT(restored.t_fine == ctx.t_fine);
+    ASSERT(restored.ctrl_meas == 0x27 && restored.config == 0xA0 && restored.ctrl_hum == 0x01);
+    ASSERT(restored.cache.ttl_us == 250000u);
+    ASSERT(restored.cache.valid == 0);
+
+    /* Windows continue exactly where they stopped */
+    for (uint32_t s = 0; s < 4; s++) {
+        bme280_slo_alert_t a;
+        bme280_slo_alert_t b;
+        ASSERT(bme280_slo_status(&snap_slo, s, BME280_SLO_LATENCY, 200000000u, &a) == BME280_OK);
+        ASSERT(bme280_slo_status(&snap_slo_restored, s, BME280_SLO_LATENCY, 200000000u, &b) == BME280_OK);
+        ASSERT(a.total == b.total && a.bad == b.bad && a.total > 0);
+    }
+    double q1;
+    double q2;
+    ASSERT(bme280_sketch_quantile(&snap_sketch.temperature, 0.9, &q1) == BME280_OK);
+    ASSERT(bme280_sketch_quantile(&snap_sketch_restored.temperature, 0.9, &q2) == BME280_OK);
+    ASSERT(q1 == q2);
+    ASSERT(snap_sketch_restored.start_us == 3600000000u);
+    ASSERT(snap_sketch_restored.humidity.count == 200);
+
+    for (int ch = 0; ch < BME280_CHANNEL_COUNT; ch++) {
+        bme280_point_t p = { 200000000u, 25.0f + (float)ch };
+        bme280_point_t out1;
+        bme280_point_t out2;
+        int e1;
+        int e2;
+        ASSERT(bme280_compress_push(&cs.channels[ch], &p, &out1, &e1) == BME280_OK);
+        ASSERT(bme280_compress_push(&cs_restored.channels[ch], &p, &out2, &e2) == BME280_OK);
+        ASSERT(e1 == e2);
+        ASSERT(!e1 || (out1.timestamp_us == out2.timestamp_us && out1.value == out2.value));
+        ASSERT(cs.channels[ch].stats.points_in == 201);
+        ASSERT(cs.channels[ch].stats.points_out == cs_restored.channels[ch].stats.points_out);
+    }
+    ASSERT(emitted[BME280_CHANNEL_TEMPERATURE] > 0);
+
+    unlink(path);
+    return TEST_PASS;
+}
+
+static int test_snapshot_damage(void) {
+    char path[64];
+    char tmp[80];
+    bme280_ctx_t ctx;
+    struct stat st;
+
+    temp_path(path, sizeof(path), "snapshot-bad");
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    memset(&ctx, 0, sizeof(ctx));
+    fake_bus_calibrate(&ctx);
+
+    ASSERT(bme280_snapshot_open(&snap_reader, path) == BME280_ERR_BUS_OPEN);
+    ASSERT(bme280_snapshot_put_ctx(NULL, 0, &ctx) == BME280_ERR_NULL_PTR);
+
+    ASSERT(bme280_snapshot_begin(&snap_writer, path) == BME280_OK);
+    ASSERT(bme280_snapshot_put_ctx(&snap_writer, 1, &ctx) == BME280_OK);
+    ASSERT(bme280_snapshot_commit(&snap_writer) == BME280_OK);
+    ASSERT(bme280_snapshot_put_ctx(&snap_writer, 2, &ctx) == BME280_ERR_NOT_INIT);
+
+    /* An aborted snapshot leaves the committed one untouched */
+    ASSERT(bme280_snapshot_begin(&snap_writer, path) == BME280_OK);
+    ASSERT(bme280_snapshot_put_ctx(&snap_writer, 2, &ctx) == BME280_OK);
+    bme280_snapshot_abort(&snap_writer);
+    ASSERT(stat(tmp, &st) != 0);
+    ASSERT(bme280_snapshot_open(&snap_reader, path) == BME280_OK);
+    ASSERT(snap_reader.sections == 1);
+    ASSERT(bme280_snapshot_get_slo(&snap_reader, &snap_slo) == BME280_ERR_NOT_INIT);
+    bme280_snapshot_close(&snap_reader);
+
+    /* A flipped bit fails the CRC */
+    int fd = open(path, O_RDWR);
+    ASSERT(fd >= 0);
+    uint8_t byte = 0;
+    ASSERT(pread(fd, &byte, 1, 30) == 1);
+    byte ^= 0x04;
+    ASSERT(pwrite(fd, &byte, 1, 30) == 1);
+    close(fd);
+    ASSERT(bme280_snapshot_open(&snap_reader, path) == BME280_ERR_READ);
+
+    /* As does a truncated file */
+    ASSERT(truncate(path, 20) == 0);
+    ASSERT(bme280_snapshot_open(&snap_reader, path) == BME280_ERR_READ);
+
+    unlink(path);
+    return TEST_PASS;
+}
+
+static int test_snapshot_other_boot(void) {
+    char path[64];
+    bme280_ctx_t ctx;
+    bme280_ctx_t restored;
+    bme280_compress_sample_t cs;
+    bme280_compress_sample_t cs_restored;
+    const float dev[BME280_CHANNEL_COUNT] = { 0.05f, 0.02f, 0.5f };
+    bme280_slo_config_t cfg = { 60000000u, 5000000u, 2.0f, 10 };
+    static uint8_t file[1 << 20];
+
+    temp_path(path, sizeof(path), "snapshot-boot");
+    memset(&ctx, 0, sizeof(ctx));
+    fake_bus_calibrate(&ctx);
+    ctx.ctrl_meas = 0x27;
+
+    ASSERT(bme280_slo_init(&snap_slo, &cfg, NULL, NULL) == BME280_OK);
+    ASSERT(bme280_sketch_set_init(&snap_sketch, BME280_SKETCH_DEFAULT_ALPHA, 3600000000u) == BME280_OK);
+    ASSERT(bme280_compress_sample_init(&cs, BME280_COMPRESS_DEADBAND, dev, 600000000u) == BME280_OK);
+    bme280_slo_record_read(&snap_slo, 0, 5000000000u, 5000001000u, BME280_OK);
+    snap_sketch.start_us = 5000000000u;
+    cs.channels[0].started = 1;
+    cs.channels[0].held.timestamp_us = 5000000000u;
+
+    ASSERT(bme280_snapshot_begin(&snap_writer, path) == BME280_OK);
+    ASSERT(bme280_snapshot_put_ctx(&snap_writer, 1, &ctx) == BME280_OK);
+    ASSERT(bme280_snapshot_put_slo(&snap_writer, &snap_slo) == BME280_OK);
+    ASSERT(bme280_snapshot_put_sketch_set(&snap_writer, 1, &snap_sketch) == BME280_OK);
+    ASSERT(bme280_snapshot_put_compress(&snap_writer, 1, &cs) == BME280_OK);
+    ASSERT(bme280_snapshot_commit(&snap_writer) == BME280_OK);
+
+    ASSERT(bme280_snapshot_open(&snap_reader, path) == BME280_OK);
+    ASSERT(snap_reader.same_boot == 1);
+    bme280_snapshot_close(&snap_reader);
+
+    /* Rewrite the boot id as if saved before a reboot, with a valid CRC */
+    int fd = open(path, O_RDWR);
+    ASSERT(fd >= 0);
+    ssize_t size = pread(fd, file, sizeof(file), 0);
+    ASSERT(size > 32 && (size_t)size < sizeof(file));
+    file[8] ^= 0xFF;
+    uint32_t crc = bme280_crc32(0, file, (size_t)size - 4);
+    for (int i = 0; i < 4; i++) {
+        file[size - 4 + i] = (uint8_t)(crc >> (8 * i));
+    }
+    ASSERT(pwrite(fd, file, (size_t)size, 0) == size);
+    close(fd);
+
+    /* Calibration and registers carry over; the clock-bound state does not */
+    memset(&restored, 0, sizeof(restored));
+    ASSERT(bme280_slo_init(&snap_slo_restored, &cfg, NULL, NULL) == BME280_OK);
+    ASSERT(bme280_sketch_set_init(&snap_sketch_restored, BME280_SKETCH_DEFAULT_ALPHA, 0) == BME280_OK);
+    ASSERT(bme280_compress_sample_init(&cs_restored, BME280_COMPRESS_DEADBAND, dev, 600000000u) == BME280_OK);
+    ASSERT(bme280_snapshot_open(&snap_reader, path) == BME280_OK);
+    ASSERT(snap_reader.same_boot == 0);
+    ASSERT(bme280_snapshot_get_ctx(&snap_reader, 1, &restored) == BME280_OK);
+    ASSERT(bme280_snapshot_get_slo(&snap_reader, &snap_slo_restored) == BME280_ERR_NOT_INIT);
+    ASSERT(bme280_snapshot_get_sketch_set(&snap_reader, 1, &snap_sketch_restored) == BME280_ERR_NOT_INIT);
+    ASSERT(bme280_snapshot_get_compress(&snap_reader, 1, &cs_restored) == BME280_ERR_NOT_INIT);
+    bme280_snapshot_close(&snap_reader);
+
+    ASSERT(restored.ctrl_meas == 0x27);
+    ASSERT(restored.calib.temp.dig_T1 == ctx.calib.temp.dig_T1);
+    ASSERT(snap_sketch_restored.start_us == 0);
+    ASSERT(cs_restored.channels[0].started == 0);
+
+    /* The fresh compressor accepts the new boot's small timestamps */
+    bme280_point_t p = { 1000u, 21.0f };
+    bme280_point_t out;
+    int emit;
+    ASSERT(bme280_compress_push(&cs_restored.channels[0], &p, &out, &emit) == BME280_OK);
+
+    unlink(path);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Allocator Tests
+ ******************************************************************************/
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t frees;
+    size_t   bytes;
+} counting_allocator_t;
+
+static void *counting_alloc(void *user, size_t size, size_t align) {
+    counting_allocator_t *c = user;
+    void *ptr = NULL;
+    if (align < sizeof(void *)) {
+        align = sizeof(void *);
+    }
+    if (posix_memalign(&ptr, align, size) != 0) {
+        return NULL;
+    }
+    c->allocs++;
+    c->bytes += size;
+    return ptr;
+}
+
+static void counting_free(void *user, void *ptr) {
+    counting_allocator_t *c = user;
+    c->frees++;
+    free(ptr);
+}
+
+static int test_allocator_hooks(void) {
+    counting_allocator_t counts = { 0, 0, 0 };
+    bme280_allocator_t a = { counting_alloc, counting_free, &counts };
+    bme280_allocator_t bad = { counting_alloc, NULL, &counts };
+
+    ASSERT(bme280_set_allocator(&bad) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_set_allocator(&a) == BME280_OK);
+
+    void *p = bme280_alloc(100, 64);
+    ASSERT(p != NULL);
+    ASSERT(((uintptr_t)p & 63) == 0);
+    ASSERT(bme280_alloc(100, 48) == NULL);
+    ASSERT(bme280_alloc(0, 0) == NULL);
+    bme280_free(p);
+    bme280_free(NULL);
+    ASSERT(counts.allocs == 1 && counts.frees == 1 && counts.bytes == 100);
+
+    ASSERT(bme280_set_allocator(NULL) == BME280_OK);
+    p = bme280_alloc(16, 0);
+    ASSERT(p != NULL);
+    bme280_free(p);
+    ASSERT(counts.allocs == 1 && counts.frees == 1);
+    return TEST_PASS;
+}
+
+/*
+ * Heap calls from every object in the test link, counted while heap_counting
+ * is set. The Makefile links with -Wl,--wrap for these symbols, so a library
+ * malloc() lands here whether or not it goes through bme280_alloc().
+ */
+static int heap_counting;
+static uint32_t heap_calls;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+int __real_posix_memalign(void **ptr, size_t align, size_t size);
+
+static void heap_count(void) {
+    if (__atomic_load_n(&heap_counting, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&heap_calls, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void *__wrap_malloc(size_t size) {
+    heap_count();
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    heap_count();
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    heap_count();
+    return __real_realloc(ptr, size);
+}
+
+int __wrap_posix_memalign(void **ptr, size_t align, size_t size) {
+    heap_count();
+    return __real_posix_memalign(ptr, align, size);
+}
+
+static int test_read_path_allocation_free(void) {
+    bme280_ctx_t ctx;
+    bme280_data_t data;
+    bme280_sketch_set_t *set = &snap_sketch;
+    bme280_compress_sample_t cs;
+    const float dev[BME280_CHANNEL_COUNT] = { 0.05f, 0.02f, 0.5f };
+    uint32_t emitted[BME280_CHANNEL_COUNT] = { 0, 0, 0 };
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+    ASSERT(bme280_set_cache_ttl(&ctx, BME280_CACHE_TTL_OFF) == BME280_OK);
+    ASSERT(bme280_sketch_set_init(set, BME280_SKETCH_DEFAULT_ALPHA, 0) == BME280_OK);
+    ASSERT(bme280_compress_sample_init(&cs, BME280_COMPRESS_SWINGING_DOOR, dev, 0) == BME280_OK);
+
+    /* Steady state: read, compensate, cache, sketch, compress */
+    __atomic_store_n(&heap_calls, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&heap_counting, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < 64; i++) {
+        ASSERT(fake_bus_push_burst(peer, 519888 + i, 415148, 30000) == 0);
+        ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+        ASSERT(fake_bus_push_burst(peer, 519888 + i, 415148, 30000) == 0);
+        ASSERT(bme280_read_data_cached(&ctx, &data, NULL) == BME280_OK);
+        ASSERT(bme280_sketch_set_add(set, &data) == BME280_OK);
+        ASSERT(bme280_compress_sample_push(&cs, 1000000ull * (uint64_t)i, &data, compress_count, emitted) == BME280_OK);
+    }
+    uint32_t steady = __atomic_load_n(&heap_calls, __ATOMIC_RELAXED);
+
+    /* The counter does see a library allocation */
+    void *p = bme280_alloc(64, 0);
+    __atomic_store_n(&heap_counting, 0, __ATOMIC_RELAXED);
+    bme280_free(p);
+    ASSERT(steady == 0);
+    ASSERT(__atomic_load_n(&heap_calls, __ATOMIC_RELAXED) == 1);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Verified Burst Read Tests
+ ******************************************************************************/
+
+/* Queue a 0xF3..0xFE burst: status, ctrl_meas, config, reserved, data */
+static int fake_bus_push_verified(int peer, uint8_t status, uint8_t ctrl_meas, uint8_t config,
+                                  int32_t adc_t, int32_t adc_p, int32_t adc_h) {
+    uint8_t buf[BME280_VERIFIED_BURST_LEN] = {
+        status, ctrl_meas, config, 0x00,
+        (uint8_t)(adc_p >> 12), (uint8_t)(adc_p >> 4), (uint8_t)(adc_p << 4),
+        (uint8_t)(adc_t >> 12), (uint8_t)(adc_t >> 4), (uint8_t)(adc_t << 4),
+        (uint8_t)(adc_h >> 8), (uint8_t)adc_h
+    };
+    return (write(peer, buf, sizeof(buf)) == (ssize_t)sizeof(buf)) ? 0 : -1;
+}
+
+static int test_verified_read_single_burst(void) {
+    bme280_ctx_t ctx;
+    bme280_data_t plain;
+    bme280_data_t checked;
+    uint8_t regs[4];
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+    ctx.ctrl_meas = BME280_CTRL_MEAS_NORMAL;
+    ctx.config = BME280_STANDBY_1000MS;
+
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &plain) == BME280_OK);
+    ASSERT(read(peer, regs, sizeof(regs)) == 1 && regs[0] == BME280_REG_DATA);
+
+    ASSERT(bme280_set_read_mode(&ctx, (bme280_read_mode_t)7) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_set_read_mode(&ctx, BME280_READ_VERIFIED) == BME280_OK);
+    /* Reserved config bit 1 may read back either way */
+    ASSERT(fake_bus_push_verified(peer, 0x00, 0x27, 0xA2, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &checked) == BME280_OK);
+    ASSERT(memcmp(&plain, &checked, sizeof(plain)) == 0);
+
+    /* One register pointer write, at the status register */
+    ASSERT(read(peer, regs, sizeof(regs)) == 1 && regs[0] == BME280_REG_STATUS);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+static int test_verified_read_detects_busy_and_reset(void) {
+    bme280_ctx_t ctx;
+    bme280_data_t data;
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+    ASSERT(bme280_set_read_mode(&ctx, BME280_READ_VERIFIED) == BME280_OK);
+    ctx.ctrl_meas = BME280_CTRL_MEAS_NORMAL;
+    ctx.config = BME280_STANDBY_1000MS;
+
+    /* Normal mode: the data registers are shadowed while a conversion runs */
+    ASSERT(fake_bus_push_verified(peer, BME280_STATUS_MEASURING, 0x27, 0xA0, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+    ASSERT_FLOAT_EQ(25.08f, data.temperature_c, 0.01f);
+    ASSERT(fake_bus_push_verified(peer, BME280_STATUS_IM_UPDATE, 0x27, 0xA0, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_ERR_BUSY);
+
+    /* Power-on defaults after a brown-out */
+    ASSERT(fake_bus_push_verified(peer, 0x00, 0x00, 0x00, 0x80000, 0x80000, 0x8000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_ERR_CONFIG);
+    /* Same mode, different oversampling */
+    ASSERT(fake_bus_push_verified(peer, 0x00, 0x4B, 0xA0, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_ERR_CONFIG);
+    ASSERT(fake_bus_push_verified(peer, 0x00, 0x27, 0x00, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_ERR_CONFIG);
+
+    /* A forced-mode sensor is back in sleep after its conversion */
+    ctx.ctrl_meas = 0x25;
+    ASSERT(fake_bus_push_verified(peer, BME280_STATUS_MEASURING, 0x25, 0xA0, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_ERR_BUSY);
+    ASSERT(fake_bus_push_verified(peer, 0x00, 0x24, 0xA0, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+    ASSERT(fake_bus_push_verified(peer, 0x00, 0x27, 0xA0, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_ERR_CONFIG);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Split-Phase Sampling Tests
+ ******************************************************************************/
+
+static int test_split_phase_sample(void) {
+    bme280_ctx_t ctx;
+    bme280_data_t expect;
+    bme280_data_t data;
+    uint8_t regs[8];
+    uint64_t ready_us = 0;
+    int ready = -1;
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+    ASSERT(bme280_sample_state(&ctx) == BME280_SAMPLE_IDLE);
+    ASSERT(bme280_poll_sample(&ctx, &ready) == BME280_ERR_NOT_INIT);
+    ASSERT(bme280_finish_sample(&ctx, &data) == BME280_ERR_NOT_INIT);
+
+    uint64_t before = bme280_time_us();
+    ASSERT(bme280_start_sample(&ctx, &ready_us) == BME280_OK);
+    ASSERT(bme280_sample_state(&ctx) == BME280_SAMPLE_CONVERTING);
+    /* 1x oversampling on all three channels: 9.3 ms worst case */
+    ASSERT(ready_us >= before + 9300 && ready_us < bme280_time_us() + 9300 + 1000);
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) == 4);
+    ASSERT(regs[0] == BME280_REG_CTRL_HUM && regs[1] == BME280_OSRS_HUM_1X);
+    ASSERT(regs[2] == BME280_REG_CTRL_MEAS && regs[3] == 0x25);
+    ASSERT(bme280_start_sample(&ctx, NULL) == BME280_ERR_BUSY);
+
+    /* Too early: answered from the deadline, no bus traffic */
+    ASSERT(bme280_poll_sample(&ctx, &ready) == BME280_OK);
+    ASSERT(ready == 0);
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) < 0);
+
+    while (bme280_time_us() < ready_us) {
+        sleep_us(1000);
+    }
+
+    /* Slower than the datasheet bound: status still says measuring */
+    regs[0] = BME280_STATUS_MEASURING;
+    ASSERT(write(peer, regs, 1) == 1);
+    ASSERT(bme280_poll_sample(&ctx, &ready) == BME280_OK);
+    ASSERT(ready == 0);
+    regs[0] = 0x00;
+    ASSERT(write(peer, regs, 1) == 1);
+    ASSERT(bme280_poll_sample(&ctx, &ready) == BME280_OK);
+    ASSERT(ready == 1);
+    ASSERT(bme280_sample_state(&ctx) == BME280_SAMPLE_READY);
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) == 2);
+    ASSERT(regs[0] == BME280_REG_STATUS && regs[1] == BME280_REG_STATUS);
+
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_finish_sample(&ctx, &data) == BME280_OK);
+    ASSERT(bme280_sample_state(&ctx) == BME280_SAMPLE_IDLE);
+    bme280_raw_t raw = { 519888, 415148, 30000 };
+    ASSERT(bme280_compensate(&ctx.calib, &raw, &expect, NULL) == BME280_OK);
+    ASSERT(memcmp(&expect, &data, sizeof(data)) == 0);
+
+    /* The next trigger keeps the oversampling now in ctrl_meas */
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) == 1);
+    ASSERT(bme280_start_sample(&ctx, NULL) == BME280_OK);
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) == 2);
+    ASSERT(regs[0] == BME280_REG_CTRL_MEAS && regs[1] == 0x25);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+#define SPLIT_SENSORS  32
+
+static int test_split_phase_retry_and_mode_switch(void) {
+    bme280_ctx_t ctx;
+    bme280_data_t data;
+    uint8_t regs[8];
+    uint64_t ready_us = 0;
+    int peer;
+
+    ASSERT(fake_bus_open(&ctx, &peer) == 0);
+    ctx.ctrl_meas = BME280_CTRL_MEAS_NORMAL;
+    ctx.config = BME280_STANDBY_1000MS;
+    ASSERT(bme280_set_cache_ttl(&ctx, 10000000u) == BME280_OK);
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_read_data_cached(&ctx, &data, NULL) == BME280_OK);
+    ASSERT(ctx.cache.valid == 1);
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) == 1);
+
+    /* A configured normal-mode sensor switches to forced; its cached sample is dropped */
+    ASSERT(bme280_start_sample(&ctx, &ready_us) == BME280_OK);
+    ASSERT(ctx.ctrl_meas == 0x25);
+    ASSERT(ctx.cache.valid == 0);
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) == 2);
+    ASSERT(regs[0] == BME280_REG_CTRL_MEAS && regs[1] == 0x25);
+
+    while (bme280_time_us() < ready_us) {
+        sleep_us(1000);
+    }
+
+    /* A failed bus read keeps the conversion for a retry */
+    ASSERT(bme280_finish_sample(&ctx, &data) == BME280_ERR_READ);
+    ASSERT(bme280_sample_state(&ctx) == BME280_SAMPLE_CONVERTING);
+    ASSERT(bme280_start_sample(&ctx, NULL) == BME280_ERR_BUSY);
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) == 1);
+    ASSERT(fake_bus_push_burst(peer, 519888, 415148, 30000) == 0);
+    ASSERT(bme280_finish_sample(&ctx, &data) == BME280_OK);
+    ASSERT(bme280_sample_state(&ctx) == BME280_SAMPLE_IDLE);
+    ASSERT_FLOAT_EQ(25.08f, data.temperature_c, 0.01f);
+
+    /* Verified reads: a reset chip loses the conversion for good */
+    ASSERT(bme280_set_read_mode(&ctx, BME280_READ_VERIFIED) == BME280_OK);
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) == 1);
+    ASSERT(bme280_start_sample(&ctx, &ready_us) == BME280_OK);
+    ASSERT(recv(peer, regs, sizeof(regs), MSG_DONTWAIT) == 2);
+    while (bme280_time_us() < ready_us) {
+        sleep_us(1000);
+    }
+    ASSERT(fake_bus_push_verified(peer, 0x00, 0x00, 0x00, 0x80000, 0x80000, 0x8000) == 0);
+    ASSERT(bme280_finish_sample(&ctx, &data) == BME280_ERR_CONFIG);
+    ASSERT(bme280_sample_state(&ctx) == BME280_SAMPLE_IDLE);
+
+    bme280_close(&ctx);
+    close(peer);
+    return TEST_PASS;
+}
+
+static int test_split_phase_many_sensors(void) {
+    static bme280_ctx_t ctxs[SPLIT_SENSORS];
+    int peers[SPLIT_SENSORS];
+    uint64_t latest = 0;
+    uint32_t done = 0;
+    uint32_t polls = 0;
+
+    for (int i = 0; i < SPLIT_SENSORS; i++) {
+        uint64_t ready_us;
+        ASSERT(fake_bus_open(&ctxs[i], &peers[i]) == 0);
+        ctxs[i].ctrl_hum = BME280_OSRS_HUM_1X;
+        ctxs[i].ctrl_meas = (uint8_t)((i & 1) ? 0x49 : 0x25);  /* 2x or 1x T/P */
+        ASSERT(bme280_start_sample(&ctxs[i], &ready_us) == BME280_OK);
+        if (ready_us > latest) {
+            latest = ready_us;
+        }
+        /* The sensor side: status idle, then the data */
+        uint8_t status = 0x00;
+        ASSERT(write(peers[i], &status, 1) == 1);
+        ASSERT(fake_bus_push_burst(peers[i], 519888 + i, 415148, 30000) == 0);
+    }
+
+    /* One loop drives every sensor; it never blocks inside the driver */
+    while (done < SPLIT_SENSORS) {
+        for (int i = 0; i < SPLIT_SENSORS; i++) {
+            bme280_data_t data;
+            int ready;
+            if (bme280_sample_state(&ctxs[i]) == BME280_SAMPLE_IDLE) {
+                continue;
+            }
+            ASSERT(bme280_poll_sample(&ctxs[i], &ready) == BME280_OK);
+            polls++;
+            if (ready) {
+                ASSERT(bme280_finish_sample(&ctxs[i], &data) == BME280_OK);
+                ASSERT(data.temperature_c > 20.0f && data.temperature_c < 30.0f);
+                done++;
+            }
+        }
+        if (done < SPLIT_SENSORS) {
+            sleep_us(500);
+        }
+    }
+    ASSERT(bme280_time_us() >= latest);
+    ASSERT(polls > SPLIT_SENSORS);
+
+    for (int i = 0; i < SPLIT_SENSORS; i++) {
+        bme280_close(&ctxs[i]);
+        close(peers[i]);
+    }
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Shared-Memory Ring Tests
+ ******************************************************************************/
+
+static void ring_fill(bme280_log_record_t *recs, uint32_t count, uint64_t first) {
+    memset(recs, 0, count * sizeof(*recs));
+    for (uint32_t i = 0; i < count; i++) {
+        recs[i].timestamp_us = first + i;
+        recs[i].sensor = (uint32_t)((first + i) % 7);
+        recs[i].data.temperature_c = 20.0f + (float)i * 0.01f;
+    }
+}
+
+static int test_ring_overrun_and_zero_copy(void) {
+    char name[64];
+    bme280_ring_t w;
+    bme280_ring_t r;
+    bme280_ring_consumer_t a;
+    bme280_ring_consumer_t b;
+    bme280_log_record_t recs[32];
+    bme280_log_record_t out[32];
+    const uint8_t *view;
+    uint32_t n = 0;
+    uint64_t lost = 0;
+
+    shard_name(name, sizeof(name), "ring");
+    ASSERT(bme280_ring_create(&w, name, 24) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_ring_open(&r, name) == BME280_ERR_NOT_INIT);
+    ASSERT(bme280_ring_create(&w, name, 16) == BME280_OK);
+    ASSERT(bme280_ring_open(&r, name) == BME280_OK);
+    ASSERT(bme280_ring_join(&r, &a) == BME280_OK);
+    ASSERT(bme280_ring_join(&r, &b) == BME280_OK);
+    ASSERT(bme280_ring_publish(&r, recs, 1) == BME280_ERR_INVALID_ARG);
+
+    /* In-place view of the writer's records */
+    ring_fill(recs, 10, 0);
+    ASSERT(bme280_ring_publish(&w, recs, 10) == BME280_OK);
+    ASSERT(bme280_ring_peek(&a, &view, &n, &lost) == BME280_OK);
+    ASSERT(n == 10 && lost == 0);
+    ASSERT(bme280_log_decode(view + 3 * BME280_LOG_RECORD_SIZE, &out[0]) == BME280_OK);
+    ASSERT(out[0].timestamp_us == 3 && out[0].sensor == 3);
+    ASSERT(bme280_ring_release(&a, 11) == BME280_ERR_INVALID_ARG);
+    ASSERT(bme280_ring_peek(&a, &view, &n, NULL) == BME280_OK && n == 10);
+    ASSERT(bme280_ring_release(&a, 10) == BME280_OK);
+    ASSERT(bme280_ring_peek(&a, &view, &n, NULL) == BME280_OK && n == 0);
+    ASSERT(bme280_ring_wait(&a, 0) == BME280_ERR_BUSY);
+    ASSERT(bme280_ring_wait(&a, 5) == BME280_ERR_BUSY);
+
+    /* Records overwritten while held are rejected on release */
+    ring_fill(recs, 4, 10);
+    ASSERT(bme280_ring_publish(&w, recs, 4) == BME280_OK);
+    ASSERT(bme280_ring_wait(&a, 0) == BME280_OK);
+    ASSERT(bme280_ring_peek(&a, &view, &n, NULL) == BME280_OK && n == 4);
+    ring_fill(recs, 16, 14);
+    ASSERT(bme280_ring_publish(&w, recs, 16) == BME280_OK);
+    ASSERT(bme280_ring_release(&a, 4) == BME280_ERR_READ);
+
+    /* Head is 30: a lapped consumer resumes at 15 and counts what it missed */
+    ASSERT(bme280_ring_read(&a, out, 32, &n, &lost) == BME280_OK);
+    ASSERT(n == 15 && lost == 5);
+    ASSERT(out[0].timestamp_us == 15 && out[14].timestamp_us == 29);
+    ASSERT(a.slot->lost == 5 && a.slot->cursor == 30);
+    ASSERT(bme280_ring_read(&b, out, 8, &n, &lost) == BME280_OK);
+    ASSERT(n == 8 && lost == 15 && out[0].timestamp_us == 15);
+    ASSERT(bme280_ring_read(&b, out, 32, &n, &lost) == BME280_OK);
+    ASSERT(n == 7 && lost == 0 && out[6].timestamp_us == 29);
+    ASSERT(out[6].sensor == 29 % 7);
+
+    /* Slots are reused after leave */
+    bme280_ring_consumer_t more[BME280_RING_MAX_CONSUMERS];
+    for (int i = 0; i < BME280_RING_MAX_CONSUMERS - 2; i++) {
+        ASSERT(bme280_ring_join(&r, &more[i]) == BME280_OK);
+    }
+    ASSERT(bme280_ring_join(&r, &more[BME280_RING_MAX_CONSUMERS - 2]) == BME280_ERR_INVALID_ARG);
+    bme280_ring_leave(&b);
+    ASSERT(bme280_ring_join(&r, &b) == BME280_OK);
+    ASSERT(bme280_ring_read(&b, out, 32, &n, &lost) == BME280_OK && n == 0);
+    for (int i = 0; i < BME280_RING_MAX_CONSUMERS - 2; i++) {
+        bme280_ring_leave(&more[i]);
+    }
+
+    bme280_ring_leave(&a);
+    bme280_ring_leave(&b);
+    bme280_ring_close(&r);
+    bme280_ring_close(&w);
+    bme280_ring_unlink(name);
+    return TEST_PASS;
+}
+
+#define RING_STREAM_RECORDS  3000
+
+/* Consumer process: follow the ring until every record has arrived in order */
+static int ring_consume(const char *name, int ready_fd) {
+    bme280_ring_t r;
+    bme280_ring_consumer_t c;
+    bme280_log_record_t out[64];
+    uint64_t expect = 0;
+    uint64_t lost_total = 0;
+    uint32_t n;
+    uint64_t lost;
+
+    if (bme280_ring_open(&r, name) != BME280_OK || bme280_ring_join(&r, &c) != BME280_OK) {
+        return 1;
+    }
+    char ok = 1;
+    if (write(ready_fd, &ok, 1) != 1) {
+        return 2;
+    }
+    while (expect < RING_STREAM_RECORDS) {
+        if (bme280_ring_wait(&c, 2000) != BME280_OK) {
+            return 3;
+        }
+        if (bme280_ring_read(&c, out, 64, &n, &lost) != BME280_OK) {
+            return 4;
+        }
+        lost_total += lost;
+        for (uint32_t i = 0; i < n; i++) {
+            if (out[i].timestamp_us != expect++) {
+                return 5;
+            }
+        }
+    }
+    bme280_ring_leave(&c);
+    bme280_ring_close(&r);
+    return lost_total == 0 ? 0 : 6;
+}
+
+static int test_ring_cross_process(void) {
+    char name[64];
+    bme280_ring_t w;
+    bme280_log_record_t recs[50];
+    pid_t pids[2];
+    int fds[2];
+
+    shard_name(name, sizeof(name), "ringx");
+    ASSERT(bme280_ring_create(&w, name, 4096) == BME280_OK);
+    ASSERT(pipe(fds) == 0);
+
+    for (int i = 0; i < 2; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            close(fds[0]);
+            _exit(ring_consume(name, fds[1]));
+        }
+        ASSERT(pids[i] > 0);
+    }
+    close(fds[1]);
+    for (int i = 0; i < 2; i++) {
+        char ok;
+        ASSERT(read(fds[0], &ok, 1) == 1);
+    }
+    close(fds[0]);
+
+    /* Small batches with pauses so consumers go to sleep between them */
+    for (uint64_t seq = 0; seq < RING_STREAM_RECORDS; seq += 50) {
+        ring_fill(recs, 50, seq);
+        ASSERT(bme280_ring_publish(&w, recs, 50) == BME280_OK);
+        sleep_us(200);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        int status = -1;
+        ASSERT(waitpid(pids[i], &status, 0) == pids[i]);
+        ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    bme280_ring_close(&w);
+    bme280_ring_unlink(name);
+    return TEST_PASS;
+}
+
+/*******************************************************************************
+ * Out-of-Process Simulator Tests
+ ******************************************************************************/
+
+static const uint8_t sim_calib[32] = {
+    0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC, 0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B,
+    0x27, 0x0B, 0x8C, 0x00, 0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17,
+    75, 0x6A, 0x01, 0x00, 0x13, 0x25, 0x03, 0x1E
+};
+static const uint8_t sim_burst[8] = { 0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00, 0x75, 0x30 };
+
+static void sim_config(bme280_sim_config_t *config, uint32_t conversion_us) {
+    memcpy(config->calib, sim_calib, sizeof(config->calib));
+    memcpy(config->burst, sim_burst, sizeof(config->burst));
+    config->conversion_us = conversion_us;
+}
+
+static void sim_expected(bme280_data_t *data) {
+    bme280_calib_t calib;
+    bme280_raw_t raw;
+    bme280_parse_calibration(&calib, sim_calib, sim_calib[24], sim_calib + 25);
+    bme280_unpack_raw(sim_burst, &raw);
+    bme280_compensate(&calib, &raw, data, NULL);
+}
+
+/* Read one register with a raw pointer write and read, as i2c-dev clients do */
+static int sim_read_reg(int fd, uint8_t reg) {
+    uint8_t value;
+    if (write(fd, &reg, 1) != 1 || read(fd, &value, 1) != 1) {
+        return -1;
+    }
+    return value;
+}
+
+static int test_sim_read_path(void) {
+    bme280_sim_t sim;
+    bme280_sim_config_t config;
+    bme280_sim_stats_t stats;
+    bme280_ctx_t ctx;
+    bme280_data_t data;
+    bme280_data_t expected;
+    bme280_calib_t calib;
+
+    sim_config(&config, 0);
+    ASSERT(bme280_sim_spawn(NULL, &config) == BME280_ERR_NULL_PTR);
+    ASSERT(bme280_sim_spawn(&sim, &config) == BME280_OK);
+    ASSERT(bme280_attach(&ctx, sim.fd, BME280_DEFAULT_ADDRESS) == BME280_OK);
+    ASSERT(sim_read_reg(sim.fd, 0xD0) == BME280_SIM_CHIP_ID);
+
+    /* Calibration comes from the simulated registers */
+    ASSERT(bme280_read_calibration(&ctx) == BME280_OK);
+    bme280_parse_calibration(&calib, sim_calib, sim_calib[24], sim_calib + 25);
+    ASSERT(ctx.calib.temp.dig_T2 == calib.temp.dig_T2);
+    ASSERT(ctx.calib.press.dig_P9 == calib.press.dig_P9);
+    ASSERT(ctx.calib.hum.dig_H4 == calib.hum.dig_H4 && ctx.calib.hum.dig_H5 == calib.hum.dig_H5);
+
+    /* One write() and one read() per register transaction */
+    ASSERT(bme280_configure(&ctx) == BME280_OK);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+    sim_expected(&expected);
+    ASSERT_FLOAT_EQ(data.temperature_c, expected.temperature_c, 0.001f);
+    ASSERT_FLOAT_EQ(data.pressure_hpa, expected.pressure_hpa, 0.01f);
+    ASSERT_FLOAT_EQ(data.humidity_rh, expected.humidity_rh, 0.01f);
+    ASSERT(bme280_sim_get_stats(&sim, &stats) == BME280_OK);
+    ASSERT(stats.messages == 8 && stats.replies == 5);
+    ASSERT(stats.register_writes == 3 && stats.conversions == 1);
+
+    /* Status, control and data in one transfer, matching the shadow registers */
+    ASSERT(bme280_set_read_mode(&ctx, BME280_READ_VERIFIED) == BME280_OK);
+    ASSERT(bme280_read_data(&ctx, &data) == BME280_OK);
+    ASSERT_FLOAT_EQ(data.temperature_c, expected.temperature_c, 0.001f);
+    ASSERT(bme280_sim_get_stats(&sim, &stats) == BME280_OK);
+    ASSERT(stats.messages == 9 && stats.replies == 6);
+
+    bme280_close(&ctx);
+    bme280_sim_stop(&sim);
+    ASSERT(sim.pid == -1 && sim.stats == NULL);
+    return TEST_PASS;
+}
+
+static int test_sim_forced_over_unix_socket(void) {
+    char path[BME280_SIM_PATH_LEN];
+    bme280_sim_t sim;
+    bme280_sim_config_t config;
+    bme280_sim_stats_t stats;
+    bme280_ctx_t ctx;
+    bme280_data_t data;
+    bme280_data_t expected;
+    uint64_t ready_us = 0;
+    int fd = -1;
+    int ready = 0;
+
+    /* Slower than the datasheet maximum the driver waits for */
+    sim_config(&config, 50000);
+    temp_path(path, sizeof(path), "sim");
+    ASSERT(bme280_sim_connect(path, &fd) == BME280_ERR_BUS_OPEN);
+    ASSERT(bme280_sim_listen(&sim, path, &config) == BME280_OK);
+    ASSERT(bme280_sim_connect(path, &fd) == BME280_OK);
+    ASSERT(bme280_attach(&ctx, fd, BME280_DEFAULT_ADDRESS) == BME280_OK);
+    ASSERT(bme280_read_calibration(&ctx) == BME280_OK);
+
+    ASSERT(bme280_start_sample(&ctx, &ready_us) == BME280_OK);
+    ASSERT((sim_read_reg(fd, BME280_REG_STATUS) & BME280_STATUS_MEASURING) != 0);
+    sleep_us((long)(ready_us - bme280_time_us()) + 1000);
+    ASSERT(bme280_poll_sample(&ctx, &ready) == BME280_OK);
+    ASSERT(ready == 0);
+
+    sleep_us(60000);
+    ASSERT(bme280_poll_sample(&ctx, &ready) == BME280_OK);
+    ASSERT(ready == 1);
+    ASSERT(bme280_finish_sample(&ctx, &data) == BME280_OK);
+    sim_expected(&expected);
+    ASSERT_FLOAT_EQ(data.temperature_c, expected.temperature_c, 0.001f);
+    ASSERT((sim_read_reg(fd, BME280_REG_CTRL_MEAS) & BME280_MODE_MASK) == 0);
+    bme280_close(&ctx);
+
+    /* Register state outlives a connection */
+    ASSERT(bme280_sim_connect(path, &fd) == BME280_OK);
+    ASSERT(sim_read_reg(fd, BME280_REG_DATA + 3) == sim_burst[3]);
+    close(fd);
+    ASSERT(bme280_sim_get_stats(&sim, &stats) == BME280_OK);
+    ASSERT(stats.conversions == 1);
+
+    bme280_sim_stop(&sim);
+    ASSERT(access(path, F_OK) != 0);
+    return TEST_PASS;
+}
+
+typedef struct {
+    bme280_ctx_t *ctx;
+    int           rounds;
+    int           bad;
+} sim_bus_worker_t;
+
+/* Calibration and configuration transactions racing the sample reads */
+static void *sim_bus_worker(void *arg) {
+    sim_bus_worker_t *w = arg;
+    bme280_calib_t calib;
+    bme280_parse_calibration(&calib, sim_calib, sim_calib[24], sim_calib + 25);
+    for (int i = 0; i < w->rounds; i++) {
+        if (bme280_read_calibration(w->ctx) != BME280_OK
+            || w->ctx->calib.press.dig_P9 != calib.press.dig_P9
+            || bme280_configure(w->ctx) != BME280_OK) {
+            w->bad++;
+        }
+    }
+    return NULL;
+}
+
+static int test_sim_concurrent_transactions(void) {
+    bme280_sim_t sim;
+    bme280_sim_config_t config;
+    bme280_ctx_t ctx;
+    bme280_data_t data;
+    bme280_data_t expected;
+    pthread_t thread;
+    sim_bus_worker_t worker;
+    int bad = 0;
+
+    sim_config(&config, 0);
+    ASSERT(bme280_sim_spawn(&sim, &config) == BME280_OK);
+    ASSERT(bme280_attach(&ctx, sim.fd, BME280_DEFAULT_ADDRESS) == BME280_OK);
+    ASSERT(bme280_read_calibration(&ctx) == BME280_OK);
+    ASSERT(bme280_configure(&ctx) == BME280_OK);
+    ASSERT(bme280_set_cache_ttl(&ctx, BME280_CACHE_TTL_OFF) == BME280_OK);
+    sim_expected(&expected);
+
+    /* Each reply must reach the caller whose pointer write asked for it */
+    worker.ctx = &ctx;
+    worker.rounds = 500;
+    worker.bad = 0;
+    pthread_create(&thread, NULL, sim_bus_worker, &worker);
+    for (int i = 0; i < 1500; i++) {
+        if (bme280_read_data(&ctx, &data) != BME280_OK
+            || fabsf(data.temperature_c - expected.temperature_c) > 0.001f) {
+            bad++;
+        }
+    }
+    pthread_join(thread, NULL);
+    ASSERT(bad == 0);
+    ASSERT(worker.bad == 0);
+
+    bme280_close(&ctx);
+    bme280_sim_stop(&sim);
+    return TEST_PASS;
+}
+
+int main(void) {
+    printf("==============================================\n");
+    printf("BME280 Driver Test Suite\n");
+    printf("Feature: bme280-c-enhancement\n");
+    printf("==============================================\n\n");
+    
+    /* Seed random number generator */
+    seed_random((uint32_t)time(NULL));
+    
+    /* Property Tests */
+    printf("Property Tests:\n");
+    printf("----------------------------------------------\n");
+    
+    printf("\nProperty 1: Compensation Formula Correctness\n");
+    printf("Validates: Requirements 1.4\n");
+    RUN_TEST(property_test_compensation_formula);
+    
+    printf("\nProperty 2: Error String Completeness\n");
+    printf("Validates: Requirements 4.6\n");
+    RUN_TEST(property_test_error_string_completeness);
+    
+    /* Unit Tests */
+    printf("\nUnit Tests:\n");
+    printf("----------------------------------------------\n");
+    
+    RUN_TEST(test_invalid_bus_path);
+    RUN_TEST(test_close_sets_fd_negative);
+    RUN_TEST(test_default_constants);
+    RUN_TEST(test_include_guards);
+    RUN_TEST(test_null_pointer_handling);
+    RUN_TEST(test_not_initialized_error);
+    RUN_TEST(test_parse_calibration);
+    RUN_TEST(test_pack_calibration);
+    RUN_TEST(test_unpack_raw);
+
+    printf("\nRead Cache Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_cache_off_reads_bus);
+    RUN_TEST(test_cache_hit_within_ttl);
+    RUN_TEST(test_cache_expiry);
+    RUN_TEST(test_cache_ttl_auto);
+    RUN_TEST(test_single_flight_coalesces);
+    RUN_TEST(test_single_flight_invalidated_read);
+
+    printf("\nFrame Publisher Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_frame_latest_wins);
+    RUN_TEST(test_frame_consistent_under_load);
+    RUN_TEST(test_frame_sweep);
+
+    printf("\nShard Registry Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_shard_claim_and_totals);
+    RUN_TEST(test_shard_reclaims_dead_owner);
+    RUN_TEST(test_shard_reclaims_expired_lease);
+    RUN_TEST(test_shard_takes_over_dead_creator);
+
+    printf("\nMQTT Sink Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_mqtt_batches_per_topic);
+    RUN_TEST(test_mqtt_flushes_on_age);
+    RUN_TEST(test_mqtt_window_and_resend);
+    RUN_TEST(test_mqtt_stalled_broker);
+    RUN_TEST(test_mqtt_drops_dead_connection);
+    RUN_TEST(test_mqtt_drops_on_receive_error);
+
+    printf("\nSample Log and Uplink Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_log_append_and_recover);
+    RUN_TEST(test_log_short_write_is_trimmed);
+    RUN_TEST(test_uplink_resumes_without_duplicates);
+
+    printf("\nUDP Stream Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_udp_loopback_batches);
+    RUN_TEST(test_udp_reorder_and_gaps);
+    RUN_TEST(test_udp_sender_restart);
+
+    printf("\nSLO Monitor Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_slo_latency_burn_alert);
+    RUN_TEST(test_slo_freshness_per_sensor);
+
+    printf("\nQuantile Sketch Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_sketch_relative_accuracy);
+    RUN_TEST(test_sketch_merge_and_collapse);
+    RUN_TEST(test_sketch_set_hourly_roll);
+
+    printf("\nHistorian Compression Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_compress_swinging_door_bound);
+    RUN_TEST(test_compress_deadband_bound);
+    RUN_TEST(test_compress_sample_channels);
+
+    printf("\nDifferential Encoding Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_diff_roundtrip_and_gain);
+    RUN_TEST(test_diff_decode_errors);
+
+    printf("\nRaw Segment Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_segment_roundtrip_and_skip);
+    RUN_TEST(test_segment_corruption);
+    RUN_TEST(test_segment_write_failure);
+
+    printf("\nState Snapshot Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_snapshot_roundtrip);
+    RUN_TEST(test_snapshot_damage);
+    RUN_TEST(test_snapshot_other_boot);
+
+    printf("\nAllocator Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_allocator_hooks);
+    RUN_TEST(test_read_path_allocation_free);
+
+    printf("\nVerified Burst Read Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_verified_read_single_burst);
+    RUN_TEST(test_verified_read_detects_busy_and_reset);
+
+    printf("\nSplit-Phase Sampling Tests:\n");
+    printf("----------------------------------------------\n");
+
+    RUN_TEST(test_split_phase_sample);
+    RUN_TEST(test_split_phase_many_sensors);
+    RUN_TEST(test_split_phase_retry_and_mode_switch);
+
+    printf("\nShared-Memory Ring Tests:\n");
+    printf("----------------------------------------------\n");
+    RUN_TEST(test_ring_overrun_and_zero_copy);
+    RUN_TEST(test_ring_cross_process);
+
+    printf("\nSimulator Tests:\n");
+    printf("----------------------------------------------\n");
+    RUN_TEST(test_sim_read_path);
+    RUN_TEST(test_sim_forced_over_unix_socket);
+    RUN_TEST(test_sim_concurrent_transactions);
     
     /* Summary */
     printf("\n==============================================\n");
@@ -0,0 +1,126 @@
+// Distributed with a free-will license.
+// Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+// BME280
+// This code is designed to work with the BME280_I2CS I2C Mini Module available from ControlEverything.com.
+// https://www.controleverything.com/content/Humidity?sku=BME280_I2CS#tabs-0-product_tabset-2
+
+// Calibration parsing and compensation formulas, free of any I2C dependency
+// so they can be reused by samplers, batch jobs and test harnesses.
+public final class BME280Compensation
+{
+    // Indices into the coefficient array returned by parseCalibration
+    public static final int T1 = 0, T2 = 1, T3 = 2;
+    public static final int P1 = 3, P2 = 4, P3 = 5, P4 = 6, P5 = 7, P6 = 8, P7 = 9, P8 = 10, P9 = 11;
+    public static final int H1 = 12, H2 = 13, H3 = 14, H4 = 15, H5 = 16, H6 = 17;
+    public static final int COEFFICIENTS = 18;
+
+    // Indices into the result array filled by compensate
+    public static final int C_TEMP = 0, F_TEMP = 1, PRESSURE = 2, HUMIDITY = 3;
+    public static final int RESULTS = 4;
+
+    private BME280Compensation()
+    {
+    }
+
+    // b1: 24 bytes from 0x88(136), h1: 1 byte from 0xA1(161), b2: 7 bytes from 0xE1(225)
+    public static int[] parseCalibration(byte[] b1, int h1, byte[] b2)
+    {
+        int[] c = new int[COEFFICIENTS];
+        parseCalibration(b1, h1, b2, c);
+        return c;
+    }
+
+    public static void parseCalibration(byte[] b1, int h1, byte[] b2, int[] c)
+    {
+        // temp coefficients
+        c[T1] = (b1[0] & 0xFF) + ((b1[1] & 0xFF) * 256);
+        c[T2] = signed16((b1[2] & 0xFF) + ((b1[3] & 0xFF) * 256));
+        c[T3] = signed16((b1[4] & 0xFF) + ((b1[5] & 0xFF) * 256));
+
+        // pressure coefficients
+        c[P1] = (b1[6] & 0xFF) + ((b1[7] & 0xFF) * 256);
+        for (int i = 1; i < 9; i++)
+        {
+            c[P1 + i] = signed16((b1[6 + 2 * i] & 0xFF) + ((b1[7 + 2 * i] & 0xFF) * 256));
+        }
+
+        // humidity coefficients
+        c[H1] = h1 & 0xFF;
+        c[H2] = (b2[0] & 0xFF) + (b2[1] * 256);
+        c[H3] = b2[2] & 0xFF;
+        c[H4] = signed16(((b2[3] & 0xFF) * 16) + (b2[4] & 0xF));
+        c[H5] = signed16(((b2[4] & 0xFF) / 16) + ((b2[5] & 0xFF) * 16));
+        c[H6] = b2[6];
+    }
+
+    public static int adcP(byte[] data, int off)
+    {
+        return (((data[off] & 0xFF) * 65536) + ((data[off + 1] & 0xFF) * 256) + (data[off + 2] & 0xF0)) / 16;
+    }
+
+    public static int adcT(byte[] data, int off)
+    {
+        return (((data[off + 3] & 0xFF) * 65536) + ((data[off + 4] & 0xFF) * 256) + (data[off + 5] & 0xF0)) / 16;
+    }
+
+    public static int adcH(byte[] data, int off)
+    {
+        return (data[off + 6] & 0xFF) * 256 + (data[off + 7] & 0xFF);
+    }
+
+    // data: 8 bytes from 0xF7(247); returns cTemp, fTemp, pressure, humidity
+    public static double[] compensate(int[] c, byte[] data)
+    {
+        double[] out = new double[RESULTS];
+        compensate(c, adcT(data, 0), adcP(data, 0), adcH(data, 0), out, 0);
+        return out;
+    }
+
+    // Allocation-free form: writes RESULTS doubles at out[off]
+    public static void compensate(int[] c, long adc_t, long adc_p, long adc_h, double[] out, int off)
+    {
+        // Temperature offset calculations
+        double var1 = (((double)adc_t) / 16384.0 - ((double)c[T1]) / 1024.0) * ((double)c[T2]);
+        double var2 = ((((double)adc_t) / 131072.0 - ((double)c[T1]) / 8192.0) *
+                       (((double)adc_t)/131072.0 - ((double)c[T1])/8192.0)) * ((double)c[T3]);
+        double t_fine = (long)(var1 + var2);
+        double cTemp = (var1 + var2) / 5120.0;
+        double fTemp = cTemp * 1.8 + 32;
+
+        // Pressure offset calculations
+        var1 = ((double)t_fine / 2.0) - 64000.0;
+        var2 = var1 * var1 * ((double)c[P6]) / 32768.0;
+        var2 = var2 + var1 * ((double)c[P5]) * 2.0;
+        var2 = (var2 / 4.0) + (((double)c[P4]) * 65536.0);
+        var1 = (((double) c[P3]) * var1 * var1 / 524288.0 + ((double) c[P2]) * var1) / 524288.0;
+        var1 = (1.0 + var1 / 32768.0) * ((double)c[P1]);
+        double p = 1048576.0 - (double)adc_p;
+        p = (p - (var2 / 4096.0)) * 6250.0 / var1;
+        var1 = ((double) c[P9]) * p * p / 2147483648.0;
+        var2 = p * ((double) c[P8]) / 32768.0;
+        double pressure = (p + (var1 + var2 + ((double)c[P7])) / 16.0) / 100;
+
+        // Humidity offset calculations
+        double var_H = (((double)t_fine) - 76800.0);
+        var_H = (adc_h - (c[H4] * 64.0 + c[H5] / 16384.0 * var_H)) * (c[H2] / 65536.0 * (1.0 + c[H6] / 67108864.0 * var_H * (1.0 + c[H3] / 67108864.0 * var_H)));
+        double humidity = var_H * (1.0 -  c[H1] * var_H / 524288.0);
+        if(humidity > 100.0)
+        {
+            humidity = 100.0;
+        }else
+            if(humidity < 0.0)
+            {
+                humidity = 0.0;
+            }
+
+        out[off + C_TEMP] = cTemp;
+        out[off + F_TEMP] = fTemp;
+        out[off + PRESSURE] = pressure;
+        out[off + HUMIDITY] = humidity;
+    }
+
+    private static int signed16(int value)
+    {
+        return (value > 32767) ? value - 65536 : value;
+    }
+}
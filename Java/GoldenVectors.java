@@ -0,0 +1,113 @@
+// Distributed with a free-will license.
+// Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+// BME280
+//
+// Golden vector runner for the Java port. Compensates every vector in the
+// shared golden file with BME280Compensation, repeating the pass to measure
+// throughput, and prints one line:
+//
+//   port,vectors,ns_per_sample,max_dt_c,max_dp_hpa,max_dh_rh
+//
+// Usage: java GoldenVectors <golden.csv> [passes]
+
+import java.io.BufferedReader;
+import java.io.FileReader;
+import java.io.IOException;
+import java.util.ArrayList;
+import java.util.List;
+
+public class GoldenVectors
+{
+    public static void main(String args[]) throws IOException
+    {
+        if(args.length < 1)
+        {
+            System.err.println("usage: java GoldenVectors <golden.csv> [passes]");
+            System.exit(1);
+        }
+        int passes = (args.length > 1) ? Integer.parseInt(args[1]) : 1000;
+
+        List<int[]> calibs = new ArrayList<>();
+        List<byte[]> bursts = new ArrayList<>();
+        List<double[]> expected = new ArrayList<>();
+        try (BufferedReader reader = new BufferedReader(new FileReader(args[0])))
+        {
+            String line;
+            while((line = reader.readLine()) != null)
+            {
+                if(line.startsWith("#") || line.isEmpty())
+                {
+                    continue;
+                }
+                String[] fields = line.split(",");
+                byte[] calib = hex(fields[0]);
+                byte[] b1 = new byte[24];
+                byte[] b2 = new byte[7];
+                System.arraycopy(calib, 0, b1, 0, 24);
+                System.arraycopy(calib, 25, b2, 0, 7);
+                calibs.add(BME280Compensation.parseCalibration(b1, calib[24] & 0xFF, b2));
+                bursts.add(hex(fields[1]));
+                expected.add(new double[] {
+                    Double.parseDouble(fields[2]), Double.parseDouble(fields[3]), Double.parseDouble(fields[4])
+                });
+            }
+        }
+
+        int count = calibs.size();
+        double[] out = new double[BME280Compensation.RESULTS];
+        double maxT = 0, maxP = 0, maxH = 0;
+        for(int i = 0; i < count; i++)
+        {
+            byte[] burst = bursts.get(i);
+            BME280Compensation.compensate(calibs.get(i), BME280Compensation.adcT(burst, 0),
+                BME280Compensation.adcP(burst, 0), BME280Compensation.adcH(burst, 0), out, 0);
+            double[] e = expected.get(i);
+            maxT = Math.max(maxT, Math.abs(out[BME280Compensation.C_TEMP] - e[0]));
+            maxP = Math.max(maxP, Math.abs(out[BME280Compensation.PRESSURE] - e[1]));
+            maxH = Math.max(maxH, Math.abs(out[BME280Compensation.HUMIDITY] - e[2]));
+        }
+
+        // Warm up the JIT before timing
+        double sink = 0;
+        for(int pass = 0; pass < passes; pass++)
+        {
+            sink += run(calibs, bursts, out);
+        }
+        long start = System.nanoTime();
+        for(int pass = 0; pass < passes; pass++)
+        {
+            sink += run(calibs, bursts, out);
+        }
+        long elapsed = System.nanoTime() - start;
+
+        System.out.printf("java,%d,%.1f,%.6f,%.6f,%.6f%n", count,
+            (double)elapsed / ((double)passes * count), maxT, maxP, maxH);
+        if(Double.isNaN(sink))
+        {
+            System.err.println("unexpected NaN");
+        }
+    }
+
+    private static double run(List<int[]> calibs, List<byte[]> bursts, double[] out)
+    {
+        double sum = 0;
+        for(int i = 0; i < calibs.size(); i++)
+        {
+            byte[] burst = bursts.get(i);
+            BME280Compensation.compensate(calibs.get(i), BME280Compensation.adcT(burst, 0),
+                BME280Compensation.adcP(burst, 0), BME280Compensation.adcH(burst, 0), out, 0);
+            sum += out[BME280Compensation.PRESSURE];
+        }
+        return sum;
+    }
+
+    private static byte[] hex(String text)
+    {
+        byte[] out = new byte[text.length() / 2];
+        for(int i = 0; i < out.length; i++)
+        {
+            out[i] = (byte)Integer.parseInt(text.substring(2 * i, 2 * i + 2), 16);
+        }
+        return out;
+    }
+}
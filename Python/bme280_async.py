@@ -0,0 +1,169 @@
+# Distributed with a free-will license.
+# Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+# BME280
+# This code is designed to work with the BME280_I2CS I2C Mini Module available from ControlEverything.com.
+# https://www.controleverything.com/content/Humidity?sku=BME280_I2CS#tabs-0-product_tabset-2
+#
+# asyncio sampler for many BME280 sensors (Python 3.7+).
+#
+# Bus transfers never run on the event loop: every I2C bus gets a
+# single-thread executor, so transfers on one bus are serialized while
+# separate buses proceed in parallel. One sweep over all sensors on a bus
+# is a single executor job, and samples are yielded as an async iterator:
+#
+#     sampler = AsyncSampler([Sensor(1, 0x76), Sensor(1, 0x77), Sensor(2, 0x76)],
+#                            interval=1.0)
+#     async with sampler:
+#         async for sample in sampler:
+#             print(sample.name, sample.cTemp, sample.pressure, sample.humidity)
+
+import asyncio
+import collections
+import concurrent.futures
+import time
+
+import BME280
+
+Sample = collections.namedtuple("Sample", "name timestamp cTemp fTemp pressure humidity")
+
+# Queue entries besides samples: a bus task that died, and the end of iteration
+_Failure = collections.namedtuple("_Failure", "bus exc")
+_CLOSED = object()
+
+class Sensor(object):
+    def __init__(self, bus, address=0x76, name=None):
+        self.bus = bus
+        self.address = address
+        self.name = name if name is not None else "%d-0x%02x" % (bus, address)
+        self.calib = None
+
+class AsyncSampler(object):
+    def __init__(self, sensors, interval=1.0, smbus_factory=None, queue_size=1024):
+        # smbus_factory(bus_number) returns an object with the smbus
+        # read_i2c_block_data/read_byte_data/write_byte_data methods
+        if smbus_factory is None:
+            import smbus
+            smbus_factory = smbus.SMBus
+        self._factory = smbus_factory
+        self._interval = interval
+        self._queue_size = queue_size
+        self._by_bus = collections.OrderedDict()
+        for sensor in sensors:
+            self._by_bus.setdefault(sensor.bus, []).append(sensor)
+        self._buses = {}
+        self._executors = {}
+        self._tasks = []
+        self._queue = None
+        self._closed = False
+
+    async def start(self):
+        loop = asyncio.get_running_loop()
+        self._queue = asyncio.Queue(self._queue_size)
+        self._closed = False
+        try:
+            for bus in self._by_bus:
+                executor = concurrent.futures.ThreadPoolExecutor(1, "bme280-bus%d" % bus)
+                self._executors[bus] = executor
+                self._buses[bus] = await loop.run_in_executor(executor, self._factory, bus)
+                await loop.run_in_executor(executor, self._setup_bus, bus)
+        except BaseException:
+            # Release the executors and buses opened so far
+            await self.close()
+            raise
+        for bus in self._by_bus:
+            self._tasks.append(asyncio.ensure_future(self._poll_bus(bus)))
+        return self
+
+    async def close(self):
+        self._closed = True
+        for task in self._tasks:
+            task.cancel()
+        await asyncio.gather(*self._tasks, return_exceptions=True)
+        self._tasks = []
+        if self._queue is not None:
+            # Wake an iterator blocked on an empty queue; it passes the sentinel on
+            try:
+                self._queue.put_nowait(_CLOSED)
+            except asyncio.QueueFull:
+                pass
+        # A cancelled task does not stop a sweep already in its executor, so
+        # each bus is closed on its own executor after that sweep, and the
+        # executors are shut down off the loop
+        executors, self._executors = self._executors, {}
+        buses, self._buses = self._buses, {}
+        await asyncio.gather(*[self._release(executor, buses.get(bus))
+                               for bus, executor in executors.items()])
+
+    async def _release(self, executor, dev):
+        loop = asyncio.get_running_loop()
+        try:
+            if dev is not None and hasattr(dev, "close"):
+                await loop.run_in_executor(executor, dev.close)
+        finally:
+            await loop.run_in_executor(None, executor.shutdown)
+
+    async def __aenter__(self):
+        return await self.start()
+
+    async def __aexit__(self, exc_type, exc, tb):
+        await self.close()
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self):
+        # Iteration ends at close(); a bus task that failed raises its error here
+        if self._queue is None or self._closed:
+            raise StopAsyncIteration
+        item = await self._queue.get()
+        if item is _CLOSED:
+            self._queue.put_nowait(_CLOSED)
+            raise StopAsyncIteration
+        if isinstance(item, _Failure):
+            raise item.exc
+        return item
+
+    def _setup_bus(self, bus):
+        # Runs on the bus executor: cache calibration and configure every sensor
+        dev = self._buses[bus]
+        for sensor in self._by_bus[bus]:
+            b1 = dev.read_i2c_block_data(sensor.address, 0x88, 24)
+            dig_H1 = dev.read_byte_data(sensor.address, 0xA1)
+            b2 = dev.read_i2c_block_data(sensor.address, 0xE1, 7)
+            sensor.calib = BME280.parse_calibration(b1, dig_H1, b2)
+            dev.write_byte_data(sensor.address, 0xF2, 0x01)
+            dev.write_byte_data(sensor.address, 0xF4, 0x27)
+            dev.write_byte_data(sensor.address, 0xF5, 0xA0)
+
+    def _sweep_bus(self, bus):
+        # Runs on the bus executor: one burst read per sensor, one job per sweep
+        dev = self._buses[bus]
+        samples = []
+        for sensor in self._by_bus[bus]:
+            try:
+                data = dev.read_i2c_block_data(sensor.address, 0xF7, 8)
+            except IOError:
+                continue
+            cTemp, fTemp, pressure, humidity = BME280.compensate(sensor.calib, data)
+            samples.append(Sample(sensor.name, time.time(), cTemp, fTemp, pressure, humidity))
+        return samples
+
+    async def _poll_bus(self, bus):
+        loop = asyncio.get_running_loop()
+        executor = self._executors[bus]
+        deadline = loop.time()
+        try:
+            while True:
+                for sample in await loop.run_in_executor(executor, self._sweep_bus, bus):
+                    await self._queue.put(sample)
+                # Fixed-rate schedule; skip missed slots instead of bursting
+                deadline += self._interval
+                now = loop.time()
+                if deadline < now:
+                    deadline = now
+                await asyncio.sleep(deadline - now)
+        except asyncio.CancelledError:
+            raise
+        except Exception as exc:
+            # The bus stops; its consumer learns why instead of waiting forever
+            await self._queue.put(_Failure(bus, exc))
@@ -0,0 +1,326 @@
+# Distributed with a free-will license.
+# Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+# BME280
+# This code is designed to work with the BME280_I2CS I2C Mini Module available from ControlEverything.com.
+# https://www.controleverything.com/content/Humidity?sku=BME280_I2CS#tabs-0-product_tabset-2
+#
+# Zero-copy access to the C library's binary sample data (Python 3).
+#
+# The files and shared memory written by C/bme280_log, C/bme280_ring and
+# C/bme280_segment are mapped read-only. With NumPy, records are structured
+# arrays over the mapped bytes; without it, the same bytes are exposed as
+# memoryviews and per-record tuples. Raw segment bursts are compensated on
+# demand, for a whole block or scan at once:
+#
+#     seg = Segment("day1.seg")
+#     cols = seg.scan(ts_min=t0, ts_max=t1, sensor=2)
+#     print(cols["temperature_c"].mean(), cols["pressure_hpa"].max())
+#
+#     ring = Ring("/bme280-samples")
+#     while True:
+#         recs, lost = ring.peek()
+#         ...                        # recs["temperature_c"], in place
+#         if not ring.release(len(recs)):
+#             ...                    # overwritten while in use: discard
+#         ring.wait(1.0)
+
+import mmap
+import os
+import struct
+import time
+import zlib
+
+import BME280
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+LOG_RECORD_SIZE = 32
+LOG_RECORD = struct.Struct("<QIifffI")
+
+RING_MAGIC = 0x474E5242
+RING_VERSION = 1
+RING_DATA_OFFSET = 2048
+RING_HEAD_WORD = 8            # head is the u64 at byte 64
+RING_CONSUMERS = 16
+RING_CONSUMER = struct.Struct("<IIQQ")
+RING_CONSUMER_OFFSET = 192
+
+SEGMENT_MAGIC = 0x53383242
+SEGMENT_VERSION = 1
+SEGMENT_HEADER = struct.Struct("<IHHII")
+SEGMENT_CALIB_SIZE = 32
+SEGMENT_BLOCK_HEADER = struct.Struct("<QQHHIII")
+SEGMENT_RECORD_SIZE = 16
+SEGMENT_RECORD = struct.Struct("<IHH8s")
+SEGMENT_MAX_BLOCK = 4096
+
+if numpy is not None:
+    LOG_DTYPE = numpy.dtype([("timestamp_us", "<u8"), ("sensor", "<u4"), ("status", "<i4"),
+                             ("temperature_c", "<f4"), ("pressure_hpa", "<f4"),
+                             ("humidity_rh", "<f4"), ("crc", "<u4")])
+    SEGMENT_DTYPE = numpy.dtype([("offset", "<u4"), ("sensor", "<u2"), ("reserved", "<u2"),
+                                 ("burst", "u1", (8,))])
+else:
+    LOG_DTYPE = SEGMENT_DTYPE = None
+
+def _map(path, length=0):
+    with open(path, "rb") as f:
+        return mmap.mmap(f.fileno(), length, access=mmap.ACCESS_READ)
+
+def _records(buf, offset, count, dtype, size):
+    # Structured array or memoryview over count records, no copy either way
+    if numpy is not None:
+        return numpy.frombuffer(buf, dtype, count, offset)
+    return memoryview(buf)[offset:offset + count * size]
+
+def _release(mm):
+    # Arrays still handed out keep the mapping alive until they are dropped
+    try:
+        mm.close()
+    except BufferError:
+        pass
+
+def _require_numpy():
+    if numpy is None:
+        raise RuntimeError("NumPy is required; use the per-record iterators without it")
+
+def compensate(calib, bursts):
+    # Vectorized BME280.compensate(): calib is one parse_calibration() tuple
+    # or an (n, 18) array of them, bursts an (n, 8) uint8 array of 0xF7..0xFE.
+    # Returns (cTemp, fTemp, pressure, humidity) as float64 arrays.
+    _require_numpy()
+    c = numpy.asarray(calib, dtype=numpy.float64).T
+    (dig_T1, dig_T2, dig_T3,
+     dig_P1, dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9,
+     dig_H1, dig_H2, dig_H3, dig_H4, dig_H5, dig_H6) = c
+
+    b = numpy.asarray(bursts, dtype=numpy.uint8).reshape(-1, 8).astype(numpy.float64)
+    adc_p = numpy.floor((b[:, 0] * 65536 + b[:, 1] * 256 + (b[:, 2] // 16) * 16) / 16)
+    adc_t = numpy.floor((b[:, 3] * 65536 + b[:, 4] * 256 + (b[:, 5] // 16) * 16) / 16)
+    adc_h = b[:, 6] * 256 + b[:, 7]
+
+    var1 = (adc_t / 16384.0 - dig_T1 / 1024.0) * dig_T2
+    var2 = ((adc_t / 131072.0 - dig_T1 / 8192.0) * (adc_t / 131072.0 - dig_T1 / 8192.0)) * dig_T3
+    t_fine = var1 + var2
+    cTemp = t_fine / 5120.0
+    fTemp = cTemp * 1.8 + 32
+
+    var1 = (t_fine / 2.0) - 64000.0
+    var2 = var1 * var1 * dig_P6 / 32768.0
+    var2 = var2 + var1 * dig_P5 * 2.0
+    var2 = (var2 / 4.0) + (dig_P4 * 65536.0)
+    var1 = (dig_P3 * var1 * var1 / 524288.0 + dig_P2 * var1) / 524288.0
+    var1 = (1.0 + var1 / 32768.0) * dig_P1
+    p = 1048576.0 - adc_p
+    with numpy.errstate(divide="ignore", invalid="ignore"):
+        p = (p - (var2 / 4096.0)) * 6250.0 / var1
+    var1 = dig_P9 * p * p / 2147483648.0
+    var2 = p * dig_P8 / 32768.0
+    pressure = (p + (var1 + var2 + dig_P7) / 16.0) / 100
+
+    var_H = t_fine - 76800.0
+    var_H = (adc_h - (dig_H4 * 64.0 + dig_H5 / 16384.0 * var_H)) * (dig_H2 / 65536.0 * (1.0 + dig_H6 / 67108864.0 * var_H * (1.0 + dig_H3 / 67108864.0 * var_H)))
+    humidity = numpy.clip(var_H * (1.0 - dig_H1 * var_H / 524288.0), 0.0, 100.0)
+
+    return (cTemp, fTemp, pressure, humidity)
+
+class LogFile(object):
+    # bme280_log file: 32-byte records of compensated samples from byte 0
+
+    def __init__(self, path):
+        count = os.path.getsize(path) // LOG_RECORD_SIZE
+        self._mm = _map(path, count * LOG_RECORD_SIZE) if count > 0 else None
+        self.count = count
+
+    def __len__(self):
+        return self.count
+
+    def records(self):
+        # LOG_DTYPE array (or memoryview) over every record
+        if self._mm is None:
+            return numpy.zeros(0, LOG_DTYPE) if numpy is not None else memoryview(b"")
+        return _records(self._mm, 0, self.count, LOG_DTYPE, LOG_RECORD_SIZE)
+
+    def record(self, index):
+        # (timestamp_us, sensor, status, temperature_c, pressure_hpa, humidity_rh, crc)
+        return LOG_RECORD.unpack_from(self._mm, index * LOG_RECORD_SIZE)
+
+    def damaged(self):
+        # Indices of records whose CRC does not match (normally none)
+        view = memoryview(self._mm) if self._mm is not None else memoryview(b"")
+        bad = []
+        for i in range(self.count):
+            base = i * LOG_RECORD_SIZE
+            if zlib.crc32(view[base:base + 28]) != LOG_RECORD.unpack_from(view, base)[6]:
+                bad.append(i)
+        view.release()
+        return bad
+
+    def close(self):
+        if self._mm is not None:
+            _release(self._mm)
+            self._mm = None
+
+class Ring(object):
+    # Passive reader of a bme280_ring. Unlike C consumers it takes no cursor
+    # slot in the ring (which needs atomic updates), so it is not listed by
+    # consumers(); it waits by polling the head rather than on the futex.
+
+    def __init__(self, name, from_oldest=False):
+        path = os.path.join("/dev/shm", name.lstrip("/"))
+        self._mm = _map(path)
+        magic, version, capacity, record_size = struct.unpack_from("<IIII", self._mm, 0)
+        if (magic != RING_MAGIC or version != RING_VERSION or record_size != LOG_RECORD_SIZE
+                or len(self._mm) != RING_DATA_OFFSET + capacity * LOG_RECORD_SIZE):
+            self._mm.close()
+            raise ValueError("%s is not a version %d bme280 ring" % (name, RING_VERSION))
+        self.capacity = capacity
+        # Aligned 8-byte loads of the head, as the C consumers do
+        self._words = memoryview(self._mm)[:RING_DATA_OFFSET].cast("Q")
+        head = self.head()
+        self.cursor = max(0, head - capacity + 1) if from_oldest else head
+        self.lost = 0
+        self._held = 0
+
+    def head(self):
+        return self._words[RING_HEAD_WORD]
+
+    def peek(self):
+        # (records, lost): unread records in place, up to the end of the ring,
+        # and how many were skipped because the writer lapped this reader
+        head = self.head()
+        skipped = 0
+        if head - self.cursor >= self.capacity:
+            skipped = head - self.capacity + 1 - self.cursor
+            self.cursor += skipped
+            self.lost += skipped
+        first = self.cursor % self.capacity
+        self._held = min(head - self.cursor, self.capacity - first)
+        recs = _records(self._mm, RING_DATA_OFFSET + first * LOG_RECORD_SIZE, self._held,
+                        LOG_DTYPE, LOG_RECORD_SIZE)
+        return recs, skipped
+
+    def release(self, n):
+        # Advance past n peeked records; False if they were overwritten while
+        # in use (the cursor then stays, and the next peek counts the loss)
+        if n > self._held:
+            raise ValueError("release of %d records, %d held" % (n, self._held))
+        self._held = 0
+        if n > 0 and self.head() - self.cursor >= self.capacity:
+            return False
+        self.cursor += n
+        return True
+
+    def wait(self, timeout, interval=0.001):
+        # True once a record is available, False on timeout
+        deadline = time.time() + timeout
+        while self.head() == self.cursor:
+            if time.time() >= deadline:
+                return False
+            time.sleep(interval)
+        return True
+
+    def consumers(self):
+        # (pid, cursor, lost) of each C consumer that has joined
+        out = []
+        for i in range(RING_CONSUMERS):
+            pid, _, cursor, lost = RING_CONSUMER.unpack_from(self._mm, RING_CONSUMER_OFFSET + i * 64)
+            if pid != 0:
+                out.append((pid, cursor, lost))
+        return out
+
+    def close(self):
+        if self._mm is not None:
+            self._words.release()
+            _release(self._mm)
+            self._mm = None
+
+class Segment(object):
+    # bme280_segment file: raw bursts in blocks, plus every sensor's calibration
+
+    def __init__(self, path):
+        self._mm = _map(path)
+        magic, version, sensors, self.block_records, _ = SEGMENT_HEADER.unpack_from(self._mm, 0)
+        if magic != SEGMENT_MAGIC or version != SEGMENT_VERSION:
+            self._mm.close()
+            raise ValueError("%s is not a version %d bme280 segment" % (path, SEGMENT_VERSION))
+
+        self.calib = []
+        base = SEGMENT_HEADER.size
+        for s in range(sensors):
+            regs = self._mm[base + s * SEGMENT_CALIB_SIZE:base + (s + 1) * SEGMENT_CALIB_SIZE]
+            self.calib.append(BME280.parse_calibration(regs[0:24], regs[24], regs[25:32]))
+        self._coeffs = numpy.array(self.calib, dtype=numpy.float64) if numpy is not None else None
+
+        # Block index from the headers alone; a short tail is an unfinished segment
+        self.index = []
+        offset = base + sensors * SEGMENT_CALIB_SIZE
+        while offset + SEGMENT_BLOCK_HEADER.size <= len(self._mm):
+            first_us, last_us, min_s, max_s, count, crc, _ = SEGMENT_BLOCK_HEADER.unpack_from(self._mm, offset)
+            payload = offset + SEGMENT_BLOCK_HEADER.size
+            if count == 0 or count > SEGMENT_MAX_BLOCK or payload + count * SEGMENT_RECORD_SIZE > len(self._mm):
+                break
+            self.index.append((first_us, last_us, min_s, max_s, count, crc, payload))
+            offset = payload + count * SEGMENT_RECORD_SIZE
+
+    def _matching(self, ts_min, ts_max, sensor):
+        # Index entries that may hold matching records, CRC-checked
+        for first_us, last_us, min_s, max_s, count, crc, payload in self.index:
+            if first_us > ts_max:
+                break
+            if last_us < ts_min or (sensor is not None and not min_s <= sensor <= max_s):
+                continue
+            view = memoryview(self._mm)[payload:payload + count * SEGMENT_RECORD_SIZE]
+            ok = zlib.crc32(view) == crc
+            view.release()
+            if not ok:
+                raise ValueError("segment block at offset %d is damaged" % (payload - SEGMENT_BLOCK_HEADER.size))
+            yield first_us, count, payload
+
+    def blocks(self, ts_min=0, ts_max=(1 << 64) - 1, sensor=None):
+        # (first_us, records) of each block that may hold matching records;
+        # records is a SEGMENT_DTYPE array (or memoryview) over the file
+        for first_us, count, payload in self._matching(ts_min, ts_max, sensor):
+            yield first_us, _records(self._mm, payload, count, SEGMENT_DTYPE, SEGMENT_RECORD_SIZE)
+
+    def compensate(self, records):
+        # (cTemp, fTemp, pressure, humidity) arrays for SEGMENT_DTYPE records
+        return compensate(self._coeffs[records["sensor"]], records["burst"])
+
+    def scan(self, ts_min=0, ts_max=(1 << 64) - 1, sensor=None):
+        # Compensated columns of the records in [ts_min, ts_max] (and sensor)
+        _require_numpy()
+        parts = []
+        for first_us, recs in self.blocks(ts_min, ts_max, sensor):
+            ts = recs["offset"].astype(numpy.uint64) + numpy.uint64(first_us)
+            keep = (ts >= ts_min) & (ts <= ts_max)
+            if sensor is not None:
+                keep &= recs["sensor"] == sensor
+            if keep.all():
+                parts.append((ts, recs))
+            elif keep.any():
+                parts.append((ts[keep], recs[keep]))
+
+        ts = numpy.concatenate([t for t, _ in parts]) if parts else numpy.zeros(0, numpy.uint64)
+        recs = numpy.concatenate([r for _, r in parts]) if parts else numpy.zeros(0, SEGMENT_DTYPE)
+        cTemp, fTemp, pressure, humidity = self.compensate(recs)
+        return {"timestamp_us": ts, "sensor": recs["sensor"], "temperature_c": cTemp,
+                "temperature_f": fTemp, "pressure_hpa": pressure, "humidity_rh": humidity}
+
+    def samples(self, ts_min=0, ts_max=(1 << 64) - 1, sensor=None):
+        # Per-record (timestamp_us, sensor, cTemp, fTemp, pressure, humidity),
+        # compensated with BME280.compensate(); works without NumPy
+        for first_us, count, payload in self._matching(ts_min, ts_max, sensor):
+            for i in range(count):
+                offset, s, _, burst = SEGMENT_RECORD.unpack_from(self._mm, payload + i * SEGMENT_RECORD_SIZE)
+                ts = first_us + offset
+                if ts_min <= ts <= ts_max and (sensor is None or s == sensor):
+                    yield (ts, s) + BME280.compensate(self.calib[s], bytearray(burst))
+
+    def close(self):
+        if self._mm is not None:
+            _release(self._mm)
+            self._mm = None
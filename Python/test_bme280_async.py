@@ -0,0 +1,163 @@
+# Distributed with a free-will license.
+# Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+#
+# Tests for bme280_async.py against an in-memory bus (no hardware or smbus):
+#
+#     $> python3 test_bme280_async.py
+
+import asyncio
+import threading
+import time
+import unittest
+
+from bme280_async import AsyncSampler, Sensor
+
+CALIB_TP = [0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC, 0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B,
+            0x27, 0x0B, 0x8C, 0x00, 0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17]
+CALIB_H1 = 75
+CALIB_H = [0x6A, 0x01, 0x00, 0x13, 0x25, 0x03, 0x1E]
+BURST = [0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00, 0x75, 0x30]
+
+class FakeBus(object):
+    # smbus stand-in; fail_burst is raised from the data burst read
+    instances = []
+
+    def __init__(self, bus, fail_burst=None, burst_delay=0.0):
+        self.bus = bus
+        self.fail_burst = fail_burst
+        self.burst_delay = burst_delay
+        self.in_burst = threading.Event()
+        self.closed = False
+        self.closed_during_burst = False
+        self.thread = None
+        self.bursting = False
+        FakeBus.instances.append(self)
+
+    def read_i2c_block_data(self, address, reg, length):
+        self.thread = threading.current_thread().name
+        if reg == 0x88:
+            return list(CALIB_TP)
+        if reg == 0xE1:
+            return list(CALIB_H)
+        if self.fail_burst is not None:
+            raise self.fail_burst
+        self.bursting = True
+        self.in_burst.set()
+        time.sleep(self.burst_delay)
+        self.bursting = False
+        return list(BURST)
+
+    def read_byte_data(self, address, reg):
+        return CALIB_H1
+
+    def write_byte_data(self, address, reg, value):
+        pass
+
+    def close(self):
+        self.closed_during_burst = self.bursting
+        self.closed = True
+
+def factory(fail_burst=None, fail_open_bus=None, burst_delay=0.0):
+    def open_bus(bus):
+        if bus == fail_open_bus:
+            raise OSError("no such bus: %d" % bus)
+        return FakeBus(bus, fail_burst, burst_delay)
+    return open_bus
+
+def run(coro):
+    return asyncio.run(coro)
+
+class AsyncSamplerTest(unittest.TestCase):
+    def setUp(self):
+        FakeBus.instances = []
+
+    def test_samples_per_bus(self):
+        async def body():
+            sensors = [Sensor(1, 0x76), Sensor(1, 0x77), Sensor(2, 0x76)]
+            names = set()
+            async with AsyncSampler(sensors, interval=0.01, smbus_factory=factory()) as sampler:
+                async for sample in sampler:
+                    self.assertAlmostEqual(sample.cTemp, 25.0, delta=15.0)
+                    names.add(sample.name)
+                    if len(names) == 3:
+                        break
+            return names
+        self.assertEqual(run(body()), {"1-0x76", "1-0x77", "2-0x76"})
+        self.assertTrue(all(bus.closed for bus in FakeBus.instances))
+        self.assertNotEqual(FakeBus.instances[0].thread, FakeBus.instances[1].thread)
+
+    def test_task_failure_reaches_iterator(self):
+        async def body():
+            sampler = AsyncSampler([Sensor(1)], interval=0.01,
+                                   smbus_factory=factory(fail_burst=ValueError("bad burst")))
+            async with sampler:
+                with self.assertRaises(ValueError):
+                    await asyncio.wait_for(sampler.__anext__(), 2.0)
+        run(body())
+
+    def test_io_error_skips_sensor(self):
+        async def body():
+            sampler = AsyncSampler([Sensor(1)], interval=0.01,
+                                   smbus_factory=factory(fail_burst=IOError("nak")))
+            async with sampler:
+                with self.assertRaises(asyncio.TimeoutError):
+                    await asyncio.wait_for(sampler.__anext__(), 0.1)
+        run(body())
+
+    def test_close_ends_iteration(self):
+        async def body():
+            sampler = AsyncSampler([Sensor(1)], interval=10.0, smbus_factory=factory())
+            await sampler.start()
+            await sampler.__anext__()
+
+            # An iterator blocked on the empty queue is released by close()
+            async def consume():
+                return [sample async for sample in sampler]
+            consumer = asyncio.ensure_future(consume())
+            await asyncio.sleep(0.05)
+            await sampler.close()
+            self.assertEqual(await asyncio.wait_for(consumer, 2.0), [])
+            with self.assertRaises(StopAsyncIteration):
+                await sampler.__anext__()
+        run(body())
+
+    def test_close_does_not_block_loop(self):
+        async def body():
+            loop = asyncio.get_running_loop()
+            sampler = AsyncSampler([Sensor(1)], interval=0.01,
+                                   smbus_factory=factory(burst_delay=0.3))
+            await sampler.start()
+            bus = FakeBus.instances[0]
+            await loop.run_in_executor(None, bus.in_burst.wait, 2.0)
+
+            # The loop keeps ticking while close() waits out the running sweep
+            ticks = []
+            async def ticker():
+                while True:
+                    ticks.append(loop.time())
+                    await asyncio.sleep(0.01)
+            ticking = asyncio.ensure_future(ticker())
+            started = loop.time()
+            await sampler.close()
+            elapsed = loop.time() - started
+            ticking.cancel()
+            return elapsed, len(ticks)
+        elapsed, ticks = run(body())
+        self.assertGreater(elapsed, 0.1)
+        self.assertGreater(ticks, 5)
+        self.assertTrue(FakeBus.instances[0].closed)
+        self.assertFalse(FakeBus.instances[0].closed_during_burst)
+
+    def test_partial_start_cleans_up(self):
+        async def body():
+            sampler = AsyncSampler([Sensor(1), Sensor(2)], smbus_factory=factory(fail_open_bus=2))
+            with self.assertRaises(OSError):
+                await sampler.start()
+            self.assertEqual(sampler._executors, {})
+            self.assertEqual(sampler._buses, {})
+        run(body())
+        self.assertEqual(len(FakeBus.instances), 1)
+        self.assertTrue(FakeBus.instances[0].closed)
+
+if __name__ == "__main__":
+    unittest.main()
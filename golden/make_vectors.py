@@ -0,0 +1,93 @@
+# Distributed with a free-will license.
+# Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+# BME280
+#
+# Generate the shared golden vector file used by run_golden.py.
+#
+# Each vector is a calibration block, a raw data burst and the expected
+# compensated output, computed here in double precision straight from the
+# datasheet formulas (t_fine truncated to an integer as in the datasheet).
+# Ports are measured against these values, never against each other.
+#
+# Usage: python make_vectors.py > bme280_golden.csv
+
+from __future__ import print_function
+
+import random
+
+VECTORS = 256
+SEED = 280
+
+# Datasheet example trimming (T, P) plus a typical humidity set
+EXAMPLE = dict(T1=27504, T2=26435, T3=-1000,
+               P1=36477, P2=-10685, P3=3024, P4=2855, P5=140, P6=-7,
+               P7=15500, P8=-14600, P9=6000,
+               H1=75, H2=362, H3=0, H4=309, H5=50, H6=30)
+
+def u16(v):
+    return [v & 0xFF, (v >> 8) & 0xFF]
+
+def encode_calib(c):
+    tp = []
+    for name in ("T1", "T2", "T3", "P1", "P2", "P3", "P4", "P5", "P6", "P7", "P8", "P9"):
+        tp += u16(c[name] & 0xFFFF)
+    hum = u16(c["H2"] & 0xFFFF) + [c["H3"] & 0xFF,
+                                   (c["H4"] >> 4) & 0xFF,
+                                   (c["H4"] & 0x0F) | ((c["H5"] & 0x0F) << 4),
+                                   (c["H5"] >> 4) & 0xFF,
+                                   c["H6"] & 0xFF]
+    return tp + [c["H1"]] + hum
+
+def encode_burst(adc_t, adc_p, adc_h):
+    return [(adc_p >> 12) & 0xFF, (adc_p >> 4) & 0xFF, (adc_p << 4) & 0xF0,
+            (adc_t >> 12) & 0xFF, (adc_t >> 4) & 0xFF, (adc_t << 4) & 0xF0,
+            (adc_h >> 8) & 0xFF, adc_h & 0xFF]
+
+def reference(c, adc_t, adc_p, adc_h):
+    var1 = (adc_t / 16384.0 - c["T1"] / 1024.0) * c["T2"]
+    var2 = ((adc_t / 131072.0 - c["T1"] / 8192.0) ** 2) * c["T3"]
+    t_fine = int(var1 + var2)
+    temperature = (var1 + var2) / 5120.0
+
+    var1 = t_fine / 2.0 - 64000.0
+    var2 = var1 * var1 * c["P6"] / 32768.0
+    var2 = var2 + var1 * c["P5"] * 2.0
+    var2 = var2 / 4.0 + c["P4"] * 65536.0
+    var1 = (c["P3"] * var1 * var1 / 524288.0 + c["P2"] * var1) / 524288.0
+    var1 = (1.0 + var1 / 32768.0) * c["P1"]
+    p = 1048576.0 - adc_p
+    p = (p - var2 / 4096.0) * 6250.0 / var1
+    var1 = c["P9"] * p * p / 2147483648.0
+    var2 = p * c["P8"] / 32768.0
+    pressure = (p + (var1 + var2 + c["P7"]) / 16.0) / 100.0
+
+    h = t_fine - 76800.0
+    h = (adc_h - (c["H4"] * 64.0 + c["H5"] / 16384.0 * h)) * \
+        (c["H2"] / 65536.0 * (1.0 + c["H6"] / 67108864.0 * h * (1.0 + c["H3"] / 67108864.0 * h)))
+    humidity = min(100.0, max(0.0, h * (1.0 - c["H1"] * h / 524288.0)))
+    return temperature, pressure, humidity
+
+def random_calib(rng):
+    return dict(T1=rng.randint(25000, 35000), T2=rng.randint(24000, 28000), T3=rng.randint(-1500, 500),
+                P1=rng.randint(30000, 40000), P2=rng.randint(-11000, -9000), P3=rng.randint(2000, 4000),
+                P4=rng.randint(2000, 8000), P5=rng.randint(-200, 200), P6=rng.randint(-10, 10),
+                P7=rng.randint(9000, 16000), P8=rng.randint(-15000, -9000), P9=rng.randint(4000, 6000),
+                H1=rng.randint(70, 80), H2=rng.randint(350, 380), H3=rng.randint(0, 5),
+                H4=rng.randint(280, 350), H5=rng.randint(40, 60), H6=rng.randint(25, 35))
+
+def main():
+    rng = random.Random(SEED)
+    print("# BME280 golden vectors: calib_hex (0x88-0x9F, 0xA1, 0xE1-0xE7), burst_hex (0xF7-0xFE),")
+    print("# temperature_c, pressure_hpa, humidity_rh. Generated by make_vectors.py; do not edit.")
+    for i in range(VECTORS):
+        c = EXAMPLE if i == 0 else random_calib(rng)
+        adc_t = 519888 if i == 0 else rng.randint(400000, 600000)
+        adc_p = 415148 if i == 0 else rng.randint(250000, 500000)
+        adc_h = 30000 if i == 0 else rng.randint(20000, 40000)
+        t, p, h = reference(c, adc_t, adc_p, adc_h)
+        calib_hex = "".join("%02x" % b for b in encode_calib(c))
+        burst_hex = "".join("%02x" % b for b in encode_burst(adc_t, adc_p, adc_h))
+        print("%s,%s,%.6f,%.6f,%.6f" % (calib_hex, burst_hex, t, p, h))
+
+if __name__ == "__main__":
+    main()
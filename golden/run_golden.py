@@ -0,0 +1,120 @@
+# Distributed with a free-will license.
+# Use it any way you want, profit or free, provided it fits in the licenses of its associated works.
+# BME280
+#
+# Cross-port consistency and throughput check against the shared golden vectors.
+#
+# Runs the C library (C/bench/golden_bme280), the Python port
+# (Python/BME280.py compensate()), its vectorized form (Python/bme280_mmap.py,
+# when NumPy is installed) and, when a JDK is installed, the Java port
+# (Java/BME280Compensation.java) over bme280_golden.csv, then prints
+# throughput and the maximum deviation from the expected outputs per port.
+#
+# Usage: python run_golden.py [passes]
+
+from __future__ import print_function
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(HERE)
+VECTORS = os.path.join(HERE, "bme280_golden.csv")
+
+def load_vectors():
+    vectors = []
+    with open(VECTORS) as f:
+        for line in f:
+            if line.startswith("#") or not line.strip():
+                continue
+            calib_hex, burst_hex, t, p, h = line.strip().split(",")
+            calib = bytearray.fromhex(calib_hex)
+            burst = bytearray.fromhex(burst_hex)
+            vectors.append((calib, burst, (float(t), float(p), float(h))))
+    return vectors
+
+def run_python(passes):
+    sys.path.insert(0, os.path.join(ROOT, "Python"))
+    import BME280
+
+    vectors = load_vectors()
+    calibs = [BME280.parse_calibration(c[0:24], c[24], c[25:32]) for c, _, _ in vectors]
+    max_dev = [0.0, 0.0, 0.0]
+    for calib, (_, burst, expected) in zip(calibs, vectors):
+        c_temp, _, pressure, humidity = BME280.compensate(calib, burst)
+        for k, actual in enumerate((c_temp, pressure, humidity)):
+            max_dev[k] = max(max_dev[k], abs(actual - expected[k]))
+
+    start = time.time()
+    for _ in range(passes):
+        for calib, (_, burst, _) in zip(calibs, vectors):
+            BME280.compensate(calib, burst)
+    elapsed = time.time() - start
+    ns = elapsed * 1e9 / (passes * len(vectors))
+    return "python,%d,%.1f,%.6f,%.6f,%.6f" % ((len(vectors), ns) + tuple(max_dev))
+
+def run_numpy(passes):
+    sys.path.insert(0, os.path.join(ROOT, "Python"))
+    import BME280
+    import bme280_mmap
+    if bme280_mmap.numpy is None:
+        return None
+    numpy = bme280_mmap.numpy
+
+    vectors = load_vectors()
+    calibs = numpy.array([BME280.parse_calibration(c[0:24], c[24], c[25:32]) for c, _, _ in vectors])
+    bursts = numpy.array([bytes(b) for _, b, _ in vectors]).view(numpy.uint8).reshape(-1, 8)
+    expected = numpy.array([e for _, _, e in vectors])
+    c_temp, _, pressure, humidity = bme280_mmap.compensate(calibs, bursts)
+    max_dev = numpy.abs(numpy.stack([c_temp, pressure, humidity], axis=1) - expected).max(axis=0)
+
+    start = time.time()
+    for _ in range(passes):
+        bme280_mmap.compensate(calibs, bursts)
+    elapsed = time.time() - start
+    ns = elapsed * 1e9 / (passes * len(vectors))
+    return "numpy,%d,%.1f,%.6f,%.6f,%.6f" % ((len(vectors), ns) + tuple(max_dev))
+
+def run_c(passes):
+    bench = os.path.join(ROOT, "C", "bench")
+    subprocess.check_call(["make", "-s", "golden_bme280"], cwd=bench)
+    out = subprocess.check_output([os.path.join(bench, "golden_bme280"), VECTORS, str(passes)])
+    return out.decode().strip()
+
+def run_java(passes):
+    if shutil.which("javac") is None or shutil.which("java") is None:
+        return None
+    java = os.path.join(ROOT, "Java")
+    classes = tempfile.mkdtemp(prefix="bme280_golden_")
+    try:
+        subprocess.check_call(["javac", "-d", classes,
+                               os.path.join(java, "BME280Compensation.java"),
+                               os.path.join(java, "GoldenVectors.java")])
+        out = subprocess.check_output(["java", "-cp", classes, "GoldenVectors", VECTORS, str(passes)])
+        return out.decode().strip()
+    finally:
+        shutil.rmtree(classes, ignore_errors=True)
+
+def main():
+    passes = int(sys.argv[1]) if len(sys.argv) > 1 else 200
+    rows = [run_c(passes * 10), run_python(max(1, passes // 10)), run_numpy(passes),
+            run_java(passes * 10)]
+
+    print("%-8s %8s %12s %12s %12s %12s" % ("port", "vectors", "ns/sample", "max dT (C)",
+                                              "max dP (hPa)", "max dH (%RH)"))
+    for row in rows:
+        if row is None:
+            continue
+        port, count, ns, dt, dp, dh = row.split(",")
+        print("%-8s %8s %12s %12s %12s %12s" % (port, count, ns, dt, dp, dh))
+    if rows[2] is None:
+        print("numpy: skipped (NumPy not installed)")
+    if rows[3] is None:
+        print("java: skipped (no JDK on PATH)")
+
+if __name__ == "__main__":
+    main()